@@ -0,0 +1,66 @@
+#!/bin/sh
+#
+# Runs scripts against a trace recorded with jse --cosa-record and prints
+# how long each takes.
+#
+# Usage: replay.sh [-j JSE] [-n RUNS] [-s PERCENT] [-o "OPTIONS"] TRACE SCRIPT...
+
+JSE=jse
+RUNS=10
+SCALE=100
+OPTIONS=
+
+while getopts "j:n:s:o:" opt; do
+    case $opt in
+        j) JSE=$OPTARG ;;
+        n) RUNS=$OPTARG ;;
+        s) SCALE=$OPTARG ;;
+        o) OPTIONS=$OPTARG ;;
+        *) exit 1 ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+if [ $# -lt 2 ]; then
+    echo "Usage: $0 [-j JSE] [-n RUNS] [-s PERCENT] [-o \"OPTIONS\"] TRACE SCRIPT..." >&2
+    exit 1
+fi
+
+TRACE=$1
+shift
+
+# Milliseconds since the epoch
+now() {
+    echo $(($(date +%s%N) / 1000000))
+}
+
+printf "%-32s %6s %8s %8s %8s\n" "script" "failed" "min ms" "avg ms" "max ms"
+
+for script in "$@"; do
+    failed=0
+    total=0
+    min=
+    max=0
+    run=0
+
+    while [ $run -lt "$RUNS" ]; do
+        start=$(now)
+        # shellcheck disable=SC2086
+        if ! "$JSE" --cosad-socket=none --cosa-replay="$TRACE" --cosa-replay-scale="$SCALE" \
+            $OPTIONS "$script" > /dev/null 2>&1 < /dev/null; then
+            failed=$((failed + 1))
+        fi
+        elapsed=$(($(now) - start))
+
+        total=$((total + elapsed))
+        if [ -z "$min" ] || [ $elapsed -lt "$min" ]; then
+            min=$elapsed
+        fi
+        if [ $elapsed -gt $max ]; then
+            max=$elapsed
+        fi
+        run=$((run + 1))
+    done
+
+    printf "%-32s %6d %8d %8d %8d\n" "$(basename "$script")" $failed "$min" $((total / RUNS)) $max
+done
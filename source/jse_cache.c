@@ -0,0 +1,429 @@
+/*****************************************************************************
+*
+* Copyright 2020 Liberty Global B.V.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*****************************************************************************/
+
+#include <string.h>
+#include <errno.h>
+
+#include "jse_debug.h"
+#include "jse_common.h"
+#include "jse_stats.h"
+#include "jse_cache.h"
+
+/** The vary header list of a script */
+struct vary_item_s
+{
+    char * script;
+    char * vary;
+    struct vary_item_s * next;
+};
+
+typedef struct vary_item_s vary_item_t;
+
+/** The vary header lists */
+static vary_item_t * first_vary_item = NULL;
+
+/** The most recently used entry */
+static jse_cache_entry_t * first_entry = NULL;
+
+/** The least recently used entry */
+static jse_cache_entry_t * last_entry = NULL;
+
+/** The memory limit */
+static size_t cache_limit = JSE_CACHE_DEFAULT_LIMIT;
+
+/** The memory in use */
+static size_t cache_size = 0;
+
+/**
+ * @brief Returns the memory used by an entry.
+ *
+ * @param entry the entry.
+ * @return the size in bytes.
+ */
+static size_t entry_size(const jse_cache_entry_t * entry)
+{
+    return sizeof(jse_cache_entry_t) + strlen(entry->key) + strlen(entry->contenttype)
+        + entry->headers_length + entry->body_length;
+}
+
+/**
+ * @brief Unlinks an entry from the list.
+ *
+ * @param entry the entry.
+ */
+static void unlink_entry(jse_cache_entry_t * entry)
+{
+    if (entry->prev != NULL)
+    {
+        entry->prev->next = entry->next;
+    }
+    else
+    {
+        first_entry = entry->next;
+    }
+
+    if (entry->next != NULL)
+    {
+        entry->next->prev = entry->prev;
+    }
+    else
+    {
+        last_entry = entry->prev;
+    }
+
+    entry->prev = NULL;
+    entry->next = NULL;
+}
+
+/**
+ * @brief Links an entry at the head of the list.
+ *
+ * @param entry the entry.
+ */
+static void link_entry(jse_cache_entry_t * entry)
+{
+    entry->prev = NULL;
+    entry->next = first_entry;
+
+    if (first_entry != NULL)
+    {
+        first_entry->prev = entry;
+    }
+    else
+    {
+        last_entry = entry;
+    }
+
+    first_entry = entry;
+}
+
+/**
+ * @brief Unlinks and frees an entry.
+ *
+ * @param entry the entry.
+ */
+static void free_entry(jse_cache_entry_t * entry)
+{
+    unlink_entry(entry);
+
+    cache_size -= entry_size(entry);
+    jse_stats_set("cache.bytes", (long)cache_size);
+
+    free(entry->key);
+    free(entry->contenttype);
+    free(entry->headers);
+    free(entry->body);
+    free(entry);
+}
+
+/**
+ * @brief Finds an entry.
+ *
+ * @param key the key.
+ * @return the entry or NULL.
+ */
+static jse_cache_entry_t * find_entry(const char * key)
+{
+    jse_cache_entry_t * entry = first_entry;
+
+    while (entry != NULL && strcmp(entry->key, key))
+    {
+        entry = entry->next;
+    }
+
+    return entry;
+}
+
+/**
+ * @brief Evicts entries until there is room for a new entry.
+ *
+ * Expired entries go first then the least recently used.
+ *
+ * @param size the size of the new entry.
+ */
+static void make_room(size_t size)
+{
+    uint64_t now = jse_time_usec();
+    jse_cache_entry_t * entry = first_entry;
+
+    while (entry != NULL)
+    {
+        jse_cache_entry_t * next = entry->next;
+
+        if (now >= entry->stale_until_usec)
+        {
+            free_entry(entry);
+        }
+
+        entry = next;
+    }
+
+    while (last_entry != NULL && cache_size + size > cache_limit)
+    {
+        JSE_VERBOSE("Evicting: %s", last_entry->key)
+
+        free_entry(last_entry);
+        jse_stats_add("cache.evict", 1);
+    }
+}
+
+/**
+ * @brief Sets the memory limit of the cache.
+ *
+ * @param limit the limit in bytes.
+ */
+void jse_cache_set_limit(size_t limit)
+{
+    cache_limit = limit;
+    make_room(0);
+}
+
+/**
+ * @brief Returns the memory limit of the cache.
+ *
+ * @return the limit in bytes.
+ */
+size_t jse_cache_get_limit(void)
+{
+    return cache_limit;
+}
+
+/**
+ * @brief Looks up an entry.
+ *
+ * @param key the key.
+ * @param pentry a pointer to the returned entry.
+ * @return the state of the entry.
+ */
+jse_cache_state_t jse_cache_lookup(const char * key, jse_cache_entry_t ** pentry)
+{
+    jse_cache_state_t state = JSE_CACHE_MISS;
+    jse_cache_entry_t * entry = find_entry(key);
+
+    *pentry = NULL;
+
+    if (entry != NULL)
+    {
+        uint64_t now = jse_time_usec();
+
+        if (now < entry->fresh_until_usec)
+        {
+            state = JSE_CACHE_FRESH;
+        }
+        else if (now < entry->stale_until_usec)
+        {
+            state = JSE_CACHE_STALE;
+        }
+        else
+        {
+            free_entry(entry);
+            entry = NULL;
+        }
+    }
+
+    if (entry != NULL)
+    {
+        /* Most recently used */
+        unlink_entry(entry);
+        link_entry(entry);
+
+        *pentry = entry;
+    }
+
+    switch (state)
+    {
+        case JSE_CACHE_FRESH:
+            jse_stats_add("cache.hit", 1);
+            break;
+        case JSE_CACHE_STALE:
+            jse_stats_add("cache.stale", 1);
+            break;
+        default:
+            jse_stats_add("cache.miss", 1);
+            break;
+    }
+
+    return state;
+}
+
+/**
+ * @brief Stores an entry replacing any existing entry with the same key.
+ *
+ * @param key the key.
+ * @param status the HTTP status.
+ * @param contenttype the content type.
+ * @param headers the headers.
+ * @param headers_length the length of the headers.
+ * @param body the body.
+ * @param body_length the length of the body.
+ * @param ttl_secs the time the entry is fresh for.
+ * @param stale_secs the time after that the entry may be used while revalidating.
+ * @return 0 on success or -1 on error.
+ */
+int jse_cache_store(const char * key, int status, const char * contenttype,
+    const char * headers, size_t headers_length, const void * body, size_t body_length,
+    long ttl_secs, long stale_secs)
+{
+    jse_cache_entry_t * entry = NULL;
+    size_t size = 0;
+    uint64_t now = jse_time_usec();
+
+    JSE_ENTER("jse_cache_store(\"%s\",%d,...)", key)
+
+    jse_cache_remove(key);
+
+    size = sizeof(jse_cache_entry_t) + strlen(key) + strlen(contenttype) + headers_length + body_length;
+    if (size > cache_limit)
+    {
+        JSE_VERBOSE("Too big to cache: %s (%lu)", key, (unsigned long)size)
+        JSE_EXIT("jse_cache_store()=-1")
+        return -1;
+    }
+
+    entry = (jse_cache_entry_t *)calloc(1, sizeof(jse_cache_entry_t));
+    if (entry == NULL)
+    {
+        JSE_ERROR("calloc() failed: %s", strerror(errno))
+        JSE_EXIT("jse_cache_store()=-1")
+        return -1;
+    }
+
+    entry->key = strdup(key);
+    entry->contenttype = strdup(contenttype);
+    entry->headers = (char *)malloc(headers_length + 1);
+    entry->body = malloc(body_length + 1);
+    if (entry->key == NULL || entry->contenttype == NULL || entry->headers == NULL || entry->body == NULL)
+    {
+        JSE_ERROR("Out of memory!")
+
+        free(entry->key);
+        free(entry->contenttype);
+        free(entry->headers);
+        free(entry->body);
+        free(entry);
+
+        JSE_EXIT("jse_cache_store()=-1")
+        return -1;
+    }
+
+    memcpy(entry->headers, headers, headers_length);
+    entry->headers_length = headers_length;
+    memcpy(entry->body, body, body_length);
+    entry->body_length = body_length;
+    entry->status = status;
+    entry->fresh_until_usec = now + ((uint64_t)ttl_secs * 1000000);
+    entry->stale_until_usec = entry->fresh_until_usec + ((uint64_t)stale_secs * 1000000);
+
+    make_room(size);
+    link_entry(entry);
+
+    cache_size += size;
+    jse_stats_set("cache.bytes", (long)cache_size);
+    jse_stats_add("cache.store", 1);
+
+    JSE_EXIT("jse_cache_store()=0")
+    return 0;
+}
+
+/**
+ * @brief Removes an entry.
+ *
+ * @param key the key.
+ */
+void jse_cache_remove(const char * key)
+{
+    jse_cache_entry_t * entry = find_entry(key);
+
+    if (entry != NULL)
+    {
+        free_entry(entry);
+    }
+}
+
+/**
+ * @brief Records the headers a script's cached responses vary on.
+ *
+ * @param script the script filename.
+ * @param vary a comma separated list of header names or NULL.
+ */
+void jse_cache_set_vary(const char * script, const char * vary)
+{
+    vary_item_t * item = first_vary_item;
+    char * copy = NULL;
+
+    while (item != NULL && strcmp(item->script, script))
+    {
+        item = item->next;
+    }
+
+    if (item != NULL)
+    {
+        if ((item->vary == NULL && vary == NULL) ||
+            (item->vary != NULL && vary != NULL && !strcmp(item->vary, vary)))
+        {
+            /* Unchanged */
+            return;
+        }
+    }
+
+    if (vary != NULL && (copy = strdup(vary)) == NULL)
+    {
+        JSE_ERROR("strdup() failed: %s", strerror(errno))
+        return;
+    }
+
+    if (item == NULL)
+    {
+        item = (vary_item_t *)calloc(1, sizeof(vary_item_t));
+        if (item == NULL || (item->script = strdup(script)) == NULL)
+        {
+            JSE_ERROR("Out of memory!")
+            free(item);
+            free(copy);
+            return;
+        }
+
+        item->next = first_vary_item;
+        first_vary_item = item;
+    }
+
+    free(item->vary);
+    item->vary = copy;
+}
+
+/**
+ * @brief Returns the headers a script's cached responses vary on.
+ *
+ * @param script the script filename.
+ * @param pvary a pointer to return the comma separated list of header
+ * names or NULL.
+ * @return true if the script has declared its responses cacheable.
+ */
+bool jse_cache_get_vary(const char * script, const char ** pvary)
+{
+    vary_item_t * item = first_vary_item;
+
+    while (item != NULL && strcmp(item->script, script))
+    {
+        item = item->next;
+    }
+
+    *pvary = item != NULL ? item->vary : NULL;
+
+    return item != NULL;
+}
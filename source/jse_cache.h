@@ -0,0 +1,152 @@
+/*****************************************************************************
+*
+* Copyright 2020 Liberty Global B.V.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*****************************************************************************/
+
+#ifndef JSE_CACHE_H
+#define JSE_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/** The default memory limit of the response cache */
+#define JSE_CACHE_DEFAULT_LIMIT (256 * 1024)
+
+/** A cached response */
+struct jse_cache_entry_s
+{
+    /** The key */
+    char * key;
+    /** The HTTP status */
+    int status;
+    /** The content type */
+    char * contenttype;
+    /** The headers, each of the form "name: value\r\n" */
+    char * headers;
+    /** The length of the headers */
+    size_t headers_length;
+    /** The body */
+    void * body;
+    /** The length of the body */
+    size_t body_length;
+    /** The time until which the entry is fresh */
+    uint64_t fresh_until_usec;
+    /** The time until which the entry may be used while revalidating */
+    uint64_t stale_until_usec;
+    /** The previous entry, more recently used */
+    struct jse_cache_entry_s * prev;
+    /** The next entry, less recently used */
+    struct jse_cache_entry_s * next;
+};
+
+/** The cache entry type */
+typedef struct jse_cache_entry_s jse_cache_entry_t;
+
+/** The result of a cache lookup */
+enum jse_cache_state_e
+{
+    JSE_CACHE_MISS = 0,
+    JSE_CACHE_FRESH,
+    JSE_CACHE_STALE
+};
+
+/** The cache state type */
+typedef enum jse_cache_state_e jse_cache_state_t;
+
+/**
+ * @brief Sets the memory limit of the cache.
+ *
+ * Entries are evicted, least recently used first, to stay within the
+ * limit. A limit of 0 disables the cache.
+ *
+ * @param limit the limit in bytes.
+ */
+void jse_cache_set_limit(size_t limit);
+
+/**
+ * @brief Returns the memory limit of the cache.
+ *
+ * @return the limit in bytes.
+ */
+size_t jse_cache_get_limit(void);
+
+/**
+ * @brief Looks up an entry.
+ *
+ * A stale entry is one whose time to live has passed but which may still
+ * be returned while a fresh copy is generated. Expired entries are removed.
+ *
+ * @param key the key.
+ * @param pentry a pointer to the returned entry.
+ * @return the state of the entry.
+ */
+jse_cache_state_t jse_cache_lookup(const char * key, jse_cache_entry_t ** pentry);
+
+/**
+ * @brief Stores an entry replacing any existing entry with the same key.
+ *
+ * The data is copied.
+ *
+ * @param key the key.
+ * @param status the HTTP status.
+ * @param contenttype the content type.
+ * @param headers the headers.
+ * @param headers_length the length of the headers.
+ * @param body the body.
+ * @param body_length the length of the body.
+ * @param ttl_secs the time the entry is fresh for.
+ * @param stale_secs the time after that the entry may be used while revalidating.
+ * @return 0 on success or -1 on error.
+ */
+int jse_cache_store(const char * key, int status, const char * contenttype,
+    const char * headers, size_t headers_length, const void * body, size_t body_length,
+    long ttl_secs, long stale_secs);
+
+/**
+ * @brief Removes an entry.
+ *
+ * @param key the key.
+ */
+void jse_cache_remove(const char * key);
+
+/**
+ * @brief Records the headers a script's cached responses vary on.
+ *
+ * @param script the script filename.
+ * @param vary a comma separated list of header names or NULL.
+ */
+void jse_cache_set_vary(const char * script, const char * vary);
+
+/**
+ * @brief Returns the headers a script's cached responses vary on.
+ *
+ * @param script the script filename.
+ * @param pvary a pointer to return the comma separated list of header
+ * names or NULL.
+ * @return true if the script has declared its responses cacheable.
+ */
+bool jse_cache_get_vary(const char * script, const char ** pvary);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
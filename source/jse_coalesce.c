@@ -0,0 +1,567 @@
+/*****************************************************************************
+*
+* Copyright 2020 Liberty Global B.V.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include "jse_debug.h"
+#include "jse_common.h"
+#include "jse_stats.h"
+#include "jse_coalesce.h"
+
+/** Identifies a response file */
+#define RESPONSE_MAGIC 0x4A534543
+
+/** The interval at which a follower polls the lock */
+#define POLL_INTERVAL_USEC 5000
+
+/** The interval at which old lock and response files are removed, and
+    the time, beyond the longest wait, they are unused before they are */
+#define SWEEP_INTERVAL_SECS 60
+
+/** The response file header. The strings and data follow. */
+struct response_header_s
+{
+    uint32_t magic;
+    int32_t status;
+    uint64_t time_usec;
+    uint32_t key_length;
+    uint32_t vary_length;
+    uint32_t contenttype_length;
+    uint32_t headers_length;
+    uint32_t body_length;
+    int32_t ttl_secs;
+    int32_t stale_secs;
+};
+
+typedef struct response_header_s response_header_t;
+
+/** The directory for the lock and response files */
+static const char * coalesce_dir = JSE_COALESCE_DEFAULT_DIR;
+
+/** The lock file descriptor while the leader */
+static int lock_fd = -1;
+
+/** The path of the response file less the extension while the leader */
+static char base_path[PATH_MAX];
+
+/** The longest time waited for a leader's response */
+static long longest_wait_ms = 0;
+
+/** The time the directory was last swept */
+static uint64_t swept_usec = 0;
+
+/**
+ * @brief Hashes a key with the 64 bit FNV-1a hash.
+ *
+ * @param key the key.
+ * @return the hash.
+ */
+static uint64_t hash_key(const char * key)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    while (*key != '\0')
+    {
+        hash ^= (uint8_t)*key++;
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Copies a string out of a response buffer.
+ *
+ * @param buffer the buffer.
+ * @param off the offset of the string.
+ * @param length the length of the string.
+ * @return the string which must be freed or NULL on error.
+ */
+static char * copy_string(const char * buffer, size_t off, size_t length)
+{
+    char * str = (char *)malloc(length + 1);
+
+    if (str != NULL)
+    {
+        memcpy(str, &buffer[off], length);
+        str[length] = '\0';
+    }
+    else
+    {
+        JSE_ERROR("malloc() failed: %s", strerror(errno))
+    }
+
+    return str;
+}
+
+/**
+ * @brief Tests whether an open file is a regular file owned by us.
+ *
+ * @param fd the file descriptor.
+ * @return true if it is.
+ */
+static bool owned_file(int fd)
+{
+    struct stat st;
+
+    return fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_uid == geteuid();
+}
+
+/**
+ * @brief Reads the response file published by the leader.
+ *
+ * @param since only return a response published after this time.
+ * @return the response or NULL if there is no valid response.
+ */
+static jse_coalesce_response_t * read_response(uint64_t since)
+{
+    jse_coalesce_response_t * response = NULL;
+    response_header_t header;
+    char path[PATH_MAX];
+    void * buffer = NULL;
+    size_t size = 0;
+    size_t off = sizeof(response_header_t);
+    int fd = -1;
+
+    snprintf(path, sizeof(path), "%s.resp", base_path);
+
+    fd = open(path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd == -1)
+    {
+        JSE_VERBOSE("No response: %s", path)
+        return NULL;
+    }
+
+    /* Only trust a response we wrote ourselves */
+    if (!owned_file(fd))
+    {
+        JSE_WARNING("Ignoring response not owned by us: %s", path)
+        close(fd);
+        return NULL;
+    }
+
+    if (jse_read_fd(fd, &buffer, &size) < (ssize_t)sizeof(response_header_t))
+    {
+        JSE_WARNING("Failed to read response: %s", path)
+        close(fd);
+        free(buffer);
+        return NULL;
+    }
+
+    close(fd);
+
+    memcpy(&header, buffer, sizeof(header));
+    if (header.magic != RESPONSE_MAGIC || header.time_usec < since ||
+        size != sizeof(header) + header.key_length + header.vary_length + header.contenttype_length +
+            header.headers_length + header.body_length)
+    {
+        JSE_VERBOSE("Old or invalid response: %s", path)
+        free(buffer);
+        return NULL;
+    }
+
+    response = (jse_coalesce_response_t *)calloc(1, sizeof(jse_coalesce_response_t));
+    if (response != NULL)
+    {
+        response->key = copy_string(buffer, off, header.key_length);
+        off += header.key_length;
+
+        if (header.vary_length > 0)
+        {
+            response->vary = copy_string(buffer, off, header.vary_length);
+            off += header.vary_length;
+        }
+
+        response->contenttype = copy_string(buffer, off, header.contenttype_length);
+        off += header.contenttype_length;
+
+        response->headers = copy_string(buffer, off, header.headers_length);
+        response->headers_length = header.headers_length;
+        off += header.headers_length;
+
+        response->body = copy_string(buffer, off, header.body_length);
+        response->body_length = header.body_length;
+
+        response->status = header.status;
+        response->ttl_secs = header.ttl_secs;
+        response->stale_secs = header.stale_secs;
+
+        if (response->key == NULL || (header.vary_length > 0 && response->vary == NULL) ||
+            response->contenttype == NULL || response->headers == NULL || response->body == NULL)
+        {
+            jse_coalesce_response_free(response);
+            response = NULL;
+        }
+    }
+    else
+    {
+        JSE_ERROR("calloc() failed: %s", strerror(errno))
+    }
+
+    free(buffer);
+
+    return response;
+}
+
+/**
+ * @brief Tests whether a filename ends with an extension.
+ *
+ * @param name the filename.
+ * @param ext the extension.
+ * @return true if it does.
+ */
+static bool has_extension(const char * name, const char * ext)
+{
+    size_t name_length = strlen(name);
+    size_t ext_length = strlen(ext);
+
+    return name_length > ext_length && !strcmp(&name[name_length - ext_length], ext);
+}
+
+/**
+ * @brief Removes a lock file if it is old and not locked.
+ *
+ * @param path the lock file path.
+ * @param oldest the modification time, in seconds, of the newest file to remove.
+ * @return true if removed.
+ */
+static bool remove_lock(const char * path, time_t oldest)
+{
+    struct stat st;
+    bool removed = false;
+    int fd = open(path, O_RDWR | O_NOFOLLOW | O_CLOEXEC);
+
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    /* Held by a leader, or touched since, means in use */
+    if (flock(fd, LOCK_EX | LOCK_NB) == 0)
+    {
+        if (fstat(fd, &st) == 0 && st.st_mtime <= oldest && unlink(path) == 0)
+        {
+            removed = true;
+        }
+
+        (void) flock(fd, LOCK_UN);
+    }
+
+    close(fd);
+
+    return removed;
+}
+
+/**
+ * @brief Removes the lock and response files of requests no longer being
+ * handled.
+ *
+ * Each request key has its own files, so without this they would build up
+ * for as long as the device runs.
+ */
+static void sweep(void)
+{
+    char path[PATH_MAX];
+    struct dirent * de = NULL;
+    struct stat st;
+    time_t oldest = time(NULL) - SWEEP_INTERVAL_SECS - (time_t)(longest_wait_ms / 1000);
+    long removed = 0;
+    DIR * dir = opendir(coalesce_dir);
+
+    if (dir == NULL)
+    {
+        JSE_ERROR("opendir(\"%s\") failed: %s", coalesce_dir, strerror(errno))
+        return;
+    }
+
+    while ((de = readdir(dir)) != NULL)
+    {
+        if (snprintf(path, sizeof(path), "%s/%s", coalesce_dir, de->d_name) >= (int)sizeof(path) ||
+            stat(path, &st) != 0 || st.st_mtime > oldest)
+        {
+            continue;
+        }
+
+        if (has_extension(de->d_name, ".lock"))
+        {
+            removed += remove_lock(path, oldest) ? 1 : 0;
+        }
+        else if ((has_extension(de->d_name, ".resp") || has_extension(de->d_name, ".tmp")) && unlink(path) == 0)
+        {
+            removed++;
+        }
+    }
+
+    closedir(dir);
+
+    if (removed > 0)
+    {
+        jse_stats_add("coalesce.swept", removed);
+    }
+}
+
+/**
+ * @brief Sets the directory for the lock and response files.
+ *
+ * @param dir the directory.
+ */
+void jse_coalesce_set_dir(const char * dir)
+{
+    coalesce_dir = dir;
+}
+
+/**
+ * @brief Starts a request.
+ *
+ * @param key the request key.
+ * @param wait_ms the time to wait for the leader's response.
+ * @param presponse a pointer to return the response when a follower.
+ * @return the result.
+ */
+jse_coalesce_result_t jse_coalesce_begin(const char * key, long wait_ms, jse_coalesce_response_t ** presponse)
+{
+    uint64_t start = jse_time_usec();
+    char path[PATH_MAX];
+    int fd = -1;
+
+    JSE_ENTER("jse_coalesce_begin(\"%s\",%ld,%p)", key, wait_ms, presponse)
+
+    *presponse = NULL;
+
+    /* A previous request should have ended */
+    jse_coalesce_end();
+
+    /* Another user must not be able to plant or read our files */
+    if (jse_private_dir(coalesce_dir) != 0)
+    {
+        JSE_EXIT("jse_coalesce_begin()=NONE")
+        return JSE_COALESCE_NONE;
+    }
+
+    snprintf(base_path, sizeof(base_path), "%s/%016llx", coalesce_dir, (unsigned long long)hash_key(key));
+    snprintf(path, sizeof(path), "%s.lock", base_path);
+
+    fd = open(path, O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (fd == -1)
+    {
+        JSE_ERROR("open(\"%s\") failed: %s", path, strerror(errno))
+        JSE_EXIT("jse_coalesce_begin()=NONE")
+        return JSE_COALESCE_NONE;
+    }
+
+    if (!owned_file(fd))
+    {
+        JSE_ERROR("Lock not owned by us: %s", path)
+        close(fd);
+        JSE_EXIT("jse_coalesce_begin()=NONE")
+        return JSE_COALESCE_NONE;
+    }
+
+    /* Marks the lock as in use so it is not swept */
+    (void) futimens(fd, NULL);
+
+    if (wait_ms > longest_wait_ms)
+    {
+        longest_wait_ms = wait_ms;
+    }
+
+    if (flock(fd, LOCK_EX | LOCK_NB) == 0)
+    {
+        lock_fd = fd;
+        jse_stats_add("coalesce.leader", 1);
+
+        JSE_EXIT("jse_coalesce_begin()=LEADER")
+        return JSE_COALESCE_LEADER;
+    }
+
+    if (errno != EWOULDBLOCK)
+    {
+        JSE_ERROR("flock(\"%s\") failed: %s", path, strerror(errno))
+        close(fd);
+        JSE_EXIT("jse_coalesce_begin()=NONE")
+        return JSE_COALESCE_NONE;
+    }
+
+    /* Another process is handling the same request. Wait for it. */
+    while (flock(fd, LOCK_EX | LOCK_NB) != 0)
+    {
+        if (errno != EWOULDBLOCK || jse_time_usec() - start > (uint64_t)wait_ms * 1000)
+        {
+            JSE_WARNING("Gave up waiting for: %s", key)
+
+            close(fd);
+            jse_stats_add("coalesce.timeout", 1);
+
+            JSE_EXIT("jse_coalesce_begin()=NONE")
+            return JSE_COALESCE_NONE;
+        }
+
+        usleep(POLL_INTERVAL_USEC);
+    }
+
+    jse_stats_add("coalesce.wait_usec", (long)(jse_time_usec() - start));
+
+    /* A response published since we started waiting answers this request */
+    *presponse = read_response(start);
+    if (*presponse != NULL)
+    {
+        (void) flock(fd, LOCK_UN);
+        close(fd);
+        jse_stats_add("coalesce.follower", 1);
+
+        JSE_EXIT("jse_coalesce_begin()=FOLLOWER")
+        return JSE_COALESCE_FOLLOWER;
+    }
+
+    /* The leader failed to publish a response, so we take over */
+    lock_fd = fd;
+    jse_stats_add("coalesce.leader", 1);
+
+    JSE_EXIT("jse_coalesce_begin()=LEADER")
+    return JSE_COALESCE_LEADER;
+}
+
+/**
+ * @brief Publishes the response for the current request.
+ *
+ * @param response the response.
+ */
+void jse_coalesce_publish(const jse_coalesce_response_t * response)
+{
+    response_header_t header;
+    char tmppath[PATH_MAX];
+    char path[PATH_MAX];
+    FILE * fp = NULL;
+    bool ok = false;
+    int fd = -1;
+
+    if (lock_fd == -1)
+    {
+        return;
+    }
+
+    JSE_ENTER("jse_coalesce_publish(%p)", response)
+
+    memset(&header, 0, sizeof(header));
+    header.magic = RESPONSE_MAGIC;
+    header.status = response->status;
+    header.time_usec = jse_time_usec();
+    header.key_length = (uint32_t)strlen(response->key);
+    header.vary_length = response->vary != NULL ? (uint32_t)strlen(response->vary) : 0;
+    header.contenttype_length = (uint32_t)strlen(response->contenttype);
+    header.headers_length = (uint32_t)response->headers_length;
+    header.body_length = (uint32_t)response->body_length;
+    header.ttl_secs = (int32_t)response->ttl_secs;
+    header.stale_secs = (int32_t)response->stale_secs;
+
+    /* Write a temporary file and rename it so readers never see part of it */
+    snprintf(tmppath, sizeof(tmppath), "%s.%d.tmp", base_path, (int)getpid());
+    snprintf(path, sizeof(path), "%s.resp", base_path);
+
+    /* The response may be private to the client so only we may read it */
+    fd = open(tmppath, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (fd != -1 && (fp = fdopen(fd, "w")) == NULL)
+    {
+        close(fd);
+    }
+
+    if (fp != NULL)
+    {
+        ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+            fwrite(response->key, 1, header.key_length, fp) == header.key_length &&
+            (header.vary_length == 0 || fwrite(response->vary, 1, header.vary_length, fp) == header.vary_length) &&
+            fwrite(response->contenttype, 1, header.contenttype_length, fp) == header.contenttype_length &&
+            fwrite(response->headers, 1, header.headers_length, fp) == header.headers_length &&
+            fwrite(response->body, 1, header.body_length, fp) == header.body_length;
+
+        if (fclose(fp) != 0)
+        {
+            ok = false;
+        }
+
+        if (ok && rename(tmppath, path) != 0)
+        {
+            JSE_ERROR("rename(\"%s\") failed: %s", tmppath, strerror(errno))
+            ok = false;
+        }
+
+        if (!ok)
+        {
+            JSE_ERROR("Failed to publish response: %s", path)
+            (void) unlink(tmppath);
+        }
+    }
+    else
+    {
+        JSE_ERROR("open(\"%s\") failed: %s", tmppath, strerror(errno))
+    }
+
+    JSE_EXIT("jse_coalesce_publish()")
+}
+
+/**
+ * @brief Ends the current request releasing any lock held.
+ */
+void jse_coalesce_end(void)
+{
+    uint64_t now;
+
+    if (lock_fd != -1)
+    {
+        (void) flock(lock_fd, LOCK_UN);
+        close(lock_fd);
+        lock_fd = -1;
+
+        /* Only leaders create files so only they need sweep */
+        now = jse_time_usec();
+        if (now - swept_usec >= (uint64_t)SWEEP_INTERVAL_SECS * 1000000)
+        {
+            swept_usec = now;
+            sweep();
+        }
+    }
+}
+
+/**
+ * @brief Frees a response returned by jse_coalesce_begin().
+ *
+ * @param response the response.
+ */
+void jse_coalesce_response_free(jse_coalesce_response_t * response)
+{
+    if (response != NULL)
+    {
+        free(response->key);
+        free(response->vary);
+        free(response->contenttype);
+        free(response->headers);
+        free(response->body);
+        free(response);
+    }
+}
@@ -0,0 +1,129 @@
+/*****************************************************************************
+*
+* Copyright 2020 Liberty Global B.V.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*****************************************************************************/
+
+#ifndef JSE_COALESCE_H
+#define JSE_COALESCE_H
+
+#include <stdlib.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/** The default directory for the coalescing lock and response files */
+#define JSE_COALESCE_DEFAULT_DIR "/var/run/jse/coalesce"
+
+/** The default time to wait for another process's response */
+#define JSE_COALESCE_DEFAULT_WAIT_MS 5000
+
+/** A response shared between processes */
+struct jse_coalesce_response_s
+{
+    /** The key */
+    char * key;
+    /** The headers the response varies on, comma separated, or NULL */
+    char * vary;
+    /** The HTTP status */
+    int status;
+    /** The content type */
+    char * contenttype;
+    /** The headers, each of the form "name: value\r\n" */
+    char * headers;
+    /** The length of the headers */
+    size_t headers_length;
+    /** The body */
+    void * body;
+    /** The length of the body */
+    size_t body_length;
+    /** The time the response may be cached for */
+    long ttl_secs;
+    /** The time the response may be used stale */
+    long stale_secs;
+};
+
+/** The shared response type */
+typedef struct jse_coalesce_response_s jse_coalesce_response_t;
+
+/** The result of starting a request */
+enum jse_coalesce_result_e
+{
+    /** Not coalesced, handle the request as normal */
+    JSE_COALESCE_NONE = 0,
+    /** This process handles the request and publishes the response */
+    JSE_COALESCE_LEADER,
+    /** Another process handled the request, the response is returned */
+    JSE_COALESCE_FOLLOWER
+};
+
+/** The coalesce result type */
+typedef enum jse_coalesce_result_e jse_coalesce_result_t;
+
+/**
+ * @brief Sets the directory for the lock and response files.
+ *
+ * A tmpfs is recommended.
+ *
+ * @param dir the directory.
+ */
+void jse_coalesce_set_dir(const char * dir);
+
+/**
+ * @brief Starts a request.
+ *
+ * If no other process is handling a request with the same key this
+ * process becomes the leader and must call jse_coalesce_end() once the
+ * response has been published. Otherwise it waits, for up to wait_ms,
+ * for the leader's response. If the leader fails to publish a response
+ * this process becomes the leader.
+ *
+ * @param key the request key.
+ * @param wait_ms the time to wait for the leader's response.
+ * @param presponse a pointer to return the response when a follower.
+ * @return the result.
+ */
+jse_coalesce_result_t jse_coalesce_begin(const char * key, long wait_ms, jse_coalesce_response_t ** presponse);
+
+/**
+ * @brief Publishes the response for the current request.
+ *
+ * Only has an effect if this process is the leader.
+ *
+ * @param response the response.
+ */
+void jse_coalesce_publish(const jse_coalesce_response_t * response);
+
+/**
+ * @brief Ends the current request releasing any lock held.
+ *
+ * Every minute or so a leader also removes the lock and response files
+ * that have not been used for a minute beyond the longest wait.
+ */
+void jse_coalesce_end(void);
+
+/**
+ * @brief Frees a response returned by jse_coalesce_begin().
+ *
+ * @param response the response.
+ */
+void jse_coalesce_response_free(jse_coalesce_response_t * response);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -22,6 +22,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
 
 #include "jse_debug.h"
 #include "jse_common.h"
@@ -326,6 +327,26 @@ error2:
     return -1;
 }
 
+/**
+ * @brief Returns a monotonic time in microseconds.
+ *
+ * The time is only useful for measuring intervals.
+ *
+ * @return the time in microseconds.
+ */
+uint64_t jse_time_usec(void)
+{
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+    {
+        JSE_ERROR("clock_gettime() failed: %s", strerror(errno))
+        return 0;
+    }
+
+    return ((uint64_t)ts.tv_sec * 1000000) + ((uint64_t)ts.tv_nsec / 1000);
+}
+
 /**
  * @brief Creates a sub directory and all the intermediate directories.
  *
@@ -449,3 +470,45 @@ int jse_mkdir(const char* path)
 
     return ret;
 }
+
+/**
+ * @brief Creates a directory that only this user may write to.
+ *
+ * Creates the directory with jse_mkdir() and then checks that it is not a
+ * symbolic link, is owned by the effective user and is not writable by
+ * the group or others, so that a directory made in advance by another
+ * user is refused rather than used.
+ *
+ * @param path the directory path.
+ *
+ * @return 0 on success or an errno.
+ */
+int jse_private_dir(const char* path)
+{
+    int ret = jse_mkdir(path);
+
+    if (ret == 0)
+    {
+        struct stat st = { 0 };
+
+        if (lstat(path, &st) != 0)
+        {
+            ret = errno;
+            JSE_ERROR("lstat(%s): %s", path, strerror(ret))
+        }
+        else
+        if (!S_ISDIR(st.st_mode))
+        {
+            JSE_ERROR("%s: not a directory", path)
+            ret = ENOTDIR;
+        }
+        else
+        if (st.st_uid != geteuid() || (st.st_mode & (S_IWGRP | S_IWOTH)) != 0)
+        {
+            JSE_ERROR("%s: not owned by us or writable by others", path)
+            ret = EPERM;
+        }
+    }
+
+    return ret;
+}
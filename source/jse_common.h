@@ -20,6 +20,7 @@
 #define JSE_COMMON_H
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <duktape.h>
 #include <qdecoder.h>
 
@@ -116,6 +117,15 @@ ssize_t jse_read_fd(int fd, void ** const pbuffer, size_t * const psize);
  */
 ssize_t jse_read_file(const char * const filename, void ** const pbuffer, size_t * const psize);
 
+/**
+ * @brief Returns a monotonic time in microseconds.
+ *
+ * The time is only useful for measuring intervals.
+ *
+ * @return the time in microseconds.
+ */
+uint64_t jse_time_usec(void);
+
 /**
  * @brief Creates a sub directory and all the intermediate directories.
  *
@@ -131,6 +141,19 @@ ssize_t jse_read_file(const char * const filename, void ** const pbuffer, size_t
  */
 int jse_mkdir(const char* path);
 
+/**
+ * @brief Creates a directory that only this user may write to.
+ *
+ * As jse_mkdir() but the directory must also be owned by the effective
+ * user, must not be a symbolic link and must not be writable by the group
+ * or others.
+ *
+ * @param path the directory path.
+ *
+ * @return 0 on success or an errno.
+ */
+int jse_private_dir(const char* path);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -20,20 +20,23 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <ctype.h>
 #include <pthread.h>
 #include <sys/time.h>
 #include <time.h>
 #include <signal.h>
 #include <errno.h>
-#include <ccsp_message_bus.h>
-#include <ccsp_base_api.h>
-#include <ccsp_memory.h>
-#include <ccsp_custom.h>
 #include <duktape.h>
 
 #include "jse_debug.h"
+#include "jse_common.h"
 #include "jse_jserror.h"
+#include "jse_cosa_types.h"
 #include "jse_cosa_error.h"
+#include "jse_stats.h"
+#include "jse_cosa_cache.h"
+#include "jse_cosa_bus.h"
+#include "jse_cosa_snapshot.h"
 #include "jse_cosa.h"
 
 #ifndef __GNUC__
@@ -45,277 +48,503 @@
 /** Reference count for binding. */
 static int ref_count = 0;
 
-#define COMPONENT_NAME "ccsp.phpextension"
-#define CONF_FILENAME "/tmp/ccsp_msg.cfg"
-#define CCSP_COMPONENT_ID_WebUI 0x00000001
-#define COSA_PHP_EXT_PCSIM "/tmp/cosa_php_pcsim"
-
-static void *bus_handle = NULL;
-static char dst_pathname_cr[64] = {0};
-static int gPcSim = 0;
-
-#ifndef BUILD_RBUS /*FIXME: mrollins: completely removed the functionality when rbus enabled -- do we need to add it back with rbus ? */
-static const char *msg_path = "/com/cisco/spvtg/ccsp/phpext";
-static const char *msg_interface = "com.cisco.spvtg.ccsp.phpext";
-static const char *msg_method = "__send";
-static const char *Introspect_msg = "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"
-                                    "<node name=\"/com/cisco/ccsp/dbus\">\n"
-                                    "  <interface name=\"org.freedesktop.DBus.Introspectable\">\n"
-                                    "    <method name=\"Introspect\">\n"
-                                    "      <arg name=\"data\" direction=\"out\" type=\"s\"/>\n"
-                                    "    </method>\n"
-                                    "  </interface>\n"
-                                    "  <interface name=\"ccsp.msg\">\n"
-                                    "    <method name=\"__send\">\n"
-                                    "      <arg type=\"s\" name=\"from\" direction=\"in\" />\n"
-                                    "      <arg type=\"s\" name=\"request\" direction=\"in\" />\n"
-                                    "      <arg type=\"s\" name=\"response\" direction=\"out\" />\n"
-                                    "    </method>\n"
-                                    "    <method name=\"__app_request\">\n"
-                                    "      <arg type=\"s\" name=\"from\" direction=\"in\" />\n"
-                                    "      <arg type=\"s\" name=\"request\" direction=\"in\" />\n"
-                                    "      <arg type=\"s\" name=\"argu\" direction=\"in\" />\n"
-                                    "      <arg type=\"s\" name=\"response\" direction=\"out\" />\n"
-                                    "    </method>\n"
-                                    "  </interface>\n"
-                                    "</node>\n";
-
-/**
- * @brief Dbus message handler
- *
- * @param conn connection object
- * @param message dbus message
- * @param user_data
- * @return an error status or DBUS_HANDLER_RESULT_HANDLED.
- */
-static DBusHandlerResult path_message_func(DBusConnection *conn, DBusMessage *message,
-    __attribute__((unused)) void *user_data)
-{
-    if (message != NULL)
-    {
-        const char *interface = dbus_message_get_interface(message);
-        const char *method = dbus_message_get_member(message);
-        DBusMessage *reply;
-        char *resp = "888888888888888888888888888888888888888888888888888888888888888888888888888888888888888888888888888";
-        char *from = 0;
-        char *req = 0;
-        char *err_msg = DBUS_ERROR_NOT_SUPPORTED;
+/** The delay before retrying a failed initialisation, doubled on each failure */
+#define INIT_RETRY_MIN_MSEC 100
 
-#ifndef __GNUC__
-        /* To keep compiler happy */
-        user_data = user_data;
-#endif
+/** The maximum delay before retrying a failed initialisation */
+#define INIT_RETRY_MAX_MSEC 60000
+
+/** Set true once the message bus is initialised */
+static bool bus_initialised = false;
+
+/** Set false to stop the first Cosa call initialising the message bus */
+static bool auto_init = true;
+
+/** The number of consecutive failed initialisations */
+static unsigned int init_failures = 0;
+
+/** The time before which initialisation is not retried */
+static uint64_t init_retry_usec = 0;
+
+/** The maximum number of values memoised during a request */
+#define MEMO_MAX 512
+
+/** A parameter value memoised during a request */
+struct memo_item_s
+{
+    /** The parameter name including the subsystem prefix */
+    char *pName;
+    /** The value */
+    char *pValue;
+    /** The type */
+    enum dataType_e type;
+    struct memo_item_s *pNext;
+};
+
+typedef struct memo_item_s memo_item_t;
+
+/** Set true to memoise parameter values during a request */
+static bool memo_enabled = false;
+
+/** The memoised values */
+static memo_item_t *memo_items = NULL;
+
+/** The number of memoised values */
+static int memo_count = 0;
+
+/**
+ * @brief Invalidates the cached component for a name after an error.
+ *
+ * Parameter faults, the TR-069 9xxx codes, are errors in the request so
+ * the component is still correct unless it did not recognise the name.
+ *
+ * @param status the CCSP status.
+ * @param pObjName object name
+ * @param pSystemPrefix subsystem prefix
+ */
+static void InvalidateDestComponentOnError(int status, char *pObjName, char *pSystemPrefix)
+{
+    if (status != CCSP_SUCCESS && (status < 9000 || status == CCSP_ERR_INVALID_PARAMETER_NAME))
+    {
+        jse_cosa_bus_invalidate(pSystemPrefix, pObjName);
+    }
+}
+
+/**
+ * @brief Caches the types of the parameter values returned by a get.
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param ppParameterVal the values.
+ * @param valCount the number of values.
+ */
+static void CacheParameterTypes(char *pSystemPrefix, parameterValStruct_t **ppParameterVal, int valCount)
+{
+    int i;
+
+    for (i = 0; i < valCount; i++)
+    {
+        jse_cosa_cache_put_type(pSystemPrefix, ppParameterVal[i]->parameterName, (int)ppParameterVal[i]->type);
+    }
+}
+
+/**
+ * @brief Enables memoising parameter values during a request.
+ *
+ * @param enable set true to enable.
+ */
+void jse_cosa_set_memo(bool enable)
+{
+    memo_enabled = enable;
+}
+
+/**
+ * @brief Creates the memo key for a parameter.
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param pName the parameter name.
+ * @param pKey the buffer for the key.
+ * @param keySize the size of the buffer.
+ * @return 0 on success or -1 if the name is too long.
+ */
+static int MemoKey(const char *pSystemPrefix, const char *pName, char *pKey, size_t keySize)
+{
+    int len = snprintf(pKey, keySize, "%s%s", pSystemPrefix, pName);
+
+    return (len < 0 || (size_t)len >= keySize) ? -1 : 0;
+}
+
+/**
+ * @brief Finds a memoised value.
+ *
+ * @param pKey the key.
+ * @return the item or NULL.
+ */
+static memo_item_t *MemoFind(const char *pKey)
+{
+    memo_item_t *pItem = memo_items;
+
+    while (pItem != NULL && strcmp(pItem->pName, pKey))
+    {
+        pItem = pItem->pNext;
+    }
+
+    return pItem;
+}
+
+/**
+ * @brief Forgets all the memoised values.
+ */
+static void MemoClear(void)
+{
+    while (memo_items != NULL)
+    {
+        memo_item_t *pItem = memo_items;
 
-        reply = dbus_message_new_method_return(message);
-        if (reply == NULL)
+        memo_items = pItem->pNext;
+        free(pItem->pName);
+        free(pItem->pValue);
+        free(pItem);
+    }
+
+    memo_count = 0;
+}
+
+/**
+ * @brief Forgets the memoised values of a parameter or object.
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param pName the parameter or object name. Every value whose name
+ * starts with this is forgotten.
+ */
+static void MemoInvalidate(const char *pSystemPrefix, const char *pName)
+{
+    memo_item_t **ppPrev = &memo_items;
+    char key[512];
+    size_t len;
+
+    if (memo_items == NULL)
+    {
+        return;
+    }
+
+    if (MemoKey(pSystemPrefix, pName, key, sizeof(key)) != 0)
+    {
+        /* Can't tell what is affected */
+        MemoClear();
+        return;
+    }
+
+    len = strlen(key);
+
+    while (*ppPrev != NULL)
+    {
+        memo_item_t *pItem = *ppPrev;
+
+        if (!strncmp(pItem->pName, key, len))
+        {
+            *ppPrev = pItem->pNext;
+            free(pItem->pName);
+            free(pItem->pValue);
+            free(pItem);
+            memo_count--;
+        }
+        else
+        {
+            ppPrev = &pItem->pNext;
+        }
+    }
+}
+
+/**
+ * @brief Memoises the parameter values returned by a get.
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param ppParameterVal the values.
+ * @param valCount the number of values.
+ */
+static void MemoPutValues(const char *pSystemPrefix, parameterValStruct_t **ppParameterVal, int valCount)
+{
+    char key[512];
+    int i;
+
+    for (i = 0; i < valCount && memo_enabled; i++)
+    {
+        memo_item_t *pItem = NULL;
+
+        char *pValue = NULL;
+
+        if (MemoKey(pSystemPrefix, ppParameterVal[i]->parameterName, key, sizeof(key)) != 0)
         {
-            return DBUS_HANDLER_RESULT_HANDLED;
+            continue;
         }
 
-        if (!strcmp("org.freedesktop.DBus.Introspectable", interface) && !strcmp(method, "Introspect"))
+        /* Replace any existing value */
+        pItem = MemoFind(key);
+        if (pItem != NULL)
         {
-            if (!dbus_message_append_args(reply, DBUS_TYPE_STRING, &Introspect_msg, DBUS_TYPE_INVALID))
+            pValue = strdup(ppParameterVal[i]->parameterValue);
+            if (pValue == NULL)
             {
-                if (!dbus_connection_send(conn, reply, NULL))
-                {
-                    dbus_message_unref(reply);
-                }
+                JSE_ERROR("strdup() failed: %s", strerror(errno))
+                break;
             }
-            return DBUS_HANDLER_RESULT_HANDLED;
+
+            free(pItem->pValue);
+            pItem->pValue = pValue;
+            pItem->type = ppParameterVal[i]->type;
+            continue;
+        }
+
+        if (memo_count >= MEMO_MAX)
+        {
+            JSE_VERBOSE("Memo full: %s", key)
+            break;
         }
 
-        if (!strcmp(msg_interface, interface) && !strcmp(method, msg_method))
+        pItem = (memo_item_t *)calloc(1, sizeof(memo_item_t));
+        if (pItem == NULL ||
+            (pItem->pName = strdup(key)) == NULL ||
+            (pItem->pValue = strdup(ppParameterVal[i]->parameterValue)) == NULL)
         {
-            if (dbus_message_get_args(message,
-                                    NULL,
-                                    DBUS_TYPE_STRING, &from,
-                                    DBUS_TYPE_STRING, &req,
-                                    DBUS_TYPE_INVALID))
+            JSE_ERROR("Out of memory!")
+            if (pItem != NULL)
             {
-                dbus_message_append_args(reply, DBUS_TYPE_STRING, &resp, DBUS_TYPE_INVALID);
-                if (!dbus_connection_send(conn, reply, NULL))
-                {
-                    dbus_message_unref(reply);
-                }
+                free(pItem->pName);
+                free(pItem);
             }
-            return DBUS_HANDLER_RESULT_HANDLED;
+            break;
         }
 
-        dbus_message_set_error_name(reply, err_msg);
-        dbus_connection_send(conn, reply, NULL);
-        dbus_message_unref(reply);
+        pItem->type = ppParameterVal[i]->type;
+        pItem->pNext = memo_items;
+        memo_items = pItem;
+        memo_count++;
+    }
+}
+
+/**
+ * @brief Frees the values returned by MemoGetValues().
+ *
+ * @param valCount the number of values.
+ * @param ppParameterVal the values.
+ */
+static void MemoFreeValues(int valCount, parameterValStruct_t **ppParameterVal)
+{
+    int i;
 
-        return DBUS_HANDLER_RESULT_HANDLED;
+    for (i = 0; i < valCount; i++)
+    {
+        free(ppParameterVal[i]);
     }
 
-    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+    free(ppParameterVal);
 }
-#endif /* BUILD_RBUS */
 
 /**
- * @brief Locate component for DM key/parameter
+ * @brief Gets parameter values from the memo.
  *
- * CCSP API call: CcspBaseIf_discComponentSupportingNamespace()
+ * The values are only returned if every parameter is memoised. Partial
+ * paths are never memoised. The returned values point to the memoised
+ * strings so must be freed with MemoFreeValues() before the memo changes.
  *
- * @param pObjName object name
- * @param ppDestComponentName pointer to dest component name
- * @param ppDestPath pointer to component dbus path
  * @param pSystemPrefix subsystem prefix
- * @return an error status or 0.
+ * @param ppNames the parameter names.
+ * @param count the number of names.
+ * @param pValCount a pointer to return the number of values.
+ * @param pppParameterVal a pointer to return the values.
+ * @return true if the values are returned.
  */
-static int UiDbusClientGetDestComponent(char *pObjName, char **ppDestComponentName, char **ppDestPath, char *pSystemPrefix)
+static bool MemoGetValues(const char *pSystemPrefix, char **ppNames, int count,
+    int *pValCount, parameterValStruct_t ***pppParameterVal)
 {
-    int ret;
-    int size = 0;
-    componentStruct_t **ppComponents = NULL;
+    parameterValStruct_t **ppParameterVal = NULL;
+    char key[512];
+    int i;
 
-    ret =
-        CcspBaseIf_discComponentSupportingNamespace(
-            bus_handle,
-            dst_pathname_cr,
-            pObjName,
-            pSystemPrefix,
-            &ppComponents,
-            &size);
+    if (!memo_enabled || memo_items == NULL || count <= 0)
+    {
+        return false;
+    }
+
+    ppParameterVal = (parameterValStruct_t **)calloc(count, sizeof(parameterValStruct_t *));
+    if (ppParameterVal == NULL)
+    {
+        JSE_ERROR("calloc() failed: %s", strerror(errno))
+        return false;
+    }
 
-    if (ret == CCSP_SUCCESS)
+    for (i = 0; i < count; i++)
     {
-        // We only support handling a single component
-        *ppDestComponentName = ppComponents[0]->componentName;
-        ppComponents[0]->componentName = NULL;
-        *ppDestPath = ppComponents[0]->dbusPath;
-        ppComponents[0]->dbusPath = NULL;
+        memo_item_t *pItem = NULL;
 
-        while (size)
+        if (MemoKey(pSystemPrefix, ppNames[i], key, sizeof(key)) == 0)
         {
-            if (ppComponents[size - 1]->componentName)
-            {
-                free(ppComponents[size - 1]->componentName);
-            }
-            if (ppComponents[size - 1]->dbusPath)
-            {
-                free(ppComponents[size - 1]->dbusPath);
-            }
-            if (ppComponents[size - 1]->remoteCR_dbus_path)
-            {
-                free(ppComponents[size - 1]->remoteCR_dbus_path);
-            }
-            if (ppComponents[size - 1]->remoteCR_name)
-            {
-                free(ppComponents[size - 1]->remoteCR_name);
-            }
-            free(ppComponents[size - 1]);
-            size--;
+            pItem = MemoFind(key);
         }
-        free(ppComponents);
-        return 0;
-    }
-    else
-    {
-        JSE_ERROR(
-            "Failed to locate the component for %s%s%s, error code = %d!",
-            pSystemPrefix,
-            strlen(pSystemPrefix) ? "." : "",
-            pObjName,
-            ret)
-        return ret;
+
+        if (pItem == NULL ||
+            (ppParameterVal[i] = (parameterValStruct_t *)calloc(1, sizeof(parameterValStruct_t))) == NULL)
+        {
+            MemoFreeValues(i, ppParameterVal);
+            jse_stats_add("cosa.memo.miss", 1);
+            return false;
+        }
+
+        ppParameterVal[i]->parameterName = ppNames[i];
+        ppParameterVal[i]->parameterValue = pItem->pValue;
+        ppParameterVal[i]->type = pItem->type;
     }
+
+    jse_stats_add("cosa.memo.hit", count);
+
+    *pValCount = count;
+    *pppParameterVal = ppParameterVal;
+
+    return true;
 }
 
 /**
- * @brief Parse and set DM subsystem prefix.
+ * @brief Frees parameter values from either the memo or a get.
  *
- * @param ppDotStr pointer to COSA dotstr
- * @param pSubSystemPrefix subsystem string, e.g. eRT.
- * @return void.
+ * @param memoised set true if the values came from the memo.
+ * @param valCount the number of values.
+ * @param ppParameterVal the values.
  */
-static void CheckAndSetSubsystemPrefix(char **ppDotStr, char *pSubSystemPrefix)
+static void FreeParameterValues(bool memoised, int valCount, parameterValStruct_t **ppParameterVal)
 {
-    if (!strncmp(*ppDotStr, "eRT", 3)) /* check whether str has prex of eRT */
+    if (memoised)
     {
-        /* Replace strncpy() to prevent compiler warnings */
-        pSubSystemPrefix[0] = 'e';
-        pSubSystemPrefix[1] = 'R';
-        pSubSystemPrefix[2] = 'T';
-        pSubSystemPrefix[3] = '.';
-        *ppDotStr += 4; /* shift four bytes to get rid of eRT: */
+        MemoFreeValues(valCount, ppParameterVal);
     }
-    else if (!strncmp(*ppDotStr, "eMG", 3)) /* check wither str has prex of eMG */
+    else if (valCount > 0)
+    {
+        jse_cosa_bus_free_values(valCount, ppParameterVal);
+    }
+}
+
+/**
+ * @brief Remembers the parameter values returned by a get.
+ *
+ * The types are cached, the values memoised for the request and the
+ * values of hot parameters cached.
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param ppParameterVal the values.
+ * @param valCount the number of values.
+ */
+static void RememberParameterValues(char *pSystemPrefix, parameterValStruct_t **ppParameterVal, int valCount)
+{
+    int i;
+
+    CacheParameterTypes(pSystemPrefix, ppParameterVal, valCount);
+    MemoPutValues(pSystemPrefix, ppParameterVal, valCount);
+
+    for (i = 0; i < valCount; i++)
     {
-        /* Replace strncpy() to prevent compiler warnings */
-        pSubSystemPrefix[0] = 'e';
-        pSubSystemPrefix[1] = 'M';
-        pSubSystemPrefix[2] = 'G';
-        pSubSystemPrefix[3] = '.';
-        *ppDotStr += 4; /* shift four bytes to get rid of eMG; */
+        jse_cosa_cache_put_hot(pSystemPrefix, ppParameterVal[i]->parameterName,
+            ppParameterVal[i]->parameterValue, (int)ppParameterVal[i]->type);
     }
 }
 
+/**
+ * @brief Forgets the values of a parameter or object that is changing.
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param pName the parameter or object name.
+ */
+static void ForgetParameterValues(const char *pSystemPrefix, const char *pName)
+{
+    MemoInvalidate(pSystemPrefix, pName);
+    jse_cosa_cache_invalidate_hot(pSystemPrefix, pName);
+}
+
 /**
  * @brief Initialise CCSP message bus
  *
+ * Does nothing if already initialised.
+ *
  * @return an error status or 0.
  */
 int jse_cosa_init()
 {
-    FILE *fp = NULL;
-    int returnStatus = 0;
+    uint64_t start = 0;
     int ret = -1;
 
+    if (bus_initialised)
+    {
+        return 0;
+    }
+
     JSE_ENTER("jse_cosa_init()")
 
-    /* Check if this is a PC simulation */
-    fp = fopen(COSA_PHP_EXT_PCSIM, "r");
-    if (fp)
+    start = jse_time_usec();
+
+    ret = jse_cosa_bus_init();
+    if (ret == 0)
     {
-        gPcSim = 1;
-        fclose(fp);
+        bus_initialised = true;
     }
 
-    bus_handle = NULL;
+    jse_stats_add("cosa.init.usec", (long)(jse_time_usec() - start));
+
+    JSE_EXIT("jse_cosa_init()=%d", ret)
+    return ret;
+}
+
+/**
+ * @brief Sets whether the first Cosa call initialises the message bus.
+ *
+ * @param enable set false to never initialise the message bus.
+ */
+void jse_cosa_set_auto_init(bool enable)
+{
+    auto_init = enable;
+}
+
+/**
+ * @brief Initialises the message bus if not already initialised.
+ *
+ * After a failure initialisation is not retried until a delay, which
+ * doubles with each consecutive failure up to INIT_RETRY_MAX_MSEC, has
+ * passed. Calls until then fail at once rather than each waiting on the
+ * bus.
+ *
+ * @param pReason a buffer for the reason on failure.
+ * @param size the size of the buffer.
+ *
+ * @return CCSP_SUCCESS or CCSP_ERR_NOT_CONNECT.
+ */
+static int EnsureInitialised(char *pReason, size_t size)
+{
+    uint64_t now = 0;
+    unsigned long delay = 0;
+    unsigned int i;
 
-    /*
-     *  Hardcoding "eRT." is just a workaround. We need to feed the subsystem
-     *  info into this initialization routine.
-     */
-    if (gPcSim)
+    if (bus_initialised)
     {
-        JSE_VERBOSE("COSA using PC simulator!")
-        strncat(dst_pathname_cr, CCSP_DBUS_INTERFACE_CR, sizeof(dst_pathname_cr) - 1);
+        return CCSP_SUCCESS;
     }
-    else
+
+    if (!auto_init)
     {
-        strncat(dst_pathname_cr, "eRT." CCSP_DBUS_INTERFACE_CR, sizeof(dst_pathname_cr) - 1);
+        snprintf(pReason, size, "CCSP is not initialised");
+        return CCSP_ERR_NOT_CONNECT;
     }
 
-    returnStatus = CCSP_Message_Bus_Init(COMPONENT_NAME, CONF_FILENAME, &bus_handle, 0, 0);
-    if (returnStatus != 0)
+    now = jse_time_usec();
+    if (now < init_retry_usec)
     {
-        JSE_ERROR("Message bus init failed, error code = %d!", returnStatus)
+        snprintf(pReason, size, "CCSP initialisation failed, retry in %lu ms",
+            (unsigned long)((init_retry_usec - now) / 1000));
+        return CCSP_ERR_NOT_CONNECT;
     }
-    else
+
+    if (jse_cosa_init() != 0)
     {
-#ifndef BUILD_RBUS
-        (void) CCSP_Msg_SleepInMilliSeconds(1000);
-        returnStatus = CCSP_Message_Bus_Register_Path(bus_handle, msg_path, path_message_func, 0);
-        if (returnStatus != CCSP_Message_Bus_OK)
+        init_failures++;
+        jse_stats_add("cosa.init.fail", 1);
+
+        for (i = 1, delay = INIT_RETRY_MIN_MSEC; i < init_failures && delay < INIT_RETRY_MAX_MSEC; i++)
         {
-            JSE_ERROR("Message bus register failed, error code = %d!", returnStatus)
-            CCSP_Message_Bus_Exit(bus_handle);
-            bus_handle = NULL;
+            delay *= 2;
         }
-        else
+
+        if (delay > INIT_RETRY_MAX_MSEC)
         {
-            JSE_INFO("COSA initialised!")
-            ret = 0;
+            delay = INIT_RETRY_MAX_MSEC;
         }
-#else
-        ret = 0;
-#endif
+
+        init_retry_usec = now + ((uint64_t)delay * 1000);
+
+        JSE_WARNING("jse_cosa_init() failed. Will try again in %lu ms!", delay)
+
+        snprintf(pReason, size, "CCSP initialisation failed");
+        return CCSP_ERR_NOT_CONNECT;
     }
 
-    JSE_EXIT("jse_cosa_init()=%d", ret)
-    return ret;
+    init_failures = 0;
+
+    return CCSP_SUCCESS;
 }
 
 /**
@@ -325,14 +554,10 @@ void jse_cosa_shutdown()
 {
     JSE_ENTER("jse_cosa_shutdown()")
 
-/* TODO fix ccsp_message_bus.h: it doesn't define CCSP_Message_Bus_Exit if BUILD_RBUS enabled */
-#ifndef BUILD_RBUS
-    if (bus_handle)
-    {
-        CCSP_Message_Bus_Exit(bus_handle);
-        bus_handle = NULL;
-    }
-#endif
+    jse_cosa_bus_shutdown();
+    jse_cosa_snapshot_clear();
+
+    bus_initialised = false;
 
     JSE_EXIT("jse_cosa_shutdown()")
 }
@@ -534,1157 +759,3781 @@ static duk_ret_t parse_parameter(const char *func, duk_context *ctx, const char
     return ret;
 }
 
+/** A group of parameters supported by the same component */
+struct cosa_group_s
+{
+    /** The component name */
+    char *pDestComponentName;
+    /** The component D-Bus path */
+    char *pDestPath;
+    /** The subsystem prefix of the first parameter */
+    char subSystemPrefix[6];
+    /** The number of parameters */
+    int count;
+    /** The parameter names less any subsystem prefix */
+    char **ppParamNameList;
+    /** The index of each parameter in the caller's list */
+    int *pIndexList;
+};
+
+typedef struct cosa_group_s cosa_group_t;
+
 /**
- * @brief The binding for getStr()
+ * @brief Frees groups created by GroupByDestComponent().
  *
- * This function calls the real CCSP API:
- *  - CcspBaseIf_getParameterValues()
+ * @param pGroups the groups.
+ * @param groupCount the number of groups.
+ */
+static void FreeGroups(cosa_group_t *pGroups, int groupCount)
+{
+    int i;
+
+    for (i = 0; i < groupCount; i++)
+    {
+        free(pGroups[i].pDestComponentName);
+        free(pGroups[i].pDestPath);
+        free(pGroups[i].ppParamNameList);
+        free(pGroups[i].pIndexList);
+    }
+
+    free(pGroups);
+}
+
+/**
+ * @brief Groups parameters by the component that supports them.
  *
- * @param ctx the duktape context.
+ * The groups keep pointers to the names so the names must remain valid
+ * while the groups are in use.
  *
- * @return 1 or a negative error status.
+ * @param ppNames the parameter names, optionally with a subsystem prefix.
+ * @param count the number of names.
+ * @param ppGroups a pointer to return the groups.
+ * @param pGroupCount a pointer to return the number of groups.
+ * @param pFailIndex a pointer to return the index of the name that failed.
+ * @return CCSP_SUCCESS or an error status.
  */
-static duk_ret_t getStr(duk_context *ctx)
+static int GroupByDestComponent(char **ppNames, int count, cosa_group_t **ppGroups, int *pGroupCount, int *pFailIndex)
 {
-    duk_ret_t ret = DUK_RET_ERROR;
+    cosa_group_t *pGroups = NULL;
+    int groupCount = 0;
+    int i, j;
 
-    char *dotstr = 0;
-    char *ppDestComponentName = NULL;
-    char *ppDestPath = NULL;
-    int size = 0;
-    parameterValStruct_t **parameterVal = NULL;
-    char retParamVal[512] = {0};
-    int returnStatus = 0;
-    char subSystemPrefix[6] = {0};
-
-    JSE_ASSERT(ctx != NULL)
-    JSE_ENTER("getStr(%p)", ctx)
+    *ppGroups = NULL;
+    *pGroupCount = 0;
+    *pFailIndex = -1;
 
-    /* Parse Input parameters first */
-    if (parse_parameter(__FUNCTION__, ctx, "s", &dotstr) != 0)
+    /* At worst a group per name */
+    pGroups = (cosa_group_t *)calloc(count > 0 ? count : 1, sizeof(cosa_group_t));
+    if (pGroups == NULL)
     {
-        JSE_ERROR("Error parsing argument(s)!")
+        JSE_ERROR("calloc() failed: %s", strerror(errno))
+        return CCSP_ERR_MEMORY_ALLOC_FAIL;
     }
-    else
-    {
-        JSE_VERBOSE("dotstr=\"%s\"", dotstr)
 
-        /* Check whether there are subsystem prefix in the dot string
-           Split Subsytem prefix and COSA dotstr if subsystem prefix is found */
-        CheckAndSetSubsystemPrefix(&dotstr, subSystemPrefix);
+    for (i = 0; i < count; i++)
+    {
+        char *dotstr = ppNames[i];
+        char subSystemPrefix[6] = {0};
+        char *pDestComponentName = NULL;
+        char *pDestPath = NULL;
+        cosa_group_t *pGroup = NULL;
+        int returnStatus;
 
-        JSE_VERBOSE("subSystemPrefix=\"%s\"", subSystemPrefix)
+        jse_cosa_bus_split_prefix(&dotstr, subSystemPrefix);
 
-        /* Get Destination component */
-        returnStatus = UiDbusClientGetDestComponent(dotstr, &ppDestComponentName, &ppDestPath, subSystemPrefix);
+        returnStatus = jse_cosa_bus_discover(dotstr, &pDestComponentName, &pDestPath, subSystemPrefix);
         if (returnStatus != 0)
         {
-            /* Does not return */
-            JSE_THROW_COSA_ERROR(ctx, returnStatus,
-                "UiDbusClientGetDestComponent() failed: \"%s\"", dotstr);
+            FreeGroups(pGroups, groupCount);
+            *pFailIndex = i;
+            return returnStatus;
         }
-        else
-        {
-            /* Get Parameter Vaues from ccsp */
-            returnStatus = CcspBaseIf_getParameterValues(bus_handle,
-                                                         ppDestComponentName,
-                                                         ppDestPath,
-                                                         &dotstr,
-                                                         1,
-                                                         &size,
-                                                         &parameterVal);
-
-            free(ppDestComponentName);
-            free(ppDestPath);
 
-            if (CCSP_SUCCESS != returnStatus)
+        for (j = 0; j < groupCount && pGroup == NULL; j++)
+        {
+            if (!strcmp(pGroups[j].pDestComponentName, pDestComponentName) &&
+                !strcmp(pGroups[j].pDestPath, pDestPath))
             {
-                free_parameterValStruct_t(bus_handle, size, parameterVal);
-
-                /* Does not return */
-                JSE_THROW_COSA_ERROR(ctx, returnStatus,
-                    "CcspBaseIf_getParameterValues() failed: \"%s\"", dotstr);
+                pGroup = &pGroups[j];
             }
-            else
+        }
+
+        if (pGroup != NULL)
+        {
+            free(pDestComponentName);
+            free(pDestPath);
+        }
+        else
+        {
+            pGroup = &pGroups[groupCount++];
+            pGroup->pDestComponentName = pDestComponentName;
+            pGroup->pDestPath = pDestPath;
+            memcpy(pGroup->subSystemPrefix, subSystemPrefix, sizeof(subSystemPrefix));
+
+            /* Sized for the worst case, all the remaining names */
+            pGroup->ppParamNameList = (char **)calloc(count - i, sizeof(char *));
+            pGroup->pIndexList = (int *)calloc(count - i, sizeof(int));
+            if (pGroup->ppParamNameList == NULL || pGroup->pIndexList == NULL)
             {
-                JSE_DEBUG(
-                    "parameterVal[0]->parameterValue=\"%s\"",
-                    parameterVal[0]->parameterValue)
+                JSE_ERROR("calloc() failed: %s", strerror(errno))
+                FreeGroups(pGroups, groupCount);
+                return CCSP_ERR_MEMORY_ALLOC_FAIL;
+            }
+        }
 
-                if (size >= 1)
-                {
-                    strncpy(retParamVal, parameterVal[0]->parameterValue, sizeof(retParamVal));
-                }
+        pGroup->ppParamNameList[pGroup->count] = dotstr;
+        pGroup->pIndexList[pGroup->count] = i;
+        pGroup->count++;
+    }
 
-                JSE_VERBOSE("retParamVal=\"%s\"", retParamVal)
+    JSE_VERBOSE("%d names in %d groups", count, groupCount)
 
-                free_parameterValStruct_t(bus_handle, size, parameterVal);
+    *ppGroups = pGroups;
+    *pGroupCount = groupCount;
 
-                /* Return only first param value */
-                duk_push_string(ctx, retParamVal);
+    return CCSP_SUCCESS;
+}
 
-                /* Return one item, the last value in the stack. */
-                ret = 1;
-            }
-        }
-    }
+/**
+ * @brief Appends a name to a comma separated list of fault names.
+ *
+ * The list is truncated if the buffer is too small.
+ *
+ * @param pFaults the buffer.
+ * @param faultsSize the size of the buffer.
+ * @param pName the name.
+ */
+static void AppendFaultName(char *pFaults, size_t faultsSize, const char *pName)
+{
+    size_t len = strlen(pFaults);
 
-    JSE_EXIT("getStr()=%d", ret)
-    return ret;
+    snprintf(&pFaults[len], faultsSize - len, "%s%s", len > 0 ? ", " : "", pName);
 }
 
 /**
- * @brief The binding for setStr()
+ * @brief Gets the strings in an array argument.
  *
- * This function calls the real CCSP APIs:
- *  - CcspBaseIf_getParameterValues()
- *  - CcspBaseIf_setParameterValues()
- * It takes the following arguments:
- *  - DM key/parameter
- *  - value to be set
- *  - commit flag
+ * The strings belong to the array so remain valid while it is.
  *
  * @param ctx the duktape context.
- *
- * @return 0 or an negative error status.
+ * @param idx the index of the array.
+ * @param pCount a pointer to return the number of strings.
+ * @return the strings, which must be freed, or NULL if there are none.
  */
-static duk_ret_t setStr(duk_context *ctx)
+static char **GetStringArray(duk_context *ctx, duk_idx_t idx, int *pCount)
 {
-    duk_ret_t ret = DUK_RET_ERROR;
-
-    char *dotstr = NULL;
-    char *val = NULL;
-    duk_bool_t bCommit = 0;
-    char *ppDestComponentName = NULL;
-    char *ppDestPath = NULL;
-    int size;
-    parameterValStruct_t **structGet = NULL;
-    parameterValStruct_t structSet[1];
-    int returnStatus;
-    char *pFaultParameterNames = NULL;
-    char subSystemPrefix[6] = {0};
-    dbus_bool bDbusCommit = 1;
+    char **ppStrings = NULL;
+    int count = (int)duk_get_length(ctx, idx);
+    int i;
 
-    JSE_ASSERT(ctx != NULL)
-    JSE_ENTER("setStr(%p)", ctx)
+    *pCount = count;
 
-    /* Parse Parameters first */
-    if (parse_parameter(__FUNCTION__, ctx, "sab", &dotstr, &val, &bCommit) != 0)
+    if (count == 0)
     {
-        JSE_ERROR("Error parsing argument(s)!")
+        return NULL;
     }
-    else
-    {
-        char *valcopy = strdup(val);
-        if (valcopy == NULL)
-        {
-            /* Does not return */
-            JSE_THROW_COSA_ERROR(ctx, CCSP_ERR_MEMORY_ALLOC_FAIL,
-                "strdup(): %s", strerror(errno));
-        }
-        else
-        {
-            JSE_VERBOSE("dotstr=\"%s\",val=\"%s\",bCommit=%s", dotstr, valcopy, bCommit ? "true" : "false")
-
-            bDbusCommit = (bCommit) ? 1 : 0;
-
-            /* Check whether there is subsystem prefix in the dot string
-            Split Subsytem prefix and COSA dotstr if subsystem prefix is found */
-            CheckAndSetSubsystemPrefix(&dotstr, subSystemPrefix);
-
-            JSE_VERBOSE("subSystemPrefix=\"%s\"", subSystemPrefix)
-
-            /* Get Destination component */
-            returnStatus = UiDbusClientGetDestComponent(dotstr, &ppDestComponentName, &ppDestPath, subSystemPrefix);
-            if (returnStatus != 0)
-            {
-                free(valcopy);
-
-                /* Does not return */
-                JSE_THROW_COSA_ERROR(ctx, returnStatus,
-                    "UiDbusClientGetDestComponent() failed: \"%s\"", dotstr);
-            }
-            else
-            {
-                /* First Get the current parameter Values */
-                returnStatus = CcspBaseIf_getParameterValues(bus_handle,
-                                                            ppDestComponentName,
-                                                            ppDestPath,
-                                                            &dotstr,
-                                                            1,
-                                                            &size,
-                                                            &structGet);
-                if (returnStatus != CCSP_SUCCESS)
-                {
-                    free(valcopy);
-                    free(ppDestComponentName);
-                    free(ppDestPath);
 
-                    /* Does not return */
-                    JSE_THROW_COSA_ERROR(ctx, returnStatus,
-                        "CcspBaseIf_getParameterValues() failed: \"%s\"", dotstr);
-                }
-                else
-                {
-                    JSE_DEBUG(
-                        "structGet[0]->parameterName=\"%s\", structGet[0]->parameterValue=\"%s\"",
-                        structGet[0]->parameterName,
-                        structGet[0]->parameterValue)
+    ppStrings = (char **)calloc(count, sizeof(char *));
+    if (ppStrings == NULL)
+    {
+        /* Does not return */
+        JSE_THROW_COSA_ERROR(ctx, CCSP_ERR_MEMORY_ALLOC_FAIL,
+            "calloc() failed: %s", strerror(errno));
+    }
 
-                    if (size != 1 || strcmp(structGet[0]->parameterName, dotstr) != 0)
-                    {
-                        JSE_ERROR("Miss match!")
+    for (i = 0; i < count; i++)
+    {
+        duk_get_prop_index(ctx, idx, (duk_uarridx_t)i);
 
-                        free(ppDestComponentName);
-                        free(ppDestPath);
-                    }
-                    else
-                    {
-                        structSet[0].parameterName = (char *)dotstr;
-                        structSet[0].parameterValue = valcopy;
-                        structSet[0].type = structGet[0]->type;
-                        returnStatus =
-                            CcspBaseIf_setParameterValues(
-                                bus_handle,
-                                ppDestComponentName,
-                                ppDestPath,
-                                0,
-                                CCSP_COMPONENT_ID_WebUI,
-                                structSet,
-                                1,
-                                bDbusCommit,
-                                &pFaultParameterNames);
-
-                        /* Per C99 free(NULL) is a NOP */
-                        free(pFaultParameterNames);
-                        free_parameterValStruct_t(bus_handle, size, structGet);
-                        free(ppDestComponentName);
-                        free(ppDestPath);
-
-                        if (CCSP_SUCCESS != returnStatus)
-                        {
-                            free(valcopy);
+        /*FIXME unsafe cast from const char* to char*: fix when replacing ccsp with new system*/
+        ppStrings[i] = (char *)duk_get_string(ctx, -1);
+        duk_pop(ctx);
 
-                            /* Does not return */
-                            JSE_THROW_COSA_ERROR(ctx, returnStatus,
-                                "CcspBaseIf_setParameterValues() failed: \"%s\" \"%s\" %d",
-                                dotstr,
-                                structSet[0].parameterValue,
-                                bDbusCommit);
-                        }
-                        else
-                        {
-                            JSE_DEBUG(
-                                "dotstr=\"%s\", structSet[0].parameterValue=\"%s\", bDbusCommit=%d",
-                                dotstr,
-                                structSet[0].parameterValue,
-                                bDbusCommit);
-
-                            /* Return nothing (undefined) */
-                            ret = 0;
-                        }
-                    }
-                }
-            }
+        if (ppStrings[i] == NULL || ppStrings[i][0] == '\0')
+        {
+            free(ppStrings);
 
-            free(valcopy);
+            /* Does not return */
+            JSE_THROW_TYPE_ERROR(ctx, "Item %d is not a name!", i);
         }
     }
 
-    JSE_EXIT("setStr()=%d", ret)
-    return ret;
+    return ppStrings;
 }
 
 /**
- * @brief The binding for getInstanceIds()
- *
- * This function calls the real CCSP API:
- *  - CcspBaseIf_GetNextLevelInstances()
+ * @brief Gets the types of a group of parameters.
  *
- * @param ctx the duktape context.
+ * The types are taken from the type cache where possible. The rest are
+ * read from the component in one request.
  *
- * @return 1 or a negative error status.
+ * @param pGroup the group.
+ * @param useCache set false to ignore the type cache.
+ * @param pTypes an array of group count types to return the types.
+ * @param pCached a pointer to return whether any type came from the cache.
+ * @param pFaults a buffer to append the names of unknown parameters to.
+ * @param faultsSize the size of the buffer.
+ * @return CCSP_SUCCESS or an error status.
  */
-static duk_ret_t getInstanceIds(duk_context *ctx)
+static int GetParameterTypes(cosa_group_t *pGroup, bool useCache, enum dataType_e *pTypes, bool *pCached,
+    char *pFaults, size_t faultsSize)
 {
-    duk_ret_t ret = DUK_RET_ERROR;
-
-    char *dotstr = NULL;
-    char *ppDestComponentName = NULL;
-    char *ppDestPath = NULL;
+    parameterValStruct_t **ppParameterVal = NULL;
+    char **ppUncachedList = NULL;
+    int *pUncachedIndexList = NULL;
+    int uncachedCount = 0;
+    int valCount = 0;
     int returnStatus;
-    unsigned int InstNum = 0;
-    unsigned int *pInstNumList = NULL;
-    size_t loop1 = 0, loop2 = 0;
-    int len = 0;
-    char format_s[512] = {0};
-    char subSystemPrefix[6] = {0};
+    int i, j;
 
-    JSE_ASSERT(ctx != NULL)
-    JSE_ENTER("getInstanceIds(%p)", ctx)
+    *pCached = false;
 
-    if (DUK_EXEC_SUCCESS != parse_parameter(__FUNCTION__, ctx, "s", &dotstr))
+    ppUncachedList = (char **)calloc(pGroup->count, sizeof(char *));
+    pUncachedIndexList = (int *)calloc(pGroup->count, sizeof(int));
+    if (ppUncachedList == NULL || pUncachedIndexList == NULL)
     {
-        JSE_ERROR("Error parsing argument(s)!")
+        JSE_ERROR("calloc() failed: %s", strerror(errno))
+        free(ppUncachedList);
+        free(pUncachedIndexList);
+        return CCSP_ERR_MEMORY_ALLOC_FAIL;
     }
-    else
-    {
-        JSE_VERBOSE("dotstr=\"%s\"", dotstr)
-
-        /* Check whether there are subsystem prefix in the dot string
-           Split Subsytem prefix and COSA dotstr if subsystem prefix is found */
-        CheckAndSetSubsystemPrefix(&dotstr, subSystemPrefix);
 
-        JSE_VERBOSE("subSystemPrefix=\"%s\"", subSystemPrefix)
+    for (i = 0; i < pGroup->count; i++)
+    {
+        int type;
 
-        /* Get Destination component */
-        returnStatus = UiDbusClientGetDestComponent(dotstr, &ppDestComponentName, &ppDestPath, subSystemPrefix);
-        if (returnStatus != 0)
+        if (useCache && jse_cosa_cache_get_type(pGroup->subSystemPrefix, pGroup->ppParamNameList[i], &type) == 0)
         {
-            /* Does not return */
-            JSE_THROW_COSA_ERROR(ctx, returnStatus,
-                "UiDbusClientGetDestComponent() failed: \"%s\"", dotstr);
+            pTypes[i] = (enum dataType_e)type;
+            *pCached = true;
         }
         else
         {
-            /* Get Next Instance Numbers */
-            returnStatus =
-                CcspBaseIf_GetNextLevelInstances(
-                    bus_handle,
-                    ppDestComponentName,
-                    ppDestPath,
-                    dotstr,
-                    &InstNum,
-                    &pInstNumList);
+            ppUncachedList[uncachedCount] = pGroup->ppParamNameList[i];
+            pUncachedIndexList[uncachedCount] = i;
+            uncachedCount++;
+        }
+    }
 
-            free(ppDestComponentName);
-            free(ppDestPath);
+    if (useCache && uncachedCount > 0 && jse_cosa_bus_is_broker())
+    {
+        /* jse-cosad may have learnt the types from another process */
+        int *pBrokerTypes = (int *)calloc(uncachedCount, sizeof(int));
 
-            if (returnStatus != CCSP_SUCCESS)
-            {
-                /* Does not return */
-                JSE_THROW_COSA_ERROR(ctx, returnStatus,
-                    "CcspBaseIf_GetNextLevelInstances() failed");
-            }
-            else
+        if (pBrokerTypes != NULL &&
+            jse_cosa_bus_get_types(pGroup->subSystemPrefix, ppUncachedList, uncachedCount, pBrokerTypes) == CCSP_SUCCESS)
+        {
+            for (i = 0, j = 0; i < uncachedCount; i++)
             {
-                for (loop1 = 0, loop2 = 0; loop1 < (size_t)(InstNum) && loop2 < sizeof(format_s); loop1++)
+                if (pBrokerTypes[i] >= 0)
                 {
-                    len = snprintf(&format_s[loop2], sizeof(format_s) - loop2, "%d,", pInstNumList[loop1]);
-                    if (len < 0)
-                    {
-                        break;
-                    }
-
-                    loop2 = loop2 + len;
+                    pTypes[pUncachedIndexList[i]] = (enum dataType_e)pBrokerTypes[i];
+                    jse_cosa_cache_put_type(pGroup->subSystemPrefix, ppUncachedList[i], pBrokerTypes[i]);
+                    *pCached = true;
                 }
-
-                if (len < 0)
+                else
                 {
-                    free(pInstNumList);
-
-                    /* Does not return */
-                    JSE_THROW_COSA_ERROR(ctx, CCSP_FAILURE, "snprintf() failed!");
+                    ppUncachedList[j] = ppUncachedList[i];
+                    pUncachedIndexList[j] = pUncachedIndexList[i];
+                    j++;
                 }
+            }
 
-                duk_push_string(ctx, format_s);
+            uncachedCount = j;
+        }
 
-                /* One item returned on the bottom of the stack, the string */
-                ret = 1;
+        free(pBrokerTypes);
+    }
+
+    if (uncachedCount == 0)
+    {
+        free(ppUncachedList);
+        free(pUncachedIndexList);
+        return CCSP_SUCCESS;
+    }
+
+    returnStatus =
+        jse_cosa_bus_get_values(
+            pGroup->subSystemPrefix,
+            pGroup->pDestComponentName,
+            pGroup->pDestPath,
+            ppUncachedList,
+            uncachedCount,
+            &valCount,
+            &ppParameterVal);
+
+    if (returnStatus != CCSP_SUCCESS)
+    {
+        InvalidateDestComponentOnError(returnStatus, ppUncachedList[0], pGroup->subSystemPrefix);
+        AppendFaultName(pFaults, faultsSize, pGroup->pDestComponentName);
+        free(ppUncachedList);
+        free(pUncachedIndexList);
+        return returnStatus;
+    }
+
+    CacheParameterTypes(pGroup->subSystemPrefix, ppParameterVal, valCount);
+
+    for (i = 0; i < uncachedCount; i++)
+    {
+        for (j = 0; j < valCount; j++)
+        {
+            if (!strcmp(ppParameterVal[j]->parameterName, ppUncachedList[i]))
+            {
+                pTypes[pUncachedIndexList[i]] = ppParameterVal[j]->type;
+                break;
             }
+        }
 
-            free(pInstNumList);
+        if (j == valCount)
+        {
+            /* A partial path or a name that matched something else */
+            AppendFaultName(pFaults, faultsSize, ppUncachedList[i]);
+            returnStatus = CCSP_ERR_INVALID_PARAMETER_NAME;
         }
     }
 
-    JSE_EXIT("getInstanceIds()=%d", ret)
-    return ret;
+    if (valCount > 0)
+    {
+        jse_cosa_bus_free_values(valCount, ppParameterVal);
+    }
+
+    free(ppUncachedList);
+    free(pUncachedIndexList);
+
+    return returnStatus;
 }
 
 /**
- * @brief The binding for addTblObj()
+ * @brief Pushes a parameter value, optionally converted to its JS type.
  *
- * This function calls the real CCSP API:
- *  - CcspBaseIf_AddTblRow()
+ * Numeric types are converted to numbers, booleans to booleans and date
+ * times to Dates. Values that do not convert are pushed as strings.
  *
  * @param ctx the duktape context.
- *
- * @return 1 or a negative error status.
+ * @param pValue the value.
+ * @param type the CCSP type.
+ * @param typed set true to convert the value.
  */
-static duk_ret_t addTblObj(duk_context *ctx)
+static void PushParameterValue(duk_context *ctx, const char *pValue, enum dataType_e type, bool typed)
 {
-    duk_ret_t ret = DUK_RET_ERROR;
+    char *pEnd = NULL;
+    double number;
 
-    char *dotstr = NULL;
-    char *ppDestComponentName = NULL;
-    char *ppDestPath = NULL;
-    int returnStatus;
-    int returnInstNum = 0;
-    char subSystemPrefix[6] = {0};
+    if (typed)
+    {
+        switch (type)
+        {
+            case ccsp_int:
+            case ccsp_unsignedInt:
+            case ccsp_long:
+            case ccsp_unsignedLong:
+            case ccsp_float:
+            case ccsp_double:
+                number = strtod(pValue, &pEnd);
+                if (pEnd != pValue && *pEnd == '\0')
+                {
+                    duk_push_number(ctx, (duk_double_t)number);
+                    return;
+                }
+                break;
 
-    JSE_ASSERT(ctx != NULL)
-    JSE_ENTER("addTblObj(%p)", ctx)
+            case ccsp_boolean:
+                if (!strcmp(pValue, "true") || !strcmp(pValue, "1"))
+                {
+                    duk_push_true(ctx);
+                    return;
+                }
+                else if (!strcmp(pValue, "false") || !strcmp(pValue, "0"))
+                {
+                    duk_push_false(ctx);
+                    return;
+                }
+                break;
 
-    if (parse_parameter(__FUNCTION__, ctx, "s", &dotstr) != 0)
-    {
-        JSE_ERROR("Error parsing argument(s)!")
-    }
-    else
-    {
-        JSE_VERBOSE("dotstr=\"%s\"", dotstr)
+            case ccsp_dateTime:
+                /* Let the Date constructor parse the ISO 8601 string */
+                duk_get_global_string(ctx, "Date");
+                duk_push_string(ctx, pValue);
+                duk_new(ctx, 1);
+                return;
 
-        /* Check whether there are subsystem prefix in the dot string
-           Split Subsytem prefix and COSA dotstr if subsystem prefix is found */
-        CheckAndSetSubsystemPrefix(&dotstr, subSystemPrefix);
+            default:
+                break;
+        }
+    }
 
-        JSE_VERBOSE("subSystemPrefix=\"%s\"", subSystemPrefix)
+    duk_push_string(ctx, pValue);
+}
 
-        /* Get Destination component */
-        returnStatus = UiDbusClientGetDestComponent(dotstr, &ppDestComponentName, &ppDestPath, subSystemPrefix);
-        if (returnStatus != 0)
+/**
+ * @brief Checks whether a path segment is an instance number.
+ *
+ * @param pSegment the segment.
+ * @param len the length of the segment.
+ * @return true if an instance number.
+ */
+static bool IsInstanceSegment(const char *pSegment, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        if (!isdigit((unsigned char)pSegment[i]))
         {
-            /* Does not return */
-            JSE_THROW_COSA_ERROR(ctx, returnStatus,
-                "UiDbusClientGetDestComponent() failed: \"%s\"", dotstr);
+            return false;
         }
-        else
+    }
+
+    return len > 0;
+}
+
+/**
+ * @brief Pushes the row of an instance table, creating it if necessary.
+ *
+ * Rows are objects with the instance number in their _instance property.
+ *
+ * @param ctx the duktape context. The table array is at the top of the stack.
+ * @param instance the instance number.
+ */
+static void PushTableRow(duk_context *ctx, unsigned long instance)
+{
+    duk_size_t rows = duk_get_length(ctx, -1);
+    duk_size_t i;
+
+    /* The rows usually arrive in order so start with the last */
+    for (i = rows; i > 0; i--)
+    {
+        duk_get_prop_index(ctx, -1, (duk_uarridx_t)(i - 1));
+        duk_get_prop_string(ctx, -1, "_instance");
+        if ((unsigned long)duk_get_number(ctx, -1) == instance)
         {
-            returnStatus =
-                CcspBaseIf_AddTblRow(
-                    bus_handle,
-                    ppDestComponentName,
-                    ppDestPath,
-                    0,
-                    dotstr,
-                    &returnInstNum);
+            /* Leave the row */
+            duk_pop(ctx);
+            return;
+        }
+        duk_pop_2(ctx);
+    }
 
-            free(ppDestComponentName);
-            free(ppDestPath);
+    duk_push_object(ctx);
+    duk_push_number(ctx, (duk_double_t)instance);
+    duk_put_prop_string(ctx, -2, "_instance");
+    duk_dup_top(ctx);
+    duk_put_prop_index(ctx, -3, (duk_uarridx_t)rows);
+}
 
-            if (returnStatus != CCSP_SUCCESS)
+/**
+ * @brief Puts a parameter value in a tree of objects.
+ *
+ * Each segment of the name is an object except for instance tables which
+ * are arrays of rows.
+ *
+ * @param ctx the duktape context.
+ * @param rootIdx the index of the root of the tree.
+ * @param pName the name relative to the root.
+ * @param pValue the value.
+ * @param type the CCSP type.
+ * @param typed set true to convert the value to its JS type.
+ */
+static void PutTreeValue(duk_context *ctx, duk_idx_t rootIdx, const char *pName, const char *pValue,
+    enum dataType_e type, bool typed)
+{
+    const char *p = pName;
+    duk_idx_t pushed = 1;
+
+    duk_dup(ctx, rootIdx);
+
+    while (true)
+    {
+        size_t len = strcspn(p, ".");
+
+        if (p[len] == '\0')
+        {
+            /* The leaf */
+            PushParameterValue(ctx, pValue, type, typed);
+            duk_put_prop_lstring(ctx, -2, p, len);
+            break;
+        }
+
+        if (duk_is_array(ctx, -1) && IsInstanceSegment(p, len))
+        {
+            PushTableRow(ctx, strtoul(p, NULL, 10));
+        }
+        else if (!duk_get_prop_lstring(ctx, -1, p, len) || !duk_is_object(ctx, -1))
+        {
+            const char *pNext = p + len + 1;
+            size_t nextLen = strcspn(pNext, ".");
+
+            duk_pop(ctx);
+
+            /* An object whose children are numbered is an instance table */
+            if (pNext[nextLen] != '\0' && IsInstanceSegment(pNext, nextLen))
             {
-                /* Does not return */
-                JSE_THROW_COSA_ERROR(ctx, returnStatus,
-                    "CcspBaseIf_AddTblRow() failed: \"%s\"", dotstr);
+                duk_push_array(ctx);
             }
             else
             {
-                duk_push_int(ctx, returnInstNum);
-
-                /* One item returned on the bottom of the stack, the instance number */
-                ret = 1;
+                duk_push_object(ctx);
             }
+
+            duk_dup_top(ctx);
+            duk_put_prop_lstring(ctx, -3, p, len);
         }
+
+        pushed++;
+        p += len + 1;
     }
 
-    JSE_EXIT("addTblObj()=%d", ret)
-    return ret;
+    duk_pop_n(ctx, pushed);
 }
 
 /**
- * @brief The binding for delTblObj()
+ * @brief Gets the value of a parameter and pushes it on to the stack.
+ *
+ * The value is taken from the hot parameter cache or the memo if possible.
+ * Nothing is pushed on error.
+ *
+ * @param ctx the duktape context.
+ * @param dotstr the parameter name, optionally with a subsystem prefix.
+ * @param ppFailedCall a pointer to return the name of the call that failed.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int PushStrValue(duk_context *ctx, char *dotstr, const char **ppFailedCall)
+{
+    char *ppDestComponentName = NULL;
+    char *ppDestPath = NULL;
+    int size = 0;
+    parameterValStruct_t **parameterVal = NULL;
+    int returnStatus = 0;
+    char subSystemPrefix[6] = {0};
+    char *pHotValue = NULL;
+    int hotType;
+
+    JSE_VERBOSE("dotstr=\"%s\"", dotstr)
+
+    /* Check whether there are subsystem prefix in the dot string
+       Split Subsytem prefix and COSA dotstr if subsystem prefix is found */
+    jse_cosa_bus_split_prefix(&dotstr, subSystemPrefix);
+
+    JSE_VERBOSE("subSystemPrefix=\"%s\"", subSystemPrefix)
+
+    if (jse_cosa_cache_get_hot(subSystemPrefix, dotstr, &pHotValue, &hotType) == 0)
+    {
+        JSE_VERBOSE("Hot value=\"%s\"", pHotValue)
+
+        duk_push_string(ctx, pHotValue);
+        free(pHotValue);
+
+        return CCSP_SUCCESS;
+    }
+
+    if (MemoGetValues(subSystemPrefix, &dotstr, 1, &size, &parameterVal))
+    {
+        JSE_VERBOSE("Memoised value=\"%s\"", parameterVal[0]->parameterValue)
+
+        /* Return only first param value */
+        duk_push_string(ctx, parameterVal[0]->parameterValue);
+        MemoFreeValues(size, parameterVal);
+
+        return CCSP_SUCCESS;
+    }
+
+    /* Get Destination component */
+    returnStatus = jse_cosa_bus_discover(dotstr, &ppDestComponentName, &ppDestPath, subSystemPrefix);
+    if (returnStatus != 0)
+    {
+        *ppFailedCall = "UiDbusClientGetDestComponent()";
+        return returnStatus;
+    }
+
+    /* Get Parameter Vaues from ccsp */
+    returnStatus = jse_cosa_bus_get_values(subSystemPrefix,
+                                           ppDestComponentName,
+                                           ppDestPath,
+                                           &dotstr,
+                                           1,
+                                           &size,
+                                           &parameterVal);
+
+    free(ppDestComponentName);
+    free(ppDestPath);
+
+    if (CCSP_SUCCESS != returnStatus)
+    {
+        jse_cosa_bus_free_values(size, parameterVal);
+        InvalidateDestComponentOnError(returnStatus, dotstr, subSystemPrefix);
+
+        *ppFailedCall = "CcspBaseIf_getParameterValues()";
+        return returnStatus;
+    }
+
+    RememberParameterValues(subSystemPrefix, parameterVal, size);
+
+    /* Return only first param value */
+    if (size >= 1)
+    {
+        JSE_VERBOSE("parameterVal[0]->parameterValue=\"%s\"", parameterVal[0]->parameterValue)
+        duk_push_string(ctx, parameterVal[0]->parameterValue);
+    }
+    else
+    {
+        duk_push_string(ctx, "");
+    }
+
+    jse_cosa_bus_free_values(size, parameterVal);
+
+    return CCSP_SUCCESS;
+}
+
+/**
+ * @brief The binding for getStr()
  *
  * This function calls the real CCSP API:
- *  - CcspBaseIf_DeleteTblRow()
+ *  - CcspBaseIf_getParameterValues()
  *
  * @param ctx the duktape context.
  *
- * @return 0 or a negative error status.
+ * @return 1 or a negative error status.
  */
-static duk_ret_t delTblObj(duk_context *ctx)
+static duk_ret_t getStr(duk_context *ctx)
 {
     duk_ret_t ret = DUK_RET_ERROR;
 
     char *dotstr = NULL;
-    char *ppDestComponentName = NULL;
-    char *ppDestPath = NULL;
-    int returnStatus;
-    char subSystemPrefix[6] = {0};
+    const char *pFailedCall = NULL;
+    int returnStatus = 0;
 
     JSE_ASSERT(ctx != NULL)
-    JSE_ENTER("delTblObj(%p)", ctx)
+    JSE_ENTER("getStr(%p)", ctx)
 
+    /* Parse Input parameters first */
     if (parse_parameter(__FUNCTION__, ctx, "s", &dotstr) != 0)
     {
         JSE_ERROR("Error parsing argument(s)!")
     }
     else
     {
-        JSE_VERBOSE("dotstr=\"%s\"", dotstr)
-
-        /* Check whether there are subsystem prefix in the dot string
-           Split Subsytem prefix and COSA dotstr if subsystem prefix is found */
-        CheckAndSetSubsystemPrefix(&dotstr, subSystemPrefix);
-
-        JSE_VERBOSE("subSystemPrefix=\"%s\"", subSystemPrefix)
-
-        // Get Destination component
-        returnStatus = UiDbusClientGetDestComponent(dotstr, &ppDestComponentName, &ppDestPath, subSystemPrefix);
-        if (returnStatus != 0)
+        returnStatus = PushStrValue(ctx, dotstr, &pFailedCall);
+        if (returnStatus != CCSP_SUCCESS)
         {
             /* Does not return */
-            JSE_THROW_COSA_ERROR(ctx, returnStatus,
-                "UiDbusClientGetDestComponent() failed: \"%s\"", dotstr);
+            JSE_THROW_COSA_ERROR(ctx, returnStatus, "%s failed: \"%s\"", pFailedCall, dotstr);
         }
-        else
-        {
-            returnStatus =
-                CcspBaseIf_DeleteTblRow(
-                    bus_handle,
-                    ppDestComponentName,
-                    ppDestPath,
-                    0,
-                    dotstr);
-
-            free(ppDestComponentName);
-            free(ppDestPath);
 
-            if (returnStatus != CCSP_SUCCESS)
-            {
-                /* Does not return */
-                JSE_THROW_COSA_ERROR(ctx, returnStatus,
-                    "CcspBaseIf_DeleteTblRow() failed: \"%s\"", dotstr);
-            }
-            else
-            {
-                /* Return nothing (undefined) */
-                ret = 0;
-            }
-        }
+        /* Return one item, the last value in the stack. */
+        ret = 1;
     }
 
-    JSE_EXIT("delTblObj()=%d", ret)
+    JSE_EXIT("getStr()=%d", ret)
     return ret;
 }
 
 /**
- * @brief The binding for DmExtGetStrsWithRootObj()
+ * @brief The binding for tryGetStr()
  *
  * This function calls the real CCSP API:
  *  - CcspBaseIf_getParameterValues()
  * It takes the following arguments:
- *  - root object name, e.g. Device.NAT.
- *  - array of DM parameter names
+ *  - DM key/parameter
+ *  - optional value to return if the parameter can not be read
+ *
+ * As getStr() but no CosaError is created or thrown, which is far cheaper
+ * for probing optional parameters.
  *
  * @param ctx the duktape context.
  *
  * @return 1 or a negative error status.
  */
-static duk_ret_t DmExtGetStrsWithRootObj(duk_context *ctx)
+static duk_ret_t tryGetStr(duk_context *ctx)
 {
     duk_ret_t ret = DUK_RET_ERROR;
 
-    char *pRootObjName;
-    char subSystemPrefix[6] = {0};
+    char *dotstr = NULL;
+    const char *pFailedCall = NULL;
     int returnStatus = 0;
-    char *pDestComponentName = NULL;
-    char *pDestPath = NULL;
-
-    duk_idx_t pParamNameArray;
-    int paramCount;
-    char **ppParamNameList = NULL;
-    duk_uarridx_t index = 0;
-    int valCount = 0;
-    parameterValStruct_t **ppParameterVal = NULL;
 
     JSE_ASSERT(ctx != NULL)
-    JSE_ENTER("DmExtGetStrsWithRootObj(%p)", ctx)
+    JSE_ENTER("tryGetStr(%p)", ctx)
 
-    /* Parse parameters */
-    if (parse_parameter(__FUNCTION__, ctx, "so", &pRootObjName, &pParamNameArray) != 0)
+    if (parse_parameter(__FUNCTION__, ctx, "s", &dotstr) != 0)
     {
         JSE_ERROR("Error parsing argument(s)!")
     }
     else
     {
-        JSE_VERBOSE("pRootObjName=\"%s\"", pRootObjName)
+        returnStatus = PushStrValue(ctx, dotstr, &pFailedCall);
+        if (returnStatus != CCSP_SUCCESS)
+        {
+            JSE_VERBOSE("%s failed: \"%s\" (%d)", pFailedCall, dotstr, returnStatus)
+            jse_stats_add("cosa.try.default", 1);
 
-        /* Check whether there is subsystem prefix in the dot string
-        Split Subsytem prefix and COSA dotstr if subsystem prefix is found */
-        CheckAndSetSubsystemPrefix(&pRootObjName, subSystemPrefix);
+            /* The default, undefined if not given */
+            duk_dup(ctx, 1);
+        }
 
-        JSE_VERBOSE("subSystemPrefix=\"%s\"", subSystemPrefix)
+        /* Return one item, the last value in the stack. */
+        ret = 1;
+    }
 
-        /*
-        *  Get Destination component for root obj name
-        */
-        returnStatus = UiDbusClientGetDestComponent(pRootObjName, &pDestComponentName, &pDestPath, subSystemPrefix);
-        if (returnStatus != 0)
+    JSE_EXIT("tryGetStr()=%d", ret)
+    return ret;
+}
+
+/**
+ * @brief The binding for setStr()
+ *
+ * This function calls the real CCSP APIs:
+ *  - CcspBaseIf_getParameterValues()
+ *  - CcspBaseIf_setParameterValues()
+ * It takes the following arguments:
+ *  - DM key/parameter
+ *  - value to be set
+ *  - commit flag
+ *
+ * @param ctx the duktape context.
+ *
+ * @return 0 or an negative error status.
+ */
+static duk_ret_t setStr(duk_context *ctx)
+{
+    duk_ret_t ret = DUK_RET_ERROR;
+
+    char *dotstr = NULL;
+    char *val = NULL;
+    duk_bool_t bCommit = 0;
+    char *ppDestComponentName = NULL;
+    char *ppDestPath = NULL;
+    parameterValStruct_t structSet[1];
+    int returnStatus;
+    char *pFaultParameterNames = NULL;
+    char subSystemPrefix[6] = {0};
+    bool bDbusCommit = true;
+
+    JSE_ASSERT(ctx != NULL)
+    JSE_ENTER("setStr(%p)", ctx)
+
+    /* Parse Parameters first */
+    if (parse_parameter(__FUNCTION__, ctx, "sab", &dotstr, &val, &bCommit) != 0)
+    {
+        JSE_ERROR("Error parsing argument(s)!")
+    }
+    else
+    {
+        char *valcopy = strdup(val);
+        if (valcopy == NULL)
         {
             /* Does not return */
-            JSE_THROW_COSA_ERROR(ctx, returnStatus,
-                "UiDbusClientGetDestComponent() failed: \"%s\"", pRootObjName);
+            JSE_THROW_COSA_ERROR(ctx, CCSP_ERR_MEMORY_ALLOC_FAIL,
+                "strdup(): %s", strerror(errno));
         }
         else
         {
-            JSE_DEBUG("pRootObjName=\"%s\", pDestComponentName\"%s\", pDestPath=\"%s\"\n",
-                pRootObjName, pDestComponentName, pDestPath)
-        }
+            JSE_VERBOSE("dotstr=\"%s\",val=\"%s\",bCommit=%s", dotstr, valcopy, bCommit ? "true" : "false")
 
-        /*
-        *  Construct parameter name array
-        */
-        paramCount = get_array_length(ctx, pParamNameArray);
+            bDbusCommit = (bCommit) ? 1 : 0;
 
-        JSE_VERBOSE("paramCount=%d", paramCount)
-
-        ppParamNameList = (char **)calloc(paramCount, sizeof(char *));
-        if (ppParamNameList == NULL)
-        {
-            free(pDestComponentName);
-            free(pDestPath);
+            /* Check whether there is subsystem prefix in the dot string
+            Split Subsytem prefix and COSA dotstr if subsystem prefix is found */
+            jse_cosa_bus_split_prefix(&dotstr, subSystemPrefix);
 
-            /* Does not return */
-            JSE_THROW_COSA_ERROR(ctx, CCSP_ERR_MEMORY_ALLOC_FAIL,
-                "calloc() failed: %s", strerror(errno));
-        }
+            /* The value is about to change so forget any cached values */
+            ForgetParameterValues(subSystemPrefix, dotstr);
 
-        index = 0;
+            JSE_VERBOSE("subSystemPrefix=\"%s\"", subSystemPrefix)
 
-        /* Iterate array and get the values */
-        duk_enum(ctx, pParamNameArray, 0);
-        while (duk_next(ctx, -1, true /* get val in addition to key */))
-        {
-            /*FIXME unsafe cast from const char* to char*: fix when replacing ccsp with new system*/
-            char *value = (char *)duk_get_string(ctx, -1); /*val at -1, key at -2*/
-            if (value)
+            /* Get Destination component */
+            returnStatus = jse_cosa_bus_discover(dotstr, &ppDestComponentName, &ppDestPath, subSystemPrefix);
+            if (returnStatus != 0)
             {
-                ppParamNameList[index] = value;
-                JSE_VERBOSE("ppParamNameList[%d]=\"%s\"", index, ppParamNameList[index])
-                index++;
+                free(valcopy);
+
+                /* Does not return */
+                JSE_THROW_COSA_ERROR(ctx, returnStatus,
+                    "UiDbusClientGetDestComponent() failed: \"%s\"", dotstr);
             }
-#ifdef JSE_DEBUG
             else
             {
-                if (duk_get_type(ctx, -2) == DUK_TYPE_NUMBER)
+                cosa_group_t group;
+                enum dataType_e type = ccsp_string;
+                bool cached = false;
+                /* Temporary buffer on the stack which will get cleaned up on throw */
+                char faultNames[256] = {0};
+                const char *pFailedCall = "CcspBaseIf_getParameterValues()";
+                int attempt;
+
+                memset(&group, 0, sizeof(group));
+                group.pDestComponentName = ppDestComponentName;
+                group.pDestPath = ppDestPath;
+                memcpy(group.subSystemPrefix, subSystemPrefix, sizeof(group.subSystemPrefix));
+                group.count = 1;
+                group.ppParamNameList = &dotstr;
+
+                /* The type comes from the cache, or the current value, and a
+                   cached type is retried once if the component rejects it */
+                for (attempt = 0; attempt < 2; attempt++)
                 {
-                    unsigned int key = duk_get_uint(ctx, -2);
-                    JSE_VERBOSE("Item %u is null!", key);
+                    returnStatus = GetParameterTypes(&group, attempt == 0, &type, &cached,
+                        faultNames, sizeof(faultNames));
+                    if (returnStatus != CCSP_SUCCESS)
+                    {
+                        pFailedCall = "CcspBaseIf_getParameterValues()";
+                        break;
+                    }
+
+                    structSet[0].parameterName = (char *)dotstr;
+                    structSet[0].parameterValue = valcopy;
+                    structSet[0].type = type;
+                    returnStatus =
+                        jse_cosa_bus_set_values(
+                            subSystemPrefix,
+                            ppDestComponentName,
+                            ppDestPath,
+                            structSet,
+                            1,
+                            bDbusCommit,
+                            &pFaultParameterNames);
+
+                    /* Per C99 free(NULL) is a NOP */
+                    free(pFaultParameterNames);
+                    pFaultParameterNames = NULL;
+
+                    pFailedCall = "CcspBaseIf_setParameterValues()";
+
+                    if (returnStatus != CCSP_ERR_INVALID_PARAMETER_TYPE || !cached)
+                    {
+                        break;
+                    }
+
+                    JSE_DEBUG("Cached type of \"%s\" rejected, retrying", dotstr)
+                    jse_cosa_cache_invalidate_type(subSystemPrefix, dotstr);
                 }
-                else if (duk_get_type(ctx, -2) == DUK_TYPE_STRING)
+
+                free(ppDestComponentName);
+                free(ppDestPath);
+
+                if (CCSP_SUCCESS != returnStatus)
                 {
-                    const char * key = duk_get_string(ctx, -2);
-                    JSE_VERBOSE("Item \"%s\" is null!", key);
+                    InvalidateDestComponentOnError(returnStatus, dotstr, subSystemPrefix);
+                    free(valcopy);
+
+                    /* Does not return */
+                    JSE_THROW_COSA_ERROR(ctx, returnStatus,
+                        "%s failed: \"%s\" %d", pFailedCall, dotstr, bDbusCommit);
                 }
                 else
                 {
-                    JSE_VERBOSE("Item with unrecognised key is null!");
+                    JSE_DEBUG(
+                        "dotstr=\"%s\", structSet[0].parameterValue=\"%s\", bDbusCommit=%d",
+                        dotstr,
+                        structSet[0].parameterValue,
+                        bDbusCommit);
+
+                    /* Return nothing (undefined) */
+                    ret = 0;
                 }
             }
-#endif
-            duk_pop_2(ctx);
+
+            free(valcopy);
         }
-        duk_pop(ctx);
-        /* done with array */
+    }
 
-        returnStatus =
-            CcspBaseIf_getParameterValues(
-                bus_handle,
-                pDestComponentName,
-                pDestPath,
-                ppParamNameList,
-                paramCount,
-                &valCount, /* valCount could be larger than paramCount */
-                &ppParameterVal);
+    JSE_EXIT("setStr()=%d", ret)
+    return ret;
+}
 
-        free(pDestComponentName);
-        free(pDestPath);
+/**
+ * @brief The binding for getInstanceIds()
+ *
+ * This function calls the real CCSP API:
+ *  - CcspBaseIf_GetNextLevelInstances()
+ *
+ * @param ctx the duktape context.
+ *
+ * @return 1 or a negative error status.
+ */
+static duk_ret_t getInstanceIds(duk_context *ctx)
+{
+    duk_ret_t ret = DUK_RET_ERROR;
 
-        if (CCSP_SUCCESS != returnStatus)
+    char *dotstr = NULL;
+    char *ppDestComponentName = NULL;
+    char *ppDestPath = NULL;
+    int returnStatus;
+    unsigned int InstNum = 0;
+    unsigned int *pInstNumList = NULL;
+    size_t loop1 = 0, loop2 = 0;
+    int len = 0;
+    char format_s[512] = {0};
+    char subSystemPrefix[6] = {0};
+
+    JSE_ASSERT(ctx != NULL)
+    JSE_ENTER("getInstanceIds(%p)", ctx)
+
+    if (DUK_EXEC_SUCCESS != parse_parameter(__FUNCTION__, ctx, "s", &dotstr))
+    {
+        JSE_ERROR("Error parsing argument(s)!")
+    }
+    else
+    {
+        JSE_VERBOSE("dotstr=\"%s\"", dotstr)
+
+        /* Check whether there are subsystem prefix in the dot string
+           Split Subsytem prefix and COSA dotstr if subsystem prefix is found */
+        jse_cosa_bus_split_prefix(&dotstr, subSystemPrefix);
+
+        JSE_VERBOSE("subSystemPrefix=\"%s\"", subSystemPrefix)
+
+        /* Get Destination component */
+        returnStatus = jse_cosa_bus_discover(dotstr, &ppDestComponentName, &ppDestPath, subSystemPrefix);
+        if (returnStatus != 0)
         {
-            free(ppParamNameList);
             /* Does not return */
-            JSE_THROW_COSA_ERROR(ctx, returnStatus, "CcspBaseIf_getParameterValues() failed");
+            JSE_THROW_COSA_ERROR(ctx, returnStatus,
+                "UiDbusClientGetDestComponent() failed: \"%s\"", dotstr);
         }
         else
         {
-            /*
-            * construct return value array: the first value is return status,
-            * the rest are sub arrays, array ( parameter name, value )
-            */
-            duk_idx_t arr_idx = duk_push_array(ctx);
-            duk_push_int(ctx, 0);
-            duk_put_prop_index(ctx, arr_idx, 0);
+            /* Get Next Instance Numbers */
+            returnStatus =
+                jse_cosa_bus_get_instances(
+                    ppDestComponentName,
+                    ppDestPath,
+                    dotstr,
+                    &InstNum,
+                    &pInstNumList);
 
-            JSE_VERBOSE("%d values returned:", valCount)
+            free(ppDestComponentName);
+            free(ppDestPath);
 
-            for (index = 0; index < valCount; index++)
+            if (returnStatus != CCSP_SUCCESS)
             {
-                duk_idx_t sub_idx;
-                JSE_VERBOSE(
-                    "ppParameterVal[%d]->parameterName=\"%s\", ppParameterVal[%d]->parameterValue=\"%s\"",
-                    index, ppParameterVal[index]->parameterName,
-                    index, ppParameterVal[index]->parameterValue)
+                InvalidateDestComponentOnError(returnStatus, dotstr, subSystemPrefix);
 
-                sub_idx = duk_push_array(ctx);
-                duk_push_string(ctx, ppParameterVal[index]->parameterName);
-                duk_put_prop_index(ctx, sub_idx, 0);
-                duk_push_string(ctx, ppParameterVal[index]->parameterValue);
-                duk_put_prop_index(ctx, sub_idx, 1);
-                duk_put_prop_index(ctx, arr_idx, index + 1);
+                /* Does not return */
+                JSE_THROW_COSA_ERROR(ctx, returnStatus,
+                    "CcspBaseIf_GetNextLevelInstances() failed");
             }
-
-            if (valCount > 0)
+            else
             {
-                free_parameterValStruct_t(bus_handle, valCount, ppParameterVal);
-            }
+                for (loop1 = 0, loop2 = 0; loop1 < (size_t)(InstNum) && loop2 < sizeof(format_s); loop1++)
+                {
+                    len = snprintf(&format_s[loop2], sizeof(format_s) - loop2, "%d,", pInstNumList[loop1]);
+                    if (len < 0)
+                    {
+                        break;
+                    }
 
-            free(ppParamNameList);
+                    loop2 = loop2 + len;
+                }
 
-            /* One item returned on the bottom of the stack, the value array */
-            ret = 1;
+                if (len < 0)
+                {
+                    free(pInstNumList);
+
+                    /* Does not return */
+                    JSE_THROW_COSA_ERROR(ctx, CCSP_FAILURE, "snprintf() failed!");
+                }
+
+                duk_push_string(ctx, format_s);
+
+                /* One item returned on the bottom of the stack, the string */
+                ret = 1;
+            }
+
+            free(pInstNumList);
         }
     }
 
-    JSE_EXIT("DmExtGetStrsWithRootObj()=%d", ret)
+    JSE_EXIT("getInstanceIds()=%d", ret)
     return ret;
 }
 
 /**
- * @brief The binding for DmExtSetStrsWithRootObj()
+ * @brief The binding for addTblObj()
  *
  * This function calls the real CCSP API:
- *  - CcspBaseIf_setParameterValues()
- * It takes the following arguments:
- *  - root object name, e.g. Device.NAT.
- *  - commit flag
- *  - array of DM parameter names
+ *  - CcspBaseIf_AddTblRow()
  *
  * @param ctx the duktape context.
  *
- * @return 0 or a negative error status.
+ * @return 1 or a negative error status.
  */
-static duk_ret_t DmExtSetStrsWithRootObj(duk_context *ctx)
+static duk_ret_t addTblObj(duk_context *ctx)
 {
     duk_ret_t ret = DUK_RET_ERROR;
 
-    int returnStatus = 0;
-    char *pRootObjName;
+    char *dotstr = NULL;
+    char *ppDestComponentName = NULL;
+    char *ppDestPath = NULL;
+    int returnStatus;
+    int returnInstNum = 0;
     char subSystemPrefix[6] = {0};
-    char *pDestComponentName = NULL;
-    char *pDestPath = NULL;
-
-    duk_bool_t bCommit = 1;
-    dbus_bool bDbusCommit = 1;
-
-    duk_idx_t pParamArray;
-    int paramCount;
-    parameterValStruct_t *pParameterValList = NULL;
-    char BoolStrBuf[16] = {0};
-    duk_uarridx_t index = 0;
-    char *pFaultParamName = NULL;
 
     JSE_ASSERT(ctx != NULL)
-    JSE_ENTER("DmExtSetStrsWithRootObj(%p)", ctx)
+    JSE_ENTER("addTblObj(%p)", ctx)
 
-    /* Parse paremeters */
-    if (parse_parameter(__FUNCTION__, ctx, "sbo", &pRootObjName, &bCommit, &pParamArray) != 0)
+    if (parse_parameter(__FUNCTION__, ctx, "s", &dotstr) != 0)
     {
         JSE_ERROR("Error parsing argument(s)!")
     }
     else
     {
-        JSE_VERBOSE("pRootObjName=\"%s\", bCommit=%s", pRootObjName, bCommit ? "true" : "false")
+        JSE_VERBOSE("dotstr=\"%s\"", dotstr)
 
-        bDbusCommit = (bCommit) ? 1 : 0;
+        /* Check whether there are subsystem prefix in the dot string
+           Split Subsytem prefix and COSA dotstr if subsystem prefix is found */
+        jse_cosa_bus_split_prefix(&dotstr, subSystemPrefix);
 
-        /* Check whether there is subsystem prefix in the dot string
-        Split Subsytem prefix and COSA dotstr if subsystem prefix is found */
-        CheckAndSetSubsystemPrefix(&pRootObjName, subSystemPrefix);
+        /* The table is about to change so forget any cached values */
+        ForgetParameterValues(subSystemPrefix, dotstr);
 
         JSE_VERBOSE("subSystemPrefix=\"%s\"", subSystemPrefix)
 
-        /*
-        *  Get Destination component for root obj name
-        */
-        returnStatus = UiDbusClientGetDestComponent(pRootObjName, &pDestComponentName, &pDestPath, subSystemPrefix);
+        /* Get Destination component */
+        returnStatus = jse_cosa_bus_discover(dotstr, &ppDestComponentName, &ppDestPath, subSystemPrefix);
         if (returnStatus != 0)
         {
             /* Does not return */
             JSE_THROW_COSA_ERROR(ctx, returnStatus,
-                "UiDbusClientGetDestComponent() failed: \"%s\"", pRootObjName);
+                "UiDbusClientGetDestComponent() failed: \"%s\"", dotstr);
         }
         else
         {
-            JSE_DEBUG(
-                "pRootObjName=\"%s\", bDbusCommit=%d, pDestComponentName=\"%s\", pDestPath=\"%s\"\n",
-                pRootObjName,
-                bDbusCommit,
-                pDestComponentName,
-                pDestPath)
-        }
+            returnStatus =
+                jse_cosa_bus_add_row(
+                    subSystemPrefix,
+                    ppDestComponentName,
+                    ppDestPath,
+                    dotstr,
+                    &returnInstNum);
 
-        /*
-        *  Construct parameter value array
-        */
-        paramCount = get_array_length(ctx, pParamArray);
+            free(ppDestComponentName);
+            free(ppDestPath);
 
-        JSE_VERBOSE("paramCount=%d", paramCount)
+            if (returnStatus != CCSP_SUCCESS)
+            {
+                InvalidateDestComponentOnError(returnStatus, dotstr, subSystemPrefix);
 
-        pParameterValList = (parameterValStruct_t *)calloc(paramCount, sizeof(parameterValStruct_t));
-        if (pParameterValList == NULL)
-        {
+                /* Does not return */
+                JSE_THROW_COSA_ERROR(ctx, returnStatus,
+                    "CcspBaseIf_AddTblRow() failed: \"%s\"", dotstr);
+            }
+            else
+            {
+                duk_push_int(ctx, returnInstNum);
+
+                /* One item returned on the bottom of the stack, the instance number */
+                ret = 1;
+            }
+        }
+    }
+
+    JSE_EXIT("addTblObj()=%d", ret)
+    return ret;
+}
+
+/**
+ * @brief The binding for delTblObj()
+ *
+ * This function calls the real CCSP API:
+ *  - CcspBaseIf_DeleteTblRow()
+ *
+ * @param ctx the duktape context.
+ *
+ * @return 0 or a negative error status.
+ */
+static duk_ret_t delTblObj(duk_context *ctx)
+{
+    duk_ret_t ret = DUK_RET_ERROR;
+
+    char *dotstr = NULL;
+    char *ppDestComponentName = NULL;
+    char *ppDestPath = NULL;
+    int returnStatus;
+    char subSystemPrefix[6] = {0};
+
+    JSE_ASSERT(ctx != NULL)
+    JSE_ENTER("delTblObj(%p)", ctx)
+
+    if (parse_parameter(__FUNCTION__, ctx, "s", &dotstr) != 0)
+    {
+        JSE_ERROR("Error parsing argument(s)!")
+    }
+    else
+    {
+        JSE_VERBOSE("dotstr=\"%s\"", dotstr)
+
+        /* Check whether there are subsystem prefix in the dot string
+           Split Subsytem prefix and COSA dotstr if subsystem prefix is found */
+        jse_cosa_bus_split_prefix(&dotstr, subSystemPrefix);
+
+        /* The table is about to change so forget any cached values */
+        ForgetParameterValues(subSystemPrefix, dotstr);
+
+        JSE_VERBOSE("subSystemPrefix=\"%s\"", subSystemPrefix)
+
+        // Get Destination component
+        returnStatus = jse_cosa_bus_discover(dotstr, &ppDestComponentName, &ppDestPath, subSystemPrefix);
+        if (returnStatus != 0)
+        {
+            /* Does not return */
+            JSE_THROW_COSA_ERROR(ctx, returnStatus,
+                "UiDbusClientGetDestComponent() failed: \"%s\"", dotstr);
+        }
+        else
+        {
+            returnStatus =
+                jse_cosa_bus_delete_row(
+                    subSystemPrefix,
+                    ppDestComponentName,
+                    ppDestPath,
+                    dotstr);
+
+            free(ppDestComponentName);
+            free(ppDestPath);
+
+            if (returnStatus != CCSP_SUCCESS)
+            {
+                InvalidateDestComponentOnError(returnStatus, dotstr, subSystemPrefix);
+
+                /* Does not return */
+                JSE_THROW_COSA_ERROR(ctx, returnStatus,
+                    "CcspBaseIf_DeleteTblRow() failed: \"%s\"", dotstr);
+            }
+            else
+            {
+                /* Return nothing (undefined) */
+                ret = 0;
+            }
+        }
+    }
+
+    JSE_EXIT("delTblObj()=%d", ret)
+    return ret;
+}
+
+/**
+ * @brief Gets parameters supported by the component of a root object.
+ *
+ * This function calls the real CCSP API:
+ *  - CcspBaseIf_getParameterValues()
+ * It takes the following arguments:
+ *  - root object name, e.g. Device.NAT.
+ *  - array of DM parameter names
+ *
+ * @param ctx the duktape context.
+ * @param func the name of the binding.
+ * @param typedObject set true to return an object of typed values rather
+ * than an array of name and string value arrays.
+ *
+ * @return 1 or a negative error status.
+ */
+static duk_ret_t GetWithRootObj(duk_context *ctx, const char *func, bool typedObject)
+{
+    duk_ret_t ret = DUK_RET_ERROR;
+
+    char *pRootObjName;
+    char subSystemPrefix[6] = {0};
+    int returnStatus = 0;
+    char *pDestComponentName = NULL;
+    char *pDestPath = NULL;
+
+    duk_idx_t pParamNameArray;
+    int paramCount;
+    char **ppParamNameList = NULL;
+    duk_uarridx_t index = 0;
+    int valCount = 0;
+    parameterValStruct_t **ppParameterVal = NULL;
+    bool memoised = false;
+
+    JSE_ASSERT(ctx != NULL)
+    JSE_ENTER("GetWithRootObj(%p,\"%s\",%d)", ctx, func, typedObject)
+
+    /* Parse parameters */
+    if (parse_parameter(func, ctx, "so", &pRootObjName, &pParamNameArray) != 0)
+    {
+        JSE_ERROR("Error parsing argument(s)!")
+    }
+    else
+    {
+        JSE_VERBOSE("pRootObjName=\"%s\"", pRootObjName)
+
+        /* Check whether there is subsystem prefix in the dot string
+        Split Subsytem prefix and COSA dotstr if subsystem prefix is found */
+        jse_cosa_bus_split_prefix(&pRootObjName, subSystemPrefix);
+
+        JSE_VERBOSE("subSystemPrefix=\"%s\"", subSystemPrefix)
+
+        /*
+        *  Get Destination component for root obj name
+        */
+        returnStatus = jse_cosa_bus_discover(pRootObjName, &pDestComponentName, &pDestPath, subSystemPrefix);
+        if (returnStatus != 0)
+        {
+            /* Does not return */
+            JSE_THROW_COSA_ERROR(ctx, returnStatus,
+                "UiDbusClientGetDestComponent() failed: \"%s\"", pRootObjName);
+        }
+        else
+        {
+            JSE_DEBUG("pRootObjName=\"%s\", pDestComponentName\"%s\", pDestPath=\"%s\"\n",
+                pRootObjName, pDestComponentName, pDestPath)
+        }
+
+        /*
+        *  Construct parameter name array
+        */
+        paramCount = get_array_length(ctx, pParamNameArray);
+
+        JSE_VERBOSE("paramCount=%d", paramCount)
+
+        ppParamNameList = (char **)calloc(paramCount, sizeof(char *));
+        if (ppParamNameList == NULL)
+        {
+            free(pDestComponentName);
+            free(pDestPath);
+
+            /* Does not return */
+            JSE_THROW_COSA_ERROR(ctx, CCSP_ERR_MEMORY_ALLOC_FAIL,
+                "calloc() failed: %s", strerror(errno));
+        }
+
+        index = 0;
+
+        /* Iterate array and get the values */
+        duk_enum(ctx, pParamNameArray, 0);
+        while (duk_next(ctx, -1, true /* get val in addition to key */))
+        {
+            /*FIXME unsafe cast from const char* to char*: fix when replacing ccsp with new system*/
+            char *value = (char *)duk_get_string(ctx, -1); /*val at -1, key at -2*/
+            if (value)
+            {
+                ppParamNameList[index] = value;
+                JSE_VERBOSE("ppParamNameList[%d]=\"%s\"", index, ppParamNameList[index])
+                index++;
+            }
+#ifdef JSE_DEBUG
+            else
+            {
+                if (duk_get_type(ctx, -2) == DUK_TYPE_NUMBER)
+                {
+                    unsigned int key = duk_get_uint(ctx, -2);
+                    JSE_VERBOSE("Item %u is null!", key);
+                }
+                else if (duk_get_type(ctx, -2) == DUK_TYPE_STRING)
+                {
+                    const char * key = duk_get_string(ctx, -2);
+                    JSE_VERBOSE("Item \"%s\" is null!", key);
+                }
+                else
+                {
+                    JSE_VERBOSE("Item with unrecognised key is null!");
+                }
+            }
+#endif
+            duk_pop_2(ctx);
+        }
+        duk_pop(ctx);
+        /* done with array */
+
+        if (MemoGetValues(subSystemPrefix, ppParamNameList, (int)index, &valCount, &ppParameterVal))
+        {
+            memoised = true;
+            returnStatus = CCSP_SUCCESS;
+        }
+        else
+        {
+            returnStatus =
+                jse_cosa_bus_get_values(
+                    subSystemPrefix,
+                    pDestComponentName,
+                    pDestPath,
+                    ppParamNameList,
+                    paramCount,
+                    &valCount, /* valCount could be larger than paramCount */
+                    &ppParameterVal);
+        }
+
+        free(pDestComponentName);
+        free(pDestPath);
+
+        if (CCSP_SUCCESS != returnStatus)
+        {
+            free(ppParamNameList);
+            InvalidateDestComponentOnError(returnStatus, pRootObjName, subSystemPrefix);
+
+            /* Does not return */
+            JSE_THROW_COSA_ERROR(ctx, returnStatus, "CcspBaseIf_getParameterValues() failed");
+        }
+        else
+        {
+            duk_idx_t arr_idx;
+
+            /*
+            * construct return value array: the first value is return status,
+            * the rest are sub arrays, array ( parameter name, value )
+            * or for a typed object, an object of the values
+            */
+            if (typedObject)
+            {
+                arr_idx = duk_push_object(ctx);
+            }
+            else
+            {
+                arr_idx = duk_push_array(ctx);
+                duk_push_int(ctx, 0);
+                duk_put_prop_index(ctx, arr_idx, 0);
+            }
+
+            JSE_VERBOSE("%d values returned:", valCount)
+
+            if (!memoised)
+            {
+                RememberParameterValues(subSystemPrefix, ppParameterVal, valCount);
+            }
+
+            for (index = 0; index < valCount; index++)
+            {
+                duk_idx_t sub_idx;
+
+                JSE_VERBOSE(
+                    "ppParameterVal[%d]->parameterName=\"%s\", ppParameterVal[%d]->parameterValue=\"%s\"",
+                    index, ppParameterVal[index]->parameterName,
+                    index, ppParameterVal[index]->parameterValue)
+
+                if (typedObject)
+                {
+                    PushParameterValue(ctx, ppParameterVal[index]->parameterValue, ppParameterVal[index]->type, true);
+                    duk_put_prop_string(ctx, arr_idx, ppParameterVal[index]->parameterName);
+                    continue;
+                }
+
+                sub_idx = duk_push_array(ctx);
+                duk_push_string(ctx, ppParameterVal[index]->parameterName);
+                duk_put_prop_index(ctx, sub_idx, 0);
+                duk_push_string(ctx, ppParameterVal[index]->parameterValue);
+                duk_put_prop_index(ctx, sub_idx, 1);
+                duk_put_prop_index(ctx, arr_idx, index + 1);
+            }
+
+            FreeParameterValues(memoised, valCount, ppParameterVal);
+
+            free(ppParamNameList);
+
+            /* One item returned on the bottom of the stack, the value array */
+            ret = 1;
+        }
+    }
+
+    JSE_EXIT("GetWithRootObj()=%d", ret)
+    return ret;
+}
+
+/**
+ * @brief The binding for DmExtGetStrsWithRootObj()
+ *
+ * Returns an array whose first element is the status, always 0, followed
+ * by a name and string value array for each parameter.
+ *
+ * @param ctx the duktape context.
+ *
+ * @return 1 or a negative error status.
+ */
+static duk_ret_t DmExtGetStrsWithRootObj(duk_context *ctx)
+{
+    return GetWithRootObj(ctx, __FUNCTION__, false);
+}
+
+/**
+ * @brief The binding for DmExtGetObjWithRootObj()
+ *
+ * Returns an object with a property, holding the typed value, for each
+ * parameter.
+ *
+ * @param ctx the duktape context.
+ *
+ * @return 1 or a negative error status.
+ */
+static duk_ret_t DmExtGetObjWithRootObj(duk_context *ctx)
+{
+    return GetWithRootObj(ctx, __FUNCTION__, true);
+}
+
+/**
+ * @brief The binding for DmExtSetStrsWithRootObj()
+ *
+ * This function calls the real CCSP API:
+ *  - CcspBaseIf_setParameterValues()
+ * It takes the following arguments:
+ *  - root object name, e.g. Device.NAT.
+ *  - commit flag
+ *  - array of DM parameter names
+ *
+ * @param ctx the duktape context.
+ *
+ * @return 0 or a negative error status.
+ */
+static duk_ret_t DmExtSetStrsWithRootObj(duk_context *ctx)
+{
+    duk_ret_t ret = DUK_RET_ERROR;
+
+    int returnStatus = 0;
+    char *pRootObjName;
+    char subSystemPrefix[6] = {0};
+    char *pDestComponentName = NULL;
+    char *pDestPath = NULL;
+
+    duk_bool_t bCommit = 1;
+    bool bDbusCommit = true;
+
+    duk_idx_t pParamArray;
+    int paramCount;
+    parameterValStruct_t *pParameterValList = NULL;
+    char BoolStrBuf[16] = {0};
+    duk_uarridx_t index = 0;
+    char *pFaultParamName = NULL;
+
+    JSE_ASSERT(ctx != NULL)
+    JSE_ENTER("DmExtSetStrsWithRootObj(%p)", ctx)
+
+    /* Parse paremeters */
+    if (parse_parameter(__FUNCTION__, ctx, "sbo", &pRootObjName, &bCommit, &pParamArray) != 0)
+    {
+        JSE_ERROR("Error parsing argument(s)!")
+    }
+    else
+    {
+        JSE_VERBOSE("pRootObjName=\"%s\", bCommit=%s", pRootObjName, bCommit ? "true" : "false")
+
+        bDbusCommit = (bCommit) ? 1 : 0;
+
+        /* Check whether there is subsystem prefix in the dot string
+        Split Subsytem prefix and COSA dotstr if subsystem prefix is found */
+        jse_cosa_bus_split_prefix(&pRootObjName, subSystemPrefix);
+
+        /* The values are about to change so forget any cached values */
+        ForgetParameterValues(subSystemPrefix, pRootObjName);
+
+        JSE_VERBOSE("subSystemPrefix=\"%s\"", subSystemPrefix)
+
+        /*
+        *  Get Destination component for root obj name
+        */
+        returnStatus = jse_cosa_bus_discover(pRootObjName, &pDestComponentName, &pDestPath, subSystemPrefix);
+        if (returnStatus != 0)
+        {
+            /* Does not return */
+            JSE_THROW_COSA_ERROR(ctx, returnStatus,
+                "UiDbusClientGetDestComponent() failed: \"%s\"", pRootObjName);
+        }
+        else
+        {
+            JSE_DEBUG(
+                "pRootObjName=\"%s\", bDbusCommit=%d, pDestComponentName=\"%s\", pDestPath=\"%s\"\n",
+                pRootObjName,
+                bDbusCommit,
+                pDestComponentName,
+                pDestPath)
+        }
+
+        /*
+        *  Construct parameter value array
+        */
+        paramCount = get_array_length(ctx, pParamArray);
+
+        JSE_VERBOSE("paramCount=%d", paramCount)
+
+        pParameterValList = (parameterValStruct_t *)calloc(paramCount, sizeof(parameterValStruct_t));
+        if (pParameterValList == NULL)
+        {
+            free(pDestComponentName);
+            free(pDestPath);
+
+            /* Does not return */
+            JSE_THROW_COSA_ERROR(ctx, CCSP_ERR_MEMORY_ALLOC_FAIL,
+                "calloc() failed: %s", strerror(errno));
+        }
+
+        index = 0;
+
+        /*
+        *  This is an array of arrays - process the first level
+        *  Second level array of each parameter value: parameter name, type and value
+        *  Therofore, the count has to be 3
+        *  Construct the parameter val struct list for CCSP Base API along the way
+        */
+        duk_enum(ctx, pParamArray, 0);
+        while (duk_next(ctx, -1, 1))
+        {
+            if (!duk_is_array(ctx, -1))
+            {
+                free(pParameterValList);
+                free(pDestComponentName);
+                free(pDestPath);
+
+                /* Does not return */
+                JSE_THROW_TYPE_ERROR(ctx, "Item is not an array!");
+            }
+            else if (get_array_length(ctx, -1) != 3)
+            {
+                free(pParameterValList);
+                free(pDestComponentName);
+                free(pDestPath);
+
+                /* Does not return */
+                JSE_THROW_RANGE_ERROR(ctx,
+                    "Invalid sub-array size (%d)",
+                    get_array_length(ctx, -1));
+            }
+            else
+            {
+                duk_enum(ctx, -1, 0);
+
+                if (duk_next(ctx, -1, true)) /* get the name */
+                {
+                    /*FIXME unsafe cast from const char* to char*: fix when replacing ccsp with new system*/
+                    pParameterValList[index].parameterName = (char *)duk_get_string(ctx, -1);
+
+                    JSE_VERBOSE("pParameterValList[%d].parameterName=\"%s\"",
+                        index, pParameterValList[index].parameterName)
+
+                    /* pop name k/v */
+                    duk_pop_2(ctx);
+
+                    if (duk_next(ctx, -1, true)) /* get the type */
+                    {
+                        /*FIXME unsafe cast from const char* to char*: fix when replacing ccsp with new system*/
+                        char *pTemp = (char *)duk_get_string(ctx, -1);
+
+                        if (jse_cosa_bus_parse_type(pTemp, &pParameterValList[index].type) != 0)
+                        {
+                            JSE_WARNING("Unknown type \"%s\"", pTemp)
+                        }
+
+                        JSE_VERBOSE("pParameterValList[%d].type=%d, pTemp=\"%s\"",
+                            index, pParameterValList[index].type, pTemp)
+
+                        /* pop type k/v */
+                        duk_pop_2(ctx);
+
+                        if (duk_next(ctx, -1, true)) /* get the value */
+                        {
+                            /*FIXME unsafe cast from const char* to char*: fix when replacing ccsp with new system*/
+                            char * value = (char *)duk_safe_to_string(ctx, -1);
+
+                            if (pParameterValList[index].type == ccsp_boolean)
+                            {
+                                /* support true/false or 1/0 for boolean value */
+                                if (!strcmp(value, "1"))
+                                {
+                                    strcpy(BoolStrBuf, "true");
+                                    value = BoolStrBuf;
+                                }
+                                else if (!strcmp(value, "0"))
+                                {
+                                    strcpy(BoolStrBuf, "false");
+                                    value = BoolStrBuf;
+                                }
+                            }
+
+                            JSE_VERBOSE("pParameterValList[%d].parameterValue=\"%s\"\n",
+                                index, value)
+
+                            pParameterValList[index].parameterValue = strdup(value);
+                            if (pParameterValList[index].parameterValue == NULL)
+                            {
+                                JSE_ERROR("strdup(): %s", strerror(errno));
+                                returnStatus = CCSP_ERR_MEMORY_ALLOC_FAIL;
+                            }
+
+                            /* pop value k/v */
+                            duk_pop_2(ctx);
+                        }
+                        else
+                        {
+                            JSE_ERROR("Subarray invalid")
+                            returnStatus = CCSP_FAILURE;
+                        }
+                    }
+                    else
+                    {
+                        JSE_ERROR("Subarray invalid")
+                        returnStatus = CCSP_FAILURE;
+                    }
+                }
+                else
+                {
+                    JSE_ERROR("Subarray invalid")
+                    returnStatus = CCSP_FAILURE;
+                }
+
+                index++;
+
+                /* pop sub array */
+                duk_pop(ctx);
+            }
+            /* pop key and value from main array */
+            duk_pop_2(ctx);
+        }
+        /* pop main array */
+        duk_pop(ctx);
+
+        if (0 == returnStatus)
+        {
+            returnStatus =
+                jse_cosa_bus_set_values(
+                    subSystemPrefix,
+                    pDestComponentName,
+                    pDestPath,
+                    pParameterValList,
+                    index, /* use the actual count, instead of paramCount */
+                    bDbusCommit,
+                    &pFaultParamName);
+        }
+
+        for (index = 0; index < paramCount; index++)
+        {
+            if (pParameterValList[index].parameterValue != NULL)
+            {
+                free(pParameterValList[index].parameterValue);
+            }
+        }
+
+        free(pParameterValList);
+        free(pDestComponentName);
+        free(pDestPath);
+
+        if (CCSP_SUCCESS != returnStatus)
+        {
+            InvalidateDestComponentOnError(returnStatus, pRootObjName, subSystemPrefix);
+
+            if (pFaultParamName != NULL)
+            {
+                /* Temporary buffer on the stack which will get cleaned up on throw */
+                char faultParamName[256];
+
+                strncpy(faultParamName, pFaultParamName ? pFaultParamName : "none", sizeof(faultParamName) - 1);
+                faultParamName[sizeof(faultParamName) - 1] = '\0';
+
+                /* Per C99 free(NULL) is a NOP */
+                free(pFaultParamName);
+
+                /* Does not return */
+                JSE_THROW_COSA_ERROR(ctx, returnStatus,
+                    "CcspBaseIf_setParameterValues() failed: %d: %s",
+                    bDbusCommit, faultParamName);
+            }
+            else
+            {
+                /* Does not return */
+                JSE_THROW_COSA_ERROR(ctx, returnStatus, "Internal error");
+            }
+        }
+        else
+        {
+            /* Return nothing (undefined) */
+            ret = 0;
+        }
+    }
+
+    JSE_EXIT("DmExtSetStrsWithRootObj()=%d", ret)
+    return ret;
+}
+
+/**
+ * @brief The binding for DmExtGetInstanceIds()
+ *
+ * This function calls the real CCSP API:
+ *  - CcspBaseIf_GetNextLevelInstances()
+ * It takes the following argument:
+ *  - object table name, e.g. Device.NAT.PortMapping.
+ *
+ * @param ctx the duktape context.
+ * 
+ * @return 1 or a negative error status.
+ */
+static duk_ret_t DmExtGetInstanceIds(duk_context *ctx)
+{
+    duk_ret_t ret = DUK_RET_ERROR;
+
+    char *dotstr = NULL;
+    char subSystemPrefix[6] = {0};
+    char *ppDestComponentName = NULL;
+    char *ppDestPath = NULL;
+    int returnStatus = 0;
+    unsigned int InstNum = 0;
+    unsigned int *pInstNumList = NULL;
+    duk_uarridx_t index = 0;
+
+    JSE_ASSERT(ctx != NULL)
+    JSE_ENTER("DmExtGetInstanceIds(%p)", ctx)
+
+    if (parse_parameter(__FUNCTION__, ctx, "s", &dotstr) != 0)
+    {
+        JSE_ERROR("Error parsing argument(s)!")
+    }
+    else
+    {
+        JSE_VERBOSE("dotstr=\"%s\"", dotstr)
+
+        /* Check whether there are subsystem prefix in the dot string
+           Split Subsytem prefix and COSA dotstr if subsystem prefix is found */
+        jse_cosa_bus_split_prefix(&dotstr, subSystemPrefix);
+
+        JSE_VERBOSE("subSystemPrefix=\"%s\"", subSystemPrefix)
+
+        // Get Destination component
+        returnStatus = jse_cosa_bus_discover(dotstr, &ppDestComponentName, &ppDestPath, subSystemPrefix);
+        if (returnStatus != 0)
+        {
+            /* Does not return */
+            JSE_THROW_COSA_ERROR(ctx, returnStatus,
+                "UiDbusClientGetDestComponent() failed: \"%s\"", dotstr);
+        }
+        else
+        {
+            JSE_DEBUG("dotstr=\"%s\", ppDestComponentName=\"%s\", ppDestPath=\"%s\"",
+                dotstr, ppDestComponentName, ppDestPath)
+        }
+
+        /*
+        *  Get Next Instance Numbers
+        */
+        returnStatus =
+            jse_cosa_bus_get_instances(
+                ppDestComponentName,
+                ppDestPath,
+                dotstr,
+                &InstNum,
+                &pInstNumList);
+
+        free(ppDestComponentName);
+        free(ppDestPath);
+
+        if (returnStatus != CCSP_SUCCESS)
+        {
+            /* Per C99 free(NULL) is a NOP */
+            free(pInstNumList);
+            InvalidateDestComponentOnError(returnStatus, dotstr, subSystemPrefix);
+
+            /* Does not return */
+            JSE_THROW_COSA_ERROR(ctx, returnStatus,
+                "CcspBaseIf_GetNextLevelInstances() failed");
+        }
+        else
+        {
+            char StrBuf[24];
+
+            duk_idx_t arr_idx = duk_push_array(ctx);
+            duk_push_int(ctx, 0);
+            duk_put_prop_index(ctx, arr_idx, 0);
+
+            JSE_VERBOSE("InstNum=%d", InstNum)
+
+            for (index = 0; index < InstNum; index++)
+            {
+                snprintf(StrBuf, sizeof(StrBuf), "%d", pInstNumList[index]);
+                duk_push_string(ctx, StrBuf);
+                duk_put_prop_index(ctx, arr_idx, index + 1);
+
+                JSE_VERBOSE("Index %d: \"%s\"", index, StrBuf)
+            }
+
+            /* Per C99 free(NULL) is a NOP */
+            free(pInstNumList);
+
+            /* One item returned on the bottom of the stack, the value array */
+            ret = 1;
+        }
+    }
+
+    JSE_EXIT("DmExtGetInstanceIds()=%d", ret)
+    return ret;
+}
+
+/** Receives each value got by FetchGroupValues() */
+typedef void (*cosa_value_func_t)(void *pData, const char *pName, const char *pValue);
+
+/**
+ * @brief Puts a value in the object on the top of the stack.
+ *
+ * @param pData the duktape context.
+ * @param pName the parameter name.
+ * @param pValue the value or NULL to put null.
+ */
+static void PutObjectValue(void *pData, const char *pName, const char *pValue)
+{
+    duk_context *ctx = (duk_context *)pData;
+
+    if (pValue != NULL)
+    {
+        duk_push_string(ctx, pValue);
+    }
+    else
+    {
+        duk_push_null(ctx);
+    }
+    duk_put_prop_string(ctx, -2, pName);
+}
+
+/**
+ * @brief Adds a value to a snapshot.
+ *
+ * @param pData the snapshot.
+ * @param pName the parameter name.
+ * @param pValue the value.
+ */
+static void PutSnapshotValue(void *pData, const char *pName, const char *pValue)
+{
+    jse_cosa_snapshot_add((jse_cosa_snapshot_t *)pData, pName, pValue);
+}
+
+/**
+ * @brief Gets the values of groups of parameters.
+ *
+ * The values are taken from the memo if possible, otherwise they are read
+ * from each component in one request. The components are queried
+ * concurrently. Each value is passed to a function with its parameter
+ * name.
+ *
+ * @param pGroups the groups.
+ * @param groupCount the number of groups.
+ * @param pFunc the function to pass the values to.
+ * @param pData the data to pass to the function.
+ * @param pComponentName a buffer to return the component name on error.
+ * @param componentNameSize the size of the buffer.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int FetchGroupValues(cosa_group_t *pGroups, int groupCount, cosa_value_func_t pFunc, void *pData,
+    char *pComponentName, size_t componentNameSize)
+{
+    jse_cosa_bus_get_t *pGets = NULL;
+    parameterValStruct_t **ppParameterVal = NULL;
+    int valCount = 0;
+    int getCount = 0;
+    int returnStatus = CCSP_SUCCESS;
+    int group, get, index;
+
+    pGets = (jse_cosa_bus_get_t *)calloc(groupCount > 0 ? groupCount : 1, sizeof(jse_cosa_bus_get_t));
+    if (pGets == NULL)
+    {
+        JSE_ERROR("calloc() failed: %s", strerror(errno))
+        snprintf(pComponentName, componentNameSize, "%s", "none");
+        return CCSP_ERR_MEMORY_ALLOC_FAIL;
+    }
+
+    /* Memoised groups are answered now, the rest are fetched together */
+    for (group = 0; group < groupCount; group++)
+    {
+        cosa_group_t *pGroup = &pGroups[group];
+
+        if (MemoGetValues(pGroup->subSystemPrefix, pGroup->ppParamNameList, pGroup->count,
+            &valCount, &ppParameterVal))
+        {
+            for (index = 0; index < valCount; index++)
+            {
+                pFunc(pData, ppParameterVal[index]->parameterName, ppParameterVal[index]->parameterValue);
+            }
+
+            FreeParameterValues(true, valCount, ppParameterVal);
+        }
+        else
+        {
+            pGets[getCount].pSystemPrefix = pGroup->subSystemPrefix;
+            pGets[getCount].pComponent = pGroup->pDestComponentName;
+            pGets[getCount].pPath = pGroup->pDestPath;
+            pGets[getCount].ppNames = pGroup->ppParamNameList;
+            pGets[getCount].count = pGroup->count;
+            getCount++;
+        }
+    }
+
+    jse_cosa_bus_get_values_many(pGets, getCount);
+
+    for (get = 0; get < getCount; get++)
+    {
+        jse_cosa_bus_get_t *pGet = &pGets[get];
+
+        if (pGet->status != CCSP_SUCCESS)
+        {
+            /* Report the first failure but still free the other values */
+            if (returnStatus == CCSP_SUCCESS)
+            {
+                snprintf(pComponentName, componentNameSize, "%s", pGet->pComponent);
+                returnStatus = pGet->status;
+            }
+
+            InvalidateDestComponentOnError(pGet->status, pGet->ppNames[0], (char *)pGet->pSystemPrefix);
+            continue;
+        }
+
+        /* valCount could be larger than count */
+        JSE_VERBOSE("%s: %d values returned in %lu us", pGet->pComponent, pGet->valCount, (unsigned long)pGet->usec)
+
+        RememberParameterValues((char *)pGet->pSystemPrefix, pGet->ppVals, pGet->valCount);
+
+        if (returnStatus == CCSP_SUCCESS)
+        {
+            for (index = 0; index < pGet->valCount; index++)
+            {
+                pFunc(pData, pGet->ppVals[index]->parameterName, pGet->ppVals[index]->parameterValue);
+            }
+        }
+
+        FreeParameterValues(false, pGet->valCount, pGet->ppVals);
+    }
+
+    free(pGets);
+
+    return returnStatus;
+}
+
+/**
+ * @brief The binding for getMany()
+ *
+ * This function calls the real CCSP API:
+ *  - CcspBaseIf_getParameterValues()
+ * It takes the following argument:
+ *  - array of DM parameter names, which may be for different components
+ *
+ * The names are grouped by component so there is one call per component.
+ *
+ * @param ctx the duktape context.
+ *
+ * @return 1 or a negative error status.
+ */
+static duk_ret_t getMany(duk_context *ctx)
+{
+    duk_ret_t ret = DUK_RET_ERROR;
+
+    duk_idx_t pParamNameArray;
+    char **ppParamNameList = NULL;
+    int paramCount = 0;
+    int uncachedCount = 0;
+    cosa_group_t *pGroups = NULL;
+    int groupCount = 0;
+    int failIndex = -1;
+    int returnStatus = 0;
+    int index;
+
+    /* Temporary buffer on the stack which will get cleaned up on throw */
+    char componentName[256];
+
+    JSE_ASSERT(ctx != NULL)
+    JSE_ENTER("getMany(%p)", ctx)
+
+    if (parse_parameter(__FUNCTION__, ctx, "o", &pParamNameArray) != 0)
+    {
+        JSE_ERROR("Error parsing argument(s)!")
+    }
+    else if (!duk_is_array(ctx, pParamNameArray))
+    {
+        /* Does not return */
+        JSE_THROW_TYPE_ERROR(ctx, "Names is not an array!");
+    }
+    else
+    {
+        ppParamNameList = GetStringArray(ctx, pParamNameArray, &paramCount);
+
+        duk_push_object(ctx);
+
+        /* Take the hot parameters from the cache and only get the rest */
+        for (index = 0; index < paramCount; index++)
+        {
+            char *dotstr = ppParamNameList[index];
+            char subSystemPrefix[6] = {0};
+            char *pHotValue = NULL;
+            int hotType;
+
+            jse_cosa_bus_split_prefix(&dotstr, subSystemPrefix);
+
+            if (jse_cosa_cache_get_hot(subSystemPrefix, dotstr, &pHotValue, &hotType) == 0)
+            {
+                duk_push_string(ctx, pHotValue);
+                duk_put_prop_string(ctx, -2, dotstr);
+                free(pHotValue);
+            }
+            else
+            {
+                ppParamNameList[uncachedCount++] = ppParamNameList[index];
+            }
+        }
+
+        returnStatus = GroupByDestComponent(ppParamNameList, uncachedCount, &pGroups, &groupCount, &failIndex);
+        if (returnStatus != CCSP_SUCCESS)
+        {
+            /* Temporary buffer on the stack which will get cleaned up on throw */
+            char failName[256] = "none";
+
+            if (failIndex >= 0)
+            {
+                strncpy(failName, ppParamNameList[failIndex], sizeof(failName) - 1);
+                failName[sizeof(failName) - 1] = '\0';
+            }
+
+            free(ppParamNameList);
+
+            /* Does not return */
+            JSE_THROW_COSA_ERROR(ctx, returnStatus,
+                "UiDbusClientGetDestComponent() failed: \"%s\"", failName);
+        }
+
+        returnStatus = FetchGroupValues(pGroups, groupCount, PutObjectValue, ctx,
+            componentName, sizeof(componentName));
+        if (returnStatus != CCSP_SUCCESS)
+        {
+            FreeGroups(pGroups, groupCount);
+            free(ppParamNameList);
+
+            /* Does not return */
+            JSE_THROW_COSA_ERROR(ctx, returnStatus,
+                "CcspBaseIf_getParameterValues() failed: \"%s\"", componentName);
+        }
+
+        FreeGroups(pGroups, groupCount);
+        free(ppParamNameList);
+
+        /* One item returned on the bottom of the stack, the value object */
+        ret = 1;
+    }
+
+    JSE_EXIT("getMany()=%d", ret)
+    return ret;
+}
+
+/**
+ * @brief Sets the values of parameters, which may be for different components.
+ *
+ * The parameters are grouped by component. The values are set in every
+ * component without committing and, only if they are all accepted, each
+ * component is asked to commit. Otherwise every component is asked to
+ * discard the values.
+ *
+ * @param ppParamNameList the parameter names, optionally with a subsystem prefix.
+ * @param ppParamValueList the values.
+ * @param paramCount the number of values.
+ * @param bCommit set true to commit the values.
+ * @param pFaultNames a buffer to return the names that failed.
+ * @param faultNamesSize the size of the buffer.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int SetParameterValues(char **ppParamNameList, char **ppParamValueList, int paramCount, bool bCommit,
+    char *pFaultNames, size_t faultNamesSize)
+{
+    cosa_group_t *pGroups = NULL;
+    int groupCount = 0;
+    int setCount = 0;
+    int failIndex = -1;
+    int returnStatus = CCSP_SUCCESS;
+    int failStatus = CCSP_SUCCESS;
+    int group, index, attempt;
+
+    returnStatus = GroupByDestComponent(ppParamNameList, paramCount, &pGroups, &groupCount, &failIndex);
+    if (failIndex >= 0)
+    {
+        AppendFaultName(pFaultNames, faultNamesSize, ppParamNameList[failIndex]);
+    }
+
+    /* The values are about to change so forget any cached values */
+    for (index = 0; index < paramCount && returnStatus == CCSP_SUCCESS; index++)
+    {
+        char *dotstr = ppParamNameList[index];
+        char subSystemPrefix[6] = {0};
+
+        jse_cosa_bus_split_prefix(&dotstr, subSystemPrefix);
+        ForgetParameterValues(subSystemPrefix, dotstr);
+    }
+
+    /* Set the values in every component without committing */
+    for (group = 0; group < groupCount && returnStatus == CCSP_SUCCESS; group++)
+    {
+        cosa_group_t *pGroup = &pGroups[group];
+        parameterValStruct_t *pParameterValList = NULL;
+        enum dataType_e *pTypes = NULL;
+        char *pFaultParamName = NULL;
+        int status;
+
+        pParameterValList = (parameterValStruct_t *)calloc(pGroup->count, sizeof(parameterValStruct_t));
+        pTypes = (enum dataType_e *)calloc(pGroup->count, sizeof(enum dataType_e));
+        if (pParameterValList == NULL || pTypes == NULL)
+        {
+            free(pParameterValList);
+            free(pTypes);
+            returnStatus = CCSP_ERR_MEMORY_ALLOC_FAIL;
+            break;
+        }
+
+        /* A cached type is retried once if the component rejects it */
+        for (attempt = 0; attempt < 2; attempt++)
+        {
+            bool cached = false;
+
+            status = GetParameterTypes(pGroup, attempt == 0, pTypes, &cached, pFaultNames, faultNamesSize);
+            if (status != CCSP_SUCCESS)
+            {
+                break;
+            }
+
+            for (index = 0; index < pGroup->count; index++)
+            {
+                char *value = ppParamValueList[pGroup->pIndexList[index]];
+
+                /* support true/false or 1/0 for boolean value */
+                if (pTypes[index] == ccsp_boolean && !strcmp(value, "1"))
+                {
+                    value = "true";
+                }
+                else if (pTypes[index] == ccsp_boolean && !strcmp(value, "0"))
+                {
+                    value = "false";
+                }
+
+                pParameterValList[index].parameterName = pGroup->ppParamNameList[index];
+                pParameterValList[index].parameterValue = value;
+                pParameterValList[index].type = pTypes[index];
+            }
+
+            status =
+                jse_cosa_bus_set_values(
+                    pGroup->subSystemPrefix,
+                    pGroup->pDestComponentName,
+                    pGroup->pDestPath,
+                    pParameterValList,
+                    pGroup->count,
+                    false,
+                    &pFaultParamName);
+
+            if (status == CCSP_ERR_INVALID_PARAMETER_TYPE && cached && attempt == 0)
+            {
+                JSE_DEBUG("%s: cached type rejected, retrying", pGroup->pDestComponentName)
+
+                for (index = 0; index < pGroup->count; index++)
+                {
+                    jse_cosa_cache_invalidate_type(pGroup->subSystemPrefix, pGroup->ppParamNameList[index]);
+                }
+            }
+            else if (status != CCSP_SUCCESS)
+            {
+                InvalidateDestComponentOnError(status, pGroup->ppParamNameList[0], pGroup->subSystemPrefix);
+                AppendFaultName(pFaultNames, faultNamesSize,
+                    pFaultParamName != NULL ? pFaultParamName : pGroup->pDestComponentName);
+            }
+            else
+            {
+                JSE_DEBUG("%s: %d values set", pGroup->pDestComponentName, pGroup->count)
+            }
+
+            /* Per C99 free(NULL) is a NOP */
+            free(pFaultParamName);
+            pFaultParamName = NULL;
+
+            if (status != CCSP_ERR_INVALID_PARAMETER_TYPE || !cached)
+            {
+                break;
+            }
+        }
+
+        free(pParameterValList);
+        free(pTypes);
+
+        /* Carry on to find the faults in the other components */
+        if (status != CCSP_SUCCESS && failStatus == CCSP_SUCCESS)
+        {
+            failStatus = status;
+        }
+
+        setCount = group + 1;
+    }
+
+    if (returnStatus == CCSP_SUCCESS)
+    {
+        returnStatus = failStatus;
+    }
+
+    /* Commit the values or, on error, ask the components to discard them */
+    if (bCommit || returnStatus != CCSP_SUCCESS)
+    {
+        for (group = 0; group < setCount; group++)
+        {
+            int status =
+                jse_cosa_bus_set_commit(
+                    pGroups[group].pDestComponentName,
+                    pGroups[group].pDestPath,
+                    returnStatus == CCSP_SUCCESS);
+
+            if (status != CCSP_SUCCESS)
+            {
+                JSE_ERROR("CcspBaseIf_setCommit(\"%s\") failed: %d", pGroups[group].pDestComponentName, status)
+
+                if (returnStatus == CCSP_SUCCESS)
+                {
+                    AppendFaultName(pFaultNames, faultNamesSize, pGroups[group].pDestComponentName);
+                    returnStatus = status;
+                }
+            }
+        }
+    }
+
+    FreeGroups(pGroups, groupCount);
+
+    return returnStatus;
+}
+
+/**
+ * @brief The binding for setMany()
+ *
+ * This function calls the real CCSP APIs:
+ *  - CcspBaseIf_getParameterValues()
+ *  - CcspBaseIf_setParameterValues()
+ *  - CcspBaseIf_setCommit()
+ * It takes the following arguments:
+ *  - object of DM parameter names and values, which may be for different
+ *    components
+ *  - commit flag
+ *
+ * The parameters are grouped by component. The values are set in every
+ * component without committing and, only if they are all accepted, each
+ * component is asked to commit. Otherwise every component is asked to
+ * discard the values.
+ *
+ * @param ctx the duktape context.
+ *
+ * @return 0 or a negative error status.
+ */
+static duk_ret_t setMany(duk_context *ctx)
+{
+    duk_ret_t ret = DUK_RET_ERROR;
+
+    duk_idx_t pParamObject;
+    duk_bool_t bCommit = 1;
+    char **ppParamNameList = NULL;
+    char **ppParamValueList = NULL;
+    int paramCount = 0;
+    int returnStatus = CCSP_SUCCESS;
+    /* Temporary buffer on the stack which will get cleaned up on throw */
+    char faultNames[512] = {0};
+    int index;
+
+    JSE_ASSERT(ctx != NULL)
+    JSE_ENTER("setMany(%p)", ctx)
+
+    if (parse_parameter(__FUNCTION__, ctx, "ob", &pParamObject, &bCommit) != 0)
+    {
+        JSE_ERROR("Error parsing argument(s)!")
+    }
+    else if (duk_is_array(ctx, pParamObject) || duk_is_function(ctx, pParamObject))
+    {
+        /* Does not return */
+        JSE_THROW_TYPE_ERROR(ctx, "Values is not an object!");
+    }
+    else
+    {
+        JSE_VERBOSE("bCommit=%s", bCommit ? "true" : "false")
+
+        /* Count the values */
+        duk_enum(ctx, pParamObject, DUK_ENUM_OWN_PROPERTIES_ONLY);
+        while (duk_next(ctx, -1, false))
+        {
+            paramCount++;
+            duk_pop(ctx);
+        }
+        duk_pop(ctx);
+
+        if (paramCount == 0)
+        {
+            JSE_EXIT("setMany()=0")
+            return 0;
+        }
+
+        ppParamNameList = (char **)calloc(paramCount, sizeof(char *));
+        ppParamValueList = (char **)calloc(paramCount, sizeof(char *));
+        if (ppParamNameList == NULL || ppParamValueList == NULL)
+        {
+            free(ppParamNameList);
+            free(ppParamValueList);
+
+            /* Does not return */
+            JSE_THROW_COSA_ERROR(ctx, CCSP_ERR_MEMORY_ALLOC_FAIL,
+                "calloc() failed: %s", strerror(errno));
+        }
+
+        /* Copy the names and values, coercing the values to strings */
+        index = 0;
+        duk_enum(ctx, pParamObject, DUK_ENUM_OWN_PROPERTIES_ONLY);
+        while (index < paramCount && duk_next(ctx, -1, true))
+        {
+            const char *value = duk_safe_to_string(ctx, -1);
+
+            ppParamNameList[index] = strdup(duk_get_string(ctx, -2));
+            ppParamValueList[index] = strdup(value);
+            if (ppParamNameList[index] == NULL || ppParamValueList[index] == NULL)
+            {
+                returnStatus = CCSP_ERR_MEMORY_ALLOC_FAIL;
+            }
+
+            JSE_VERBOSE("\"%s\"=\"%s\"", ppParamNameList[index], value)
+
+            index++;
+            duk_pop_2(ctx);
+        }
+        duk_pop(ctx);
+
+        if (returnStatus == CCSP_SUCCESS)
+        {
+            returnStatus = SetParameterValues(ppParamNameList, ppParamValueList, paramCount, bCommit,
+                faultNames, sizeof(faultNames));
+        }
+
+        for (index = 0; index < paramCount; index++)
+        {
+            free(ppParamNameList[index]);
+            free(ppParamValueList[index]);
+        }
+
+        free(ppParamNameList);
+        free(ppParamValueList);
+
+        if (returnStatus != CCSP_SUCCESS)
+        {
+            /* Does not return */
+            JSE_THROW_COSA_ERROR(ctx, returnStatus,
+                "setMany() failed: %d: %s", bCommit, faultNames[0] != '\0' ? faultNames : "none");
+        }
+
+        /* Return nothing (undefined) */
+        ret = 0;
+    }
+
+    JSE_EXIT("setMany()=%d", ret)
+    return ret;
+}
+
+/**
+ * @brief The binding for getTree()
+ *
+ * This function calls the real CCSP API:
+ *  - CcspBaseIf_getParameterValues()
+ * It takes the following arguments:
+ *  - DM partial path, e.g. Device.WiFi.
+ *  - optional typed flag
+ *
+ * @param ctx the duktape context.
+ *
+ * @return 1 or a negative error status.
+ */
+static duk_ret_t getTree(duk_context *ctx)
+{
+    duk_ret_t ret = DUK_RET_ERROR;
+
+    char *dotstr = NULL;
+    char *pDestComponentName = NULL;
+    char *pDestPath = NULL;
+    char subSystemPrefix[6] = {0};
+    duk_bool_t bTyped = 0;
+    int valCount = 0;
+    parameterValStruct_t **ppParameterVal = NULL;
+    int returnStatus = 0;
+    size_t pathLen;
+    duk_idx_t rootIdx;
+    int index;
+
+    JSE_ASSERT(ctx != NULL)
+    JSE_ENTER("getTree(%p)", ctx)
+
+    if (parse_parameter(__FUNCTION__, ctx, "s", &dotstr) != 0)
+    {
+        JSE_ERROR("Error parsing argument(s)!")
+    }
+    else if (dotstr[strlen(dotstr) - 1] != '.')
+    {
+        /* Does not return */
+        JSE_THROW_TYPE_ERROR(ctx, "Not a partial path: \"%s\"", dotstr);
+    }
+    else
+    {
+        bTyped = duk_get_boolean(ctx, 1);
+
+        JSE_VERBOSE("dotstr=\"%s\", bTyped=%s", dotstr, bTyped ? "true" : "false")
+
+        jse_cosa_bus_split_prefix(&dotstr, subSystemPrefix);
+
+        returnStatus = jse_cosa_bus_discover(dotstr, &pDestComponentName, &pDestPath, subSystemPrefix);
+        if (returnStatus != 0)
+        {
+            /* Does not return */
+            JSE_THROW_COSA_ERROR(ctx, returnStatus,
+                "UiDbusClientGetDestComponent() failed: \"%s\"", dotstr);
+        }
+
+        returnStatus =
+            jse_cosa_bus_get_values(
+                subSystemPrefix,
+                pDestComponentName,
+                pDestPath,
+                &dotstr,
+                1,
+                &valCount, /* valCount is the number of parameters in the subtree */
+                &ppParameterVal);
+
+        free(pDestComponentName);
+        free(pDestPath);
+
+        if (returnStatus != CCSP_SUCCESS)
+        {
+            InvalidateDestComponentOnError(returnStatus, dotstr, subSystemPrefix);
+
+            /* Does not return */
+            JSE_THROW_COSA_ERROR(ctx, returnStatus,
+                "CcspBaseIf_getParameterValues() failed: \"%s\"", dotstr);
+        }
+
+        JSE_VERBOSE("%d values returned", valCount)
+
+        RememberParameterValues(subSystemPrefix, ppParameterVal, valCount);
+
+        pathLen = strlen(dotstr);
+
+        /* A table's tree is an array of rows */
+        if (valCount > 0 && !strncmp(ppParameterVal[0]->parameterName, dotstr, pathLen) &&
+            IsInstanceSegment(ppParameterVal[0]->parameterName + pathLen,
+                strcspn(ppParameterVal[0]->parameterName + pathLen, ".")))
+        {
+            rootIdx = duk_push_array(ctx);
+        }
+        else
+        {
+            rootIdx = duk_push_object(ctx);
+        }
+
+        for (index = 0; index < valCount; index++)
+        {
+            const char *pName = ppParameterVal[index]->parameterName;
+
+            if (!strncmp(pName, dotstr, pathLen))
+            {
+                PutTreeValue(ctx, rootIdx, pName + pathLen, ppParameterVal[index]->parameterValue,
+                    ppParameterVal[index]->type, bTyped);
+            }
+            else
+            {
+                JSE_WARNING("Unexpected parameter: %s", pName)
+            }
+        }
+
+        if (valCount > 0)
+        {
+            jse_cosa_bus_free_values(valCount, ppParameterVal);
+        }
+
+        /* One item returned on the top of the stack, the tree */
+        ret = 1;
+    }
+
+    JSE_EXIT("getTree()=%d", ret)
+    return ret;
+}
+
+/**
+ * @brief Frees an array of strings.
+ *
+ * @param ppStrings the strings.
+ * @param count the number of strings.
+ */
+static void FreeStrings(char **ppStrings, int count)
+{
+    int i;
+
+    if (ppStrings != NULL)
+    {
+        for (i = 0; i < count; i++)
+        {
+            free(ppStrings[i]);
+        }
+
+        free(ppStrings);
+    }
+}
+
+/**
+ * @brief The binding for getTable()
+ *
+ * This function calls the real CCSP APIs:
+ *  - CcspBaseIf_GetNextLevelInstances()
+ *  - CcspBaseIf_getParameterValues()
+ * It takes the following arguments:
+ *  - object table name, e.g. Device.NAT.PortMapping.
+ *  - optional array of column names
+ *  - optional options object with offset, limit and typed properties
+ *
+ * @param ctx the duktape context.
+ *
+ * @return 1 or a negative error status.
+ */
+static duk_ret_t getTable(duk_context *ctx)
+{
+    duk_ret_t ret = DUK_RET_ERROR;
+
+    char *dotstr = NULL;
+    char subSystemPrefix[6] = {0};
+    char *pDestComponentName = NULL;
+    char *pDestPath = NULL;
+    int returnStatus = 0;
+    unsigned int instCount = 0;
+    unsigned int *pInstNumList = NULL;
+    char **ppColumnList = NULL;
+    int columnCount = 0;
+    char **ppParamNameList = NULL;
+    int paramCount = 0;
+    int valCount = 0;
+    parameterValStruct_t **ppParameterVal = NULL;
+    unsigned int offset = 0;
+    unsigned int limit = 0;
+    unsigned int first, last;
+    duk_bool_t bTyped = 0;
+    size_t pathLen;
+    duk_idx_t arr_idx;
+    unsigned int row = 0;
+    int index, column;
+
+    JSE_ASSERT(ctx != NULL)
+    JSE_ENTER("getTable(%p)", ctx)
+
+    if (parse_parameter(__FUNCTION__, ctx, "s", &dotstr) != 0)
+    {
+        JSE_ERROR("Error parsing argument(s)!")
+    }
+    else if (dotstr[strlen(dotstr) - 1] != '.')
+    {
+        /* Does not return */
+        JSE_THROW_TYPE_ERROR(ctx, "Not a table: \"%s\"", dotstr);
+    }
+    else if (!duk_is_null_or_undefined(ctx, 1) && !duk_is_array(ctx, 1))
+    {
+        /* Does not return */
+        JSE_THROW_TYPE_ERROR(ctx, "Columns is not an array!");
+    }
+    else
+    {
+        if (duk_is_object(ctx, 2))
+        {
+            duk_get_prop_string(ctx, 2, "offset");
+            offset = duk_is_number(ctx, -1) ? (unsigned int)duk_get_uint(ctx, -1) : 0;
+            duk_get_prop_string(ctx, 2, "limit");
+            limit = duk_is_number(ctx, -1) ? (unsigned int)duk_get_uint(ctx, -1) : 0;
+            duk_get_prop_string(ctx, 2, "typed");
+            bTyped = duk_get_boolean(ctx, -1);
+            duk_pop_3(ctx);
+        }
+
+        JSE_VERBOSE("dotstr=\"%s\", offset=%u, limit=%u", dotstr, offset, limit)
+
+        if (duk_is_array(ctx, 1))
+        {
+            ppColumnList = GetStringArray(ctx, 1, &columnCount);
+        }
+
+        jse_cosa_bus_split_prefix(&dotstr, subSystemPrefix);
+
+        returnStatus = jse_cosa_bus_discover(dotstr, &pDestComponentName, &pDestPath, subSystemPrefix);
+        if (returnStatus != 0)
+        {
+            free(ppColumnList);
+
+            /* Does not return */
+            JSE_THROW_COSA_ERROR(ctx, returnStatus,
+                "UiDbusClientGetDestComponent() failed: \"%s\"", dotstr);
+        }
+
+        returnStatus =
+            jse_cosa_bus_get_instances(
+                pDestComponentName,
+                pDestPath,
+                dotstr,
+                &instCount,
+                &pInstNumList);
+
+        if (returnStatus != CCSP_SUCCESS)
+        {
+            /* Per C99 free(NULL) is a NOP */
+            free(pInstNumList);
             free(pDestComponentName);
             free(pDestPath);
+            free(ppColumnList);
+            InvalidateDestComponentOnError(returnStatus, dotstr, subSystemPrefix);
+
+            /* Does not return */
+            JSE_THROW_COSA_ERROR(ctx, returnStatus,
+                "CcspBaseIf_GetNextLevelInstances() failed: \"%s\"", dotstr);
+        }
+
+        /* The page of rows */
+        first = offset < instCount ? offset : instCount;
+        last = (limit > 0 && limit < instCount - first) ? first + limit : instCount;
+
+        JSE_VERBOSE("%u rows, returning %u to %u", instCount, first, last)
+
+        /* The names of the columns of the rows, or the rows if no columns */
+        paramCount = (int)(last - first) * (columnCount > 0 ? columnCount : 1);
+        if (paramCount > 0)
+        {
+            ppParamNameList = (char **)calloc(paramCount, sizeof(char *));
+            if (ppParamNameList == NULL)
+            {
+                returnStatus = CCSP_ERR_MEMORY_ALLOC_FAIL;
+            }
+        }
+
+        for (row = first, index = 0; row < last && returnStatus == CCSP_SUCCESS; row++)
+        {
+            for (column = 0; column < (columnCount > 0 ? columnCount : 1) && returnStatus == CCSP_SUCCESS; column++)
+            {
+                const char *pColumn = columnCount > 0 ? ppColumnList[column] : "";
+                size_t size = strlen(dotstr) + 12 + strlen(pColumn);
+
+                ppParamNameList[index] = (char *)malloc(size);
+                if (ppParamNameList[index] == NULL)
+                {
+                    returnStatus = CCSP_ERR_MEMORY_ALLOC_FAIL;
+                }
+                else
+                {
+                    snprintf(ppParamNameList[index++], size, "%s%u.%s", dotstr, pInstNumList[row], pColumn);
+                }
+            }
+        }
+
+        if (returnStatus == CCSP_SUCCESS && paramCount > 0)
+        {
+            returnStatus =
+                jse_cosa_bus_get_values(
+                    subSystemPrefix,
+                    pDestComponentName,
+                    pDestPath,
+                    ppParamNameList,
+                    paramCount,
+                    &valCount,
+                    &ppParameterVal);
+        }
+
+        free(pDestComponentName);
+        free(pDestPath);
+        FreeStrings(ppParamNameList, paramCount);
+        free(ppColumnList);
+
+        if (returnStatus != CCSP_SUCCESS)
+        {
+            free(pInstNumList);
+            InvalidateDestComponentOnError(returnStatus, dotstr, subSystemPrefix);
+
+            /* Does not return */
+            JSE_THROW_COSA_ERROR(ctx, returnStatus,
+                "CcspBaseIf_getParameterValues() failed: \"%s\"", dotstr);
+        }
+
+        RememberParameterValues(subSystemPrefix, ppParameterVal, valCount);
+
+        /* The rows in table order */
+        arr_idx = duk_push_array(ctx);
+
+        for (row = first; row < last; row++)
+        {
+            duk_push_object(ctx);
+            duk_push_number(ctx, (duk_double_t)pInstNumList[row]);
+            duk_put_prop_string(ctx, -2, "_instance");
+            duk_put_prop_index(ctx, arr_idx, row - first);
+        }
+
+        duk_push_number(ctx, (duk_double_t)instCount);
+        duk_put_prop_string(ctx, arr_idx, "total");
+
+        pathLen = strlen(dotstr);
+        row = first;
+
+        for (index = 0; index < valCount; index++)
+        {
+            const char *pName = ppParameterVal[index]->parameterName;
+            const char *pColumn = NULL;
+            unsigned long instance;
+            unsigned int i;
+
+            if (strncmp(pName, dotstr, pathLen) != 0)
+            {
+                JSE_WARNING("Unexpected parameter: %s", pName)
+                continue;
+            }
+
+            instance = strtoul(pName + pathLen, (char **)&pColumn, 10);
+            if (*pColumn != '.')
+            {
+                JSE_WARNING("Unexpected parameter: %s", pName)
+                continue;
+            }
+
+            /* The values usually arrive in row order */
+            for (i = 0; i < last - first && pInstNumList[row] != instance; i++)
+            {
+                row = row + 1 < last ? row + 1 : first;
+            }
+
+            if (pInstNumList[row] == instance)
+            {
+                duk_get_prop_index(ctx, arr_idx, row - first);
+                PutTreeValue(ctx, -1, pColumn + 1, ppParameterVal[index]->parameterValue,
+                    ppParameterVal[index]->type, bTyped);
+                duk_pop(ctx);
+            }
+        }
+
+        if (valCount > 0)
+        {
+            jse_cosa_bus_free_values(valCount, ppParameterVal);
+        }
+
+        free(pInstNumList);
+
+        /* One item returned on the top of the stack, the rows */
+        ret = 1;
+    }
+
+    JSE_EXIT("getTable()=%d", ret)
+    return ret;
+}
+
+/** The maximum number of rows added by one addRows() call */
+#define ADD_ROWS_MAX 1024
+
+/**
+ * @brief Counts the values to set in new rows, checking their type.
+ *
+ * Throws an error if the values of a row are not an object.
+ *
+ * @param ctx the duktape context.
+ * @param idx the index of the values, an object used for every row or an
+ * array of an object per row.
+ * @param rowCount the number of rows.
+ * @return the number of values.
+ */
+static int CountRowValues(duk_context *ctx, duk_idx_t idx, int rowCount)
+{
+    bool bPerRow = duk_is_array(ctx, idx);
+    int valueCount = 0;
+    int row;
+
+    for (row = 0; row < (bPerRow ? rowCount : 1); row++)
+    {
+        if (bPerRow)
+        {
+            duk_get_prop_index(ctx, idx, (duk_uarridx_t)row);
+        }
+        else
+        {
+            duk_dup(ctx, idx);
+        }
+
+        if (!duk_is_object(ctx, -1) || duk_is_array(ctx, -1) || duk_is_function(ctx, -1))
+        {
+            /* Does not return */
+            JSE_THROW_TYPE_ERROR(ctx, "Values of row %d is not an object!", row);
+        }
+
+        duk_enum(ctx, -1, DUK_ENUM_OWN_PROPERTIES_ONLY);
+        while (duk_next(ctx, -1, false))
+        {
+            valueCount++;
+            duk_pop(ctx);
+        }
+        duk_pop_2(ctx);
+    }
+
+    return bPerRow ? valueCount : valueCount * rowCount;
+}
+
+/**
+ * @brief Copies the values to set in new rows.
+ *
+ * The name of each value is the row name followed by the property name,
+ * e.g. "Device.NAT.PortMapping.3.Enable".
+ *
+ * @param ctx the duktape context.
+ * @param idx the index of the values, as for CountRowValues().
+ * @param pTable the table name, optionally with a subsystem prefix.
+ * @param pInstances the instance numbers of the rows.
+ * @param rowCount the number of rows.
+ * @param ppNames an array of valueCount to return the names, which must be freed.
+ * @param ppValues an array of valueCount to return the values, which must be freed.
+ * @param valueCount the number of values counted by CountRowValues().
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int CopyRowValues(duk_context *ctx, duk_idx_t idx, const char *pTable, const int *pInstances, int rowCount,
+    char **ppNames, char **ppValues, int valueCount)
+{
+    bool bPerRow = duk_is_array(ctx, idx);
+    int returnStatus = CCSP_SUCCESS;
+    int index = 0;
+    int row;
+
+    for (row = 0; row < rowCount; row++)
+    {
+        if (bPerRow)
+        {
+            duk_get_prop_index(ctx, idx, (duk_uarridx_t)row);
+        }
+        else
+        {
+            duk_dup(ctx, idx);
+        }
+
+        duk_enum(ctx, -1, DUK_ENUM_OWN_PROPERTIES_ONLY);
+        while (index < valueCount && duk_next(ctx, -1, true))
+        {
+            const char *pColumn = duk_get_string(ctx, -2);
+            const char *pValue = duk_safe_to_string(ctx, -1);
+            size_t nameSize = strlen(pTable) + strlen(pColumn) + 16;
+
+            ppNames[index] = (char *)malloc(nameSize);
+            ppValues[index] = strdup(pValue);
+            if (ppNames[index] == NULL || ppValues[index] == NULL)
+            {
+                returnStatus = CCSP_ERR_MEMORY_ALLOC_FAIL;
+            }
+            else
+            {
+                snprintf(ppNames[index], nameSize, "%s%d.%s", pTable, pInstances[row], pColumn);
+                JSE_VERBOSE("\"%s\"=\"%s\"", ppNames[index], pValue)
+            }
+
+            index++;
+            duk_pop_2(ctx);
+        }
+        duk_pop_2(ctx);
+    }
+
+    return returnStatus;
+}
+
+/**
+ * @brief Deletes rows added by addRows() after a failure.
+ *
+ * The rows are deleted newest first. Errors are only logged.
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param pComponent the component name.
+ * @param pPath the component D-Bus path.
+ * @param pTable the table name.
+ * @param pInstances the instance numbers of the rows.
+ * @param rowCount the number of rows.
+ */
+static void DeleteAddedRows(const char *pSystemPrefix, const char *pComponent, char *pPath, const char *pTable,
+    const int *pInstances, int rowCount)
+{
+    char rowName[512];
+    int row;
+
+    for (row = rowCount - 1; row >= 0; row--)
+    {
+        int status;
+
+        snprintf(rowName, sizeof(rowName), "%s%d.", pTable, pInstances[row]);
+
+        status = jse_cosa_bus_delete_row(pSystemPrefix, pComponent, pPath, rowName);
+        if (status != CCSP_SUCCESS)
+        {
+            JSE_ERROR("CcspBaseIf_DeleteTblRow() failed: \"%s\": %d", rowName, status)
+        }
+    }
+}
+
+/**
+ * @brief The binding for addRows()
+ *
+ * This function calls the real CCSP APIs:
+ *  - CcspBaseIf_AddTblRow()
+ *  - CcspBaseIf_setParameterValues()
+ *  - CcspBaseIf_setCommit()
+ * It takes the following arguments:
+ *  - DM table name, e.g. Device.NAT.PortMapping.
+ *  - number of rows to add
+ *  - optional values of the new rows, an object used for every row or an
+ *    array of an object per row
+ *
+ * The component is discovered once for all the rows. The values of every
+ * row are set together and committed once. If a row can not be added or
+ * the values are rejected the rows already added are deleted.
+ *
+ * @param ctx the duktape context.
+ *
+ * @return 1 or a negative error status.
+ */
+static duk_ret_t addRows(duk_context *ctx)
+{
+    duk_ret_t ret = DUK_RET_ERROR;
+
+    char *pTable = NULL;
+    char *dotstr = NULL;
+    duk_double_t rowNumber = 0;
+    char *pDestComponentName = NULL;
+    char *pDestPath = NULL;
+    char subSystemPrefix[6] = {0};
+    int *pInstances = NULL;
+    int rowCount = 0;
+    int addedCount = 0;
+    char **ppParamNameList = NULL;
+    char **ppParamValueList = NULL;
+    int paramCount = 0;
+    int returnStatus = CCSP_SUCCESS;
+    /* Temporary buffer on the stack which will get cleaned up on throw */
+    char faultNames[512] = {0};
+    int row;
+
+    JSE_ASSERT(ctx != NULL)
+    JSE_ENTER("addRows(%p)", ctx)
+
+    if (parse_parameter(__FUNCTION__, ctx, "sn", &pTable, &rowNumber) != 0)
+    {
+        JSE_ERROR("Error parsing argument(s)!")
+    }
+    else if (pTable[strlen(pTable) - 1] != '.')
+    {
+        /* Does not return */
+        JSE_THROW_TYPE_ERROR(ctx, "Not a table: \"%s\"", pTable);
+    }
+    else if (rowNumber < 1 || rowNumber > ADD_ROWS_MAX || rowNumber != (int)rowNumber)
+    {
+        /* Does not return */
+        JSE_THROW_RANGE_ERROR(ctx, "Invalid number of rows: %g", rowNumber);
+    }
+    else
+    {
+        rowCount = (int)rowNumber;
+
+        /* Check the values before adding anything */
+        if (!duk_is_null_or_undefined(ctx, 2))
+        {
+            if (duk_is_array(ctx, 2) && duk_get_length(ctx, 2) != (duk_size_t)rowCount)
+            {
+                /* Does not return */
+                JSE_THROW_TYPE_ERROR(ctx, "Values is not an object per row!");
+            }
+
+            paramCount = CountRowValues(ctx, 2, rowCount);
+        }
+
+        JSE_VERBOSE("pTable=\"%s\", rowCount=%d, paramCount=%d", pTable, rowCount, paramCount)
+
+        dotstr = pTable;
+        jse_cosa_bus_split_prefix(&dotstr, subSystemPrefix);
+
+        /* The table is about to change so forget any cached values */
+        ForgetParameterValues(subSystemPrefix, dotstr);
+
+        returnStatus = jse_cosa_bus_discover(dotstr, &pDestComponentName, &pDestPath, subSystemPrefix);
+        if (returnStatus != 0)
+        {
+            /* Does not return */
+            JSE_THROW_COSA_ERROR(ctx, returnStatus,
+                "UiDbusClientGetDestComponent() failed: \"%s\"", dotstr);
+        }
+
+        pInstances = (int *)calloc(rowCount, sizeof(int));
+        ppParamNameList = (char **)calloc(paramCount > 0 ? paramCount : 1, sizeof(char *));
+        ppParamValueList = (char **)calloc(paramCount > 0 ? paramCount : 1, sizeof(char *));
+        if (pInstances == NULL || ppParamNameList == NULL || ppParamValueList == NULL)
+        {
+            JSE_ERROR("calloc() failed: %s", strerror(errno))
+            returnStatus = CCSP_ERR_MEMORY_ALLOC_FAIL;
+        }
+
+        for (row = 0; row < rowCount && returnStatus == CCSP_SUCCESS; row++)
+        {
+            returnStatus =
+                jse_cosa_bus_add_row(
+                    subSystemPrefix,
+                    pDestComponentName,
+                    pDestPath,
+                    dotstr,
+                    &pInstances[row]);
+
+            if (returnStatus != CCSP_SUCCESS)
+            {
+                InvalidateDestComponentOnError(returnStatus, dotstr, subSystemPrefix);
+                AppendFaultName(faultNames, sizeof(faultNames), dotstr);
+            }
+            else
+            {
+                addedCount++;
+            }
+        }
+
+        if (returnStatus == CCSP_SUCCESS && paramCount > 0)
+        {
+            returnStatus = CopyRowValues(ctx, 2, pTable, pInstances, rowCount,
+                ppParamNameList, ppParamValueList, paramCount);
+            if (returnStatus == CCSP_SUCCESS)
+            {
+                returnStatus = SetParameterValues(ppParamNameList, ppParamValueList, paramCount, true,
+                    faultNames, sizeof(faultNames));
+            }
+        }
+
+        /* All the rows or none */
+        if (returnStatus != CCSP_SUCCESS && addedCount > 0)
+        {
+            DeleteAddedRows(subSystemPrefix, pDestComponentName, pDestPath, dotstr, pInstances, addedCount);
+        }
+
+        FreeStrings(ppParamNameList, paramCount);
+        FreeStrings(ppParamValueList, paramCount);
+        free(pDestComponentName);
+        free(pDestPath);
+
+        if (returnStatus != CCSP_SUCCESS)
+        {
+            free(pInstances);
 
             /* Does not return */
-            JSE_THROW_COSA_ERROR(ctx, CCSP_ERR_MEMORY_ALLOC_FAIL,
-                "calloc() failed: %s", strerror(errno));
+            JSE_THROW_COSA_ERROR(ctx, returnStatus,
+                "addRows() failed: %s", faultNames[0] != '\0' ? faultNames : "none");
         }
 
-        index = 0;
+        duk_push_array(ctx);
+        for (row = 0; row < rowCount; row++)
+        {
+            duk_push_int(ctx, pInstances[row]);
+            duk_put_prop_index(ctx, -2, (duk_uarridx_t)row);
+        }
 
-        /*
-        *  This is an array of arrays - process the first level
-        *  Second level array of each parameter value: parameter name, type and value
-        *  Therofore, the count has to be 3
-        *  Construct the parameter val struct list for CCSP Base API along the way
-        */
-        duk_enum(ctx, pParamArray, 0);
-        while (duk_next(ctx, -1, 1))
+        free(pInstances);
+
+        /* One item returned on the top of the stack, the instance numbers */
+        ret = 1;
+    }
+
+    JSE_EXIT("addRows()=%d", ret)
+    return ret;
+}
+
+/**
+ * @brief Gets the length of the table part of a row name.
+ *
+ * @param pRowName the row name, e.g. Device.NAT.PortMapping.3.
+ * @return the length of the table name, e.g. Device.NAT.PortMapping.
+ */
+static size_t TableNameLength(const char *pRowName)
+{
+    size_t len = strlen(pRowName);
+
+    /* Skip the trailing '.' then the instance number */
+    if (len > 0 && pRowName[len - 1] == '.')
+    {
+        len--;
+    }
+
+    while (len > 0 && pRowName[len - 1] != '.')
+    {
+        len--;
+    }
+
+    return len;
+}
+
+/**
+ * @brief The binding for deleteRows()
+ *
+ * This function calls the real CCSP API:
+ *  - CcspBaseIf_DeleteTblRow()
+ * It takes the following argument:
+ *  - array of DM row names, e.g. Device.NAT.PortMapping.3.
+ *
+ * The component is only discovered again when the table changes. Every
+ * row is tried, the names of the rows that could not be deleted being
+ * listed in the error thrown.
+ *
+ * @param ctx the duktape context.
+ *
+ * @return 0 or a negative error status.
+ */
+static duk_ret_t deleteRows(duk_context *ctx)
+{
+    duk_ret_t ret = DUK_RET_ERROR;
+
+    duk_idx_t pRowNameArray;
+    char **ppRowNameList = NULL;
+    int rowCount = 0;
+    char *pDestComponentName = NULL;
+    char *pDestPath = NULL;
+    const char *pTable = NULL;
+    size_t tableLen = 0;
+    int returnStatus = CCSP_SUCCESS;
+    int failStatus = CCSP_SUCCESS;
+    int deletedCount = 0;
+    /* Temporary buffer on the stack which will get cleaned up on throw */
+    char faultNames[512] = {0};
+    int row;
+
+    JSE_ASSERT(ctx != NULL)
+    JSE_ENTER("deleteRows(%p)", ctx)
+
+    if (parse_parameter(__FUNCTION__, ctx, "o", &pRowNameArray) != 0)
+    {
+        JSE_ERROR("Error parsing argument(s)!")
+    }
+    else if (!duk_is_array(ctx, pRowNameArray))
+    {
+        /* Does not return */
+        JSE_THROW_TYPE_ERROR(ctx, "Names is not an array!");
+    }
+    else
+    {
+        ppRowNameList = GetStringArray(ctx, pRowNameArray, &rowCount);
+
+        for (row = 0; row < rowCount; row++)
         {
-            if (!duk_is_array(ctx, -1))
+            char *dotstr = ppRowNameList[row];
+            char subSystemPrefix[6] = {0};
+            size_t len = TableNameLength(dotstr);
+
+            /* Rows of the same table share the component */
+            if (pDestComponentName == NULL || len != tableLen || strncmp(pTable, dotstr, len))
             {
-                free(pParameterValList);
                 free(pDestComponentName);
                 free(pDestPath);
+                pDestComponentName = NULL;
+                pDestPath = NULL;
+                pTable = NULL;
+            }
 
-                /* Does not return */
-                JSE_THROW_TYPE_ERROR(ctx, "Item is not an array!");
+            jse_cosa_bus_split_prefix(&dotstr, subSystemPrefix);
+
+            JSE_VERBOSE("dotstr=\"%s\"", dotstr)
+
+            /* The table is about to change so forget any cached values */
+            ForgetParameterValues(subSystemPrefix, dotstr);
+
+            if (pDestComponentName == NULL)
+            {
+                returnStatus = jse_cosa_bus_discover(dotstr, &pDestComponentName, &pDestPath, subSystemPrefix);
+                if (returnStatus != 0)
+                {
+                    JSE_ERROR("UiDbusClientGetDestComponent() failed: \"%s\"", dotstr)
+                    pDestComponentName = NULL;
+                    pDestPath = NULL;
+                }
+                else
+                {
+                    pTable = ppRowNameList[row];
+                    tableLen = len;
+                }
             }
-            else if (get_array_length(ctx, -1) != 3)
+
+            if (pDestComponentName != NULL)
             {
-                free(pParameterValList);
-                free(pDestComponentName);
-                free(pDestPath);
+                returnStatus =
+                    jse_cosa_bus_delete_row(
+                        subSystemPrefix,
+                        pDestComponentName,
+                        pDestPath,
+                        dotstr);
 
-                /* Does not return */
-                JSE_THROW_RANGE_ERROR(ctx,
-                    "Invalid sub-array size (%d)",
-                    get_array_length(ctx, -1));
+                if (returnStatus != CCSP_SUCCESS)
+                {
+                    JSE_ERROR("CcspBaseIf_DeleteTblRow() failed: \"%s\": %d", dotstr, returnStatus)
+                    InvalidateDestComponentOnError(returnStatus, dotstr, subSystemPrefix);
+
+                    /* Discover again in case the component has changed */
+                    free(pDestComponentName);
+                    free(pDestPath);
+                    pDestComponentName = NULL;
+                    pDestPath = NULL;
+                    pTable = NULL;
+                }
+                else
+                {
+                    deletedCount++;
+                }
             }
-            else
-            {
-                duk_enum(ctx, -1, 0);
 
-                if (duk_next(ctx, -1, true)) /* get the name */
+            /* Carry on to delete the other rows */
+            if (returnStatus != CCSP_SUCCESS)
+            {
+                AppendFaultName(faultNames, sizeof(faultNames), ppRowNameList[row]);
+                if (failStatus == CCSP_SUCCESS)
                 {
-                    /*FIXME unsafe cast from const char* to char*: fix when replacing ccsp with new system*/
-                    pParameterValList[index].parameterName = (char *)duk_get_string(ctx, -1);
+                    failStatus = returnStatus;
+                }
+            }
+        }
 
-                    JSE_VERBOSE("pParameterValList[%d].parameterName=\"%s\"",
-                        index, pParameterValList[index].parameterName)
+        free(pDestComponentName);
+        free(pDestPath);
+        free(ppRowNameList);
 
-                    /* pop name k/v */
-                    duk_pop_2(ctx);
+        JSE_VERBOSE("%d of %d rows deleted", deletedCount, rowCount)
 
-                    if (duk_next(ctx, -1, true)) /* get the type */
-                    {
-                        /*FIXME unsafe cast from const char* to char*: fix when replacing ccsp with new system*/
-                        char *pTemp = (char *)duk_get_string(ctx, -1);
+        if (failStatus != CCSP_SUCCESS)
+        {
+            /* Does not return */
+            JSE_THROW_COSA_ERROR(ctx, failStatus,
+                "deleteRows() failed: %d of %d rows deleted: %s", deletedCount, rowCount, faultNames);
+        }
 
-                        if (!strcmp(pTemp, "void"))
-                        {
-                            pParameterValList[index].type = ccsp_none;
-                        }
-                        else if (!strcmp(pTemp, "string"))
-                        {
-                            pParameterValList[index].type = ccsp_string;
-                        }
-                        else if (!strcmp(pTemp, "int"))
-                        {
-                            pParameterValList[index].type = ccsp_int;
-                        }
-                        else if (!strcmp(pTemp, "uint"))
-                        {
-                            pParameterValList[index].type = ccsp_unsignedInt;
-                        }
-                        else if (!strcmp(pTemp, "bool"))
-                        {
-                            pParameterValList[index].type = ccsp_boolean;
-                        }
-                        else if (!strcmp(pTemp, "datetime"))
-                        {
-                            pParameterValList[index].type = ccsp_dateTime;
-                        }
-                        else if (!strcmp(pTemp, "base64"))
-                        {
-                            pParameterValList[index].type = ccsp_base64;
-                        }
-                        else if (!strcmp(pTemp, "long"))
-                        {
-                            pParameterValList[index].type = ccsp_long;
-                        }
-                        else if (!strcmp(pTemp, "unlong"))
-                        {
-                            pParameterValList[index].type = ccsp_unsignedLong;
-                        }
-                        else if (!strcmp(pTemp, "float"))
-                        {
-                            pParameterValList[index].type = ccsp_float;
-                        }
-                        else if (!strcmp(pTemp, "double"))
-                        {
-                            pParameterValList[index].type = ccsp_double;
-                        }
-                        else if (!strcmp(pTemp, "byte"))
-                        {
-                            pParameterValList[index].type = ccsp_byte;
-                        }
+        /* Return nothing (undefined) */
+        ret = 0;
+    }
 
-                        JSE_VERBOSE("pParameterValList[%d].type=%d, pTemp=\"%s\"",
-                            index, pParameterValList[index].type, pTemp)
+    JSE_EXIT("deleteRows()=%d", ret)
+    return ret;
+}
 
-                        /* pop type k/v */
-                        duk_pop_2(ctx);
+/** The maximum number of prepared parameter sets */
+#define PREPARED_MAX 64
 
-                        if (duk_next(ctx, -1, true)) /* get the value */
-                        {
-                            /*FIXME unsafe cast from const char* to char*: fix when replacing ccsp with new system*/
-                            char * value = (char *)duk_safe_to_string(ctx, -1);
+/** A prepared parameter set */
+struct cosa_prepared_s
+{
+    /** The names separated by '\n', identifying the set */
+    char *pKey;
+    /** A copy of the key split into the names */
+    char *pNames;
+    /** The names */
+    char **ppNames;
+    /** The number of names */
+    int count;
+    /** The names grouped by component */
+    cosa_group_t *pGroups;
+    /** The number of groups */
+    int groupCount;
+    /** The discovery generation when grouped */
+    unsigned int generation;
+    /** The next set, less recently used */
+    struct cosa_prepared_s *pNext;
+};
+
+typedef struct cosa_prepared_s cosa_prepared_t;
+
+/** The prepared parameter sets, most recently used first */
+static cosa_prepared_t *prepared_items = NULL;
 
-                            if (pParameterValList[index].type == ccsp_boolean)
-                            {
-                                /* support true/false or 1/0 for boolean value */
-                                if (!strcmp(value, "1"))
-                                {
-                                    strcpy(BoolStrBuf, "true");
-                                    value = BoolStrBuf;
-                                }
-                                else if (!strcmp(value, "0"))
-                                {
-                                    strcpy(BoolStrBuf, "false");
-                                    value = BoolStrBuf;
-                                }
-                            }
+/**
+ * @brief Frees a prepared parameter set.
+ *
+ * @param pPrepared the set.
+ */
+static void FreePrepared(cosa_prepared_t *pPrepared)
+{
+    FreeGroups(pPrepared->pGroups, pPrepared->groupCount);
+    free(pPrepared->ppNames);
+    free(pPrepared->pNames);
+    free(pPrepared->pKey);
+    free(pPrepared);
+}
+
+/**
+ * @brief Finds a prepared parameter set making it the most recently used.
+ *
+ * @param pKey the key.
+ * @return the set or NULL.
+ */
+static cosa_prepared_t *FindPrepared(const char *pKey)
+{
+    cosa_prepared_t **ppPrev = &prepared_items;
+    cosa_prepared_t *pPrepared = prepared_items;
+
+    while (pPrepared != NULL && strcmp(pPrepared->pKey, pKey))
+    {
+        ppPrev = &pPrepared->pNext;
+        pPrepared = pPrepared->pNext;
+    }
+
+    if (pPrepared != NULL && pPrepared != prepared_items)
+    {
+        *ppPrev = pPrepared->pNext;
+        pPrepared->pNext = prepared_items;
+        prepared_items = pPrepared;
+    }
+
+    return pPrepared;
+}
+
+/**
+ * @brief Creates a prepared parameter set.
+ *
+ * The least recently used set is freed if there are too many.
+ *
+ * @param pKey the key.
+ * @return the set or NULL on error.
+ */
+static cosa_prepared_t *CreatePrepared(const char *pKey)
+{
+    cosa_prepared_t *pPrepared = NULL;
+    cosa_prepared_t **ppLast = NULL;
+    char *pName = NULL;
+    int count = 1;
+    int i;
+
+    pPrepared = (cosa_prepared_t *)calloc(1, sizeof(cosa_prepared_t));
+    if (pPrepared == NULL)
+    {
+        JSE_ERROR("calloc() failed: %s", strerror(errno))
+        return NULL;
+    }
+
+    for (pName = strchr(pKey, '\n'); pName != NULL; pName = strchr(pName + 1, '\n'))
+    {
+        count++;
+    }
+
+    pPrepared->pKey = strdup(pKey);
+    pPrepared->pNames = strdup(pKey);
+    pPrepared->ppNames = (char **)calloc(count, sizeof(char *));
+    if (pPrepared->pKey == NULL || pPrepared->pNames == NULL || pPrepared->ppNames == NULL)
+    {
+        JSE_ERROR("Out of memory!")
+        FreePrepared(pPrepared);
+        return NULL;
+    }
+
+    /* Split the copy in place so the names share its memory */
+    pName = pPrepared->pNames;
+    for (i = 0; i < count; i++)
+    {
+        char *pEnd = strchr(pName, '\n');
+
+        pPrepared->ppNames[i] = pName;
+        if (pEnd != NULL)
+        {
+            *pEnd = '\0';
+            pName = pEnd + 1;
+        }
+    }
+
+    pPrepared->count = count;
+    pPrepared->pNext = prepared_items;
+    prepared_items = pPrepared;
+
+    /* Drop the least recently used */
+    for (i = 0, ppLast = &prepared_items; *ppLast != NULL && i < PREPARED_MAX; i++)
+    {
+        ppLast = &(*ppLast)->pNext;
+    }
+
+    while (*ppLast != NULL)
+    {
+        cosa_prepared_t *pEvicted = *ppLast;
+
+        *ppLast = pEvicted->pNext;
+        FreePrepared(pEvicted);
+        jse_stats_add("cosa.prepared.evict", 1);
+    }
+
+    return pPrepared;
+}
+
+/**
+ * @brief Groups the names of a prepared parameter set by component.
+ *
+ * Does nothing if the set was grouped since discovery last changed.
+ *
+ * @param pPrepared the set.
+ * @param pFailIndex a pointer to return the index of the name that failed.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int GroupPrepared(cosa_prepared_t *pPrepared, int *pFailIndex)
+{
+    unsigned int generation = jse_cosa_cache_generation();
+    int returnStatus;
+
+    *pFailIndex = -1;
+
+    if (pPrepared->pGroups != NULL && pPrepared->generation == generation)
+    {
+        return CCSP_SUCCESS;
+    }
+
+    if (pPrepared->pGroups != NULL)
+    {
+        JSE_VERBOSE("Regrouping: discovery changed")
+        jse_stats_add("cosa.prepared.regroup", 1);
+    }
+
+    FreeGroups(pPrepared->pGroups, pPrepared->groupCount);
+    pPrepared->pGroups = NULL;
+    pPrepared->groupCount = 0;
+
+    returnStatus = GroupByDestComponent(pPrepared->ppNames, pPrepared->count,
+        &pPrepared->pGroups, &pPrepared->groupCount, pFailIndex);
+    if (returnStatus == CCSP_SUCCESS)
+    {
+        pPrepared->generation = generation;
+    }
+
+    return returnStatus;
+}
+
+/**
+ * @brief Finds or creates a prepared parameter set and groups its names.
+ *
+ * Throws an error on failure.
+ *
+ * @param ctx the duktape context.
+ * @param pKey the key.
+ * @return the set.
+ */
+static cosa_prepared_t *GetPrepared(duk_context *ctx, const char *pKey)
+{
+    cosa_prepared_t *pPrepared = FindPrepared(pKey);
+    int failIndex = -1;
+    int returnStatus;
+
+    if (pPrepared == NULL && (pPrepared = CreatePrepared(pKey)) == NULL)
+    {
+        /* Does not return */
+        JSE_THROW_COSA_ERROR(ctx, CCSP_ERR_MEMORY_ALLOC_FAIL, "Failed to prepare names");
+    }
+
+    returnStatus = GroupPrepared(pPrepared, &failIndex);
+    if (returnStatus != CCSP_SUCCESS)
+    {
+        /* Temporary buffer on the stack which will get cleaned up on throw */
+        char failName[256] = "none";
+
+        if (failIndex >= 0)
+        {
+            strncpy(failName, pPrepared->ppNames[failIndex], sizeof(failName) - 1);
+            failName[sizeof(failName) - 1] = '\0';
+        }
+
+        /* Does not return */
+        JSE_THROW_COSA_ERROR(ctx, returnStatus,
+            "UiDbusClientGetDestComponent() failed: \"%s\"", failName);
+    }
+
+    return pPrepared;
+}
 
-                            JSE_VERBOSE("pParameterValList[%d].parameterValue=\"%s\"\n",
-                                index, value)
+/**
+ * @brief The binding for the fetch() method of a prepared handle
+ *
+ * This function calls the real CCSP API:
+ *  - CcspBaseIf_getParameterValues()
+ *
+ * The components were resolved by prepare() so there is only one call
+ * per component.
+ *
+ * @param ctx the duktape context.
+ *
+ * @return 1 or a negative error status.
+ */
+static duk_ret_t preparedFetch(duk_context *ctx)
+{
+    duk_ret_t ret = DUK_RET_ERROR;
 
-                            pParameterValList[index].parameterValue = strdup(value);
-                            if (pParameterValList[index].parameterValue == NULL)
-                            {
-                                JSE_ERROR("strdup(): %s", strerror(errno));
-                                returnStatus = CCSP_ERR_MEMORY_ALLOC_FAIL;
-                            }
+    cosa_prepared_t *pPrepared = NULL;
+    const char *pKey = NULL;
+    int returnStatus = 0;
 
-                            /* pop value k/v */
-                            duk_pop_2(ctx);
-                        }
-                        else
-                        {
-                            JSE_ERROR("Subarray invalid")
-                            returnStatus = CCSP_FAILURE;
-                        }
-                    }
-                    else
-                    {
-                        JSE_ERROR("Subarray invalid")
-                        returnStatus = CCSP_FAILURE;
-                    }
-                }
-                else
-                {
-                    JSE_ERROR("Subarray invalid")
-                    returnStatus = CCSP_FAILURE;
-                }
+    /* Temporary buffer on the stack which will get cleaned up on throw */
+    char componentName[256];
 
-                index++;
+    JSE_ASSERT(ctx != NULL)
+    JSE_ENTER("preparedFetch(%p)", ctx)
 
-                /* pop sub array */
-                duk_pop(ctx);
-            }
-            /* pop key and value from main array */
-            duk_pop_2(ctx);
-        }
-        /* pop main array */
-        duk_pop(ctx);
+    duk_push_this(ctx);
+    duk_get_prop_string(ctx, -1, DUK_HIDDEN_SYMBOL("key"));
+    pKey = duk_get_string(ctx, -1);
+    if (pKey == NULL)
+    {
+        /* Does not return */
+        JSE_THROW_TYPE_ERROR(ctx, "Not a prepared handle!");
+    }
 
-        if (0 == returnStatus)
-        {
-            returnStatus =
-                CcspBaseIf_setParameterValues(
-                    bus_handle,
-                    pDestComponentName,
-                    pDestPath,
-                    0,
-                    CCSP_COMPONENT_ID_WebUI,
-                    pParameterValList,
-                    index, /* use the actual count, instead of paramCount */
-                    bDbusCommit,
-                    &pFaultParamName);
-        }
+    /* Set again if evicted or discovery has changed */
+    pPrepared = GetPrepared(ctx, pKey);
 
-        for (index = 0; index < paramCount; index++)
-        {
-            if (pParameterValList[index].parameterValue != NULL)
-            {
-                free(pParameterValList[index].parameterValue);
-            }
-        }
+    duk_push_object(ctx);
 
-        free(pParameterValList);
-        free(pDestComponentName);
-        free(pDestPath);
+    returnStatus = FetchGroupValues(pPrepared->pGroups, pPrepared->groupCount, PutObjectValue, ctx,
+        componentName, sizeof(componentName));
+    if (returnStatus != CCSP_SUCCESS)
+    {
+        /* Does not return */
+        JSE_THROW_COSA_ERROR(ctx, returnStatus,
+            "CcspBaseIf_getParameterValues() failed: \"%s\"", componentName);
+    }
 
-        if (CCSP_SUCCESS != returnStatus)
-        {
-            if (pFaultParamName != NULL)
-            {
-                /* Temporary buffer on the stack which will get cleaned up on throw */
-                char faultParamName[256];
+    /* One item returned on the top of the stack, the value object */
+    ret = 1;
 
-                strncpy(faultParamName, pFaultParamName ? pFaultParamName : "none", sizeof(faultParamName) - 1);
-                faultParamName[sizeof(faultParamName) - 1] = '\0';
+    JSE_EXIT("preparedFetch()=%d", ret)
+    return ret;
+}
 
-                /* Per C99 free(NULL) is a NOP */
-                free(pFaultParamName);
+/**
+ * @brief Pushes the key of a prepared parameter set.
+ *
+ * The key is the names joined by '\n', which can't be in a name. Throws
+ * an error if there are no names or an item is not a name.
+ *
+ * @param ctx the duktape context.
+ * @param idx the index of the array of names.
+ */
+static void PushPreparedKey(duk_context *ctx, duk_idx_t idx)
+{
+    char **ppParamNameList = NULL;
+    int paramCount = 0;
+    int index;
 
-                /* Does not return */
-                JSE_THROW_COSA_ERROR(ctx, returnStatus,
-                    "CcspBaseIf_setParameterValues() failed: %d: %s",
-                    bDbusCommit, faultParamName);
-            }
-            else
-            {
-                /* Does not return */
-                JSE_THROW_COSA_ERROR(ctx, returnStatus, "Internal error");
-            }
-        }
-        else
+    ppParamNameList = GetStringArray(ctx, idx, &paramCount);
+    if (paramCount == 0)
+    {
+        /* Does not return */
+        JSE_THROW_TYPE_ERROR(ctx, "Names is empty!");
+    }
+
+    duk_push_string(ctx, "\n");
+    for (index = 0; index < paramCount; index++)
+    {
+        if (strchr(ppParamNameList[index], '\n') != NULL)
         {
-            /* Return nothing (undefined) */
-            ret = 0;
+            free(ppParamNameList);
+
+            /* Does not return */
+            JSE_THROW_TYPE_ERROR(ctx, "Item %d is not a name!", index);
         }
+
+        duk_push_string(ctx, ppParamNameList[index]);
     }
 
-    JSE_EXIT("DmExtSetStrsWithRootObj()=%d", ret)
-    return ret;
+    free(ppParamNameList);
+
+    duk_join(ctx, paramCount);
 }
 
 /**
- * @brief The binding for DmExtGetInstanceIds()
+ * @brief The binding for prepare()
  *
  * This function calls the real CCSP API:
- *  - CcspBaseIf_GetNextLevelInstances()
+ *  - CcspBaseIf_discComponentSupportingNamespace()
  * It takes the following argument:
- *  - object table name, e.g. Device.NAT.PortMapping.
+ *  - array of DM parameter names, which may be for different components
+ *
+ * The names are grouped by component once and kept across requests so
+ * the fetch() method of the returned handle only gets the values.
  *
  * @param ctx the duktape context.
- * 
+ *
  * @return 1 or a negative error status.
  */
-static duk_ret_t DmExtGetInstanceIds(duk_context *ctx)
+static duk_ret_t prepare(duk_context *ctx)
 {
     duk_ret_t ret = DUK_RET_ERROR;
 
-    char *dotstr = NULL;
-    char subSystemPrefix[6] = {0};
-    char *ppDestComponentName = NULL;
-    char *ppDestPath = NULL;
-    int returnStatus = 0;
-    unsigned int InstNum = 0;
-    unsigned int *pInstNumList = NULL;
-    duk_uarridx_t index = 0;
+    duk_idx_t pParamNameArray;
 
     JSE_ASSERT(ctx != NULL)
-    JSE_ENTER("DmExtGetInstanceIds(%p)", ctx)
+    JSE_ENTER("prepare(%p)", ctx)
 
-    if (parse_parameter(__FUNCTION__, ctx, "s", &dotstr) != 0)
+    if (parse_parameter(__FUNCTION__, ctx, "o", &pParamNameArray) != 0)
     {
         JSE_ERROR("Error parsing argument(s)!")
     }
+    else if (!duk_is_array(ctx, pParamNameArray))
+    {
+        /* Does not return */
+        JSE_THROW_TYPE_ERROR(ctx, "Names is not an array!");
+    }
     else
     {
-        JSE_VERBOSE("dotstr=\"%s\"", dotstr)
+        PushPreparedKey(ctx, pParamNameArray);
+        (void) GetPrepared(ctx, duk_get_string(ctx, -1));
 
-        /* Check whether there are subsystem prefix in the dot string
-           Split Subsytem prefix and COSA dotstr if subsystem prefix is found */
-        CheckAndSetSubsystemPrefix(&dotstr, subSystemPrefix);
+        duk_push_object(ctx);
+        duk_swap_top(ctx, -2);
+        duk_put_prop_string(ctx, -2, DUK_HIDDEN_SYMBOL("key"));
+        duk_push_c_function(ctx, preparedFetch, 0);
+        duk_put_prop_string(ctx, -2, "fetch");
 
-        JSE_VERBOSE("subSystemPrefix=\"%s\"", subSystemPrefix)
+        /* One item returned on the top of the stack, the handle */
+        ret = 1;
+    }
 
-        // Get Destination component
-        returnStatus = UiDbusClientGetDestComponent(dotstr, &ppDestComponentName, &ppDestPath, subSystemPrefix);
-        if (returnStatus != 0)
+    JSE_EXIT("prepare()=%d", ret)
+    return ret;
+}
+
+/**
+ * @brief The binding for getChanged()
+ *
+ * This function calls the real CCSP API:
+ *  - CcspBaseIf_getParameterValues()
+ * It takes the following arguments:
+ *  - snapshot id, e.g. a session id and page name
+ *  - array of DM parameter names, or a DM parameter name or partial path
+ *  - optional revision the caller last got
+ *
+ * The values are compared with those of the last call with the same id
+ * and only the values that differ are returned, null for parameters that
+ * have gone. Every value is returned the first time, if the names change
+ * or if the revision is given and is not that of the last call. The
+ * revision of the values is returned as the _revision property.
+ *
+ * The names are grouped by component as by prepare().
+ *
+ * @param ctx the duktape context.
+ *
+ * @return 1 or a negative error status.
+ */
+static duk_ret_t getChanged(duk_context *ctx)
+{
+    duk_ret_t ret = DUK_RET_ERROR;
+
+    const char *pId = NULL;
+    const char *pKey = NULL;
+    const char *pRevision = NULL;
+    cosa_prepared_t *pPrepared = NULL;
+    jse_cosa_snapshot_t *pSnapshot = NULL;
+    int returnStatus = 0;
+    int changed;
+
+    /* Temporary buffers on the stack which will get cleaned up on throw */
+    char componentName[256];
+    char revision[JSE_COSA_SNAPSHOT_REVISION_SIZE];
+
+    JSE_ASSERT(ctx != NULL)
+    JSE_ENTER("getChanged(%p)", ctx)
+
+    if (parse_parameter(__FUNCTION__, ctx, "s", &pId) != 0)
+    {
+        JSE_ERROR("Error parsing argument(s)!")
+    }
+    else
+    {
+        if (duk_is_array(ctx, 1))
         {
-            /* Does not return */
-            JSE_THROW_COSA_ERROR(ctx, returnStatus,
-                "UiDbusClientGetDestComponent() failed: \"%s\"", dotstr);
+            PushPreparedKey(ctx, 1);
+        }
+        else if (duk_is_string(ctx, 1) && duk_get_length(ctx, 1) > 0 &&
+            strchr(duk_get_string(ctx, 1), '\n') == NULL)
+        {
+            duk_dup(ctx, 1);
         }
         else
         {
-            JSE_DEBUG("dotstr=\"%s\", ppDestComponentName=\"%s\", ppDestPath=\"%s\"",
-                dotstr, ppDestComponentName, ppDestPath)
+            /* Does not return */
+            JSE_THROW_TYPE_ERROR(ctx, "Names is not an array or a name!");
         }
+        pKey = duk_get_string(ctx, -1);
 
-        /*
-        *  Get Next Instance Numbers
-        */
-        returnStatus =
-            CcspBaseIf_GetNextLevelInstances(
-                bus_handle,
-                ppDestComponentName,
-                ppDestPath,
-                dotstr,
-                &InstNum,
-                &pInstNumList);
+        if (duk_is_string(ctx, 2))
+        {
+            pRevision = duk_get_string(ctx, 2);
+        }
+        else if (!duk_is_null_or_undefined(ctx, 2))
+        {
+            /* Does not return */
+            JSE_THROW_TYPE_ERROR(ctx, "Revision is not a string!");
+        }
 
-        free(ppDestComponentName);
-        free(ppDestPath);
+        JSE_VERBOSE("id=\"%s\", revision=\"%s\"", pId, pRevision != NULL ? pRevision : "none")
+
+        pPrepared = GetPrepared(ctx, pKey);
 
+        pSnapshot = jse_cosa_snapshot_new();
+        if (pSnapshot == NULL)
+        {
+            /* Does not return */
+            JSE_THROW_COSA_ERROR(ctx, CCSP_ERR_MEMORY_ALLOC_FAIL, "Failed to create snapshot");
+        }
+
+        returnStatus = FetchGroupValues(pPrepared->pGroups, pPrepared->groupCount, PutSnapshotValue, pSnapshot,
+            componentName, sizeof(componentName));
         if (returnStatus != CCSP_SUCCESS)
         {
-            /* Per C99 free(NULL) is a NOP */
-            free(pInstNumList);
+            jse_cosa_snapshot_free(pSnapshot);
 
             /* Does not return */
             JSE_THROW_COSA_ERROR(ctx, returnStatus,
-                "CcspBaseIf_GetNextLevelInstances() failed");
+                "CcspBaseIf_getParameterValues() failed: \"%s\"", componentName);
         }
-        else
-        {
-            char StrBuf[24];
-
-            duk_idx_t arr_idx = duk_push_array(ctx);
-            duk_push_int(ctx, 0);
-            duk_put_prop_index(ctx, arr_idx, 0);
 
-            JSE_VERBOSE("InstNum=%d", InstNum)
+        duk_push_object(ctx);
 
-            for (index = 0; index < InstNum; index++)
-            {
-                snprintf(StrBuf, sizeof(StrBuf), "%d", pInstNumList[index]);
-                duk_push_string(ctx, StrBuf);
-                duk_put_prop_index(ctx, arr_idx, index + 1);
+        changed = jse_cosa_snapshot_diff(pId, pKey, pSnapshot, pRevision, PutObjectValue, ctx, revision);
+        if (changed < 0)
+        {
+            /* Does not return */
+            JSE_THROW_COSA_ERROR(ctx, CCSP_ERR_MEMORY_ALLOC_FAIL, "Failed to compare snapshot");
+        }
 
-                JSE_VERBOSE("Index %d: \"%s\"", index, StrBuf)
-            }
+        JSE_VERBOSE("%d values changed, revision %s", changed, revision)
 
-            /* Per C99 free(NULL) is a NOP */
-            free(pInstNumList);
+        duk_push_string(ctx, revision);
+        duk_put_prop_string(ctx, -2, "_revision");
 
-            /* One item returned on the bottom of the stack, the value array */
-            ret = 1;
-        }
+        /* One item returned on the top of the stack, the changed values */
+        ret = 1;
     }
 
-    JSE_EXIT("DmExtGetInstanceIds()=%d", ret)
+    JSE_EXIT("getChanged()=%d", ret)
     return ret;
 }
 
 /* Duktape/C function bind list */
 static const duk_function_list_entry ccsp_cosa_funcs[] = {
     {"getStr", getStr, 1},
+    {"tryGetStr", tryGetStr, 2},
     {"setStr", setStr, 3},
     {"getInstanceIds", getInstanceIds, 1},
     {"addTblObj", addTblObj, 1},
     {"delTblObj", delTblObj, 1},
+    {"addRows", addRows, 3},
+    {"deleteRows", deleteRows, 1},
     {"DmExtGetStrsWithRootObj", DmExtGetStrsWithRootObj, 2},
     {"DmExtSetStrsWithRootObj", DmExtSetStrsWithRootObj, 3},
     {"DmExtGetInstanceIds", DmExtGetInstanceIds, 1},
+    {"DmExtGetObjWithRootObj", DmExtGetObjWithRootObj, 2},
+    {"getMany", getMany, 1},
+    {"setMany", setMany, 2},
+    {"getTree", getTree, 2},
+    {"getTable", getTable, 3},
+    {"prepare", prepare, 1},
+    {"getChanged", getChanged, 3},
     {NULL, NULL, 0}};
 
+/**
+ * @brief Calls a Cosa function, initialising the message bus first
+ *
+ * The message bus is only initialised when a script first uses it, so
+ * requests that don't use Cosa don't pay for it. If it can not be
+ * initialised a CosaError is thrown, except by tryGetStr() which returns
+ * its default as for any other failure to read.
+ *
+ * @param ctx the duktape context.
+ *
+ * @return the function's return value.
+ */
+static duk_ret_t CallLazily(duk_context *ctx)
+{
+    const duk_function_list_entry *pFunc = &ccsp_cosa_funcs[duk_get_current_magic(ctx)];
+    char reason[64];
+
+    if (EnsureInitialised(reason, sizeof(reason)) != CCSP_SUCCESS)
+    {
+        if (pFunc->value == tryGetStr)
+        {
+            JSE_VERBOSE("tryGetStr(): %s", reason)
+            jse_stats_add("cosa.try.default", 1);
+
+            /* The default, undefined if not given */
+            duk_dup(ctx, 1);
+            return 1;
+        }
+
+        /* Does not return */
+        JSE_THROW_COSA_ERROR(ctx, CCSP_ERR_NOT_CONNECT, "%s", reason);
+    }
+
+    return pFunc->value(ctx);
+}
+
 /**
  * @brief Bind CCSP functions
  *
@@ -1694,6 +4543,7 @@ static const duk_function_list_entry ccsp_cosa_funcs[] = {
 duk_int_t jse_bind_cosa(jse_context_t* jse_ctx)
 {
     duk_int_t ret = DUK_ERR_ERROR;
+    int i;
 
     JSE_ENTER("jse_bind_cosa(%p)", jse_ctx)
 
@@ -1710,7 +4560,16 @@ duk_int_t jse_bind_cosa(jse_context_t* jse_ctx)
             if (ref_count == 0)
             {
                 duk_push_object(jse_ctx->ctx);
-                duk_put_function_list(jse_ctx->ctx, -1, ccsp_cosa_funcs);
+
+                /* Each function is bound through CallLazily(), the magic
+                   being its index in the list */
+                for (i = 0; ccsp_cosa_funcs[i].key != NULL; i++)
+                {
+                    duk_push_c_function(jse_ctx->ctx, CallLazily, ccsp_cosa_funcs[i].nargs);
+                    duk_set_magic(jse_ctx->ctx, -1, (duk_int_t)i);
+                    duk_put_prop_string(jse_ctx->ctx, -2, ccsp_cosa_funcs[i].key);
+                }
+
                 duk_put_global_string(jse_ctx->ctx, "Cosa");
             }
 
@@ -1740,6 +4599,12 @@ void jse_unbind_cosa(jse_context_t * jse_ctx)
     ref_count --;
     JSE_VERBOSE("ref_count=%d", ref_count)
 
+    /* Memoised values only last for a request */
+    if (ref_count == 0)
+    {
+        MemoClear();
+    }
+
     /* TODO: Actually unbind */
 
     jse_unbind_cosa_error(jse_ctx);
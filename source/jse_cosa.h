@@ -20,6 +20,8 @@
 #ifndef JSE_COSA_H
 #define JSE_COSA_H
 
+#include <stdbool.h>
+
 #include "jse_common.h"
 
 #if defined(__cplusplus)
@@ -29,15 +31,38 @@ extern "C" {
 /**
  * @brief Initialise CCSP message bus
  *
+ * Does nothing if already initialised. Called by the first Cosa call of
+ * a script so need not be called at start up.
+ *
  * @return an error status or 0.
  */
 int jse_cosa_init(void);
 
+/**
+ * @brief Sets whether the first Cosa call initialises the message bus.
+ *
+ * Enabled by default. When disabled Cosa calls fail unless
+ * jse_cosa_init() has been called.
+ *
+ * @param enable set false to never initialise the message bus.
+ */
+void jse_cosa_set_auto_init(bool enable);
+
 /**
  * Shutdown the CCSP message bus
  */
 void jse_cosa_shutdown(void);
 
+/**
+ * @brief Enables memoising parameter values during a request.
+ *
+ * Repeated reads of a parameter in a request are then answered from memory.
+ * Sets and table changes forget the values they affect.
+ *
+ * @param enable set true to enable.
+ */
+void jse_cosa_set_memo(bool enable);
+
 /**
  * @brief Bind CCSP functions
  *
@@ -0,0 +1,161 @@
+/*****************************************************************************
+*
+* Copyright 2020 Liberty Global B.V.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*****************************************************************************/
+
+#ifndef JSE_COSA_BACKEND_H
+#define JSE_COSA_BACKEND_H
+
+#include <stdbool.h>
+
+#include "jse_cosa_types.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/**
+ * A data model the Cosa bindings talk to.
+ *
+ * The functions return CCSP_SUCCESS or a CCSP error status, as the CCSP
+ * APIs they mirror, unless stated otherwise. Names are passed without any
+ * subsystem prefix, which is passed separately.
+ */
+struct jse_cosa_backend_s
+{
+    /** The backend name, for logging */
+    const char *name;
+
+    /** Set if get_values() may be called from several threads at once */
+    bool concurrent;
+
+    /**
+     * @brief Initialises the backend.
+     *
+     * @return 0 on success or -1 on error.
+     */
+    int (*init)(void);
+
+    /**
+     * @brief Shuts down the backend.
+     */
+    void (*shutdown)(void);
+
+    /**
+     * @brief Locates the component supporting a name.
+     *
+     * See CcspBaseIf_discComponentSupportingNamespace().
+     *
+     * @param pSystemPrefix subsystem prefix
+     * @param pObjName the parameter or object name.
+     * @param ppComponent a pointer to return the component name, which must be freed.
+     * @param ppPath a pointer to return the component D-Bus path, which must be freed.
+     */
+    int (*discover)(const char *pSystemPrefix, char *pObjName, char **ppComponent, char **ppPath);
+
+    /**
+     * @brief Forgets a cached component, may be NULL.
+     *
+     * @param pSystemPrefix subsystem prefix
+     * @param pObjName the parameter or object name.
+     */
+    void (*invalidate)(const char *pSystemPrefix, const char *pObjName);
+
+    /**
+     * @brief Gets the types of parameters known to the backend, may be NULL.
+     *
+     * @param pSystemPrefix subsystem prefix
+     * @param ppNames the parameter names.
+     * @param count the number of names.
+     * @param pTypes an array of count types to return the types, -1 if not known.
+     */
+    int (*get_types)(const char *pSystemPrefix, char **ppNames, int count, int *pTypes);
+
+    /**
+     * @brief Gets parameter values from a component.
+     *
+     * See CcspBaseIf_getParameterValues().
+     */
+    int (*get_values)(const char *pSystemPrefix, const char *pComponent, char *pPath,
+        char **ppNames, int count, int *pValCount, parameterValStruct_t ***pppVals);
+
+    /**
+     * @brief Frees the values returned by get_values().
+     */
+    void (*free_values)(int valCount, parameterValStruct_t **ppVals);
+
+    /**
+     * @brief Sets parameter values of a component.
+     *
+     * See CcspBaseIf_setParameterValues().
+     */
+    int (*set_values)(const char *pSystemPrefix, const char *pComponent, char *pPath,
+        parameterValStruct_t *pVals, int count, bool commit, char **ppFaultName);
+
+    /**
+     * @brief Commits or discards the values set on a component.
+     *
+     * See CcspBaseIf_setCommit().
+     */
+    int (*set_commit)(const char *pComponent, char *pPath, bool commit);
+
+    /**
+     * @brief Gets the instance numbers of a table.
+     *
+     * See CcspBaseIf_GetNextLevelInstances().
+     */
+    int (*get_instances)(const char *pComponent, char *pPath, char *pObjName,
+        unsigned int *pCount, unsigned int **ppInstances);
+
+    /**
+     * @brief Adds a row to a table.
+     *
+     * See CcspBaseIf_AddTblRow().
+     */
+    int (*add_row)(const char *pSystemPrefix, const char *pComponent, char *pPath, char *pObjName, int *pInstance);
+
+    /**
+     * @brief Deletes a row from a table.
+     *
+     * See CcspBaseIf_DeleteTblRow().
+     */
+    int (*delete_row)(const char *pSystemPrefix, const char *pComponent, char *pPath, char *pObjName);
+};
+
+/** The backend type */
+typedef struct jse_cosa_backend_s jse_cosa_backend_t;
+
+#ifdef BUILD_RDK
+/** The CCSP message bus */
+extern const jse_cosa_backend_t jse_cosa_ccsp_backend;
+#endif
+
+#ifdef BUILD_RBUS
+/** rbus, used directly rather than through the CCSP message bus API */
+extern const jse_cosa_backend_t jse_cosa_rbus_backend;
+#endif
+
+/** The in-process mock data model, see jse_cosa_mock.h */
+extern const jse_cosa_backend_t jse_cosa_mock_backend;
+
+/** Answers calls with those recorded in a trace, see jse_cosa_trace.h */
+extern const jse_cosa_backend_t jse_cosa_replay_backend;
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
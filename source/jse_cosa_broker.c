@@ -0,0 +1,533 @@
+/*****************************************************************************
+*
+* Copyright 2020 Liberty Global B.V.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*****************************************************************************/
+
+/* For struct ucred */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "jse_debug.h"
+#include "jse_common.h"
+#include "jse_cosa_broker.h"
+
+/** The backlog of connections waiting to be accepted */
+#define LISTEN_BACKLOG 16
+
+/**
+ * @brief Makes room in a message.
+ *
+ * @param msg the message.
+ * @param length the length to add.
+ * @return true if there is room.
+ */
+static bool make_room(jse_cosa_broker_msg_t * msg, size_t length)
+{
+    if (msg->error)
+    {
+        return false;
+    }
+
+    if (msg->length + length > JSE_COSA_BROKER_MAX_MESSAGE)
+    {
+        JSE_ERROR("Message too long!")
+        msg->error = true;
+        return false;
+    }
+
+    if (msg->length + length > msg->size)
+    {
+        size_t size = msg->size > 0 ? msg->size : 256;
+        unsigned char * data = NULL;
+
+        while (size < msg->length + length)
+        {
+            size *= 2;
+        }
+
+        data = (unsigned char *)realloc(msg->data, size);
+        if (data == NULL)
+        {
+            JSE_ERROR("realloc() failed: %s", strerror(errno))
+            msg->error = true;
+            return false;
+        }
+
+        msg->data = data;
+        msg->size = size;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Writes all of a buffer to a socket.
+ *
+ * @param fd the socket.
+ * @param buffer the buffer.
+ * @param length the length to write.
+ * @return 0 on success or -1 on error.
+ */
+static int write_all(int fd, const void * buffer, size_t length)
+{
+    const unsigned char * p = (const unsigned char *)buffer;
+
+    while (length > 0)
+    {
+        ssize_t written = send(fd, p, length, MSG_NOSIGNAL);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                /* Timed out, errno is left for the caller */
+                return -1;
+            }
+
+            JSE_ERROR("send() failed: %s", strerror(errno))
+            return -1;
+        }
+
+        p += written;
+        length -= (size_t)written;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Reads all of a buffer from a socket.
+ *
+ * @param fd the socket.
+ * @param buffer the buffer.
+ * @param length the length to read.
+ * @return 0 on success or -1 on error or end of file.
+ */
+static int read_all(int fd, void * buffer, size_t length)
+{
+    unsigned char * p = (unsigned char *)buffer;
+
+    while (length > 0)
+    {
+        ssize_t got = recv(fd, p, length, 0);
+        if (got < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                /* Timed out, errno is left for the caller */
+                return -1;
+            }
+
+            JSE_ERROR("recv() failed: %s", strerror(errno))
+            return -1;
+        }
+
+        if (got == 0)
+        {
+            /* The other end closed */
+            return -1;
+        }
+
+        p += got;
+        length -= (size_t)got;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Fills in the address of a socket.
+ *
+ * @param path the socket path.
+ * @param addr the address to fill in.
+ * @return 0 on success or -1 if the path is too long.
+ */
+static int socket_address(const char * path, struct sockaddr_un * addr)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+
+    if (strlen(path) >= sizeof(addr->sun_path))
+    {
+        JSE_ERROR("Socket path too long: %s", path)
+        return -1;
+    }
+
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+/**
+ * @brief Empties a message keeping its buffer.
+ *
+ * @param msg the message.
+ */
+void jse_cosa_broker_msg_reset(jse_cosa_broker_msg_t * msg)
+{
+    msg->length = 0;
+    msg->offset = 0;
+    msg->error = false;
+}
+
+/**
+ * @brief Frees the buffer of a message.
+ *
+ * @param msg the message.
+ */
+void jse_cosa_broker_msg_free(jse_cosa_broker_msg_t * msg)
+{
+    free(msg->data);
+    memset(msg, 0, sizeof(*msg));
+}
+
+/**
+ * @brief Adds an integer to a message.
+ *
+ * @param msg the message.
+ * @param value the value.
+ */
+void jse_cosa_broker_put_int(jse_cosa_broker_msg_t * msg, int32_t value)
+{
+    if (make_room(msg, sizeof(value)))
+    {
+        memcpy(&msg->data[msg->length], &value, sizeof(value));
+        msg->length += sizeof(value);
+    }
+}
+
+/**
+ * @brief Adds a string to a message.
+ *
+ * @param msg the message.
+ * @param str the string or NULL.
+ */
+void jse_cosa_broker_put_string(jse_cosa_broker_msg_t * msg, const char * str)
+{
+    size_t length = str != NULL ? strlen(str) : 0;
+
+    jse_cosa_broker_put_int(msg, str != NULL ? (int32_t)length : -1);
+
+    if (length > 0 && make_room(msg, length))
+    {
+        memcpy(&msg->data[msg->length], str, length);
+        msg->length += length;
+    }
+}
+
+/**
+ * @brief Parses an integer from a message.
+ *
+ * @param msg the message.
+ * @return the value or 0 on error.
+ */
+int32_t jse_cosa_broker_get_int(jse_cosa_broker_msg_t * msg)
+{
+    int32_t value = 0;
+
+    if (msg->error || msg->offset + sizeof(value) > msg->length)
+    {
+        msg->error = true;
+        return 0;
+    }
+
+    memcpy(&value, &msg->data[msg->offset], sizeof(value));
+    msg->offset += sizeof(value);
+
+    return value;
+}
+
+/**
+ * @brief Parses a string from a message.
+ *
+ * @param msg the message.
+ * @return a copy of the string, which must be freed, or NULL if the
+ * string is NULL or on error.
+ */
+char * jse_cosa_broker_get_string(jse_cosa_broker_msg_t * msg)
+{
+    int32_t length = jse_cosa_broker_get_int(msg);
+    char * str = NULL;
+
+    if (msg->error || length < 0)
+    {
+        return NULL;
+    }
+
+    if (msg->offset + (size_t)length > msg->length)
+    {
+        msg->error = true;
+        return NULL;
+    }
+
+    str = (char *)malloc((size_t)length + 1);
+    if (str == NULL)
+    {
+        JSE_ERROR("malloc() failed: %s", strerror(errno))
+        msg->error = true;
+        return NULL;
+    }
+
+    memcpy(str, &msg->data[msg->offset], (size_t)length);
+    str[length] = '\0';
+    msg->offset += (size_t)length;
+
+    return str;
+}
+
+/**
+ * @brief Sends a message.
+ *
+ * @param fd the socket.
+ * @param msg the message.
+ * @return 0 on success or -1 on error.
+ */
+int jse_cosa_broker_send(int fd, const jse_cosa_broker_msg_t * msg)
+{
+    uint32_t length = (uint32_t)msg->length;
+
+    if (msg->error)
+    {
+        return -1;
+    }
+
+    if (write_all(fd, &length, sizeof(length)) != 0 || write_all(fd, msg->data, msg->length) != 0)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Receives a message.
+ *
+ * @param fd the socket.
+ * @param msg the message, which is reset first.
+ * @return 0 on success or -1 on error or end of file.
+ */
+int jse_cosa_broker_receive(int fd, jse_cosa_broker_msg_t * msg)
+{
+    uint32_t length = 0;
+
+    jse_cosa_broker_msg_reset(msg);
+
+    if (read_all(fd, &length, sizeof(length)) != 0)
+    {
+        return -1;
+    }
+
+    if (!make_room(msg, length) || read_all(fd, msg->data, length) != 0)
+    {
+        return -1;
+    }
+
+    msg->length = length;
+
+    return 0;
+}
+
+/**
+ * @brief Sets the receive and send timeouts of a socket.
+ *
+ * A read or write that takes longer fails with EAGAIN.
+ *
+ * @param fd the socket.
+ * @param timeout_msec the timeout in milliseconds, 0 to clear it.
+ * @return 0 on success or -1 on error.
+ */
+int jse_cosa_broker_set_timeout(int fd, long timeout_msec)
+{
+    struct timeval tv;
+
+    if (timeout_msec < 0)
+    {
+        timeout_msec = 0;
+    }
+
+    tv.tv_sec = timeout_msec / 1000;
+    tv.tv_usec = (timeout_msec % 1000) * 1000;
+
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) != 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) != 0)
+    {
+        JSE_ERROR("setsockopt() failed: %s", strerror(errno))
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Checks the user at the other end of a socket.
+ *
+ * @param fd the connected socket.
+ * @param allow_root true to accept root as well as our own user.
+ * @return true if the peer is trusted.
+ */
+bool jse_cosa_broker_check_peer(int fd, bool allow_root)
+{
+    struct ucred cred;
+    socklen_t length = sizeof(cred);
+
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &length) != 0)
+    {
+        JSE_ERROR("getsockopt(SO_PEERCRED) failed: %s", strerror(errno))
+        return false;
+    }
+
+    if (cred.uid != geteuid() && !(allow_root && cred.uid == 0))
+    {
+        JSE_ERROR("Refusing peer with uid %u (pid %d)",
+            (unsigned int)cred.uid, (int)cred.pid)
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Connects to the jse-cosad socket.
+ *
+ * @param path the socket path.
+ * @param timeout_msec the time to wait to send or receive, 0 to wait as
+ * long as it takes.
+ * @return the socket or -1 on error.
+ */
+int jse_cosa_broker_connect(const char * path, long timeout_msec)
+{
+    struct sockaddr_un addr;
+    int fd = -1;
+
+    if (socket_address(path, &addr) != 0)
+    {
+        return -1;
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+    {
+        JSE_ERROR("socket() failed: %s", strerror(errno))
+        return -1;
+    }
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        /* Not an error, the daemon is optional */
+        JSE_VERBOSE("connect(\"%s\") failed: %s", path, strerror(errno))
+        close(fd);
+        return -1;
+    }
+
+    /* Whoever is listening gets every value we set, so it must be us or root */
+    if (!jse_cosa_broker_check_peer(fd, true))
+    {
+        close(fd);
+        return -1;
+    }
+
+    if (timeout_msec > 0)
+    {
+        (void) jse_cosa_broker_set_timeout(fd, timeout_msec);
+    }
+
+    return fd;
+}
+
+/**
+ * @brief Creates the jse-cosad socket and listens on it.
+ *
+ * @param path the socket path.
+ * @return the socket or -1 on error.
+ */
+int jse_cosa_broker_listen(const char * path)
+{
+    struct sockaddr_un addr;
+    char dir[sizeof(addr.sun_path)];
+    mode_t mask = 0;
+    int fd = -1;
+    int ret = 0;
+
+    if (socket_address(path, &addr) != 0)
+    {
+        return -1;
+    }
+
+    /* Only we may create, replace or connect to the socket */
+    strcpy(dir, addr.sun_path);
+    if (jse_private_dir(dirname(dir)) != 0)
+    {
+        JSE_ERROR("Unsafe socket directory for \"%s\"", path)
+        return -1;
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+    {
+        JSE_ERROR("socket() failed: %s", strerror(errno))
+        return -1;
+    }
+
+    (void) unlink(path);
+
+    mask = umask(S_IRWXG | S_IRWXO);
+    ret = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    (void) umask(mask);
+
+    if (ret != 0)
+    {
+        JSE_ERROR("bind(\"%s\") failed: %s", path, strerror(errno))
+        close(fd);
+        return -1;
+    }
+
+    if (chmod(path, S_IRUSR | S_IWUSR) != 0)
+    {
+        JSE_ERROR("chmod(\"%s\") failed: %s", path, strerror(errno))
+        close(fd);
+        (void) unlink(path);
+        return -1;
+    }
+
+    if (listen(fd, LISTEN_BACKLOG) != 0)
+    {
+        JSE_ERROR("listen(\"%s\") failed: %s", path, strerror(errno))
+        close(fd);
+        (void) unlink(path);
+        return -1;
+    }
+
+    return fd;
+}
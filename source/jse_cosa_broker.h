@@ -0,0 +1,201 @@
+/*****************************************************************************
+*
+* Copyright 2020 Liberty Global B.V.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*****************************************************************************/
+
+#ifndef JSE_COSA_BROKER_H
+#define JSE_COSA_BROKER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/** The default path of the jse-cosad socket */
+#define JSE_COSA_BROKER_DEFAULT_SOCKET "/var/run/jse/cosad.sock"
+
+/** The maximum size of a message */
+#define JSE_COSA_BROKER_MAX_MESSAGE (1024 * 1024)
+
+/**
+ * The requests.
+ *
+ * Each message is a 32 bit length followed by that many bytes. A request
+ * starts with the operation and a response with the CCSP status. The
+ * fields that follow are 32 bit integers and strings, each a 32 bit
+ * length, -1 for NULL, followed by that many bytes. All in host byte
+ * order as both ends are on the same host.
+ */
+enum jse_cosa_broker_op_e
+{
+    /** prefix, name -> status, component, path */
+    JSE_COSA_BROKER_DISCOVER = 1,
+    /** prefix, name -> status */
+    JSE_COSA_BROKER_INVALIDATE,
+    /** prefix, component, path, count, names -> status, count, (name, value, type)s */
+    JSE_COSA_BROKER_GET,
+    /** prefix, component, path, commit, count, (name, value, type)s -> status, fault name */
+    JSE_COSA_BROKER_SET,
+    /** component, path, commit -> status */
+    JSE_COSA_BROKER_COMMIT,
+    /** component, path, name -> status, count, instances */
+    JSE_COSA_BROKER_INSTANCES,
+    /** prefix, component, path, name -> status, instance */
+    JSE_COSA_BROKER_ADD_ROW,
+    /** prefix, component, path, name -> status */
+    JSE_COSA_BROKER_DELETE_ROW,
+    /** prefix, count, names -> status, count, types, -1 if not cached */
+    JSE_COSA_BROKER_TYPES
+};
+
+/** A message being built or parsed */
+struct jse_cosa_broker_msg_s
+{
+    /** The message data */
+    unsigned char * data;
+    /** The length of the message */
+    size_t length;
+    /** The size of the buffer */
+    size_t size;
+    /** The offset of the next field to parse */
+    size_t offset;
+    /** Set if a field could not be added or parsed */
+    bool error;
+};
+
+/** The message type */
+typedef struct jse_cosa_broker_msg_s jse_cosa_broker_msg_t;
+
+/**
+ * @brief Empties a message keeping its buffer.
+ *
+ * @param msg the message.
+ */
+void jse_cosa_broker_msg_reset(jse_cosa_broker_msg_t * msg);
+
+/**
+ * @brief Frees the buffer of a message.
+ *
+ * @param msg the message.
+ */
+void jse_cosa_broker_msg_free(jse_cosa_broker_msg_t * msg);
+
+/**
+ * @brief Adds an integer to a message.
+ *
+ * @param msg the message.
+ * @param value the value.
+ */
+void jse_cosa_broker_put_int(jse_cosa_broker_msg_t * msg, int32_t value);
+
+/**
+ * @brief Adds a string to a message.
+ *
+ * @param msg the message.
+ * @param str the string or NULL.
+ */
+void jse_cosa_broker_put_string(jse_cosa_broker_msg_t * msg, const char * str);
+
+/**
+ * @brief Parses an integer from a message.
+ *
+ * @param msg the message.
+ * @return the value or 0 on error.
+ */
+int32_t jse_cosa_broker_get_int(jse_cosa_broker_msg_t * msg);
+
+/**
+ * @brief Parses a string from a message.
+ *
+ * @param msg the message.
+ * @return a copy of the string, which must be freed, or NULL if the
+ * string is NULL or on error.
+ */
+char * jse_cosa_broker_get_string(jse_cosa_broker_msg_t * msg);
+
+/**
+ * @brief Sends a message.
+ *
+ * @param fd the socket.
+ * @param msg the message.
+ * @return 0 on success or -1 on error.
+ */
+int jse_cosa_broker_send(int fd, const jse_cosa_broker_msg_t * msg);
+
+/**
+ * @brief Receives a message.
+ *
+ * @param fd the socket.
+ * @param msg the message, which is reset first.
+ * @return 0 on success or -1 on error or end of file.
+ */
+int jse_cosa_broker_receive(int fd, jse_cosa_broker_msg_t * msg);
+
+/**
+ * @brief Sets the receive and send timeouts of a socket.
+ *
+ * A read or write that takes longer fails with errno set to EAGAIN.
+ *
+ * @param fd the socket.
+ * @param timeout_msec the timeout in milliseconds, 0 to clear it.
+ * @return 0 on success or -1 on error.
+ */
+int jse_cosa_broker_set_timeout(int fd, long timeout_msec);
+
+/**
+ * @brief Checks the user at the other end of a socket.
+ *
+ * The peer must be running as our effective user or, if allowed, as root.
+ *
+ * @param fd the connected socket.
+ * @param allow_root true to accept root as well as our own user.
+ * @return true if the peer is trusted.
+ */
+bool jse_cosa_broker_check_peer(int fd, bool allow_root);
+
+/**
+ * @brief Connects to the jse-cosad socket.
+ *
+ * The daemon must be running as our user or root. If a timeout is given,
+ * sending or receiving fails with errno set to EAGAIN once it passes.
+ *
+ * @param path the socket path.
+ * @param timeout_msec the time to wait to send or receive, 0 to wait as
+ * long as it takes.
+ * @return the socket or -1 on error.
+ */
+int jse_cosa_broker_connect(const char * path, long timeout_msec);
+
+/**
+ * @brief Creates the jse-cosad socket and listens on it.
+ *
+ * The directory holding the socket is created if needed and must be owned
+ * by us and not writable by others. Any existing socket file is replaced
+ * and the new one may only be used by our user.
+ *
+ * @param path the socket path.
+ * @return the socket or -1 on error.
+ */
+int jse_cosa_broker_listen(const char * path);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
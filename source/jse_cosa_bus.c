@@ -0,0 +1,1703 @@
+/*
+ If not stated otherwise in this file or this component's Licenses.txt file the
+ following copyright and licenses apply:
+
+ Copyright 2018 RDK Management
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "jse_debug.h"
+#include "jse_common.h"
+#include "jse_stats.h"
+#include "jse_cosa_cache.h"
+#include "jse_cosa_broker.h"
+#include "jse_cosa_pool.h"
+#include "jse_cosa_guard.h"
+#include "jse_cosa_backend.h"
+#include "jse_cosa_trace.h"
+#include "jse_cosa_bus.h"
+
+/** The jse-cosad socket path or NULL to not use it */
+static const char *broker_path = JSE_COSA_BROKER_DEFAULT_SOCKET;
+
+/** The jse-cosad socket or -1 if not connected */
+static int broker_fd = -1;
+
+/** The jse-cosad request and response */
+static jse_cosa_broker_msg_t broker_msg;
+
+/** Whether the jse-cosad request may be timed out */
+static bool broker_timed = false;
+
+/** The timeout set on the jse-cosad socket */
+static long broker_fd_timeout_msec = 0;
+
+/** The backend to use instead of jse-cosad and the message bus, if any */
+static const jse_cosa_backend_t *chosen_backend = NULL;
+
+/** The backend in use or NULL if not initialised */
+static const jse_cosa_backend_t *backend = NULL;
+
+/** Set if the backend in use is jse-cosad */
+static bool broker_in_use = false;
+
+/** The file to record backend calls to or NULL to not record them */
+static const char *record_path = NULL;
+
+/** The backend calls */
+enum backend_call_op_e
+{
+    CALL_DISCOVER,
+    CALL_GET_VALUES,
+    CALL_SET_VALUES,
+    CALL_SET_COMMIT,
+    CALL_GET_INSTANCES,
+    CALL_ADD_ROW,
+    CALL_DELETE_ROW
+};
+
+/** A backend call, its arguments and its results */
+typedef struct backend_call_s
+{
+    enum backend_call_op_e op;
+    const jse_cosa_backend_t *pBackend;
+
+    /* The arguments used by the call */
+    char *pSystemPrefix;
+    char *pComponent;
+    char *pPath;
+    char *pObjName;
+    char **ppNames;
+    parameterValStruct_t *pVals;
+    int count;
+    bool commit;
+
+    /* The results */
+    int status;
+    int valCount;
+    parameterValStruct_t **ppVals;
+    char *pFaultName;
+    char *pDestComponent;
+    char *pDestPath;
+    unsigned int instCount;
+    unsigned int *pInstances;
+    int instance;
+
+    /* Set when the call returns, or when the caller gives up waiting */
+    bool done;
+    bool abandoned;
+} backend_call_t;
+
+/** The time to wait for a backend call, 0 to wait as long as it takes */
+static long call_timeout_msec = 0;
+
+/** Protects the calls made with a deadline */
+static pthread_mutex_t deadline_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Signalled when a call made with a deadline returns */
+static pthread_cond_t deadline_cond = PTHREAD_COND_INITIALIZER;
+
+/** The number of calls that timed out and have not yet returned */
+static int abandoned_calls = 0;
+
+
+/**
+ * @brief Starts a jse-cosad request.
+ *
+ * @param op the operation.
+ */
+static void BrokerStart(enum jse_cosa_broker_op_e op)
+{
+    /* Writes are left to finish however long they take, as for the bus */
+    broker_timed = op != JSE_COSA_BROKER_SET && op != JSE_COSA_BROKER_COMMIT &&
+        op != JSE_COSA_BROKER_ADD_ROW && op != JSE_COSA_BROKER_DELETE_ROW;
+
+    jse_cosa_broker_msg_reset(&broker_msg);
+    jse_cosa_broker_put_int(&broker_msg, (int32_t)op);
+}
+
+/**
+ * @brief Sends the request to jse-cosad and receives the response.
+ *
+ * If jse-cosad has restarted since the last request the request is sent
+ * again on a new connection. The response is left in broker_msg.
+ *
+ * @return the status in the response or an error status.
+ */
+static int BrokerCall(void)
+{
+    long timeout_msec = broker_timed ? call_timeout_msec : 0;
+    int attempt;
+    int status;
+
+    for (attempt = 0; attempt < 2; attempt++)
+    {
+        bool reconnected = false;
+
+        if (broker_fd == -1)
+        {
+            broker_fd = jse_cosa_broker_connect(broker_path, timeout_msec);
+            if (broker_fd == -1)
+            {
+                JSE_WARNING("jse-cosad is not running!")
+                jse_stats_add("cosa.broker.error", 1);
+                return CCSP_ERR_NOT_CONNECT;
+            }
+
+            broker_fd_timeout_msec = timeout_msec;
+            reconnected = true;
+        }
+        else if (broker_fd_timeout_msec != timeout_msec &&
+            jse_cosa_broker_set_timeout(broker_fd, timeout_msec) == 0)
+        {
+            broker_fd_timeout_msec = timeout_msec;
+        }
+
+        if (jse_cosa_broker_send(broker_fd, &broker_msg) == 0)
+        {
+            break;
+        }
+
+        close(broker_fd);
+        broker_fd = -1;
+
+        /* Only a failed send on an old connection is worth retrying */
+        if (reconnected)
+        {
+            jse_stats_add("cosa.broker.error", 1);
+            return CCSP_ERR_NOT_CONNECT;
+        }
+    }
+
+    /* The request and response share the buffer */
+    if (jse_cosa_broker_receive(broker_fd, &broker_msg) != 0)
+    {
+        /* A late response would be taken for the next one so reconnect */
+        bool timedOut = errno == EAGAIN || errno == EWOULDBLOCK;
+
+        close(broker_fd);
+        broker_fd = -1;
+        jse_stats_add("cosa.broker.error", 1);
+
+        if (timedOut)
+        {
+            JSE_ERROR("jse-cosad request timed out after %ld ms", call_timeout_msec)
+            return CCSP_ERR_TIMEOUT;
+        }
+
+        JSE_WARNING("Lost the connection to jse-cosad!")
+        return CCSP_ERR_NOT_CONNECT;
+    }
+
+    jse_stats_add("cosa.broker.request", 1);
+
+    status = jse_cosa_broker_get_int(&broker_msg);
+
+    return broker_msg.error ? CCSP_FAILURE : status;
+}
+
+/**
+ * @brief Locates the component supporting a name through jse-cosad.
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param pObjName object name
+ * @param ppDestComponentName pointer to dest component name
+ * @param ppDestPath pointer to component dbus path
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int BrokerDiscover(const char *pSystemPrefix, char *pObjName, char **ppDestComponentName, char **ppDestPath)
+{
+    int ret;
+
+    BrokerStart(JSE_COSA_BROKER_DISCOVER);
+    jse_cosa_broker_put_string(&broker_msg, pSystemPrefix);
+    jse_cosa_broker_put_string(&broker_msg, pObjName);
+
+    ret = BrokerCall();
+    if (ret == CCSP_SUCCESS)
+    {
+        *ppDestComponentName = jse_cosa_broker_get_string(&broker_msg);
+        *ppDestPath = jse_cosa_broker_get_string(&broker_msg);
+        if (*ppDestComponentName == NULL || *ppDestPath == NULL)
+        {
+            free(*ppDestComponentName);
+            free(*ppDestPath);
+            ret = CCSP_FAILURE;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Tells jse-cosad to forget the cached component for a name.
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param pObjName object name
+ */
+static void BrokerInvalidate(const char *pSystemPrefix, const char *pObjName)
+{
+    BrokerStart(JSE_COSA_BROKER_INVALIDATE);
+    jse_cosa_broker_put_string(&broker_msg, pSystemPrefix);
+    jse_cosa_broker_put_string(&broker_msg, pObjName);
+    (void) BrokerCall();
+}
+
+/**
+ * @brief Gets the types of parameters cached by jse-cosad.
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param ppNames the parameter names.
+ * @param count the number of names.
+ * @param pTypes an array of count types to return the types, -1 if not cached.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int BrokerGetTypes(const char *pSystemPrefix, char **ppNames, int count, int *pTypes)
+{
+    int returnStatus = CCSP_SUCCESS;
+    int i;
+
+    BrokerStart(JSE_COSA_BROKER_TYPES);
+    jse_cosa_broker_put_string(&broker_msg, pSystemPrefix);
+    jse_cosa_broker_put_int(&broker_msg, count);
+    for (i = 0; i < count; i++)
+    {
+        jse_cosa_broker_put_string(&broker_msg, ppNames[i]);
+    }
+
+    returnStatus = BrokerCall();
+    if (returnStatus == CCSP_SUCCESS)
+    {
+        if (jse_cosa_broker_get_int(&broker_msg) != count)
+        {
+            return CCSP_FAILURE;
+        }
+
+        for (i = 0; i < count; i++)
+        {
+            pTypes[i] = jse_cosa_broker_get_int(&broker_msg);
+        }
+
+        if (broker_msg.error)
+        {
+            return CCSP_FAILURE;
+        }
+    }
+
+    return returnStatus;
+}
+
+/**
+ * @brief Frees the values returned by BrokerGetValues().
+ *
+ * @param valCount the number of values.
+ * @param ppVals the values.
+ */
+static void BrokerFreeValues(int valCount, parameterValStruct_t **ppVals)
+{
+    int i;
+
+    for (i = 0; i < valCount; i++)
+    {
+        if (ppVals[i] != NULL)
+        {
+            free(ppVals[i]->parameterName);
+            free(ppVals[i]->parameterValue);
+            free(ppVals[i]);
+        }
+    }
+
+    free(ppVals);
+}
+
+/**
+ * @brief Gets parameter values from a component through jse-cosad.
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param pComponent the component name.
+ * @param pPath the component D-Bus path.
+ * @param ppNames the parameter names.
+ * @param count the number of names.
+ * @param pValCount a pointer to return the number of values.
+ * @param pppVals a pointer to return the values.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int BrokerGetValues(const char *pSystemPrefix, const char *pComponent, char *pPath,
+    char **ppNames, int count, int *pValCount, parameterValStruct_t ***pppVals)
+{
+    parameterValStruct_t **ppVals = NULL;
+    int returnStatus;
+    int valCount;
+    int i;
+
+    *pValCount = 0;
+    *pppVals = NULL;
+
+    BrokerStart(JSE_COSA_BROKER_GET);
+    jse_cosa_broker_put_string(&broker_msg, pSystemPrefix);
+    jse_cosa_broker_put_string(&broker_msg, pComponent);
+    jse_cosa_broker_put_string(&broker_msg, pPath);
+    jse_cosa_broker_put_int(&broker_msg, count);
+    for (i = 0; i < count; i++)
+    {
+        jse_cosa_broker_put_string(&broker_msg, ppNames[i]);
+    }
+
+    returnStatus = BrokerCall();
+    if (returnStatus != CCSP_SUCCESS)
+    {
+        return returnStatus;
+    }
+
+    valCount = jse_cosa_broker_get_int(&broker_msg);
+    if (broker_msg.error || valCount < 0)
+    {
+        return CCSP_FAILURE;
+    }
+
+    ppVals = (parameterValStruct_t **)calloc(valCount > 0 ? valCount : 1, sizeof(parameterValStruct_t *));
+    if (ppVals == NULL)
+    {
+        JSE_ERROR("calloc() failed: %s", strerror(errno))
+        return CCSP_ERR_MEMORY_ALLOC_FAIL;
+    }
+
+    for (i = 0; i < valCount; i++)
+    {
+        ppVals[i] = (parameterValStruct_t *)calloc(1, sizeof(parameterValStruct_t));
+        if (ppVals[i] == NULL)
+        {
+            JSE_ERROR("calloc() failed: %s", strerror(errno))
+            break;
+        }
+
+        ppVals[i]->parameterName = jse_cosa_broker_get_string(&broker_msg);
+        ppVals[i]->parameterValue = jse_cosa_broker_get_string(&broker_msg);
+        ppVals[i]->type = (enum dataType_e)jse_cosa_broker_get_int(&broker_msg);
+
+        if (broker_msg.error || ppVals[i]->parameterName == NULL || ppVals[i]->parameterValue == NULL)
+        {
+            /* Freed below */
+            i++;
+            break;
+        }
+    }
+
+    if (i < valCount || broker_msg.error)
+    {
+        BrokerFreeValues(i, ppVals);
+        return CCSP_FAILURE;
+    }
+
+    *pValCount = valCount;
+    *pppVals = ppVals;
+
+    return CCSP_SUCCESS;
+}
+
+/**
+ * @brief Sets parameter values of a component through jse-cosad.
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param pComponent the component name.
+ * @param pPath the component D-Bus path.
+ * @param pVals the values.
+ * @param count the number of values.
+ * @param commit set true to commit the values.
+ * @param ppFaultName a pointer to return the name of a rejected parameter.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int BrokerSetValues(const char *pSystemPrefix, const char *pComponent, char *pPath,
+    parameterValStruct_t *pVals, int count, bool commit, char **ppFaultName)
+{
+    int returnStatus;
+    int i;
+
+    BrokerStart(JSE_COSA_BROKER_SET);
+    jse_cosa_broker_put_string(&broker_msg, pSystemPrefix);
+    jse_cosa_broker_put_string(&broker_msg, pComponent);
+    jse_cosa_broker_put_string(&broker_msg, pPath);
+    jse_cosa_broker_put_int(&broker_msg, commit ? 1 : 0);
+    jse_cosa_broker_put_int(&broker_msg, count);
+    for (i = 0; i < count; i++)
+    {
+        jse_cosa_broker_put_string(&broker_msg, pVals[i].parameterName);
+        jse_cosa_broker_put_string(&broker_msg, pVals[i].parameterValue);
+        jse_cosa_broker_put_int(&broker_msg, (int32_t)pVals[i].type);
+    }
+
+    returnStatus = BrokerCall();
+    if (returnStatus != CCSP_SUCCESS && returnStatus != CCSP_ERR_NOT_CONNECT)
+    {
+        *ppFaultName = jse_cosa_broker_get_string(&broker_msg);
+    }
+
+    return returnStatus;
+}
+
+/**
+ * @brief Commits or discards the values set on a component through jse-cosad.
+ *
+ * @param pComponent the component name.
+ * @param pPath the component D-Bus path.
+ * @param commit set true to commit, false to discard.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int BrokerSetCommit(const char *pComponent, char *pPath, bool commit)
+{
+    BrokerStart(JSE_COSA_BROKER_COMMIT);
+    jse_cosa_broker_put_string(&broker_msg, pComponent);
+    jse_cosa_broker_put_string(&broker_msg, pPath);
+    jse_cosa_broker_put_int(&broker_msg, commit ? 1 : 0);
+
+    return BrokerCall();
+}
+
+/**
+ * @brief Gets the instance numbers of a table through jse-cosad.
+ *
+ * @param pComponent the component name.
+ * @param pPath the component D-Bus path.
+ * @param pObjName the table name.
+ * @param pCount a pointer to return the number of instances.
+ * @param ppInstances a pointer to return the instance numbers, which must be freed.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int BrokerGetInstances(const char *pComponent, char *pPath, char *pObjName,
+    unsigned int *pCount, unsigned int **ppInstances)
+{
+    unsigned int *pInstances = NULL;
+    int returnStatus;
+    int count;
+    int i;
+
+    *pCount = 0;
+    *ppInstances = NULL;
+
+    BrokerStart(JSE_COSA_BROKER_INSTANCES);
+    jse_cosa_broker_put_string(&broker_msg, pComponent);
+    jse_cosa_broker_put_string(&broker_msg, pPath);
+    jse_cosa_broker_put_string(&broker_msg, pObjName);
+
+    returnStatus = BrokerCall();
+    if (returnStatus != CCSP_SUCCESS)
+    {
+        return returnStatus;
+    }
+
+    count = jse_cosa_broker_get_int(&broker_msg);
+    if (broker_msg.error || count < 0)
+    {
+        return CCSP_FAILURE;
+    }
+
+    if (count > 0)
+    {
+        pInstances = (unsigned int *)calloc(count, sizeof(unsigned int));
+        if (pInstances == NULL)
+        {
+            JSE_ERROR("calloc() failed: %s", strerror(errno))
+            return CCSP_ERR_MEMORY_ALLOC_FAIL;
+        }
+
+        for (i = 0; i < count; i++)
+        {
+            pInstances[i] = (unsigned int)jse_cosa_broker_get_int(&broker_msg);
+        }
+
+        if (broker_msg.error)
+        {
+            free(pInstances);
+            return CCSP_FAILURE;
+        }
+    }
+
+    *pCount = (unsigned int)count;
+    *ppInstances = pInstances;
+
+    return CCSP_SUCCESS;
+}
+
+/**
+ * @brief Adds a row to a table through jse-cosad.
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param pComponent the component name.
+ * @param pPath the component D-Bus path.
+ * @param pObjName the table name.
+ * @param pInstance a pointer to return the instance number.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int BrokerAddRow(const char *pSystemPrefix, const char *pComponent, char *pPath, char *pObjName, int *pInstance)
+{
+    int returnStatus;
+
+    BrokerStart(JSE_COSA_BROKER_ADD_ROW);
+    jse_cosa_broker_put_string(&broker_msg, pSystemPrefix);
+    jse_cosa_broker_put_string(&broker_msg, pComponent);
+    jse_cosa_broker_put_string(&broker_msg, pPath);
+    jse_cosa_broker_put_string(&broker_msg, pObjName);
+
+    returnStatus = BrokerCall();
+    if (returnStatus == CCSP_SUCCESS)
+    {
+        *pInstance = jse_cosa_broker_get_int(&broker_msg);
+        if (broker_msg.error)
+        {
+            returnStatus = CCSP_FAILURE;
+        }
+    }
+
+    return returnStatus;
+}
+
+/**
+ * @brief Deletes a row from a table through jse-cosad.
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param pComponent the component name.
+ * @param pPath the component D-Bus path.
+ * @param pObjName the row name.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int BrokerDeleteRow(const char *pSystemPrefix, const char *pComponent, char *pPath, char *pObjName)
+{
+    BrokerStart(JSE_COSA_BROKER_DELETE_ROW);
+    jse_cosa_broker_put_string(&broker_msg, pSystemPrefix);
+    jse_cosa_broker_put_string(&broker_msg, pComponent);
+    jse_cosa_broker_put_string(&broker_msg, pPath);
+    jse_cosa_broker_put_string(&broker_msg, pObjName);
+
+    return BrokerCall();
+}
+
+/**
+ * @brief Connects to jse-cosad.
+ *
+ * @return 0 on success or -1 if jse-cosad is not running.
+ */
+static int BrokerInit(void)
+{
+    broker_fd = jse_cosa_broker_connect(broker_path, call_timeout_msec);
+    if (broker_fd == -1)
+    {
+        return -1;
+    }
+
+    broker_fd_timeout_msec = call_timeout_msec;
+
+    JSE_INFO("COSA using jse-cosad: %s", broker_path)
+    return 0;
+}
+
+/**
+ * @brief Disconnects from jse-cosad.
+ */
+static void BrokerShutdown(void)
+{
+    if (broker_fd != -1)
+    {
+        close(broker_fd);
+        broker_fd = -1;
+    }
+
+    jse_cosa_broker_msg_free(&broker_msg);
+}
+
+/** jse-cosad, which serves one request at a time */
+static const jse_cosa_backend_t broker_backend = {
+    "jse-cosad",
+    false,
+    BrokerInit,
+    BrokerShutdown,
+    BrokerDiscover,
+    BrokerInvalidate,
+    BrokerGetTypes,
+    BrokerGetValues,
+    BrokerFreeValues,
+    BrokerSetValues,
+    BrokerSetCommit,
+    BrokerGetInstances,
+    BrokerAddRow,
+    BrokerDeleteRow
+};
+
+/**
+ * @brief Parse and set DM subsystem prefix.
+ *
+ * @param ppDotStr pointer to COSA dotstr
+ * @param pSubSystemPrefix subsystem string, e.g. eRT.
+ * @return void.
+ */
+void jse_cosa_bus_split_prefix(char **ppDotStr, char *pSubSystemPrefix)
+{
+    if (!strncmp(*ppDotStr, "eRT", 3)) /* check whether str has prex of eRT */
+    {
+        /* Replace strncpy() to prevent compiler warnings */
+        pSubSystemPrefix[0] = 'e';
+        pSubSystemPrefix[1] = 'R';
+        pSubSystemPrefix[2] = 'T';
+        pSubSystemPrefix[3] = '.';
+        *ppDotStr += 4; /* shift four bytes to get rid of eRT: */
+    }
+    else if (!strncmp(*ppDotStr, "eMG", 3)) /* check wither str has prex of eMG */
+    {
+        /* Replace strncpy() to prevent compiler warnings */
+        pSubSystemPrefix[0] = 'e';
+        pSubSystemPrefix[1] = 'M';
+        pSubSystemPrefix[2] = 'G';
+        pSubSystemPrefix[3] = '.';
+        *ppDotStr += 4; /* shift four bytes to get rid of eMG; */
+    }
+}
+
+/** The names of the data types as used by DmExtSetStrsWithRootObj() */
+static const struct
+{
+    const char *name;
+    enum dataType_e type;
+} type_names[] = {
+    {"void", ccsp_none},
+    {"string", ccsp_string},
+    {"int", ccsp_int},
+    {"uint", ccsp_unsignedInt},
+    {"bool", ccsp_boolean},
+    {"datetime", ccsp_dateTime},
+    {"base64", ccsp_base64},
+    {"long", ccsp_long},
+    {"unlong", ccsp_unsignedLong},
+    {"float", ccsp_float},
+    {"double", ccsp_double},
+    {"byte", ccsp_byte}
+};
+
+/**
+ * @brief Converts a data type name to a data type.
+ *
+ * @param pName the name, e.g. "string".
+ * @param pType a pointer to return the type.
+ * @return 0 on success or -1 if the name is not recognised.
+ */
+int jse_cosa_bus_parse_type(const char *pName, enum dataType_e *pType)
+{
+    size_t i;
+
+    for (i = 0; i < sizeof(type_names) / sizeof(type_names[0]); i++)
+    {
+        if (!strcmp(pName, type_names[i].name))
+        {
+            *pType = type_names[i].type;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Loads a parameter type manifest into the type cache.
+ *
+ * @param filename the manifest filename.
+ * @return 0 on success or -1 on error.
+ */
+int jse_cosa_bus_load_types(const char *filename)
+{
+    FILE *fp = NULL;
+    char line[512];
+    int lineNumber = 0;
+    int count = 0;
+
+    JSE_ENTER("jse_cosa_bus_load_types(\"%s\")", filename)
+
+    fp = fopen(filename, "re");
+    if (fp == NULL)
+    {
+        JSE_ERROR("fopen(\"%s\") failed: %s", filename, strerror(errno))
+        JSE_EXIT("jse_cosa_bus_load_types()=-1")
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        char *pName = NULL;
+        char *pTypeName = NULL;
+        char *pSave = NULL;
+        char *dotstr = NULL;
+        char subSystemPrefix[6] = {0};
+        enum dataType_e type;
+
+        lineNumber++;
+
+        pName = strtok_r(line, " \t\r\n", &pSave);
+        if (pName == NULL || pName[0] == '#')
+        {
+            /* Blank line or comment */
+            continue;
+        }
+
+        pTypeName = strtok_r(NULL, " \t\r\n", &pSave);
+        if (pTypeName == NULL || jse_cosa_bus_parse_type(pTypeName, &type) != 0)
+        {
+            JSE_WARNING("%s:%d: invalid type", filename, lineNumber)
+            continue;
+        }
+
+        dotstr = pName;
+        jse_cosa_bus_split_prefix(&dotstr, subSystemPrefix);
+        jse_cosa_cache_put_type(subSystemPrefix, dotstr, (int)type);
+        count++;
+    }
+
+    fclose(fp);
+
+    JSE_INFO("Loaded %d parameter types from %s", count, filename)
+
+    JSE_EXIT("jse_cosa_bus_load_types()=0")
+    return 0;
+}
+
+/**
+ * @brief Loads the list of hot parameters.
+ *
+ * @param filename the list filename.
+ * @return 0 on success or -1 on error.
+ */
+int jse_cosa_bus_load_hot(const char *filename)
+{
+    FILE *fp = NULL;
+    char line[512];
+    int count = 0;
+
+    JSE_ENTER("jse_cosa_bus_load_hot(\"%s\")", filename)
+
+    fp = fopen(filename, "re");
+    if (fp == NULL)
+    {
+        JSE_ERROR("fopen(\"%s\") failed: %s", filename, strerror(errno))
+        JSE_EXIT("jse_cosa_bus_load_hot()=-1")
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        char *pSave = NULL;
+        char *pName = strtok_r(line, " \t\r\n", &pSave);
+        char subSystemPrefix[6] = {0};
+
+        if (pName == NULL || pName[0] == '#')
+        {
+            /* Blank line or comment */
+            continue;
+        }
+
+        jse_cosa_bus_split_prefix(&pName, subSystemPrefix);
+        if (jse_cosa_cache_add_hot(subSystemPrefix, pName) == 0)
+        {
+            count++;
+        }
+    }
+
+    fclose(fp);
+
+    JSE_INFO("Loaded %d hot parameters from %s", count, filename)
+
+    JSE_EXIT("jse_cosa_bus_load_hot()=0")
+    return 0;
+}
+
+/**
+ * @brief Copies a string.
+ *
+ * @param ppCopy a pointer to return the copy.
+ * @param pStr the string or NULL.
+ * @return true on success.
+ */
+static bool CopyString(char **ppCopy, const char *pStr)
+{
+    *ppCopy = NULL;
+
+    if (pStr != NULL && (*ppCopy = strdup(pStr)) == NULL)
+    {
+        JSE_ERROR("strdup() failed: %s", strerror(errno))
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Frees the arguments of a call copied by CopyCall().
+ *
+ * @param pCall the call.
+ */
+static void FreeCallArguments(backend_call_t *pCall)
+{
+    int i;
+
+    free(pCall->pSystemPrefix);
+    free(pCall->pComponent);
+    free(pCall->pPath);
+    free(pCall->pObjName);
+
+    if (pCall->ppNames != NULL)
+    {
+        for (i = 0; i < pCall->count; i++)
+        {
+            free(pCall->ppNames[i]);
+        }
+        free(pCall->ppNames);
+    }
+}
+
+/**
+ * @brief Frees the results of a call nobody is waiting for.
+ *
+ * @param pCall the call.
+ */
+static void FreeCallResults(backend_call_t *pCall)
+{
+    if (pCall->ppVals != NULL)
+    {
+        pCall->pBackend->free_values(pCall->valCount, pCall->ppVals);
+    }
+
+    free(pCall->pDestComponent);
+    free(pCall->pDestPath);
+    free(pCall->pInstances);
+}
+
+/**
+ * @brief Copies a read call and its arguments, which the caller may free
+ * before the call returns.
+ *
+ * @param pArgs the call.
+ * @return the copy or NULL on error.
+ */
+static backend_call_t *CopyCall(const backend_call_t *pArgs)
+{
+    backend_call_t *pCall = (backend_call_t *)calloc(1, sizeof(backend_call_t));
+    bool ok;
+    int i;
+
+    if (pCall == NULL)
+    {
+        JSE_ERROR("calloc() failed: %s", strerror(errno))
+        return NULL;
+    }
+
+    pCall->op = pArgs->op;
+    pCall->pBackend = pArgs->pBackend;
+    pCall->count = pArgs->count;
+    pCall->commit = pArgs->commit;
+
+    ok = CopyString(&pCall->pSystemPrefix, pArgs->pSystemPrefix) &&
+        CopyString(&pCall->pComponent, pArgs->pComponent) &&
+        CopyString(&pCall->pPath, pArgs->pPath) &&
+        CopyString(&pCall->pObjName, pArgs->pObjName);
+
+    if (ok && pArgs->ppNames != NULL)
+    {
+        pCall->ppNames = (char **)calloc((size_t)pArgs->count, sizeof(char *));
+        ok = pCall->ppNames != NULL;
+
+        for (i = 0; ok && i < pArgs->count; i++)
+        {
+            ok = CopyString(&pCall->ppNames[i], pArgs->ppNames[i]);
+        }
+    }
+
+    if (!ok)
+    {
+        FreeCallArguments(pCall);
+        free(pCall);
+        return NULL;
+    }
+
+    return pCall;
+}
+
+/**
+ * @brief Makes a backend call.
+ *
+ * @param pCall the call, updated with the results.
+ */
+static void DoCall(backend_call_t *pCall)
+{
+    const jse_cosa_backend_t *pBackend = pCall->pBackend;
+
+    switch (pCall->op)
+    {
+        case CALL_DISCOVER:
+            pCall->status = pBackend->discover(pCall->pSystemPrefix, pCall->pObjName,
+                &pCall->pDestComponent, &pCall->pDestPath);
+            break;
+        case CALL_GET_VALUES:
+            pCall->status = pBackend->get_values(pCall->pSystemPrefix, pCall->pComponent, pCall->pPath,
+                pCall->ppNames, pCall->count, &pCall->valCount, &pCall->ppVals);
+            break;
+        case CALL_SET_VALUES:
+            pCall->status = pBackend->set_values(pCall->pSystemPrefix, pCall->pComponent, pCall->pPath,
+                pCall->pVals, pCall->count, pCall->commit, &pCall->pFaultName);
+            break;
+        case CALL_SET_COMMIT:
+            pCall->status = pBackend->set_commit(pCall->pComponent, pCall->pPath, pCall->commit);
+            break;
+        case CALL_GET_INSTANCES:
+            pCall->status = pBackend->get_instances(pCall->pComponent, pCall->pPath, pCall->pObjName,
+                &pCall->instCount, &pCall->pInstances);
+            break;
+        case CALL_ADD_ROW:
+            pCall->status = pBackend->add_row(pCall->pSystemPrefix, pCall->pComponent, pCall->pPath,
+                pCall->pObjName, &pCall->instance);
+            break;
+        case CALL_DELETE_ROW:
+            pCall->status = pBackend->delete_row(pCall->pSystemPrefix, pCall->pComponent, pCall->pPath,
+                pCall->pObjName);
+            break;
+    }
+}
+
+/**
+ * @brief Makes a backend call on a worker thread.
+ *
+ * If the caller has given up waiting the results are freed.
+ *
+ * @param arg the copied call.
+ */
+static void DeadlineTask(void *arg)
+{
+    backend_call_t *pCall = (backend_call_t *)arg;
+    bool abandoned;
+
+    pthread_mutex_lock(&deadline_mutex);
+    abandoned = pCall->abandoned;
+    pthread_mutex_unlock(&deadline_mutex);
+
+    /* Not worth making if the caller gave up before a worker was free */
+    if (!abandoned)
+    {
+        DoCall(pCall);
+    }
+
+    pthread_mutex_lock(&deadline_mutex);
+
+    if (pCall->abandoned)
+    {
+        if (!abandoned)
+        {
+            JSE_WARNING("Late %s call finished: %d", pCall->pComponent != NULL ? pCall->pComponent : "discovery",
+                pCall->status)
+        }
+        FreeCallResults(pCall);
+        FreeCallArguments(pCall);
+        free(pCall);
+        abandoned_calls--;
+    }
+    else
+    {
+        pCall->done = true;
+        pthread_cond_broadcast(&deadline_cond);
+    }
+
+    pthread_mutex_unlock(&deadline_mutex);
+}
+
+/**
+ * @brief Makes a backend call, giving up once the call timeout passes.
+ *
+ * Only reads are timed out, and only with backends that may be called
+ * from several threads at once; jse-cosad requests time out on the socket.
+ * The call is made on a worker thread, with a copy of its arguments, and
+ * left to finish on its own if it takes too long. Writes are always made
+ * here, as one left running could land after the script has moved on.
+ *
+ * May be called on a worker thread so only logs.
+ *
+ * @param pCall the call, updated with the results.
+ * @return the CCSP status, CCSP_ERR_TIMEOUT if the call timed out.
+ */
+static int CallBackend(backend_call_t *pCall)
+{
+    backend_call_t *pCopy = NULL;
+    struct timespec deadline;
+
+    pCall->pBackend = backend;
+
+    if (call_timeout_msec <= 0 || !backend->concurrent ||
+        (pCall->op != CALL_DISCOVER && pCall->op != CALL_GET_VALUES && pCall->op != CALL_GET_INSTANCES) ||
+        (pCopy = CopyCall(pCall)) == NULL)
+    {
+        DoCall(pCall);
+        return pCall->status;
+    }
+
+    if (jse_cosa_pool_submit(DeadlineTask, pCopy) != 0)
+    {
+        FreeCallArguments(pCopy);
+        free(pCopy);
+        DoCall(pCall);
+        return pCall->status;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += call_timeout_msec / 1000;
+    deadline.tv_nsec += (call_timeout_msec % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&deadline_mutex);
+
+    while (!pCopy->done)
+    {
+        if (pthread_cond_timedwait(&deadline_cond, &deadline_mutex, &deadline) == ETIMEDOUT)
+        {
+            break;
+        }
+    }
+
+    if (!pCopy->done)
+    {
+        /* The task frees the call when it finally returns */
+        pCopy->abandoned = true;
+        abandoned_calls++;
+        pthread_mutex_unlock(&deadline_mutex);
+
+        JSE_ERROR("%s call timed out after %ld ms", pCall->pComponent != NULL ? pCall->pComponent : "Discovery",
+            call_timeout_msec)
+        pCall->status = CCSP_ERR_TIMEOUT;
+        return CCSP_ERR_TIMEOUT;
+    }
+
+    pthread_mutex_unlock(&deadline_mutex);
+
+    pCall->status = pCopy->status;
+    pCall->valCount = pCopy->valCount;
+    pCall->ppVals = pCopy->ppVals;
+    pCall->pFaultName = pCopy->pFaultName;
+    pCall->pDestComponent = pCopy->pDestComponent;
+    pCall->pDestPath = pCopy->pDestPath;
+    pCall->instCount = pCopy->instCount;
+    pCall->pInstances = pCopy->pInstances;
+    pCall->instance = pCopy->instance;
+
+    FreeCallArguments(pCopy);
+    free(pCopy);
+
+    return pCall->status;
+}
+
+/**
+ * @brief Locate component for DM key/parameter
+ *
+ * @param pObjName object name
+ * @param ppDestComponentName pointer to dest component name
+ * @param ppDestPath pointer to component dbus path
+ * @param pSystemPrefix subsystem prefix
+ * @return an error status or 0.
+ */
+int jse_cosa_bus_discover(char *pObjName, char **ppDestComponentName, char **ppDestPath, char *pSystemPrefix)
+{
+    int ret;
+
+    if (jse_cosa_cache_get_component(pSystemPrefix, pObjName, ppDestComponentName, ppDestPath) == 0)
+    {
+        return 0;
+    }
+
+    if (backend != NULL)
+    {
+        backend_call_t call = { .op = CALL_DISCOVER, .pSystemPrefix = pSystemPrefix, .pObjName = pObjName };
+
+        ret = CallBackend(&call);
+        *ppDestComponentName = call.pDestComponent;
+        *ppDestPath = call.pDestPath;
+    }
+    else
+    {
+        ret = CCSP_ERR_NOT_CONNECT;
+    }
+
+    if (ret == CCSP_SUCCESS)
+    {
+        jse_cosa_cache_put_component(pSystemPrefix, pObjName, *ppDestComponentName, *ppDestPath);
+        return 0;
+    }
+    else
+    {
+        JSE_ERROR(
+            "Failed to locate the component for %s%s%s, error code = %d!",
+            pSystemPrefix,
+            strlen(pSystemPrefix) ? "." : "",
+            pObjName,
+            ret)
+        return ret;
+    }
+}
+
+/**
+ * @brief Forgets the cached component for a name.
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param pObjName object name
+ */
+void jse_cosa_bus_invalidate(const char *pSystemPrefix, const char *pObjName)
+{
+    jse_cosa_cache_invalidate_component(pSystemPrefix, pObjName);
+
+    if (backend != NULL && backend->invalidate != NULL)
+    {
+        backend->invalidate(pSystemPrefix, pObjName);
+    }
+}
+
+/**
+ * @brief Gets the types of parameters known to the backend.
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param ppNames the parameter names.
+ * @param count the number of names.
+ * @param pTypes an array of count types to return the types, -1 if not known.
+ * @return CCSP_SUCCESS or an error status.
+ */
+int jse_cosa_bus_get_types(const char *pSystemPrefix, char **ppNames, int count, int *pTypes)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        pTypes[i] = -1;
+    }
+
+    if (backend == NULL || backend->get_types == NULL)
+    {
+        /* The caller has already looked in our own cache */
+        return CCSP_SUCCESS;
+    }
+
+    return backend->get_types(pSystemPrefix, ppNames, count, pTypes);
+}
+
+/**
+ * @brief Gets parameter values from a component.
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param pComponent the component name.
+ * @param pPath the component D-Bus path.
+ * @param ppNames the parameter names.
+ * @param count the number of names.
+ * @param pValCount a pointer to return the number of values.
+ * @param pppVals a pointer to return the values, freed by jse_cosa_bus_free_values().
+ * @return CCSP_SUCCESS or an error status.
+ */
+int jse_cosa_bus_get_values(const char *pSystemPrefix, const char *pComponent, char *pPath,
+    char **ppNames, int count, int *pValCount, parameterValStruct_t ***pppVals)
+{
+    backend_call_t call = {
+        .op = CALL_GET_VALUES,
+        .pSystemPrefix = (char *)pSystemPrefix,
+        .pComponent = (char *)pComponent,
+        .pPath = pPath,
+        .ppNames = ppNames,
+        .count = count
+    };
+    int status;
+
+    if (backend == NULL)
+    {
+        return CCSP_ERR_NOT_CONNECT;
+    }
+
+    if ((status = jse_cosa_guard_allow(pComponent)) != CCSP_SUCCESS)
+    {
+        return status;
+    }
+
+    status = CallBackend(&call);
+    jse_cosa_guard_report(pComponent, status);
+
+    *pValCount = call.valCount;
+    *pppVals = call.ppVals;
+
+    return status;
+}
+
+/**
+ * @brief Gets the values of one request of a batch.
+ *
+ * May run on a worker thread so only calls the backend.
+ *
+ * @param arg the request.
+ */
+static void GetValuesTask(void *arg)
+{
+    jse_cosa_bus_get_t *pGet = (jse_cosa_bus_get_t *)arg;
+    uint64_t start = jse_time_usec();
+    backend_call_t call = {
+        .op = CALL_GET_VALUES,
+        .pSystemPrefix = (char *)pGet->pSystemPrefix,
+        .pComponent = (char *)pGet->pComponent,
+        .pPath = pGet->pPath,
+        .ppNames = pGet->ppNames,
+        .count = pGet->count
+    };
+
+    if (pGet->status != CCSP_SUCCESS)
+    {
+        /* Rejected by the component's breaker */
+        return;
+    }
+
+    pGet->status = CallBackend(&call);
+    pGet->valCount = call.valCount;
+    pGet->ppVals = call.ppVals;
+
+    pGet->usec = jse_time_usec() - start;
+}
+
+/**
+ * @brief Gets parameter values from several components at once.
+ *
+ * @param pGets the requests.
+ * @param count the number of requests.
+ */
+void jse_cosa_bus_get_values_many(jse_cosa_bus_get_t *pGets, int count)
+{
+    uint64_t start = jse_time_usec();
+    uint64_t serial = 0;
+    uint64_t elapsed;
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        pGets[i].valCount = 0;
+        pGets[i].ppVals = NULL;
+        pGets[i].status = backend != NULL ? jse_cosa_guard_allow(pGets[i].pComponent) : CCSP_ERR_NOT_CONNECT;
+        pGets[i].usec = 0;
+    }
+
+    if (backend == NULL)
+    {
+        return;
+    }
+
+    if (backend->concurrent)
+    {
+        jse_cosa_pool_run(GetValuesTask, pGets, sizeof(jse_cosa_bus_get_t), count);
+    }
+    else
+    {
+        /* e.g. jse-cosad answers one request at a time */
+        for (i = 0; i < count; i++)
+        {
+            GetValuesTask(&pGets[i]);
+        }
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (pGets[i].status != JSE_COSA_ERR_CIRCUIT_OPEN)
+        {
+            jse_cosa_guard_report(pGets[i].pComponent, pGets[i].status);
+        }
+    }
+
+    if (!backend->concurrent)
+    {
+        return;
+    }
+
+    if (count > 1)
+    {
+        elapsed = jse_time_usec() - start;
+
+        for (i = 0; i < count; i++)
+        {
+            serial += pGets[i].usec;
+        }
+
+        JSE_DEBUG("%d components in %lu us, %lu us one after another",
+            count, (unsigned long)elapsed, (unsigned long)serial)
+
+        jse_stats_add("cosa.fanout.batch", 1);
+        jse_stats_add("cosa.fanout.usec", (long)elapsed);
+        jse_stats_add("cosa.fanout.saved_usec", serial > elapsed ? (long)(serial - elapsed) : 0);
+    }
+}
+
+/**
+ * @brief Frees the values returned by jse_cosa_bus_get_values().
+ *
+ * @param valCount the number of values.
+ * @param ppVals the values.
+ */
+void jse_cosa_bus_free_values(int valCount, parameterValStruct_t **ppVals)
+{
+    if (backend != NULL && ppVals != NULL)
+    {
+        backend->free_values(valCount, ppVals);
+    }
+}
+
+/**
+ * @brief Sets parameter values of a component.
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param pComponent the component name.
+ * @param pPath the component D-Bus path.
+ * @param pVals the values.
+ * @param count the number of values.
+ * @param commit set true to commit the values.
+ * @param ppFaultName a pointer to return the name of a rejected parameter, which must be freed.
+ * @return CCSP_SUCCESS or an error status.
+ */
+int jse_cosa_bus_set_values(const char *pSystemPrefix, const char *pComponent, char *pPath,
+    parameterValStruct_t *pVals, int count, bool commit, char **ppFaultName)
+{
+    backend_call_t call = {
+        .op = CALL_SET_VALUES,
+        .pSystemPrefix = (char *)pSystemPrefix,
+        .pComponent = (char *)pComponent,
+        .pPath = pPath,
+        .pVals = pVals,
+        .count = count,
+        .commit = commit
+    };
+    int status;
+
+    if (backend == NULL)
+    {
+        return CCSP_ERR_NOT_CONNECT;
+    }
+
+    if ((status = jse_cosa_guard_allow(pComponent)) != CCSP_SUCCESS)
+    {
+        return status;
+    }
+
+    status = CallBackend(&call);
+    jse_cosa_guard_report(pComponent, status);
+
+    if (ppFaultName != NULL)
+    {
+        *ppFaultName = call.pFaultName;
+    }
+    else
+    {
+        free(call.pFaultName);
+    }
+
+    return status;
+}
+
+/**
+ * @brief Commits or discards the values set on a component.
+ *
+ * @param pComponent the component name.
+ * @param pPath the component D-Bus path.
+ * @param commit set true to commit, false to discard.
+ * @return CCSP_SUCCESS or an error status.
+ */
+int jse_cosa_bus_set_commit(const char *pComponent, char *pPath, bool commit)
+{
+    backend_call_t call = { .op = CALL_SET_COMMIT, .pComponent = (char *)pComponent, .pPath = pPath, .commit = commit };
+    int status;
+
+    if (backend == NULL)
+    {
+        return CCSP_ERR_NOT_CONNECT;
+    }
+
+    if ((status = jse_cosa_guard_allow(pComponent)) != CCSP_SUCCESS)
+    {
+        return status;
+    }
+
+    status = CallBackend(&call);
+    jse_cosa_guard_report(pComponent, status);
+
+    return status;
+}
+
+/**
+ * @brief Gets the instance numbers of a table.
+ *
+ * @param pComponent the component name.
+ * @param pPath the component D-Bus path.
+ * @param pObjName the table name.
+ * @param pCount a pointer to return the number of instances.
+ * @param ppInstances a pointer to return the instance numbers, which must be freed.
+ * @return CCSP_SUCCESS or an error status.
+ */
+int jse_cosa_bus_get_instances(const char *pComponent, char *pPath, char *pObjName,
+    unsigned int *pCount, unsigned int **ppInstances)
+{
+    backend_call_t call = { .op = CALL_GET_INSTANCES, .pComponent = (char *)pComponent, .pPath = pPath, .pObjName = pObjName };
+    int status;
+
+    if (backend == NULL)
+    {
+        return CCSP_ERR_NOT_CONNECT;
+    }
+
+    if ((status = jse_cosa_guard_allow(pComponent)) != CCSP_SUCCESS)
+    {
+        return status;
+    }
+
+    status = CallBackend(&call);
+    jse_cosa_guard_report(pComponent, status);
+
+    *pCount = call.instCount;
+    *ppInstances = call.pInstances;
+
+    return status;
+}
+
+/**
+ * @brief Adds a row to a table.
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param pComponent the component name.
+ * @param pPath the component D-Bus path.
+ * @param pObjName the table name.
+ * @param pInstance a pointer to return the instance number.
+ * @return CCSP_SUCCESS or an error status.
+ */
+int jse_cosa_bus_add_row(const char *pSystemPrefix, const char *pComponent, char *pPath, char *pObjName, int *pInstance)
+{
+    backend_call_t call = {
+        .op = CALL_ADD_ROW,
+        .pSystemPrefix = (char *)pSystemPrefix,
+        .pComponent = (char *)pComponent,
+        .pPath = pPath,
+        .pObjName = pObjName
+    };
+    int status;
+
+    if (backend == NULL)
+    {
+        return CCSP_ERR_NOT_CONNECT;
+    }
+
+    if ((status = jse_cosa_guard_allow(pComponent)) != CCSP_SUCCESS)
+    {
+        return status;
+    }
+
+    status = CallBackend(&call);
+    jse_cosa_guard_report(pComponent, status);
+
+    *pInstance = call.instance;
+
+    return status;
+}
+
+/**
+ * @brief Deletes a row from a table.
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param pComponent the component name.
+ * @param pPath the component D-Bus path.
+ * @param pObjName the row name.
+ * @return CCSP_SUCCESS or an error status.
+ */
+int jse_cosa_bus_delete_row(const char *pSystemPrefix, const char *pComponent, char *pPath, char *pObjName)
+{
+    backend_call_t call = {
+        .op = CALL_DELETE_ROW,
+        .pSystemPrefix = (char *)pSystemPrefix,
+        .pComponent = (char *)pComponent,
+        .pPath = pPath,
+        .pObjName = pObjName
+    };
+    int status;
+
+    if (backend == NULL)
+    {
+        return CCSP_ERR_NOT_CONNECT;
+    }
+
+    if ((status = jse_cosa_guard_allow(pComponent)) != CCSP_SUCCESS)
+    {
+        return status;
+    }
+
+    status = CallBackend(&call);
+    jse_cosa_guard_report(pComponent, status);
+
+    return status;
+}
+
+/**
+ * @brief Sets the jse-cosad socket used instead of the message bus.
+ *
+ * @param path the socket path or NULL to always use the message bus.
+ */
+void jse_cosa_bus_set_broker(const char *path)
+{
+    broker_path = path;
+}
+
+/**
+ * @brief Sets the time to wait for each backend call.
+ *
+ * @param msec the time in milliseconds, 0 to wait as long as the call takes.
+ */
+void jse_cosa_bus_set_timeout(long msec)
+{
+    call_timeout_msec = msec > 0 ? msec : 0;
+}
+
+/**
+ * @brief Sets the backend to use instead of jse-cosad or the message bus.
+ *
+ * @param pBackend the backend or NULL for the default.
+ */
+void jse_cosa_bus_set_backend(const jse_cosa_backend_t *pBackend)
+{
+    chosen_backend = pBackend;
+}
+
+/**
+ * @brief Sets the file to record every backend call to.
+ *
+ * @param filename the trace filename or NULL to not record calls.
+ */
+void jse_cosa_bus_set_record(const char *filename)
+{
+    record_path = filename;
+}
+
+/**
+ * @brief Returns whether requests go through jse-cosad.
+ *
+ * @return true if connected to jse-cosad.
+ */
+bool jse_cosa_bus_is_broker(void)
+{
+    return broker_in_use;
+}
+
+/**
+ * @brief Initialises the backend.
+ *
+ * Uses the backend set by jse_cosa_bus_set_backend() if any, otherwise
+ * jse-cosad if it is running, otherwise rbus or the CCSP message bus.
+ *
+ * @return an error status or 0.
+ */
+int jse_cosa_bus_init(void)
+{
+    const jse_cosa_backend_t *pBackend = chosen_backend;
+
+    JSE_ENTER("jse_cosa_bus_init()")
+
+    if (pBackend == NULL && broker_path != NULL && broker_backend.init() == 0)
+    {
+        backend = &broker_backend;
+        broker_in_use = true;
+
+        if (record_path != NULL)
+        {
+            backend = jse_cosa_trace_record(backend, record_path);
+        }
+
+        JSE_EXIT("jse_cosa_bus_init()=0")
+        return 0;
+    }
+
+#if defined(BUILD_RBUS)
+    if (pBackend == NULL)
+    {
+        pBackend = &jse_cosa_rbus_backend;
+    }
+#elif defined(BUILD_RDK)
+    if (pBackend == NULL)
+    {
+        pBackend = &jse_cosa_ccsp_backend;
+    }
+#endif
+
+    if (pBackend == NULL)
+    {
+        JSE_ERROR("No Cosa backend!")
+        JSE_EXIT("jse_cosa_bus_init()=-1")
+        return -1;
+    }
+
+    /* Set first as initialising may discover components */
+    backend = pBackend;
+
+    if (backend->init() != 0)
+    {
+        backend = NULL;
+
+        JSE_EXIT("jse_cosa_bus_init()=-1")
+        return -1;
+    }
+
+    JSE_DEBUG("COSA using the %s backend", backend->name)
+
+    if (record_path != NULL)
+    {
+        backend = jse_cosa_trace_record(backend, record_path);
+    }
+
+    JSE_EXIT("jse_cosa_bus_init()=0")
+    return 0;
+}
+
+/**
+ * @brief Shuts down the backend.
+ */
+void jse_cosa_bus_shutdown(void)
+{
+    int abandoned;
+
+    JSE_ENTER("jse_cosa_bus_shutdown()")
+
+    /* No batch can be running but the workers may be using the backend */
+    jse_cosa_pool_shutdown();
+
+    pthread_mutex_lock(&deadline_mutex);
+    abandoned = abandoned_calls;
+    pthread_mutex_unlock(&deadline_mutex);
+
+    if (abandoned > 0)
+    {
+        /* Shutting down under a call that is still running could crash */
+        JSE_WARNING("%d timed out calls still running, not shutting down the %s backend", abandoned, backend->name)
+    }
+    else if (backend != NULL)
+    {
+        backend->shutdown();
+    }
+
+    backend = NULL;
+    broker_in_use = false;
+
+    JSE_EXIT("jse_cosa_bus_shutdown()")
+}
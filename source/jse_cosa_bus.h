@@ -0,0 +1,307 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2016 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#ifndef JSE_COSA_BUS_H
+#define JSE_COSA_BUS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "jse_cosa_types.h"
+#include "jse_cosa_backend.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/** A request for parameter values from one component */
+struct jse_cosa_bus_get_s
+{
+    /** The subsystem prefix */
+    const char *pSystemPrefix;
+    /** The component name */
+    const char *pComponent;
+    /** The component D-Bus path */
+    char *pPath;
+    /** The parameter names */
+    char **ppNames;
+    /** The number of names */
+    int count;
+    /** Returns CCSP_SUCCESS or an error status */
+    int status;
+    /** Returns the number of values */
+    int valCount;
+    /** Returns the values, freed by jse_cosa_bus_free_values() */
+    parameterValStruct_t **ppVals;
+    /** Returns the time the request took */
+    uint64_t usec;
+};
+
+/** The component request type */
+typedef struct jse_cosa_bus_get_s jse_cosa_bus_get_t;
+
+/**
+ * @brief Sets the jse-cosad socket used instead of the message bus.
+ *
+ * @param path the socket path or NULL to always use the message bus.
+ */
+void jse_cosa_bus_set_broker(const char *path);
+
+/**
+ * @brief Sets the time to wait for each backend call.
+ *
+ * A call that reads the data model and takes longer fails with
+ * CCSP_ERR_TIMEOUT and is left to finish on a worker thread. Requests to
+ * jse-cosad time out on the socket, which is then reconnected. Calls that
+ * change the data model wait as long as they take. Must be called before
+ * jse_cosa_bus_init().
+ *
+ * @param msec the time in milliseconds, 0 to wait as long as the call takes.
+ */
+void jse_cosa_bus_set_timeout(long msec);
+
+/**
+ * @brief Sets the backend to use instead of jse-cosad or the message bus.
+ *
+ * Must be called before jse_cosa_bus_init().
+ *
+ * @param pBackend the backend or NULL for the default.
+ */
+void jse_cosa_bus_set_backend(const jse_cosa_backend_t *pBackend);
+
+/**
+ * @brief Sets the file to record every backend call to.
+ *
+ * See jse_cosa_trace_record() for the format. Must be called before
+ * jse_cosa_bus_init().
+ *
+ * @param filename the trace filename or NULL to not record calls.
+ */
+void jse_cosa_bus_set_record(const char *filename);
+
+/**
+ * @brief Initialises the backend.
+ *
+ * Uses the backend set by jse_cosa_bus_set_backend() if any, otherwise
+ * connects to jse-cosad or, if it is not running, initialises the CCSP
+ * message bus.
+ *
+ * @return an error status or 0.
+ */
+int jse_cosa_bus_init(void);
+
+/**
+ * @brief Shuts down the backend.
+ */
+void jse_cosa_bus_shutdown(void);
+
+/**
+ * @brief Returns whether requests go through jse-cosad.
+ *
+ * @return true if connected to jse-cosad.
+ */
+bool jse_cosa_bus_is_broker(void);
+
+/**
+ * @brief Parse and set DM subsystem prefix.
+ *
+ * @param ppDotStr pointer to COSA dotstr, moved past any prefix.
+ * @param pSubSystemPrefix subsystem string, e.g. eRT.
+ */
+void jse_cosa_bus_split_prefix(char **ppDotStr, char *pSubSystemPrefix);
+
+/**
+ * @brief Converts a data type name to a data type.
+ *
+ * @param pName the name, e.g. "string".
+ * @param pType a pointer to return the type.
+ * @return 0 on success or -1 if the name is not recognised.
+ */
+int jse_cosa_bus_parse_type(const char *pName, enum dataType_e *pType);
+
+/**
+ * @brief Loads a parameter type manifest into the type cache.
+ *
+ * Each line of the manifest is a parameter name, in which instance numbers
+ * may be written as {i}, and a type name as used by
+ * DmExtSetStrsWithRootObj(), e.g. "Device.WiFi.SSID.{i}.SSID string".
+ * Blank lines and lines starting with '#' are ignored.
+ *
+ * @param filename the manifest filename.
+ * @return 0 on success or -1 on error.
+ */
+int jse_cosa_bus_load_types(const char *filename);
+
+/**
+ * @brief Loads the list of hot parameters.
+ *
+ * Each line of the list is a parameter name. The values of hot parameters
+ * are cached across requests and kept up to date by value change
+ * notifications. Blank lines and lines starting with '#' are ignored.
+ *
+ * @param filename the list filename.
+ * @return 0 on success or -1 on error.
+ */
+int jse_cosa_bus_load_hot(const char *filename);
+
+/**
+ * @brief Locate component for DM key/parameter
+ *
+ * The result is cached.
+ *
+ * @param pObjName object name
+ * @param ppDestComponentName pointer to dest component name
+ * @param ppDestPath pointer to component dbus path
+ * @param pSystemPrefix subsystem prefix
+ * @return an error status or 0.
+ */
+int jse_cosa_bus_discover(char *pObjName, char **ppDestComponentName, char **ppDestPath, char *pSystemPrefix);
+
+/**
+ * @brief Forgets the cached component for a name.
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param pObjName object name
+ */
+void jse_cosa_bus_invalidate(const char *pSystemPrefix, const char *pObjName);
+
+/**
+ * @brief Gets the types of parameters known to the backend, e.g. jse-cosad.
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param ppNames the parameter names.
+ * @param count the number of names.
+ * @param pTypes an array of count types to return the types, -1 if not known.
+ * @return CCSP_SUCCESS or an error status.
+ */
+int jse_cosa_bus_get_types(const char *pSystemPrefix, char **ppNames, int count, int *pTypes);
+
+/**
+ * @brief Gets parameter values from a component.
+ *
+ * See CcspBaseIf_getParameterValues().
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param pComponent the component name.
+ * @param pPath the component D-Bus path.
+ * @param ppNames the parameter names.
+ * @param count the number of names.
+ * @param pValCount a pointer to return the number of values.
+ * @param pppVals a pointer to return the values, freed by jse_cosa_bus_free_values().
+ * @return CCSP_SUCCESS or an error status.
+ */
+int jse_cosa_bus_get_values(const char *pSystemPrefix, const char *pComponent, char *pPath,
+    char **ppNames, int count, int *pValCount, parameterValStruct_t ***pppVals);
+
+/**
+ * @brief Gets parameter values from several components at once.
+ *
+ * The requests are sent concurrently, on the worker threads, so the time
+ * taken approaches that of the slowest component rather than the sum of
+ * them all.
+ *
+ * @param pGets the requests.
+ * @param count the number of requests.
+ */
+void jse_cosa_bus_get_values_many(jse_cosa_bus_get_t *pGets, int count);
+
+/**
+ * @brief Frees the values returned by jse_cosa_bus_get_values().
+ *
+ * @param valCount the number of values.
+ * @param ppVals the values.
+ */
+void jse_cosa_bus_free_values(int valCount, parameterValStruct_t **ppVals);
+
+/**
+ * @brief Sets parameter values of a component.
+ *
+ * See CcspBaseIf_setParameterValues().
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param pComponent the component name.
+ * @param pPath the component D-Bus path.
+ * @param pVals the values.
+ * @param count the number of values.
+ * @param commit set true to commit the values.
+ * @param ppFaultName a pointer to return the name of a rejected parameter, which must be freed.
+ * @return CCSP_SUCCESS or an error status.
+ */
+int jse_cosa_bus_set_values(const char *pSystemPrefix, const char *pComponent, char *pPath,
+    parameterValStruct_t *pVals, int count, bool commit, char **ppFaultName);
+
+/**
+ * @brief Commits or discards the values set on a component.
+ *
+ * See CcspBaseIf_setCommit().
+ *
+ * @param pComponent the component name.
+ * @param pPath the component D-Bus path.
+ * @param commit set true to commit, false to discard.
+ * @return CCSP_SUCCESS or an error status.
+ */
+int jse_cosa_bus_set_commit(const char *pComponent, char *pPath, bool commit);
+
+/**
+ * @brief Gets the instance numbers of a table.
+ *
+ * See CcspBaseIf_GetNextLevelInstances().
+ *
+ * @param pComponent the component name.
+ * @param pPath the component D-Bus path.
+ * @param pObjName the table name.
+ * @param pCount a pointer to return the number of instances.
+ * @param ppInstances a pointer to return the instance numbers, which must be freed.
+ * @return CCSP_SUCCESS or an error status.
+ */
+int jse_cosa_bus_get_instances(const char *pComponent, char *pPath, char *pObjName,
+    unsigned int *pCount, unsigned int **ppInstances);
+
+/**
+ * @brief Adds a row to a table.
+ *
+ * See CcspBaseIf_AddTblRow().
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param pComponent the component name.
+ * @param pPath the component D-Bus path.
+ * @param pObjName the table name.
+ * @param pInstance a pointer to return the instance number.
+ * @return CCSP_SUCCESS or an error status.
+ */
+int jse_cosa_bus_add_row(const char *pSystemPrefix, const char *pComponent, char *pPath, char *pObjName, int *pInstance);
+
+/**
+ * @brief Deletes a row from a table.
+ *
+ * See CcspBaseIf_DeleteTblRow().
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param pComponent the component name.
+ * @param pPath the component D-Bus path.
+ * @param pObjName the row name.
+ * @return CCSP_SUCCESS or an error status.
+ */
+int jse_cosa_bus_delete_row(const char *pSystemPrefix, const char *pComponent, char *pPath, char *pObjName);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
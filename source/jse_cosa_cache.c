@@ -0,0 +1,851 @@
+/*****************************************************************************
+*
+* Copyright 2020 Liberty Global B.V.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "jse_debug.h"
+#include "jse_common.h"
+#include "jse_stats.h"
+#include "jse_cosa_cache.h"
+
+/** The number of hash buckets. A power of 2. */
+#define BUCKETS 64
+
+/** The maximum length of a key */
+#define KEY_MAX 256
+
+/** A cached component */
+struct component_item_s
+{
+    /** The normalised object path including the subsystem prefix */
+    char * key;
+    /** The component name */
+    char * component;
+    /** The component D-Bus path */
+    char * path;
+    /** The time the entry expires */
+    uint64_t expires_usec;
+    struct component_item_s * next;
+};
+
+typedef struct component_item_s component_item_t;
+
+/** A cached parameter type */
+struct type_item_s
+{
+    /** The normalised parameter name including the subsystem prefix */
+    char * key;
+    /** The type */
+    int type;
+    struct type_item_s * next;
+};
+
+typedef struct type_item_s type_item_t;
+
+/** The cached components */
+static component_item_t * components[BUCKETS];
+
+/** The cached parameter types */
+static type_item_t * types[BUCKETS];
+
+/** The number of cached parameter types */
+static int type_count = 0;
+
+/** A hot parameter */
+struct hot_item_s
+{
+    /** The parameter name including the subsystem prefix */
+    char * key;
+    /** The value or NULL if not known */
+    char * value;
+    /** The type */
+    int type;
+    /** Set once a change notification has been received */
+    bool notified;
+    /** The time the value was updated */
+    uint64_t updated_usec;
+    struct hot_item_s * next;
+};
+
+typedef struct hot_item_s hot_item_t;
+
+/** The hot parameters */
+static hot_item_t * hot_items[BUCKETS];
+
+/** The number of hot parameters */
+static int hot_count = 0;
+
+/** The time to cache hot parameters that are not notified */
+static long hot_ttl_secs = JSE_COSA_CACHE_DEFAULT_HOT_TTL;
+
+/** The notifications received since the statistics were updated */
+static long hot_notify_count = 0;
+
+/** Protects the hot parameters, which are updated by the bus thread */
+static pthread_mutex_t hot_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** The time to cache components for */
+static long discovery_ttl_secs = JSE_COSA_CACHE_DEFAULT_DISCOVERY_TTL;
+
+/** Incremented when a component is invalidated */
+static unsigned int discovery_generation = 0;
+
+/**
+ * @brief Hashes a key with the 32 bit FNV-1a hash.
+ *
+ * @param key the key.
+ * @return the hash.
+ */
+static uint32_t hash_key(const char * key)
+{
+    uint32_t hash = 0x811c9dc5;
+
+    while (*key != '\0')
+    {
+        hash ^= (uint8_t)*key++;
+        hash *= 0x01000193;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Frees a cached component.
+ *
+ * @param item the item.
+ */
+static void free_component(component_item_t * item)
+{
+    free(item->key);
+    free(item->component);
+    free(item->path);
+    free(item);
+}
+
+/**
+ * @brief Finds a cached component removing it if expired.
+ *
+ * @param key the key.
+ * @param pprev a pointer to return the link to the item.
+ * @return the item or NULL.
+ */
+static component_item_t * find_component(const char * key, component_item_t *** pprev)
+{
+    component_item_t ** prev = &components[hash_key(key) & (BUCKETS - 1)];
+    component_item_t * item = *prev;
+
+    while (item != NULL && strcmp(item->key, key))
+    {
+        prev = &item->next;
+        item = item->next;
+    }
+
+    if (item != NULL && jse_time_usec() >= item->expires_usec)
+    {
+        *prev = item->next;
+        free_component(item);
+        item = NULL;
+    }
+
+    *pprev = prev;
+
+    return item;
+}
+
+/**
+ * @brief Creates the normalised key for a parameter or object name.
+ *
+ * @param prefix the subsystem prefix, e.g. "eRT." or "".
+ * @param name the parameter or object name.
+ * @param object set true to use the object path, i.e. up to the last '.'.
+ * @param buffer the buffer to write the key to.
+ * @param size the size of the buffer.
+ * @return 0 on success or -1 if the buffer is too small.
+ */
+int jse_cosa_cache_key(const char * prefix, const char * name, int object, char * buffer, size_t size)
+{
+    const char * end = name + strlen(name);
+    const char * p = name;
+    size_t off = strlen(prefix);
+
+    if (off >= size)
+    {
+        return -1;
+    }
+
+    strcpy(buffer, prefix);
+
+    if (object)
+    {
+        const char * dot = strrchr(name, '.');
+        end = dot != NULL ? dot + 1 : name;
+    }
+
+    while (p < end)
+    {
+        size_t len = strcspn(p, ".");
+        bool number = len > 0;
+        size_t i;
+
+        if (p + len > end)
+        {
+            len = (size_t)(end - p);
+        }
+
+        for (i = 0; i < len && number; i++)
+        {
+            number = isdigit((unsigned char)p[i]) != 0;
+        }
+
+        if (number)
+        {
+            if (off + 3 >= size)
+            {
+                return -1;
+            }
+
+            memcpy(&buffer[off], "{i}", 3);
+            off += 3;
+        }
+        else
+        {
+            if (off + len >= size)
+            {
+                return -1;
+            }
+
+            memcpy(&buffer[off], p, len);
+            off += len;
+        }
+
+        p += len;
+
+        /* The separator */
+        if (p < end)
+        {
+            if (off + 1 >= size)
+            {
+                return -1;
+            }
+
+            buffer[off++] = *p++;
+        }
+    }
+
+    buffer[off] = '\0';
+
+    return 0;
+}
+
+/**
+ * @brief Sets the time to cache the component supporting a namespace.
+ *
+ * @param secs the time in seconds, 0 disables the cache.
+ */
+void jse_cosa_cache_set_discovery_ttl(long secs)
+{
+    discovery_ttl_secs = secs;
+}
+
+/**
+ * @brief Looks up the component supporting a name.
+ *
+ * @param prefix the subsystem prefix.
+ * @param name the parameter or object name.
+ * @param pcomponent a pointer to return a copy of the component name.
+ * @param ppath a pointer to return a copy of the component D-Bus path.
+ * @return 0 on success or -1 if not cached.
+ */
+int jse_cosa_cache_get_component(const char * prefix, const char * name, char ** pcomponent, char ** ppath)
+{
+    component_item_t ** prev = NULL;
+    component_item_t * item = NULL;
+    char key[KEY_MAX];
+
+    if (discovery_ttl_secs <= 0 || jse_cosa_cache_key(prefix, name, true, key, sizeof(key)) != 0)
+    {
+        return -1;
+    }
+
+    item = find_component(key, &prev);
+    if (item == NULL)
+    {
+        jse_stats_add("cosa.discovery.miss", 1);
+        return -1;
+    }
+
+    *pcomponent = strdup(item->component);
+    *ppath = strdup(item->path);
+    if (*pcomponent == NULL || *ppath == NULL)
+    {
+        JSE_ERROR("strdup() failed: %s", strerror(errno))
+
+        free(*pcomponent);
+        free(*ppath);
+        *pcomponent = NULL;
+        *ppath = NULL;
+        return -1;
+    }
+
+    JSE_VERBOSE("Cached component for %s: %s", key, item->component)
+    jse_stats_add("cosa.discovery.hit", 1);
+
+    return 0;
+}
+
+/**
+ * @brief Stores the component supporting a name.
+ *
+ * @param prefix the subsystem prefix.
+ * @param name the parameter or object name.
+ * @param component the component name.
+ * @param path the component D-Bus path.
+ */
+void jse_cosa_cache_put_component(const char * prefix, const char * name, const char * component, const char * path)
+{
+    component_item_t ** prev = NULL;
+    component_item_t * item = NULL;
+    char key[KEY_MAX];
+
+    if (discovery_ttl_secs <= 0 || jse_cosa_cache_key(prefix, name, true, key, sizeof(key)) != 0)
+    {
+        return;
+    }
+
+    item = find_component(key, &prev);
+    if (item != NULL)
+    {
+        /* Replace it */
+        *prev = item->next;
+        free_component(item);
+    }
+
+    item = (component_item_t *)calloc(1, sizeof(component_item_t));
+    if (item == NULL)
+    {
+        JSE_ERROR("calloc() failed: %s", strerror(errno))
+        return;
+    }
+
+    item->key = strdup(key);
+    item->component = strdup(component);
+    item->path = strdup(path);
+    if (item->key == NULL || item->component == NULL || item->path == NULL)
+    {
+        JSE_ERROR("strdup() failed: %s", strerror(errno))
+        free_component(item);
+        return;
+    }
+
+    item->expires_usec = jse_time_usec() + ((uint64_t)discovery_ttl_secs * 1000000);
+
+    prev = &components[hash_key(key) & (BUCKETS - 1)];
+    item->next = *prev;
+    *prev = item;
+}
+
+/**
+ * @brief Removes the component supporting a name.
+ *
+ * @param prefix the subsystem prefix.
+ * @param name the parameter or object name.
+ */
+void jse_cosa_cache_invalidate_component(const char * prefix, const char * name)
+{
+    component_item_t ** prev = NULL;
+    component_item_t * item = NULL;
+    char key[KEY_MAX];
+
+    if (jse_cosa_cache_key(prefix, name, true, key, sizeof(key)) != 0)
+    {
+        return;
+    }
+
+    item = find_component(key, &prev);
+    if (item != NULL)
+    {
+        JSE_DEBUG("Invalidating component for %s: %s", key, item->component)
+
+        *prev = item->next;
+        free_component(item);
+
+        discovery_generation ++;
+        jse_stats_add("cosa.discovery.invalidate", 1);
+    }
+}
+
+/**
+ * @brief Returns the discovery generation.
+ *
+ * @return the generation.
+ */
+unsigned int jse_cosa_cache_generation(void)
+{
+    return discovery_generation;
+}
+
+/**
+ * @brief Finds a cached parameter type.
+ *
+ * @param key the key.
+ * @param pprev a pointer to return the link to the item.
+ * @return the item or NULL.
+ */
+static type_item_t * find_type(const char * key, type_item_t *** pprev)
+{
+    type_item_t ** prev = &types[hash_key(key) & (BUCKETS - 1)];
+    type_item_t * item = *prev;
+
+    while (item != NULL && strcmp(item->key, key))
+    {
+        prev = &item->next;
+        item = item->next;
+    }
+
+    *pprev = prev;
+
+    return item;
+}
+
+/**
+ * @brief Looks up the type of a parameter.
+ *
+ * @param prefix the subsystem prefix.
+ * @param name the parameter name.
+ * @param ptype a pointer to return the type.
+ * @return 0 on success or -1 if not cached.
+ */
+int jse_cosa_cache_get_type(const char * prefix, const char * name, int * ptype)
+{
+    type_item_t ** prev = NULL;
+    type_item_t * item = NULL;
+    char key[KEY_MAX];
+
+    if (jse_cosa_cache_key(prefix, name, false, key, sizeof(key)) != 0)
+    {
+        return -1;
+    }
+
+    item = find_type(key, &prev);
+    if (item == NULL)
+    {
+        jse_stats_add("cosa.type.miss", 1);
+        return -1;
+    }
+
+    *ptype = item->type;
+    jse_stats_add("cosa.type.hit", 1);
+
+    return 0;
+}
+
+/**
+ * @brief Stores the type of a parameter.
+ *
+ * @param prefix the subsystem prefix.
+ * @param name the parameter name.
+ * @param type the type.
+ */
+void jse_cosa_cache_put_type(const char * prefix, const char * name, int type)
+{
+    type_item_t ** prev = NULL;
+    type_item_t * item = NULL;
+    char key[KEY_MAX];
+
+    if (jse_cosa_cache_key(prefix, name, false, key, sizeof(key)) != 0)
+    {
+        return;
+    }
+
+    item = find_type(key, &prev);
+    if (item != NULL)
+    {
+        item->type = type;
+        return;
+    }
+
+    if (type_count >= JSE_COSA_CACHE_MAX_TYPES)
+    {
+        JSE_VERBOSE("Type cache full: %s", key)
+        return;
+    }
+
+    item = (type_item_t *)calloc(1, sizeof(type_item_t));
+    if (item == NULL || (item->key = strdup(key)) == NULL)
+    {
+        JSE_ERROR("Out of memory!")
+        free(item);
+        return;
+    }
+
+    item->type = type;
+    item->next = *prev;
+    *prev = item;
+
+    type_count ++;
+}
+
+/**
+ * @brief Removes the type of a parameter.
+ *
+ * @param prefix the subsystem prefix.
+ * @param name the parameter name.
+ */
+void jse_cosa_cache_invalidate_type(const char * prefix, const char * name)
+{
+    type_item_t ** prev = NULL;
+    type_item_t * item = NULL;
+    char key[KEY_MAX];
+
+    if (jse_cosa_cache_key(prefix, name, false, key, sizeof(key)) != 0)
+    {
+        return;
+    }
+
+    item = find_type(key, &prev);
+    if (item != NULL)
+    {
+        JSE_DEBUG("Invalidating type for %s", key)
+
+        *prev = item->next;
+        free(item->key);
+        free(item);
+
+        type_count --;
+        jse_stats_add("cosa.type.invalidate", 1);
+    }
+}
+
+/**
+ * @brief Finds a hot parameter. Must be called with the mutex locked.
+ *
+ * @param key the key.
+ * @return the item or NULL.
+ */
+static hot_item_t * find_hot(const char * key)
+{
+    hot_item_t * item = hot_items[hash_key(key) & (BUCKETS - 1)];
+
+    while (item != NULL && strcmp(item->key, key))
+    {
+        item = item->next;
+    }
+
+    return item;
+}
+
+/**
+ * @brief Updates the value of a hot parameter. Must be called with the
+ * mutex locked.
+ *
+ * @param item the item.
+ * @param value the value or NULL if not known.
+ * @param type the type.
+ */
+static void update_hot(hot_item_t * item, const char * value, int type)
+{
+    char * copy = NULL;
+
+    if (value != NULL && (copy = strdup(value)) == NULL)
+    {
+        JSE_ERROR("strdup() failed: %s", strerror(errno))
+    }
+
+    free(item->value);
+    item->value = copy;
+    item->type = type;
+    item->updated_usec = jse_time_usec();
+}
+
+/**
+ * @brief Sets the time to cache hot parameters that are not notified.
+ *
+ * @param secs the time in seconds.
+ */
+void jse_cosa_cache_set_hot_ttl(long secs)
+{
+    hot_ttl_secs = secs;
+}
+
+/**
+ * @brief Adds a hot parameter.
+ *
+ * @param prefix the subsystem prefix.
+ * @param name the parameter name.
+ * @return 0 on success or -1 on error.
+ */
+int jse_cosa_cache_add_hot(const char * prefix, const char * name)
+{
+    hot_item_t * item = NULL;
+    char key[KEY_MAX];
+    int ret = -1;
+
+    if (snprintf(key, sizeof(key), "%s%s", prefix, name) >= (int)sizeof(key))
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&hot_mutex);
+
+    if (find_hot(key) != NULL)
+    {
+        ret = 0;
+    }
+    else if ((item = (hot_item_t *)calloc(1, sizeof(hot_item_t))) == NULL ||
+        (item->key = strdup(key)) == NULL)
+    {
+        JSE_ERROR("Out of memory!")
+        free(item);
+    }
+    else
+    {
+        hot_item_t ** bucket = &hot_items[hash_key(key) & (BUCKETS - 1)];
+
+        item->next = *bucket;
+        *bucket = item;
+        hot_count ++;
+        ret = 0;
+    }
+
+    pthread_mutex_unlock(&hot_mutex);
+
+    return ret;
+}
+
+/**
+ * @brief Returns the names of the hot parameters.
+ *
+ * @param pnames a pointer to return the array of names. The names and
+ * array must be freed.
+ * @return the number of names.
+ */
+int jse_cosa_cache_get_hot_names(char *** pnames)
+{
+    char ** names = NULL;
+    int count = 0;
+    int i;
+
+    *pnames = NULL;
+
+    pthread_mutex_lock(&hot_mutex);
+
+    if (hot_count > 0 && (names = (char **)calloc(hot_count, sizeof(char *))) != NULL)
+    {
+        for (i = 0; i < BUCKETS; i++)
+        {
+            hot_item_t * item = NULL;
+
+            for (item = hot_items[i]; item != NULL && count < hot_count; item = item->next)
+            {
+                if ((names[count] = strdup(item->key)) != NULL)
+                {
+                    count ++;
+                }
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&hot_mutex);
+
+    *pnames = names;
+
+    return count;
+}
+
+/**
+ * @brief Looks up the value of a hot parameter.
+ *
+ * @param prefix the subsystem prefix.
+ * @param name the parameter name.
+ * @param pvalue a pointer to return a copy of the value.
+ * @param ptype a pointer to return the type.
+ * @return 0 on success or -1 if not cached.
+ */
+int jse_cosa_cache_get_hot(const char * prefix, const char * name, char ** pvalue, int * ptype)
+{
+    const char * result = NULL;
+    hot_item_t * item = NULL;
+    uint64_t now = jse_time_usec();
+    uint64_t age = 0;
+    long notify_count = 0;
+    bool hot = false;
+    bool expired = false;
+    char key[KEY_MAX];
+
+    if (hot_count == 0 || snprintf(key, sizeof(key), "%s%s", prefix, name) >= (int)sizeof(key))
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&hot_mutex);
+
+    notify_count = hot_notify_count;
+    hot_notify_count = 0;
+
+    item = find_hot(key);
+    if (item != NULL)
+    {
+        hot = true;
+        age = now - item->updated_usec;
+
+        /* Without notifications the value may have changed at any time.
+           With them it is still bounded as notifications stop if the
+           component restarts. */
+        expired = item->value != NULL &&
+            age >= (uint64_t)hot_ttl_secs * 1000000 * (item->notified ? JSE_COSA_CACHE_NOTIFIED_TTL_FACTOR : 1);
+
+        if (item->value != NULL && !expired)
+        {
+            *pvalue = strdup(item->value);
+            *ptype = item->type;
+            result = *pvalue;
+        }
+    }
+
+    pthread_mutex_unlock(&hot_mutex);
+
+    if (notify_count > 0)
+    {
+        jse_stats_add("cosa.hot.notify", notify_count);
+    }
+
+    if (!hot)
+    {
+        return -1;
+    }
+
+    if (result == NULL)
+    {
+        jse_stats_add(expired ? "cosa.hot.expired" : "cosa.hot.miss", 1);
+        return -1;
+    }
+
+    jse_stats_add("cosa.hot.hit", 1);
+    jse_stats_add("cosa.hot.age_msec", (long)(age / 1000));
+
+    return 0;
+}
+
+/**
+ * @brief Stores the value of a hot parameter read from its component.
+ *
+ * Does nothing if the parameter is not hot.
+ *
+ * @param prefix the subsystem prefix.
+ * @param name the parameter name.
+ * @param value the value.
+ * @param type the type.
+ */
+void jse_cosa_cache_put_hot(const char * prefix, const char * name, const char * value, int type)
+{
+    hot_item_t * item = NULL;
+    char key[KEY_MAX];
+
+    if (hot_count == 0 || snprintf(key, sizeof(key), "%s%s", prefix, name) >= (int)sizeof(key))
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&hot_mutex);
+
+    item = find_hot(key);
+    if (item != NULL)
+    {
+        update_hot(item, value, type);
+    }
+
+    pthread_mutex_unlock(&hot_mutex);
+}
+
+/**
+ * @brief Stores the value of a hot parameter from a change notification.
+ *
+ * This may be called from any thread.
+ *
+ * @param prefix the subsystem prefix.
+ * @param name the parameter name.
+ * @param value the new value or NULL if not known.
+ * @param type the type.
+ */
+void jse_cosa_cache_notify_hot(const char * prefix, const char * name, const char * value, int type)
+{
+    hot_item_t * item = NULL;
+    char key[KEY_MAX];
+
+    if (hot_count == 0 || snprintf(key, sizeof(key), "%s%s", prefix, name) >= (int)sizeof(key))
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&hot_mutex);
+
+    item = find_hot(key);
+    if (item != NULL)
+    {
+        update_hot(item, value, type);
+        item->notified = true;
+        hot_notify_count ++;
+    }
+
+    pthread_mutex_unlock(&hot_mutex);
+}
+
+/**
+ * @brief Forgets the values of the hot parameters below a name.
+ *
+ * @param prefix the subsystem prefix.
+ * @param name the parameter or object name.
+ */
+void jse_cosa_cache_invalidate_hot(const char * prefix, const char * name)
+{
+    char key[KEY_MAX];
+    size_t len;
+    int i;
+
+    if (hot_count == 0)
+    {
+        return;
+    }
+
+    snprintf(key, sizeof(key), "%s%s", prefix, name);
+    len = strlen(key);
+
+    pthread_mutex_lock(&hot_mutex);
+
+    for (i = 0; i < BUCKETS; i++)
+    {
+        hot_item_t * item = NULL;
+
+        for (item = hot_items[i]; item != NULL; item = item->next)
+        {
+            if (!strncmp(item->key, key, len))
+            {
+                free(item->value);
+                item->value = NULL;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&hot_mutex);
+}
@@ -0,0 +1,215 @@
+/*****************************************************************************
+*
+* Copyright 2020 Liberty Global B.V.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*****************************************************************************/
+
+#ifndef JSE_COSA_CACHE_H
+#define JSE_COSA_CACHE_H
+
+#include <stdlib.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/** The default time to cache the component supporting a namespace */
+#define JSE_COSA_CACHE_DEFAULT_DISCOVERY_TTL 300
+
+/** The maximum number of parameter types cached */
+#define JSE_COSA_CACHE_MAX_TYPES 8192
+
+/** The default time to cache hot parameters that are not notified */
+#define JSE_COSA_CACHE_DEFAULT_HOT_TTL 10
+
+/** The multiple of the hot TTL notified hot parameters are cached for */
+#define JSE_COSA_CACHE_NOTIFIED_TTL_FACTOR 30
+
+/**
+ * @brief Creates the normalised key for a parameter or object name.
+ *
+ * Instance numbers are replaced by "{i}", as used when components register
+ * their namespaces, so that all the instances of a table share a key.
+ *
+ * @param prefix the subsystem prefix, e.g. "eRT." or "".
+ * @param name the parameter or object name.
+ * @param object set true to use the object path, i.e. up to the last '.'.
+ * @param buffer the buffer to write the key to.
+ * @param size the size of the buffer.
+ * @return 0 on success or -1 if the buffer is too small.
+ */
+int jse_cosa_cache_key(const char * prefix, const char * name, int object, char * buffer, size_t size);
+
+/**
+ * @brief Sets the time to cache the component supporting a namespace.
+ *
+ * @param secs the time in seconds, 0 disables the cache.
+ */
+void jse_cosa_cache_set_discovery_ttl(long secs);
+
+/**
+ * @brief Looks up the component supporting a name.
+ *
+ * @param prefix the subsystem prefix.
+ * @param name the parameter or object name.
+ * @param pcomponent a pointer to return a copy of the component name.
+ * @param ppath a pointer to return a copy of the component D-Bus path.
+ * @return 0 on success or -1 if not cached.
+ */
+int jse_cosa_cache_get_component(const char * prefix, const char * name, char ** pcomponent, char ** ppath);
+
+/**
+ * @brief Stores the component supporting a name.
+ *
+ * @param prefix the subsystem prefix.
+ * @param name the parameter or object name.
+ * @param component the component name.
+ * @param path the component D-Bus path.
+ */
+void jse_cosa_cache_put_component(const char * prefix, const char * name, const char * component, const char * path);
+
+/**
+ * @brief Removes the component supporting a name.
+ *
+ * Called when a request to the component fails, as the component may
+ * have restarted or the namespace moved.
+ *
+ * @param prefix the subsystem prefix.
+ * @param name the parameter or object name.
+ */
+void jse_cosa_cache_invalidate_component(const char * prefix, const char * name);
+
+/**
+ * @brief Returns the discovery generation.
+ *
+ * The generation changes whenever a cached component is invalidated so
+ * anything derived from the cache can tell whether it may be out of date.
+ *
+ * @return the generation.
+ */
+unsigned int jse_cosa_cache_generation(void);
+
+/**
+ * @brief Looks up the type of a parameter.
+ *
+ * Types are cached by name, with instance numbers normalised, as all the
+ * instances of a table have the same parameter types.
+ *
+ * @param prefix the subsystem prefix.
+ * @param name the parameter name.
+ * @param ptype a pointer to return the type.
+ * @return 0 on success or -1 if not cached.
+ */
+int jse_cosa_cache_get_type(const char * prefix, const char * name, int * ptype);
+
+/**
+ * @brief Stores the type of a parameter.
+ *
+ * @param prefix the subsystem prefix.
+ * @param name the parameter name.
+ * @param type the type.
+ */
+void jse_cosa_cache_put_type(const char * prefix, const char * name, int type);
+
+/**
+ * @brief Removes the type of a parameter.
+ *
+ * Called when a component rejects a value because of its type.
+ *
+ * @param prefix the subsystem prefix.
+ * @param name the parameter name.
+ */
+void jse_cosa_cache_invalidate_type(const char * prefix, const char * name);
+
+/**
+ * @brief Sets the time to cache hot parameters that are not notified.
+ *
+ * Hot parameters whose component has sent a change notification are
+ * cached for JSE_COSA_CACHE_NOTIFIED_TTL_FACTOR times as long, in case
+ * the subscription is lost, e.g. when the component restarts. The rest
+ * are only cached for this time.
+ *
+ * @param secs the time in seconds.
+ */
+void jse_cosa_cache_set_hot_ttl(long secs);
+
+/**
+ * @brief Adds a hot parameter.
+ *
+ * The values of hot parameters are cached across requests.
+ *
+ * @param prefix the subsystem prefix.
+ * @param name the parameter name.
+ * @return 0 on success or -1 on error.
+ */
+int jse_cosa_cache_add_hot(const char * prefix, const char * name);
+
+/**
+ * @brief Returns the names of the hot parameters.
+ *
+ * @param pnames a pointer to return the array of names, including any
+ * subsystem prefix. The names and array must be freed.
+ * @return the number of names.
+ */
+int jse_cosa_cache_get_hot_names(char *** pnames);
+
+/**
+ * @brief Looks up the value of a hot parameter.
+ *
+ * @param prefix the subsystem prefix.
+ * @param name the parameter name.
+ * @param pvalue a pointer to return a copy of the value, which must be freed.
+ * @param ptype a pointer to return the type.
+ * @return 0 on success or -1 if not cached.
+ */
+int jse_cosa_cache_get_hot(const char * prefix, const char * name, char ** pvalue, int * ptype);
+
+/**
+ * @brief Stores the value of a hot parameter read from its component.
+ *
+ * Does nothing if the parameter is not hot.
+ *
+ * @param prefix the subsystem prefix.
+ * @param name the parameter name.
+ * @param value the value.
+ * @param type the type.
+ */
+void jse_cosa_cache_put_hot(const char * prefix, const char * name, const char * value, int type);
+
+/**
+ * @brief Stores the value of a hot parameter from a change notification.
+ *
+ * Unlike the other functions this may be called from any thread.
+ *
+ * @param prefix the subsystem prefix.
+ * @param name the parameter name.
+ * @param value the new value or NULL if not known.
+ * @param type the type.
+ */
+void jse_cosa_cache_notify_hot(const char * prefix, const char * name, const char * value, int type);
+
+/**
+ * @brief Forgets the values of the hot parameters below a name.
+ *
+ * @param prefix the subsystem prefix.
+ * @param name the parameter or object name.
+ */
+void jse_cosa_cache_invalidate_hot(const char * prefix, const char * name);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
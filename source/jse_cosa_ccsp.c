@@ -0,0 +1,631 @@
+/*
+ If not stated otherwise in this file or this component's Licenses.txt file the
+ following copyright and licenses apply:
+
+ Copyright 2018 RDK Management
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#include <ccsp_message_bus.h>
+#include <ccsp_base_api.h>
+#include <ccsp_memory.h>
+#include <ccsp_custom.h>
+
+#include "jse_debug.h"
+#include "jse_cosa_cache.h"
+#include "jse_cosa_backend.h"
+#include "jse_cosa_bus.h"
+
+#ifndef __GNUC__
+#ifndef __attribute__
+#define __attribute__(a)
+#endif
+#endif
+
+#define COMPONENT_NAME "ccsp.phpextension"
+#define CONF_FILENAME "/tmp/ccsp_msg.cfg"
+#define CCSP_COMPONENT_ID_WebUI 0x00000001
+#define COSA_PHP_EXT_PCSIM "/tmp/cosa_php_pcsim"
+
+static void *bus_handle = NULL;
+static char dst_pathname_cr[64] = {0};
+static int gPcSim = 0;
+
+/** The time to wait for the CR to report the system ready */
+#define READY_TIMEOUT_MSEC 1000
+
+/** Protects system_ready, which is set from the D-Bus thread */
+static pthread_mutex_t ready_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Signalled when the system ready event arrives */
+static pthread_cond_t ready_cond = PTHREAD_COND_INITIALIZER;
+
+/** Set true when the system ready event arrives */
+static bool system_ready = false;
+
+#ifndef BUILD_RBUS /*FIXME: mrollins: completely removed the functionality when rbus enabled -- do we need to add it back with rbus ? */
+static const char *msg_path = "/com/cisco/spvtg/ccsp/phpext";
+static const char *msg_interface = "com.cisco.spvtg.ccsp.phpext";
+static const char *msg_method = "__send";
+static const char *Introspect_msg = "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"
+                                    "<node name=\"/com/cisco/ccsp/dbus\">\n"
+                                    "  <interface name=\"org.freedesktop.DBus.Introspectable\">\n"
+                                    "    <method name=\"Introspect\">\n"
+                                    "      <arg name=\"data\" direction=\"out\" type=\"s\"/>\n"
+                                    "    </method>\n"
+                                    "  </interface>\n"
+                                    "  <interface name=\"ccsp.msg\">\n"
+                                    "    <method name=\"__send\">\n"
+                                    "      <arg type=\"s\" name=\"from\" direction=\"in\" />\n"
+                                    "      <arg type=\"s\" name=\"request\" direction=\"in\" />\n"
+                                    "      <arg type=\"s\" name=\"response\" direction=\"out\" />\n"
+                                    "    </method>\n"
+                                    "    <method name=\"__app_request\">\n"
+                                    "      <arg type=\"s\" name=\"from\" direction=\"in\" />\n"
+                                    "      <arg type=\"s\" name=\"request\" direction=\"in\" />\n"
+                                    "      <arg type=\"s\" name=\"argu\" direction=\"in\" />\n"
+                                    "      <arg type=\"s\" name=\"response\" direction=\"out\" />\n"
+                                    "    </method>\n"
+                                    "  </interface>\n"
+                                    "</node>\n";
+
+/**
+ * @brief Dbus message handler
+ *
+ * @param conn connection object
+ * @param message dbus message
+ * @param user_data
+ * @return an error status or DBUS_HANDLER_RESULT_HANDLED.
+ */
+static DBusHandlerResult path_message_func(DBusConnection *conn, DBusMessage *message,
+    __attribute__((unused)) void *user_data)
+{
+    if (message != NULL)
+    {
+        const char *interface = dbus_message_get_interface(message);
+        const char *method = dbus_message_get_member(message);
+        DBusMessage *reply;
+        char *resp = "888888888888888888888888888888888888888888888888888888888888888888888888888888888888888888888888888";
+        char *from = 0;
+        char *req = 0;
+        char *err_msg = DBUS_ERROR_NOT_SUPPORTED;
+
+#ifndef __GNUC__
+        /* To keep compiler happy */
+        user_data = user_data;
+#endif
+
+        reply = dbus_message_new_method_return(message);
+        if (reply == NULL)
+        {
+            return DBUS_HANDLER_RESULT_HANDLED;
+        }
+
+        if (!strcmp("org.freedesktop.DBus.Introspectable", interface) && !strcmp(method, "Introspect"))
+        {
+            if (!dbus_message_append_args(reply, DBUS_TYPE_STRING, &Introspect_msg, DBUS_TYPE_INVALID))
+            {
+                if (!dbus_connection_send(conn, reply, NULL))
+                {
+                    dbus_message_unref(reply);
+                }
+            }
+            return DBUS_HANDLER_RESULT_HANDLED;
+        }
+
+        if (!strcmp(msg_interface, interface) && !strcmp(method, msg_method))
+        {
+            if (dbus_message_get_args(message,
+                                    NULL,
+                                    DBUS_TYPE_STRING, &from,
+                                    DBUS_TYPE_STRING, &req,
+                                    DBUS_TYPE_INVALID))
+            {
+                dbus_message_append_args(reply, DBUS_TYPE_STRING, &resp, DBUS_TYPE_INVALID);
+                if (!dbus_connection_send(conn, reply, NULL))
+                {
+                    dbus_message_unref(reply);
+                }
+            }
+            return DBUS_HANDLER_RESULT_HANDLED;
+        }
+
+        dbus_message_set_error_name(reply, err_msg);
+        dbus_connection_send(conn, reply, NULL);
+        dbus_message_unref(reply);
+
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
+
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+#endif /* BUILD_RBUS */
+
+/**
+ * @brief Locate component for DM key/parameter on the message bus
+ *
+ * CCSP API call: CcspBaseIf_discComponentSupportingNamespace()
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param pObjName object name
+ * @param ppDestComponentName pointer to dest component name
+ * @param ppDestPath pointer to component dbus path
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int Discover(const char *pSystemPrefix, char *pObjName, char **ppDestComponentName, char **ppDestPath)
+{
+    int ret;
+    int size = 0;
+    componentStruct_t **ppComponents = NULL;
+
+    ret =
+        CcspBaseIf_discComponentSupportingNamespace(
+            bus_handle,
+            dst_pathname_cr,
+            pObjName,
+            pSystemPrefix,
+            &ppComponents,
+            &size);
+
+    if (ret == CCSP_SUCCESS)
+    {
+        // We only support handling a single component
+        *ppDestComponentName = ppComponents[0]->componentName;
+        ppComponents[0]->componentName = NULL;
+        *ppDestPath = ppComponents[0]->dbusPath;
+        ppComponents[0]->dbusPath = NULL;
+
+        while (size)
+        {
+            if (ppComponents[size - 1]->componentName)
+            {
+                free(ppComponents[size - 1]->componentName);
+            }
+            if (ppComponents[size - 1]->dbusPath)
+            {
+                free(ppComponents[size - 1]->dbusPath);
+            }
+            if (ppComponents[size - 1]->remoteCR_dbus_path)
+            {
+                free(ppComponents[size - 1]->remoteCR_dbus_path);
+            }
+            if (ppComponents[size - 1]->remoteCR_name)
+            {
+                free(ppComponents[size - 1]->remoteCR_name);
+            }
+            free(ppComponents[size - 1]);
+            size--;
+        }
+        free(ppComponents);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Handles CCSP parameter value change notifications.
+ *
+ * This is called on the message bus thread.
+ *
+ * @param pVal the changes.
+ * @param size the number of changes.
+ * @param user_data unused.
+ */
+static void HotValueChanged(parameterSigStruct_t *pVal, int size, __attribute__((unused)) void *user_data)
+{
+    int i;
+
+#ifndef __GNUC__
+    /* To keep compiler happy */
+    user_data = user_data;
+#endif
+
+    for (i = 0; i < size; i++)
+    {
+        if (pVal[i].parameterName != NULL)
+        {
+            jse_cosa_cache_notify_hot(
+                pVal[i].subsystem_prefix != NULL ? pVal[i].subsystem_prefix : "",
+                pVal[i].parameterName,
+                pVal[i].newValue,
+                (int)pVal[i].type);
+        }
+    }
+}
+
+/**
+ * @brief Subscribes to the value change notifications of the components
+ * supporting the hot parameters.
+ */
+static void SubscribeHotParameters(void)
+{
+    char **ppNames = NULL;
+    char **ppComponents = NULL;
+    int componentCount = 0;
+    int count;
+    int i, j;
+
+    count = jse_cosa_cache_get_hot_names(&ppNames);
+    if (count == 0)
+    {
+        return;
+    }
+
+    ppComponents = (char **)calloc(count, sizeof(char *));
+    if (ppComponents != NULL)
+    {
+        CcspBaseIf_SetCallback2(bus_handle, "parameterValueChangeSignal", HotValueChanged, NULL);
+
+        for (i = 0; i < count; i++)
+        {
+            char *dotstr = ppNames[i];
+            char subSystemPrefix[6] = {0};
+            char *pDestComponentName = NULL;
+            char *pDestPath = NULL;
+            int returnStatus;
+
+            jse_cosa_bus_split_prefix(&dotstr, subSystemPrefix);
+
+            if (jse_cosa_bus_discover(dotstr, &pDestComponentName, &pDestPath, subSystemPrefix) != 0)
+            {
+                JSE_WARNING("No component for hot parameter %s", ppNames[i])
+                continue;
+            }
+
+            free(pDestPath);
+
+            for (j = 0; j < componentCount && strcmp(ppComponents[j], pDestComponentName); j++)
+            {
+            }
+
+            if (j < componentCount)
+            {
+                /* Already subscribed */
+                free(pDestComponentName);
+                continue;
+            }
+
+            returnStatus = CcspBaseIf_Register_Event(bus_handle, pDestComponentName, "parameterValueChangeSignal");
+            if (returnStatus != CCSP_SUCCESS)
+            {
+                JSE_WARNING("CcspBaseIf_Register_Event(\"%s\") failed: %d", pDestComponentName, returnStatus)
+            }
+            else
+            {
+                JSE_DEBUG("Subscribed to %s", pDestComponentName)
+            }
+
+            ppComponents[componentCount++] = pDestComponentName;
+        }
+
+        for (j = 0; j < componentCount; j++)
+        {
+            free(ppComponents[j]);
+        }
+
+        free(ppComponents);
+    }
+    else
+    {
+        JSE_ERROR("calloc() failed: %s", strerror(errno))
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        free(ppNames[i]);
+    }
+
+    free(ppNames);
+}
+
+/**
+ * @brief Called when the CR reports the system ready.
+ *
+ * Called on the D-Bus thread.
+ *
+ * @param user_data unused.
+ */
+static void SystemReady(void *user_data)
+{
+    (void) user_data;
+
+    pthread_mutex_lock(&ready_mutex);
+    system_ready = true;
+    pthread_cond_broadcast(&ready_cond);
+    pthread_mutex_unlock(&ready_mutex);
+}
+
+/**
+ * @brief Waits for the CR to report the system ready.
+ *
+ * Returns at once if the system is already ready. Otherwise waits for the
+ * system ready event, for up to READY_TIMEOUT_MSEC. Components may still
+ * answer if the system is not ready so it is not an error.
+ */
+static void WaitForSystemReady(void)
+{
+    dbus_bool ready = 0;
+    struct timespec deadline;
+    int returnStatus;
+
+    returnStatus = CcspBaseIf_isSystemReady(bus_handle, dst_pathname_cr, &ready);
+    if (returnStatus == CCSP_SUCCESS && ready)
+    {
+        return;
+    }
+
+    CcspBaseIf_SetCallback2(bus_handle, "systemReadySignal", SystemReady, NULL);
+
+    returnStatus = CcspBaseIf_Register_Event(bus_handle, NULL, "systemReadySignal");
+    if (returnStatus != CCSP_SUCCESS)
+    {
+        JSE_WARNING("CcspBaseIf_Register_Event(\"systemReadySignal\") failed: %d", returnStatus)
+        return;
+    }
+
+    /* The event may have been sent before registering */
+    if (CcspBaseIf_isSystemReady(bus_handle, dst_pathname_cr, &ready) != CCSP_SUCCESS || !ready)
+    {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += READY_TIMEOUT_MSEC / 1000;
+        deadline.tv_nsec += (READY_TIMEOUT_MSEC % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+
+        pthread_mutex_lock(&ready_mutex);
+        while (!system_ready)
+        {
+            if (pthread_cond_timedwait(&ready_cond, &ready_mutex, &deadline) == ETIMEDOUT)
+            {
+                break;
+            }
+        }
+        ready = system_ready;
+        pthread_mutex_unlock(&ready_mutex);
+
+        if (!ready)
+        {
+            JSE_WARNING("System not ready after %d ms!", READY_TIMEOUT_MSEC)
+        }
+    }
+
+    (void) CcspBaseIf_UnRegister_Event(bus_handle, NULL, "systemReadySignal");
+}
+
+/**
+ * @brief Initialises the CCSP message bus.
+ *
+ * @return 0 on success or -1 on error.
+ */
+static int Init(void)
+{
+    FILE *fp = NULL;
+    int returnStatus = 0;
+    int ret = -1;
+
+    JSE_ENTER("Init()")
+
+    /* Check if this is a PC simulation */
+    fp = fopen(COSA_PHP_EXT_PCSIM, "r");
+    if (fp)
+    {
+        gPcSim = 1;
+        fclose(fp);
+    }
+
+    bus_handle = NULL;
+
+    /*
+     *  Hardcoding "eRT." is just a workaround. We need to feed the subsystem
+     *  info into this initialization routine.
+     */
+    if (gPcSim)
+    {
+        JSE_VERBOSE("COSA using PC simulator!")
+        snprintf(dst_pathname_cr, sizeof(dst_pathname_cr), "%s", CCSP_DBUS_INTERFACE_CR);
+    }
+    else
+    {
+        snprintf(dst_pathname_cr, sizeof(dst_pathname_cr), "%s", "eRT." CCSP_DBUS_INTERFACE_CR);
+    }
+
+    returnStatus = CCSP_Message_Bus_Init(COMPONENT_NAME, CONF_FILENAME, &bus_handle, 0, 0);
+    if (returnStatus != 0)
+    {
+        JSE_ERROR("Message bus init failed, error code = %d!", returnStatus)
+        bus_handle = NULL;
+    }
+    else
+    {
+#ifndef BUILD_RBUS
+        returnStatus = CCSP_Message_Bus_Register_Path(bus_handle, msg_path, path_message_func, 0);
+        if (returnStatus != CCSP_Message_Bus_OK)
+        {
+            JSE_ERROR("Message bus register failed, error code = %d!", returnStatus)
+            CCSP_Message_Bus_Exit(bus_handle);
+            bus_handle = NULL;
+        }
+        else
+        {
+            WaitForSystemReady();
+
+            JSE_INFO("COSA initialised!")
+            ret = 0;
+        }
+#else
+        ret = 0;
+#endif
+
+        if (ret == 0)
+        {
+            SubscribeHotParameters();
+        }
+    }
+
+    JSE_EXIT("Init()=%d", ret)
+    return ret;
+}
+
+/**
+ * @brief Shuts down the CCSP message bus.
+ */
+static void Shutdown(void)
+{
+/* TODO fix ccsp_message_bus.h: it doesn't define CCSP_Message_Bus_Exit if BUILD_RBUS enabled */
+#ifndef BUILD_RBUS
+    if (bus_handle)
+    {
+        CCSP_Message_Bus_Exit(bus_handle);
+        bus_handle = NULL;
+    }
+#endif
+}
+
+/**
+ * @brief Gets parameter values from a component.
+ *
+ * Thread safe, the message bus serialises the calls it needs to.
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param pComponent the component name.
+ * @param pPath the component D-Bus path.
+ * @param ppNames the parameter names.
+ * @param count the number of names.
+ * @param pValCount a pointer to return the number of values.
+ * @param pppVals a pointer to return the values.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int GetValues(__attribute__((unused)) const char *pSystemPrefix, const char *pComponent, char *pPath,
+    char **ppNames, int count, int *pValCount, parameterValStruct_t ***pppVals)
+{
+    return CcspBaseIf_getParameterValues(bus_handle, pComponent, pPath, ppNames, count, pValCount, pppVals);
+}
+
+/**
+ * @brief Frees the values returned by GetValues().
+ *
+ * @param valCount the number of values.
+ * @param ppVals the values.
+ */
+static void FreeValues(int valCount, parameterValStruct_t **ppVals)
+{
+    free_parameterValStruct_t(bus_handle, valCount, ppVals);
+}
+
+/**
+ * @brief Sets parameter values of a component.
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param pComponent the component name.
+ * @param pPath the component D-Bus path.
+ * @param pVals the values.
+ * @param count the number of values.
+ * @param commit set true to commit the values.
+ * @param ppFaultName a pointer to return the name of a rejected parameter.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int SetValues(__attribute__((unused)) const char *pSystemPrefix, const char *pComponent, char *pPath,
+    parameterValStruct_t *pVals, int count, bool commit, char **ppFaultName)
+{
+    return CcspBaseIf_setParameterValues(bus_handle, pComponent, pPath, 0, CCSP_COMPONENT_ID_WebUI,
+        pVals, count, commit ? 1 : 0, ppFaultName);
+}
+
+/**
+ * @brief Commits or discards the values set on a component.
+ *
+ * @param pComponent the component name.
+ * @param pPath the component D-Bus path.
+ * @param commit set true to commit, false to discard.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int SetCommit(const char *pComponent, char *pPath, bool commit)
+{
+    return CcspBaseIf_setCommit(bus_handle, pComponent, pPath, 0, CCSP_COMPONENT_ID_WebUI, commit ? 1 : 0);
+}
+
+/**
+ * @brief Gets the instance numbers of a table.
+ *
+ * @param pComponent the component name.
+ * @param pPath the component D-Bus path.
+ * @param pObjName the table name.
+ * @param pCount a pointer to return the number of instances.
+ * @param ppInstances a pointer to return the instance numbers.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int GetInstances(const char *pComponent, char *pPath, char *pObjName,
+    unsigned int *pCount, unsigned int **ppInstances)
+{
+    return CcspBaseIf_GetNextLevelInstances(bus_handle, pComponent, pPath, pObjName, pCount, ppInstances);
+}
+
+/**
+ * @brief Adds a row to a table.
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param pComponent the component name.
+ * @param pPath the component D-Bus path.
+ * @param pObjName the table name.
+ * @param pInstance a pointer to return the instance number.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int AddRow(__attribute__((unused)) const char *pSystemPrefix, const char *pComponent, char *pPath,
+    char *pObjName, int *pInstance)
+{
+    return CcspBaseIf_AddTblRow(bus_handle, pComponent, pPath, 0, pObjName, pInstance);
+}
+
+/**
+ * @brief Deletes a row from a table.
+ *
+ * @param pSystemPrefix subsystem prefix
+ * @param pComponent the component name.
+ * @param pPath the component D-Bus path.
+ * @param pObjName the row name.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int DeleteRow(__attribute__((unused)) const char *pSystemPrefix, const char *pComponent, char *pPath,
+    char *pObjName)
+{
+    return CcspBaseIf_DeleteTblRow(bus_handle, pComponent, pPath, 0, pObjName);
+}
+
+/** The CCSP message bus */
+const jse_cosa_backend_t jse_cosa_ccsp_backend = {
+    "ccsp",
+    true,
+    Init,
+    Shutdown,
+    Discover,
+    NULL,
+    NULL,
+    GetValues,
+    FreeValues,
+    SetValues,
+    SetCommit,
+    GetInstances,
+    AddRow,
+    DeleteRow
+};
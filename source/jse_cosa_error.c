@@ -28,6 +28,9 @@
 #endif
 #endif
 
+/** The heap stash key of the CosaError prototype */
+#define COSA_ERROR_STASH_KEY "CosaError.prototype"
+
 /** Reference count for binding. */
 static int ref_count = 0;
 
@@ -102,6 +105,55 @@ static duk_ret_t do_cosa_error_get_error_code(duk_context * ctx)
     return 1;
 }
 
+/**
+ * @brief Pushes the CosaError prototype on to the stack.
+ *
+ * The prototype inherits from Error.prototype and holds the name and
+ * methods shared by every CosaError. It is created once per heap and kept in
+ * the heap stash.
+ *
+ * @param ctx the duktape context.
+ */
+static void push_cosa_error_prototype(duk_context * ctx)
+{
+    duk_push_heap_stash(ctx);
+    /* [ .... stash ] */
+
+    if (!duk_get_prop_string(ctx, -1, COSA_ERROR_STASH_KEY))
+    {
+        /* [ .... stash, undefined ] */
+        duk_pop(ctx);
+
+        duk_push_object(ctx);
+        /* [ .... stash, prototype ] */
+
+        duk_get_global_string(ctx, "Error");
+        duk_get_prop_string(ctx, -1, "prototype");
+        /* [ .... stash, prototype, Error, Error.prototype ] */
+
+        duk_set_prototype(ctx, -3);
+        duk_pop(ctx);
+        /* [ .... stash, prototype ] */
+
+        duk_push_string(ctx, "CosaError");
+        duk_put_prop_string(ctx, -2, "name");
+
+        duk_push_c_function(ctx, do_cosa_error_to_string, 0);
+        duk_put_prop_string(ctx, -2, "toString");
+
+        duk_push_c_function(ctx, do_cosa_error_get_error_code, 0);
+        duk_put_prop_string(ctx, -2, "getErrorCode");
+
+        duk_dup_top(ctx);
+        duk_put_prop_string(ctx, -3, COSA_ERROR_STASH_KEY);
+    }
+
+    /* [ .... stash, prototype ] */
+    duk_swap_top(ctx, -2);
+    duk_pop(ctx);
+    /* [ .... prototype ] */
+}
+
 /**
  * @brief Pushes a CosaError object on to the stack.
  *
@@ -118,30 +170,18 @@ static duk_int_t push_cosa_error_va(duk_context * ctx, int error_code, const cha
     duk_push_error_object_va(ctx, DUK_ERR_ERROR, format, ap);
     /* [ .... Error ] */
 
-    duk_push_string(ctx, "CosaError");
-    /* [ .... Error, "PosixError" ] */
+    push_cosa_error_prototype(ctx);
+    /* [ .... Error, CosaError.prototype ] */
 
-    duk_put_prop_string(ctx, -2, "name"); /* Error */
-    /* [ .... Error ] */
+    duk_set_prototype(ctx, -2); /* Error */
+    /* [ .... CosaError ] */
 
     duk_push_int(ctx, error_code);
     /* [ .... Error, error_code ] */
 
     /* This creates the errorCode field. */
-    duk_put_prop_string(ctx, -2, "errorCode"); /* Error */
-    /* [ .... Error ] */
-
-    duk_push_c_function(ctx, do_cosa_error_to_string, 0);
-    /* [ .... Error, do_posix_error_to_string ] */
-
-    duk_put_prop_string(ctx, -2, "toString"); /* Error */
-    /* [ .... Error ] */
-
-    duk_push_c_function(ctx, do_cosa_error_get_error_code, 0);
-    /* [ .... Error, do_cosa_error_get_error_code ] */
-
-    duk_put_prop_string(ctx, -2, "getErrorCode"); /* Error */
-    /* [ .... Error ] */
+    duk_put_prop_string(ctx, -2, "errorCode"); /* CosaError */
+    /* [ .... CosaError ] */
 
     return DUK_ERR_NONE;
 }
@@ -311,6 +351,13 @@ duk_int_t jse_bind_cosa_error(jse_context_t * jse_ctx)
         if (ref_count == 0)
         {
             duk_push_c_function(jse_ctx->ctx, do_new_cosa_error, 2);
+
+            /* So that instanceof CosaError works */
+            push_cosa_error_prototype(jse_ctx->ctx);
+            duk_dup(jse_ctx->ctx, -2);
+            duk_put_prop_string(jse_ctx->ctx, -2, "constructor");
+            duk_put_prop_string(jse_ctx->ctx, -2, "prototype");
+
             duk_put_global_string(jse_ctx->ctx, "CosaError");
 
             duk_push_c_function(jse_ctx->ctx, do_throw_cosa_error, 2);
@@ -0,0 +1,228 @@
+/*****************************************************************************
+*
+* Copyright 2020 Liberty Global B.V.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "jse_debug.h"
+#include "jse_common.h"
+#include "jse_stats.h"
+#include "jse_cosa_types.h"
+#include "jse_cosa_guard.h"
+
+/** The maximum number of components with a breaker */
+#define MAX_BREAKERS 32
+
+/** The maximum length of a component name including the terminator */
+#define MAX_COMPONENT_NAME 128
+
+/** The statistic prefix of the state of each breaker */
+#define BREAKER_STAT_PREFIX "cosa.breaker."
+
+/** A component's circuit breaker */
+typedef struct breaker_s
+{
+    char component[MAX_COMPONENT_NAME];
+    /** The number of consecutive failures */
+    int failures;
+    /** The time calls are rejected until, once open */
+    uint64_t open_until;
+} breaker_t;
+
+/** The number of consecutive failures that open a breaker, 0 to disable */
+static int threshold = JSE_COSA_GUARD_DEFAULT_THRESHOLD;
+
+/** The time a breaker stays open */
+static uint64_t cooldown_usec = JSE_COSA_GUARD_DEFAULT_COOLDOWN * 1000000ULL;
+
+/** The breakers */
+static breaker_t breakers[MAX_BREAKERS];
+static int breaker_count = 0;
+
+/**
+ * @brief Finds the breaker of a component.
+ *
+ * @param component the component name.
+ * @param create set true to create the breaker if there is none.
+ * @return the breaker or NULL.
+ */
+static breaker_t * find_breaker(const char * component, bool create)
+{
+    int i;
+
+    for (i = 0; i < breaker_count; i++)
+    {
+        if (strcmp(breakers[i].component, component) == 0)
+        {
+            return &breakers[i];
+        }
+    }
+
+    if (!create || breaker_count == MAX_BREAKERS || strlen(component) >= MAX_COMPONENT_NAME)
+    {
+        return NULL;
+    }
+
+    strcpy(breakers[breaker_count].component, component);
+    breakers[breaker_count].failures = 0;
+    breakers[breaker_count].open_until = 0;
+
+    return &breakers[breaker_count++];
+}
+
+/**
+ * @brief Exports the state of a breaker and the number that are open.
+ *
+ * The per breaker statistic is named after the last part of the component
+ * name, e.g. cosa.breaker.pam, and is 1 while it is open.
+ *
+ * @param breaker the breaker that changed.
+ */
+static void export_state(const breaker_t * breaker)
+{
+    char name[JSE_STATS_NAME_MAX];
+    const char * short_name = strrchr(breaker->component, '.');
+    long open = 0;
+    int i;
+
+    snprintf(name, sizeof(name), BREAKER_STAT_PREFIX "%s",
+        short_name != NULL ? short_name + 1 : breaker->component);
+    jse_stats_set(name, breaker->failures >= threshold ? 1 : 0);
+
+    for (i = 0; i < breaker_count; i++)
+    {
+        if (breakers[i].failures >= threshold)
+        {
+            open++;
+        }
+    }
+
+    jse_stats_set("cosa.breaker.open", open);
+}
+
+/**
+ * @brief Sets the number of consecutive failures that open a breaker.
+ *
+ * @param failures the number of failures, 0 to disable the breakers.
+ */
+void jse_cosa_guard_set_threshold(int failures)
+{
+    threshold = failures > 0 ? failures : 0;
+}
+
+/**
+ * @brief Sets the time a breaker stays open.
+ *
+ * @param secs the time in seconds.
+ */
+void jse_cosa_guard_set_cooldown(long secs)
+{
+    cooldown_usec = secs > 0 ? (uint64_t)secs * 1000000ULL : 0;
+}
+
+/**
+ * @brief Checks whether a component may be called.
+ *
+ * @param component the component name.
+ * @return CCSP_SUCCESS or JSE_COSA_ERR_CIRCUIT_OPEN.
+ */
+int jse_cosa_guard_allow(const char * component)
+{
+    breaker_t * breaker = NULL;
+    uint64_t now;
+
+    if (threshold == 0 || component == NULL)
+    {
+        return CCSP_SUCCESS;
+    }
+
+    breaker = find_breaker(component, false);
+    if (breaker == NULL || breaker->failures < threshold)
+    {
+        return CCSP_SUCCESS;
+    }
+
+    now = jse_time_usec();
+    if (now >= breaker->open_until)
+    {
+        /* Let this call test the component, the rest wait for it */
+        JSE_DEBUG("%s: breaker half open", component)
+        breaker->open_until = now + cooldown_usec;
+        return CCSP_SUCCESS;
+    }
+
+    jse_stats_add("cosa.breaker.reject", 1);
+    return JSE_COSA_ERR_CIRCUIT_OPEN;
+}
+
+/**
+ * @brief Records the outcome of a call to a component.
+ *
+ * @param component the component name.
+ * @param status the CCSP status of the call.
+ */
+void jse_cosa_guard_report(const char * component, int status)
+{
+    breaker_t * breaker = NULL;
+    bool failed = status != CCSP_SUCCESS && status != CCSP_ERR_MEMORY_ALLOC_FAIL && status < 9000;
+
+    if (status == CCSP_ERR_TIMEOUT)
+    {
+        jse_stats_add("cosa.timeout", 1);
+    }
+
+    if (threshold == 0 || component == NULL)
+    {
+        return;
+    }
+
+    breaker = find_breaker(component, failed);
+    if (breaker == NULL)
+    {
+        return;
+    }
+
+    if (!failed)
+    {
+        if (breaker->failures >= threshold)
+        {
+            JSE_INFO("%s: breaker closed", component)
+            breaker->failures = 0;
+            export_state(breaker);
+        }
+
+        breaker->failures = 0;
+        return;
+    }
+
+    breaker->failures++;
+
+    if (breaker->failures >= threshold)
+    {
+        breaker->open_until = jse_time_usec() + cooldown_usec;
+
+        if (breaker->failures == threshold)
+        {
+            JSE_WARNING("%s: breaker opened after %d failures, last %d", component, breaker->failures, status)
+            jse_stats_add("cosa.breaker.trip", 1);
+            export_state(breaker);
+        }
+    }
+}
@@ -0,0 +1,78 @@
+/*****************************************************************************
+*
+* Copyright 2020 Liberty Global B.V.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*****************************************************************************/
+
+#ifndef JSE_COSA_GUARD_H
+#define JSE_COSA_GUARD_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/**
+ * The CosaError code of calls rejected because the component's circuit
+ * breaker is open. A TR-069 vendor specific fault code, so the component
+ * is not rediscovered.
+ */
+#define JSE_COSA_ERR_CIRCUIT_OPEN 9801
+
+/** The default number of consecutive failures that open a breaker */
+#define JSE_COSA_GUARD_DEFAULT_THRESHOLD 3
+
+/** The default time a breaker stays open in seconds */
+#define JSE_COSA_GUARD_DEFAULT_COOLDOWN 30
+
+/**
+ * @brief Sets the number of consecutive failures that open a breaker.
+ *
+ * @param failures the number of failures, 0 to disable the breakers.
+ */
+void jse_cosa_guard_set_threshold(int failures);
+
+/**
+ * @brief Sets the time a breaker stays open.
+ *
+ * @param secs the time in seconds.
+ */
+void jse_cosa_guard_set_cooldown(long secs);
+
+/**
+ * @brief Checks whether a component may be called.
+ *
+ * Once the cooldown has passed one call is let through to test the
+ * component. Not thread safe, called by the thread making the Cosa call.
+ *
+ * @param component the component name.
+ * @return CCSP_SUCCESS or JSE_COSA_ERR_CIRCUIT_OPEN.
+ */
+int jse_cosa_guard_allow(const char * component);
+
+/**
+ * @brief Records the outcome of a call to a component.
+ *
+ * Timeouts and bus errors count as failures, parameter faults do not.
+ *
+ * @param component the component name.
+ * @param status the CCSP status of the call.
+ */
+void jse_cosa_guard_report(const char * component, int status);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,1256 @@
+/*****************************************************************************
+*
+* Copyright 2020 Liberty Global B.V.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <duktape.h>
+
+#include "jse_debug.h"
+#include "jse_common.h"
+#include "jse_cosa_types.h"
+#include "jse_cosa_bus.h"
+#include "jse_cosa_mock.h"
+
+/** The instance number of table row templates */
+#define TEMPLATE_INSTANCE "{i}"
+
+/** A component */
+typedef struct mock_component_s
+{
+    char * name;
+    char * path;
+    /** The latency of each call or -1 to use the default */
+    long latency;
+} mock_component_t;
+
+/** A parameter */
+typedef struct mock_param_s
+{
+    char * name;
+    char * value;
+    /** The value set but not yet committed or NULL */
+    char * pending;
+    enum dataType_e type;
+    /** The index of the owning component */
+    int component;
+} mock_param_t;
+
+/** The snapshot filename */
+static const char * snapshot_file = NULL;
+
+/** The default latency of each call */
+static long default_latency = 0;
+
+/** The components */
+static mock_component_t * components = NULL;
+static int component_count = 0;
+
+/** The parameters, sorted by name */
+static mock_param_t * params = NULL;
+static int param_count = 0;
+static int param_size = 0;
+
+/** Protects the parameters, which are read concurrently */
+static pthread_rwlock_t params_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/**
+ * @brief Compares parameters by name.
+ *
+ * @param a the first parameter.
+ * @param b the second parameter.
+ * @return <0, 0 or >0 as for strcmp().
+ */
+static int compare_params(const void * a, const void * b)
+{
+    return strcmp(((const mock_param_t *)a)->name, ((const mock_param_t *)b)->name);
+}
+
+/**
+ * @brief Finds the first parameter at or after a name.
+ *
+ * @param name the name.
+ * @return the index of the parameter or param_count.
+ */
+static int lower_bound(const char * name)
+{
+    int low = 0;
+    int high = param_count;
+
+    while (low < high)
+    {
+        int mid = low + (high - low) / 2;
+
+        if (strcmp(params[mid].name, name) < 0)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+/**
+ * @brief Finds a parameter.
+ *
+ * @param name the full name.
+ * @return the index of the parameter or -1 if not found.
+ */
+static int find_param(const char * name)
+{
+    int i = lower_bound(name);
+
+    return i < param_count && strcmp(params[i].name, name) == 0 ? i : -1;
+}
+
+/**
+ * @brief Returns whether a name starts with a prefix.
+ *
+ * @param name the name.
+ * @param prefix the prefix.
+ * @return true if it does.
+ */
+static bool has_prefix(const char * name, const char * prefix)
+{
+    return strncmp(name, prefix, strlen(prefix)) == 0;
+}
+
+/**
+ * @brief Finds a component by name.
+ *
+ * @param name the component name.
+ * @return the index of the component or -1 if not found.
+ */
+static int find_component(const char * name)
+{
+    int i;
+
+    for (i = 0; i < component_count; i++)
+    {
+        if (strcmp(components[i].name, name) == 0)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Simulates the time a call to a component takes.
+ *
+ * @param component the index of the component or -1 for the CR.
+ */
+static void delay(int component)
+{
+    long usec = default_latency;
+
+    if (component >= 0 && components[component].latency >= 0)
+    {
+        usec = components[component].latency;
+    }
+
+    if (usec > 0)
+    {
+        (void) usleep((useconds_t)usec);
+    }
+}
+
+/**
+ * @brief Adds a parameter, keeping the array unsorted.
+ *
+ * @param name the name, copied.
+ * @param value the value, copied.
+ * @param type the type.
+ * @param component the index of the owning component.
+ * @return 0 on success or -1 on error.
+ */
+static int add_param(const char * name, const char * value, enum dataType_e type, int component)
+{
+    mock_param_t * param = NULL;
+
+    if (param_count == param_size)
+    {
+        int size = param_size > 0 ? param_size * 2 : 64;
+        mock_param_t * grown = (mock_param_t *)realloc(params, (size_t)size * sizeof(mock_param_t));
+        if (grown == NULL)
+        {
+            JSE_ERROR("realloc() failed: %s", strerror(errno))
+            return -1;
+        }
+
+        params = grown;
+        param_size = size;
+    }
+
+    param = &params[param_count];
+    param->name = strdup(name);
+    param->value = strdup(value);
+    param->pending = NULL;
+    param->type = type;
+    param->component = component;
+
+    if (param->name == NULL || param->value == NULL)
+    {
+        JSE_ERROR("strdup() failed: %s", strerror(errno))
+        free(param->name);
+        free(param->value);
+        return -1;
+    }
+
+    param_count++;
+    return 0;
+}
+
+/**
+ * @brief Frees a parameter.
+ *
+ * @param param the parameter.
+ */
+static void free_param(mock_param_t * param)
+{
+    free(param->name);
+    free(param->value);
+    free(param->pending);
+}
+
+/**
+ * @brief Adds a component.
+ *
+ * @param name the component name, copied.
+ * @param latency the latency of each call or -1 for the default.
+ * @return the index of the component or -1 on error.
+ */
+static int add_component(const char * name, long latency)
+{
+    mock_component_t * grown = NULL;
+    char * path = NULL;
+    char * p = NULL;
+
+    grown = (mock_component_t *)realloc(components, (size_t)(component_count + 1) * sizeof(mock_component_t));
+    if (grown == NULL)
+    {
+        JSE_ERROR("realloc() failed: %s", strerror(errno))
+        return -1;
+    }
+    components = grown;
+
+    /* The D-Bus path of eRT.com.cisco.x is /eRT/com/cisco/x */
+    path = (char *)malloc(strlen(name) + 2);
+    if (path == NULL)
+    {
+        JSE_ERROR("malloc() failed: %s", strerror(errno))
+        return -1;
+    }
+
+    path[0] = '/';
+    strcpy(&path[1], name);
+    for (p = path; *p != '\0'; p++)
+    {
+        if (*p == '.')
+        {
+            *p = '/';
+        }
+    }
+
+    components[component_count].name = strdup(name);
+    components[component_count].path = path;
+    components[component_count].latency = latency;
+
+    if (components[component_count].name == NULL)
+    {
+        JSE_ERROR("strdup() failed: %s", strerror(errno))
+        free(path);
+        return -1;
+    }
+
+    return component_count++;
+}
+
+/**
+ * @brief Returns the type of a JSON value.
+ *
+ * @param ctx the duktape context.
+ * @param idx the index of the value.
+ * @param pType a pointer to return the type.
+ * @return 0 on success or -1 if the value is not a string, boolean or number.
+ */
+static int value_type(duk_context * ctx, duk_idx_t idx, enum dataType_e * pType)
+{
+    if (duk_is_string(ctx, idx))
+    {
+        *pType = ccsp_string;
+    }
+    else if (duk_is_boolean(ctx, idx))
+    {
+        *pType = ccsp_boolean;
+    }
+    else if (duk_is_number(ctx, idx))
+    {
+        double number = duk_get_number(ctx, idx);
+
+        if (number != floor(number) || number < -2147483648.0 || number > 4294967295.0)
+        {
+            *pType = ccsp_double;
+        }
+        else
+        {
+            *pType = number < 0 ? ccsp_int : ccsp_unsignedInt;
+        }
+    }
+    else
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Adds the parameters of a component from the snapshot.
+ *
+ * @param ctx the duktape context with the parameters object on the top.
+ * @param component the index of the component.
+ * @return 0 on success or -1 on error.
+ */
+static int load_params(duk_context * ctx, int component)
+{
+    int ret = 0;
+
+    duk_enum(ctx, -1, DUK_ENUM_OWN_PROPERTIES_ONLY);
+
+    while (ret == 0 && duk_next(ctx, -1, 1))
+    {
+        const char * name = duk_get_string(ctx, -2);
+        enum dataType_e type = ccsp_string;
+
+        if (duk_is_array(ctx, -1))
+        {
+            (void) duk_get_prop_index(ctx, -1, 0);
+            if (jse_cosa_bus_parse_type(duk_safe_to_string(ctx, -1), &type) != 0)
+            {
+                JSE_ERROR("%s: bad type for %s", snapshot_file, name)
+                ret = -1;
+            }
+            duk_pop(ctx);
+
+            (void) duk_get_prop_index(ctx, -1, 1);
+            duk_remove(ctx, -2);
+        }
+        else if (value_type(ctx, -1, &type) != 0)
+        {
+            JSE_ERROR("%s: bad value for %s", snapshot_file, name)
+            ret = -1;
+        }
+
+        if (ret == 0)
+        {
+            ret = add_param(name, duk_safe_to_string(ctx, -1), type, component);
+        }
+
+        duk_pop_2(ctx);
+    }
+
+    duk_pop(ctx);
+
+    return ret;
+}
+
+/**
+ * @brief Parses the snapshot.
+ *
+ * @param ctx the duktape context with the snapshot text on the top.
+ * @param udata unused.
+ * @return 1, the snapshot object.
+ */
+static duk_ret_t decode_snapshot(duk_context * ctx, void * udata)
+{
+    (void) udata;
+
+    duk_json_decode(ctx, -1);
+    return 1;
+}
+
+/**
+ * @brief Loads the snapshot.
+ *
+ * @return 0 on success or -1 on error.
+ */
+static int load_snapshot(void)
+{
+    duk_context * ctx = NULL;
+    void * buffer = NULL;
+    size_t size = 0;
+    int ret = 0;
+    int i;
+
+    if (snapshot_file == NULL)
+    {
+        JSE_ERROR("No Cosa mock snapshot!")
+        return -1;
+    }
+
+    if (jse_read_file(snapshot_file, &buffer, &size) < 0)
+    {
+        JSE_ERROR("Failed to read %s", snapshot_file)
+        return -1;
+    }
+
+    ctx = duk_create_heap(NULL, NULL, NULL, NULL, NULL);
+    if (ctx == NULL)
+    {
+        JSE_ERROR("Failed to create the duktape heap!")
+        free(buffer);
+        return -1;
+    }
+
+    (void) duk_push_lstring(ctx, (const char *)buffer, size);
+    free(buffer);
+
+    if (duk_safe_call(ctx, decode_snapshot, NULL, 1, 1) != DUK_EXEC_SUCCESS || !duk_is_object(ctx, -1))
+    {
+        JSE_ERROR("%s: %s", snapshot_file, duk_safe_to_string(ctx, -1))
+        duk_destroy_heap(ctx);
+        return -1;
+    }
+
+    duk_enum(ctx, -1, DUK_ENUM_OWN_PROPERTIES_ONLY);
+
+    while (ret == 0 && duk_next(ctx, -1, 1))
+    {
+        int component = -1;
+
+        (void) duk_get_prop_string(ctx, -1, "latency");
+        component = add_component(duk_get_string(ctx, -3), (long)duk_get_number_default(ctx, -1, -1));
+        duk_pop(ctx);
+
+        if (component < 0)
+        {
+            ret = -1;
+        }
+        else if (duk_get_prop_string(ctx, -1, "parameters") && duk_is_object(ctx, -1))
+        {
+            ret = load_params(ctx, component);
+        }
+        else
+        {
+            JSE_WARNING("%s: %s has no parameters", snapshot_file, components[component].name)
+            duk_pop(ctx);
+        }
+
+        duk_pop_2(ctx);
+    }
+
+    duk_destroy_heap(ctx);
+
+    if (ret == 0 && param_count > 0)
+    {
+        qsort(params, (size_t)param_count, sizeof(mock_param_t), compare_params);
+
+        for (i = 1; i < param_count; i++)
+        {
+            if (strcmp(params[i - 1].name, params[i].name) == 0)
+            {
+                JSE_ERROR("%s: %s is defined twice", snapshot_file, params[i].name)
+                ret = -1;
+                break;
+            }
+        }
+    }
+
+    JSE_DEBUG("Loaded %d components and %d parameters from %s", component_count, param_count, snapshot_file)
+
+    return ret;
+}
+
+/**
+ * @brief Returns the default value of a new parameter.
+ *
+ * @param type the parameter type.
+ * @return the value.
+ */
+static const char * default_value(enum dataType_e type)
+{
+    switch (type)
+    {
+        case ccsp_string:
+        case ccsp_base64:
+            return "";
+        case ccsp_boolean:
+            return "false";
+        case ccsp_dateTime:
+            return "0001-01-01T00:00:00Z";
+        default:
+            return "0";
+    }
+}
+
+/**
+ * @brief Checks a value is valid for a type.
+ *
+ * @param value the value.
+ * @param type the type.
+ * @return true if valid.
+ */
+static bool valid_value(const char * value, enum dataType_e type)
+{
+    char * end = NULL;
+
+    switch (type)
+    {
+        case ccsp_boolean:
+            return strcmp(value, "true") == 0 || strcmp(value, "false") == 0 ||
+                strcmp(value, "1") == 0 || strcmp(value, "0") == 0;
+        case ccsp_int:
+        case ccsp_long:
+            (void) strtoll(value, &end, 10);
+            break;
+        case ccsp_unsignedInt:
+        case ccsp_unsignedLong:
+        case ccsp_byte:
+            if (value[0] == '-')
+            {
+                return false;
+            }
+            (void) strtoull(value, &end, 10);
+            break;
+        case ccsp_float:
+        case ccsp_double:
+            (void) strtod(value, &end);
+            break;
+        default:
+            return true;
+    }
+
+    return end != value && *end == '\0';
+}
+
+/**
+ * @brief Returns the instance number of the next row name component.
+ *
+ * @param name the rest of the name after the table name.
+ * @return the instance number or 0 if not a row.
+ */
+static unsigned int row_instance(const char * name)
+{
+    char * end = NULL;
+    unsigned long instance = strtoul(name, &end, 10);
+
+    if (end == name || (*end != '.' && *end != '\0') || instance == 0 || instance > 0xffffffffUL)
+    {
+        return 0;
+    }
+
+    return (unsigned int)instance;
+}
+
+/**
+ * @brief Initialises the mock backend.
+ *
+ * @return 0 on success or -1 on error.
+ */
+static int mock_init(void)
+{
+    if (load_snapshot() != 0)
+    {
+        JSE_ERROR("Failed to load the Cosa mock snapshot!")
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Shuts down the mock backend.
+ */
+static void mock_shutdown(void)
+{
+    int i;
+
+    for (i = 0; i < param_count; i++)
+    {
+        free_param(&params[i]);
+    }
+
+    for (i = 0; i < component_count; i++)
+    {
+        free(components[i].name);
+        free(components[i].path);
+    }
+
+    free(params);
+    free(components);
+
+    params = NULL;
+    param_count = 0;
+    param_size = 0;
+    components = NULL;
+    component_count = 0;
+}
+
+/**
+ * @brief Locates the component supporting a name.
+ *
+ * @param pSystemPrefix unused.
+ * @param pObjName the parameter or object name.
+ * @param ppComponent a pointer to return the component name.
+ * @param ppPath a pointer to return the component D-Bus path.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int mock_discover(const char * pSystemPrefix, char * pObjName, char ** ppComponent, char ** ppPath)
+{
+    int ret = CCSP_CR_ERR_UNSUPPORTED_NAMESPACE;
+    int i;
+
+    (void) pSystemPrefix;
+
+    delay(-1);
+
+    pthread_rwlock_rdlock(&params_lock);
+
+    i = lower_bound(pObjName);
+    if (i < param_count && has_prefix(params[i].name, pObjName))
+    {
+        *ppComponent = strdup(components[params[i].component].name);
+        *ppPath = strdup(components[params[i].component].path);
+
+        if (*ppComponent != NULL && *ppPath != NULL)
+        {
+            ret = CCSP_SUCCESS;
+        }
+        else
+        {
+            free(*ppComponent);
+            free(*ppPath);
+            ret = CCSP_ERR_MEMORY_ALLOC_FAIL;
+        }
+    }
+
+    pthread_rwlock_unlock(&params_lock);
+
+    return ret;
+}
+
+/**
+ * @brief Frees values.
+ *
+ * @param valCount the number of values.
+ * @param ppVals the values.
+ */
+static void mock_free_values(int valCount, parameterValStruct_t ** ppVals)
+{
+    int i;
+
+    for (i = 0; i < valCount; i++)
+    {
+        if (ppVals[i] != NULL)
+        {
+            free(ppVals[i]->parameterName);
+            free(ppVals[i]->parameterValue);
+            free(ppVals[i]);
+        }
+    }
+
+    free(ppVals);
+}
+
+/**
+ * @brief Adds a value to those returned.
+ *
+ * @param pppVals a pointer to the values.
+ * @param pValCount a pointer to the number of values.
+ * @param pSize a pointer to the size of the values array.
+ * @param param the parameter.
+ * @return 0 on success or -1 on error.
+ */
+static int put_value(parameterValStruct_t *** pppVals, int * pValCount, int * pSize, const mock_param_t * param)
+{
+    parameterValStruct_t * pVal = NULL;
+
+    if (*pValCount == *pSize)
+    {
+        int size = *pSize > 0 ? *pSize * 2 : 16;
+        parameterValStruct_t ** grown =
+            (parameterValStruct_t **)realloc(*pppVals, (size_t)size * sizeof(parameterValStruct_t *));
+        if (grown == NULL)
+        {
+            JSE_ERROR("realloc() failed: %s", strerror(errno))
+            return -1;
+        }
+
+        *pppVals = grown;
+        *pSize = size;
+    }
+
+    pVal = (parameterValStruct_t *)calloc(1, sizeof(parameterValStruct_t));
+    if (pVal == NULL)
+    {
+        JSE_ERROR("calloc() failed: %s", strerror(errno))
+        return -1;
+    }
+
+    (*pppVals)[(*pValCount)++] = pVal;
+
+    pVal->parameterName = strdup(param->name);
+    pVal->parameterValue = strdup(param->value);
+    pVal->type = param->type;
+
+    if (pVal->parameterName == NULL || pVal->parameterValue == NULL)
+    {
+        JSE_ERROR("strdup() failed: %s", strerror(errno))
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Gets parameter values from a component.
+ *
+ * Names ending in '.' get every parameter below them.
+ *
+ * @param pSystemPrefix unused.
+ * @param pComponent the component name.
+ * @param pPath unused.
+ * @param ppNames the parameter names.
+ * @param count the number of names.
+ * @param pValCount a pointer to return the number of values.
+ * @param pppVals a pointer to return the values.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int mock_get_values(const char * pSystemPrefix, const char * pComponent, char * pPath,
+    char ** ppNames, int count, int * pValCount, parameterValStruct_t *** pppVals)
+{
+    parameterValStruct_t ** ppVals = NULL;
+    int valCount = 0;
+    int size = 0;
+    int ret = CCSP_SUCCESS;
+    int component = find_component(pComponent);
+    int i;
+    int j;
+
+    (void) pSystemPrefix;
+    (void) pPath;
+
+    delay(component);
+
+    pthread_rwlock_rdlock(&params_lock);
+
+    for (i = 0; ret == CCSP_SUCCESS && i < count; i++)
+    {
+        size_t length = strlen(ppNames[i]);
+        bool found = false;
+
+        if (length > 0 && ppNames[i][length - 1] == '.')
+        {
+            for (j = lower_bound(ppNames[i]); j < param_count && has_prefix(params[j].name, ppNames[i]); j++)
+            {
+                found = params[j].component == component;
+                if (!found)
+                {
+                    break;
+                }
+
+                if (strstr(params[j].name, TEMPLATE_INSTANCE) == NULL && put_value(&ppVals, &valCount, &size, &params[j]) != 0)
+                {
+                    ret = CCSP_ERR_MEMORY_ALLOC_FAIL;
+                    break;
+                }
+            }
+        }
+        else if ((j = find_param(ppNames[i])) >= 0 && params[j].component == component &&
+            strstr(ppNames[i], TEMPLATE_INSTANCE) == NULL)
+        {
+            found = true;
+
+            if (put_value(&ppVals, &valCount, &size, &params[j]) != 0)
+            {
+                ret = CCSP_ERR_MEMORY_ALLOC_FAIL;
+            }
+        }
+
+        if (ret == CCSP_SUCCESS && !found)
+        {
+            /* Not a name, or one owned by another component */
+            ret = CCSP_ERR_INVALID_PARAMETER_NAME;
+        }
+    }
+
+    pthread_rwlock_unlock(&params_lock);
+
+    if (ret != CCSP_SUCCESS)
+    {
+        mock_free_values(valCount, ppVals);
+        return ret;
+    }
+
+    *pValCount = valCount;
+    *pppVals = ppVals;
+
+    return CCSP_SUCCESS;
+}
+
+/**
+ * @brief Sets parameter values of a component.
+ *
+ * @param pSystemPrefix unused.
+ * @param pComponent the component name.
+ * @param pPath unused.
+ * @param pVals the values.
+ * @param count the number of values.
+ * @param commit set true to commit the values.
+ * @param ppFaultName a pointer to return the name of a rejected parameter.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int mock_set_values(const char * pSystemPrefix, const char * pComponent, char * pPath,
+    parameterValStruct_t * pVals, int count, bool commit, char ** ppFaultName)
+{
+    int ret = CCSP_SUCCESS;
+    int component = find_component(pComponent);
+    int i;
+    int j;
+
+    (void) pSystemPrefix;
+    (void) pPath;
+
+    delay(component);
+
+    pthread_rwlock_wrlock(&params_lock);
+
+    /* Nothing is set unless every value is valid */
+    for (i = 0; i < count; i++)
+    {
+        j = find_param(pVals[i].parameterName);
+
+        if (j < 0 || params[j].component != component || strstr(params[j].name, TEMPLATE_INSTANCE) != NULL)
+        {
+            ret = CCSP_ERR_INVALID_PARAMETER_NAME;
+        }
+        else if (pVals[i].type != params[j].type)
+        {
+            ret = CCSP_ERR_INVALID_PARAMETER_TYPE;
+        }
+        else if (!valid_value(pVals[i].parameterValue, params[j].type))
+        {
+            ret = CCSP_ERR_INVALID_PARAMETER_VALUE;
+        }
+
+        if (ret != CCSP_SUCCESS)
+        {
+            if (ppFaultName != NULL)
+            {
+                *ppFaultName = strdup(pVals[i].parameterName);
+            }
+            break;
+        }
+    }
+
+    for (i = 0; ret == CCSP_SUCCESS && i < count; i++)
+    {
+        char * value = strdup(pVals[i].parameterValue);
+        if (value == NULL)
+        {
+            ret = CCSP_ERR_MEMORY_ALLOC_FAIL;
+            break;
+        }
+
+        j = find_param(pVals[i].parameterName);
+
+        if (commit)
+        {
+            free(params[j].value);
+            params[j].value = value;
+        }
+        else
+        {
+            free(params[j].pending);
+            params[j].pending = value;
+        }
+    }
+
+    pthread_rwlock_unlock(&params_lock);
+
+    return ret;
+}
+
+/**
+ * @brief Commits or discards the values set on a component.
+ *
+ * @param pComponent the component name.
+ * @param pPath unused.
+ * @param commit set true to commit, false to discard.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int mock_set_commit(const char * pComponent, char * pPath, bool commit)
+{
+    int component = find_component(pComponent);
+    int i;
+
+    (void) pPath;
+
+    if (component < 0)
+    {
+        return CCSP_ERR_NOT_CONNECT;
+    }
+
+    delay(component);
+
+    pthread_rwlock_wrlock(&params_lock);
+
+    for (i = 0; i < param_count; i++)
+    {
+        if (params[i].component == component && params[i].pending != NULL)
+        {
+            if (commit)
+            {
+                free(params[i].value);
+                params[i].value = params[i].pending;
+            }
+            else
+            {
+                free(params[i].pending);
+            }
+
+            params[i].pending = NULL;
+        }
+    }
+
+    pthread_rwlock_unlock(&params_lock);
+
+    return CCSP_SUCCESS;
+}
+
+/**
+ * @brief Compares instance numbers.
+ *
+ * @param a the first instance number.
+ * @param b the second instance number.
+ * @return <0, 0 or >0.
+ */
+static int compare_instances(const void * a, const void * b)
+{
+    unsigned int x = *(const unsigned int *)a;
+    unsigned int y = *(const unsigned int *)b;
+
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/**
+ * @brief Collects the instance numbers of a table.
+ *
+ * Called with the lock held.
+ *
+ * @param pObjName the table name, ending in '.'.
+ * @param pCount a pointer to return the number of instances.
+ * @param ppInstances a pointer to return the sorted instance numbers.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int collect_instances(const char * pObjName, unsigned int * pCount, unsigned int ** ppInstances)
+{
+    size_t length = strlen(pObjName);
+    unsigned int * pInstances = NULL;
+    unsigned int count = 0;
+    unsigned int size = 0;
+    bool found = false;
+    int i;
+
+    for (i = lower_bound(pObjName); i < param_count && has_prefix(params[i].name, pObjName); i++)
+    {
+        unsigned int instance = row_instance(&params[i].name[length]);
+
+        found = true;
+
+        if (instance == 0)
+        {
+            continue;
+        }
+
+        /* The rows of each instance are sorted together, as text */
+        if (count > 0 && pInstances[count - 1] == instance)
+        {
+            continue;
+        }
+
+        if (count == size)
+        {
+            unsigned int * grown = NULL;
+
+            size = size > 0 ? size * 2 : 8;
+            grown = (unsigned int *)realloc(pInstances, size * sizeof(unsigned int));
+            if (grown == NULL)
+            {
+                JSE_ERROR("realloc() failed: %s", strerror(errno))
+                free(pInstances);
+                return CCSP_ERR_MEMORY_ALLOC_FAIL;
+            }
+
+            pInstances = grown;
+        }
+
+        pInstances[count++] = instance;
+    }
+
+    if (!found)
+    {
+        return CCSP_ERR_INVALID_PARAMETER_NAME;
+    }
+
+    if (count > 0)
+    {
+        qsort(pInstances, count, sizeof(unsigned int), compare_instances);
+    }
+
+    *pCount = count;
+    *ppInstances = pInstances;
+
+    return CCSP_SUCCESS;
+}
+
+/**
+ * @brief Gets the instance numbers of a table.
+ *
+ * @param pComponent the component name.
+ * @param pPath unused.
+ * @param pObjName the table name.
+ * @param pCount a pointer to return the number of instances.
+ * @param ppInstances a pointer to return the instance numbers.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int mock_get_instances(const char * pComponent, char * pPath, char * pObjName,
+    unsigned int * pCount, unsigned int ** ppInstances)
+{
+    int ret;
+
+    (void) pPath;
+
+    delay(find_component(pComponent));
+
+    pthread_rwlock_rdlock(&params_lock);
+    ret = collect_instances(pObjName, pCount, ppInstances);
+    pthread_rwlock_unlock(&params_lock);
+
+    return ret;
+}
+
+/**
+ * @brief Returns whether a table has a template row.
+ *
+ * Called with the lock held.
+ *
+ * @param pObjName the table name, ending in '.'.
+ * @return true if it has.
+ */
+static bool has_template(const char * pObjName)
+{
+    char name[256];
+    int i;
+
+    snprintf(name, sizeof(name), "%s%s.", pObjName, TEMPLATE_INSTANCE);
+    i = lower_bound(name);
+
+    return i < param_count && has_prefix(params[i].name, name);
+}
+
+/**
+ * @brief Adds a row to a table.
+ *
+ * The columns are those of the {i} template row, if there is one,
+ * otherwise those of the last row, with default values.
+ *
+ * @param pSystemPrefix unused.
+ * @param pComponent the component name.
+ * @param pPath unused.
+ * @param pObjName the table name.
+ * @param pInstance a pointer to return the instance number.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int mock_add_row(const char * pSystemPrefix, const char * pComponent, char * pPath, char * pObjName, int * pInstance)
+{
+    size_t length = strlen(pObjName);
+    int component = find_component(pComponent);
+    unsigned int * pInstances = NULL;
+    unsigned int count = 0;
+    unsigned int instance = 0;
+    char source[16];
+    char * name = NULL;
+    int first = param_count;
+    int ret;
+    int i;
+
+    (void) pSystemPrefix;
+    (void) pPath;
+
+    delay(component);
+
+    pthread_rwlock_wrlock(&params_lock);
+
+    ret = collect_instances(pObjName, &count, &pInstances);
+    if (ret != CCSP_SUCCESS)
+    {
+        pthread_rwlock_unlock(&params_lock);
+        return ret;
+    }
+
+    instance = count > 0 ? pInstances[count - 1] + 1 : 1;
+
+    /* Copy the columns of the template, or the last row */
+    snprintf(source, sizeof(source), "%s.", TEMPLATE_INSTANCE);
+    if (count > 0 && !has_template(pObjName))
+    {
+        snprintf(source, sizeof(source), "%u.", pInstances[count - 1]);
+    }
+
+    free(pInstances);
+
+    for (i = lower_bound(pObjName); ret == CCSP_SUCCESS && i < first && has_prefix(params[i].name, pObjName); i++)
+    {
+        const char * column = &params[i].name[length];
+
+        if (!has_prefix(column, source))
+        {
+            continue;
+        }
+
+        column += strlen(source);
+
+        name = (char *)malloc(length + 12 + strlen(column));
+        if (name == NULL)
+        {
+            JSE_ERROR("malloc() failed: %s", strerror(errno))
+            ret = CCSP_ERR_MEMORY_ALLOC_FAIL;
+            break;
+        }
+
+        sprintf(name, "%s%u.%s", pObjName, instance, column);
+
+        if (add_param(name, default_value(params[i].type), params[i].type, params[i].component) != 0)
+        {
+            ret = CCSP_ERR_MEMORY_ALLOC_FAIL;
+        }
+
+        free(name);
+    }
+
+    if (ret == CCSP_SUCCESS && param_count == first)
+    {
+        /* Neither a template nor a row to copy */
+        ret = CCSP_ERR_NOT_SUPPORT;
+    }
+
+    if (ret != CCSP_SUCCESS)
+    {
+        while (param_count > first)
+        {
+            free_param(&params[--param_count]);
+        }
+    }
+    else
+    {
+        qsort(params, (size_t)param_count, sizeof(mock_param_t), compare_params);
+        *pInstance = (int)instance;
+    }
+
+    pthread_rwlock_unlock(&params_lock);
+
+    return ret;
+}
+
+/**
+ * @brief Deletes a row from a table.
+ *
+ * @param pSystemPrefix unused.
+ * @param pComponent the component name.
+ * @param pPath unused.
+ * @param pObjName the row name.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int mock_delete_row(const char * pSystemPrefix, const char * pComponent, char * pPath, char * pObjName)
+{
+    int first;
+    int last;
+
+    (void) pSystemPrefix;
+    (void) pPath;
+
+    delay(find_component(pComponent));
+
+    pthread_rwlock_wrlock(&params_lock);
+
+    first = lower_bound(pObjName);
+    for (last = first; last < param_count && has_prefix(params[last].name, pObjName); last++)
+    {
+        free_param(&params[last]);
+    }
+
+    if (last > first)
+    {
+        memmove(&params[first], &params[last], (size_t)(param_count - last) * sizeof(mock_param_t));
+        param_count -= last - first;
+    }
+
+    pthread_rwlock_unlock(&params_lock);
+
+    return last > first ? CCSP_SUCCESS : CCSP_ERR_INVALID_PARAMETER_NAME;
+}
+
+/**
+ * @brief Sets the data model snapshot loaded by the mock backend.
+ *
+ * @param filename the snapshot filename.
+ */
+void jse_cosa_mock_set_snapshot(const char * filename)
+{
+    snapshot_file = filename;
+}
+
+/**
+ * @brief Sets the latency of calls to components without their own.
+ *
+ * @param usec the latency in microseconds.
+ */
+void jse_cosa_mock_set_latency(long usec)
+{
+    default_latency = usec > 0 ? usec : 0;
+}
+
+/** The in-process mock data model */
+const jse_cosa_backend_t jse_cosa_mock_backend = {
+    "mock",
+    true,
+    mock_init,
+    mock_shutdown,
+    mock_discover,
+    NULL,
+    NULL,
+    mock_get_values,
+    mock_free_values,
+    mock_set_values,
+    mock_set_commit,
+    mock_get_instances,
+    mock_add_row,
+    mock_delete_row
+};
@@ -0,0 +1,65 @@
+/*****************************************************************************
+*
+* Copyright 2020 Liberty Global B.V.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*****************************************************************************/
+
+#ifndef JSE_COSA_MOCK_H
+#define JSE_COSA_MOCK_H
+
+#include "jse_cosa_backend.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/**
+ * @brief Sets the data model snapshot loaded by the mock backend.
+ *
+ * The snapshot is a JSON object of components, each with the parameters it
+ * owns and, optionally, the latency of each call to it in microseconds:
+ *
+ *     {
+ *       "eRT.com.cisco.spvtg.ccsp.pam": {
+ *         "latency": 2000,
+ *         "parameters": {
+ *           "Device.DeviceInfo.SoftwareVersion": "1.0",
+ *           "Device.DeviceInfo.UpTime": ["unsignedInt", 3600],
+ *           "Device.Hosts.Host.{i}.Active": false
+ *         }
+ *       }
+ *     }
+ *
+ * A value is a string, boolean or number, or an array of a type name, as
+ * used by DmExtSetStrsWithRootObj(), and the value. Numbers are int,
+ * unsignedInt or double. A table row with the instance number {i} is the
+ * template for rows added by AddTblRow().
+ *
+ * @param filename the snapshot filename.
+ */
+void jse_cosa_mock_set_snapshot(const char *filename);
+
+/**
+ * @brief Sets the latency of calls to components without their own.
+ *
+ * @param usec the latency in microseconds.
+ */
+void jse_cosa_mock_set_latency(long usec);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
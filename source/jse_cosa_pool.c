@@ -0,0 +1,424 @@
+/*****************************************************************************
+*
+* Copyright 2020 Liberty Global B.V.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "jse_debug.h"
+#include "jse_cosa_pool.h"
+
+/** A task submitted to run on its own */
+struct pool_task_s
+{
+    jse_cosa_pool_func_t func;
+    void * arg;
+    struct pool_task_s * next;
+};
+
+typedef struct pool_task_s pool_task_t;
+
+/** The number of worker threads to start for batches */
+static int pool_max = JSE_COSA_POOL_DEFAULT_THREADS;
+
+/** The worker threads */
+static pthread_t pool_threads[JSE_COSA_POOL_MAX_THREADS];
+
+/** Set for each worker thread while it runs a submitted task */
+static bool pool_busy[JSE_COSA_POOL_MAX_THREADS];
+
+/** The number of worker threads started */
+static int pool_size = 0;
+
+/** The number of worker threads waiting for work */
+static int pool_idle = 0;
+
+/** Set to stop the worker threads */
+static bool pool_stopping = false;
+
+/** Changed by each shutdown so that workers left running a task exit */
+static unsigned int pool_generation = 0;
+
+/** Protects the batch and the submitted tasks */
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Signalled when a batch starts, a task is submitted or the pool stops */
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+
+/** Signalled when the last task of a batch finishes */
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+
+/** The batch being run */
+static jse_cosa_pool_func_t batch_func = NULL;
+static unsigned char * batch_args = NULL;
+static size_t batch_arg_size = 0;
+static int batch_count = 0;
+
+/** The next task to run */
+static int batch_next = 0;
+
+/** The number of tasks not yet finished */
+static int batch_remaining = 0;
+
+/** The submitted tasks not yet started, in order */
+static pool_task_t * task_first = NULL;
+static pool_task_t * task_last = NULL;
+static int task_count = 0;
+
+/**
+ * @brief Runs the next task of the batch, if any.
+ *
+ * Called with the mutex locked, which is released while the task runs.
+ *
+ * @return true if a task was run.
+ */
+static bool run_next(void)
+{
+    int i;
+
+    if (batch_next >= batch_count)
+    {
+        return false;
+    }
+
+    i = batch_next++;
+
+    pthread_mutex_unlock(&pool_mutex);
+    batch_func(&batch_args[(size_t)i * batch_arg_size]);
+    pthread_mutex_lock(&pool_mutex);
+
+    if (--batch_remaining == 0)
+    {
+        pthread_cond_signal(&done_cond);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Runs the next submitted task, if any.
+ *
+ * Called with the mutex locked, which is released while the task runs.
+ *
+ * @param index the index of the worker thread.
+ * @param generation the generation the worker thread was started in.
+ * @return true if a task was run.
+ */
+static bool run_task(int index, unsigned int generation)
+{
+    pool_task_t * task = task_first;
+
+    if (task == NULL)
+    {
+        return false;
+    }
+
+    task_first = task->next;
+    if (task_first == NULL)
+    {
+        task_last = NULL;
+    }
+    task_count--;
+
+    pool_busy[index] = true;
+
+    pthread_mutex_unlock(&pool_mutex);
+    task->func(task->arg);
+    free(task);
+    pthread_mutex_lock(&pool_mutex);
+
+    /* The pool may have been shut down and the slot reused */
+    if (generation == pool_generation)
+    {
+        pool_busy[index] = false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief The worker thread.
+ *
+ * @param arg the index of the worker thread.
+ * @return NULL.
+ */
+static void * worker(void * arg)
+{
+    int index = (int)(intptr_t)arg;
+    unsigned int generation;
+
+    pthread_mutex_lock(&pool_mutex);
+
+    generation = pool_generation;
+
+    while (!pool_stopping && generation == pool_generation)
+    {
+        if (!run_task(index, generation) && !run_next())
+        {
+            pool_idle++;
+            pthread_cond_wait(&work_cond, &pool_mutex);
+            pool_idle--;
+        }
+    }
+
+    pthread_mutex_unlock(&pool_mutex);
+
+    return NULL;
+}
+
+/**
+ * @brief Starts a worker thread.
+ *
+ * Called with the mutex locked.
+ *
+ * @return true if started.
+ */
+static bool start_worker(void)
+{
+    int ret;
+
+    if (pool_size >= JSE_COSA_POOL_MAX_THREADS)
+    {
+        return false;
+    }
+
+    pool_busy[pool_size] = false;
+
+    ret = pthread_create(&pool_threads[pool_size], NULL, worker, (void *)(intptr_t)pool_size);
+    if (ret != 0)
+    {
+        JSE_ERROR("pthread_create() failed: %s", strerror(ret))
+        return false;
+    }
+
+    pool_size++;
+
+    return true;
+}
+
+/**
+ * @brief Starts the worker threads for batches.
+ *
+ * If not all the threads start the pool runs with those that did.
+ *
+ * Called with the mutex locked.
+ */
+static void start_threads(void)
+{
+    while (pool_size < pool_max && start_worker())
+    {
+    }
+
+    JSE_VERBOSE("%d worker threads started", pool_size)
+}
+
+/**
+ * @brief Sets the number of worker threads.
+ *
+ * Only takes effect before the first batch is run.
+ *
+ * @param threads the number of threads, 0 to run every task on the
+ * calling thread.
+ */
+void jse_cosa_pool_set_threads(int threads)
+{
+    pthread_mutex_lock(&pool_mutex);
+
+    if (pool_size == 0)
+    {
+        pool_max = threads > 0 ? threads : 0;
+        if (pool_max > JSE_COSA_POOL_MAX_THREADS)
+        {
+            pool_max = JSE_COSA_POOL_MAX_THREADS;
+        }
+    }
+
+    pthread_mutex_unlock(&pool_mutex);
+}
+
+/**
+ * @brief Runs a batch of tasks concurrently and waits for them all.
+ *
+ * The calling thread runs tasks too. The worker threads are started by
+ * the first batch of more than one task.
+ *
+ * @param func the task function.
+ * @param args an array of count arguments, one per task.
+ * @param arg_size the size of each argument.
+ * @param count the number of tasks.
+ */
+void jse_cosa_pool_run(jse_cosa_pool_func_t func, void * args, size_t arg_size, int count)
+{
+    int i;
+
+    if (count <= 1 || pool_max == 0)
+    {
+        for (i = 0; i < count; i++)
+        {
+            func((unsigned char *)args + (size_t)i * arg_size);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pool_mutex);
+
+    if (pool_size < pool_max)
+    {
+        start_threads();
+    }
+
+    batch_func = func;
+    batch_args = (unsigned char *)args;
+    batch_arg_size = arg_size;
+    batch_count = count;
+    batch_next = 0;
+    batch_remaining = count;
+
+    pthread_cond_broadcast(&work_cond);
+
+    while (run_next())
+    {
+        /* Help out until no tasks are left to start */
+    }
+
+    while (batch_remaining > 0)
+    {
+        pthread_cond_wait(&done_cond, &pool_mutex);
+    }
+
+    batch_func = NULL;
+    batch_args = NULL;
+    batch_count = 0;
+    batch_next = 0;
+
+    pthread_mutex_unlock(&pool_mutex);
+}
+
+/**
+ * @brief Runs a task on a worker thread without waiting for it.
+ *
+ * A worker thread is started if none is free, up to
+ * JSE_COSA_POOL_MAX_THREADS, after which the task waits for one.
+ *
+ * @param func the task function.
+ * @param arg the task argument.
+ * @return 0 on success or -1 if the task can not be run.
+ */
+int jse_cosa_pool_submit(jse_cosa_pool_func_t func, void * arg)
+{
+    pool_task_t * task = (pool_task_t *)calloc(1, sizeof(pool_task_t));
+
+    if (task == NULL)
+    {
+        JSE_ERROR("calloc() failed: %s", strerror(errno))
+        return -1;
+    }
+
+    task->func = func;
+    task->arg = arg;
+
+    pthread_mutex_lock(&pool_mutex);
+
+    if (task_count >= pool_idle)
+    {
+        (void) start_worker();
+    }
+
+    if (pool_size == 0)
+    {
+        pthread_mutex_unlock(&pool_mutex);
+        free(task);
+        return -1;
+    }
+
+    if (task_last != NULL)
+    {
+        task_last->next = task;
+    }
+    else
+    {
+        task_first = task;
+    }
+    task_last = task;
+    task_count++;
+
+    pthread_cond_signal(&work_cond);
+
+    pthread_mutex_unlock(&pool_mutex);
+
+    return 0;
+}
+
+/**
+ * @brief Stops the worker threads.
+ */
+void jse_cosa_pool_shutdown(void)
+{
+    bool busy[JSE_COSA_POOL_MAX_THREADS];
+    int size;
+    int i;
+
+    pthread_mutex_lock(&pool_mutex);
+
+    if (pool_size == 0)
+    {
+        pthread_mutex_unlock(&pool_mutex);
+        return;
+    }
+
+    pool_stopping = true;
+    pthread_cond_broadcast(&work_cond);
+
+    size = pool_size;
+    memcpy(busy, pool_busy, sizeof(busy));
+
+    /* Tasks not yet started are dropped */
+    while (task_first != NULL)
+    {
+        pool_task_t * task = task_first;
+
+        task_first = task->next;
+        free(task);
+    }
+    task_last = NULL;
+    task_count = 0;
+
+    pthread_mutex_unlock(&pool_mutex);
+
+    for (i = 0; i < size; i++)
+    {
+        if (busy[i])
+        {
+            /* Still running a task that may never return */
+            pthread_detach(pool_threads[i]);
+        }
+        else
+        {
+            pthread_join(pool_threads[i], NULL);
+        }
+    }
+
+    pthread_mutex_lock(&pool_mutex);
+    pool_size = 0;
+    pool_stopping = false;
+    pool_generation++;
+    pthread_mutex_unlock(&pool_mutex);
+}
@@ -0,0 +1,84 @@
+/*****************************************************************************
+*
+* Copyright 2020 Liberty Global B.V.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*****************************************************************************/
+
+#ifndef JSE_COSA_POOL_H
+#define JSE_COSA_POOL_H
+
+#include <stdlib.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/** The default number of worker threads */
+#define JSE_COSA_POOL_DEFAULT_THREADS 3
+
+/** The most worker threads started, for batches and submitted tasks */
+#define JSE_COSA_POOL_MAX_THREADS 16
+
+/** A task, called with a pointer to its argument */
+typedef void (*jse_cosa_pool_func_t)(void * arg);
+
+/**
+ * @brief Sets the number of worker threads.
+ *
+ * Only takes effect before the first batch is run.
+ *
+ * @param threads the number of threads, 0 to run every task on the
+ * calling thread.
+ */
+void jse_cosa_pool_set_threads(int threads);
+
+/**
+ * @brief Runs a batch of tasks concurrently and waits for them all.
+ *
+ * The calling thread runs tasks too. The worker threads are started by
+ * the first batch of more than one task.
+ *
+ * @param func the task function.
+ * @param args an array of count arguments, one per task.
+ * @param arg_size the size of each argument.
+ * @param count the number of tasks.
+ */
+void jse_cosa_pool_run(jse_cosa_pool_func_t func, void * args, size_t arg_size, int count);
+
+/**
+ * @brief Runs a task on a worker thread without waiting for it.
+ *
+ * A worker thread is started if none is free, up to
+ * JSE_COSA_POOL_MAX_THREADS, after which the task waits for one. Tasks
+ * not yet started when the pool is shut down are dropped.
+ *
+ * @param func the task function.
+ * @param arg the task argument.
+ * @return 0 on success or -1 if the task can not be run.
+ */
+int jse_cosa_pool_submit(jse_cosa_pool_func_t func, void * arg);
+
+/**
+ * @brief Stops the worker threads.
+ *
+ * Worker threads still running a submitted task are left to finish it.
+ */
+void jse_cosa_pool_shutdown(void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,774 @@
+/*****************************************************************************
+*
+* Copyright 2020 Liberty Global B.V.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*****************************************************************************/
+
+#ifdef BUILD_RBUS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <rbus.h>
+
+#include "jse_debug.h"
+#include "jse_cosa_types.h"
+#include "jse_cosa_cache.h"
+#include "jse_cosa_backend.h"
+#include "jse_cosa_bus.h"
+
+/*
+ * rbus finds the provider of each name itself, so there is no discovery.
+ * Every name is reported as supported by this one pseudo component, which
+ * also makes a batch a single rbus_getExt() call.
+ */
+#define RBUS_COMPONENT "rbus"
+#define RBUS_PATH "/rbus"
+
+/** A hot parameter subscription */
+typedef struct hot_subscription_s
+{
+    /** The name without the subsystem prefix */
+    char * name;
+    char prefix[6];
+} hot_subscription_t;
+
+/** A value set without being committed */
+typedef struct pending_value_s
+{
+    char * name;
+    rbusValue_t value;
+} pending_value_t;
+
+/** The rbus connection */
+static rbusHandle_t rbus_handle = NULL;
+
+/** The hot parameter subscriptions */
+static hot_subscription_t * hot_subscriptions = NULL;
+static int hot_subscription_count = 0;
+
+/**
+ * The values set without being committed. rbus has no separate commit so
+ * they are held here and set, with commit, by jse_cosa_bus_set_commit().
+ */
+static pending_value_t * pending = NULL;
+static int pending_count = 0;
+
+/**
+ * @brief Converts an rbus error to a CCSP status.
+ *
+ * @param error the rbus error.
+ * @return the CCSP status.
+ */
+static int status_from_rbus(rbusError_t error)
+{
+    switch (error)
+    {
+        case RBUS_ERROR_SUCCESS:
+            return CCSP_SUCCESS;
+        case RBUS_ERROR_OUT_OF_RESOURCES:
+            return CCSP_ERR_MEMORY_ALLOC_FAIL;
+        case RBUS_ERROR_TIMEOUT:
+            return CCSP_ERR_TIMEOUT;
+        case RBUS_ERROR_NOT_INITIALIZED:
+        case RBUS_ERROR_BUS_ERROR:
+        case RBUS_ERROR_INVALID_HANDLE:
+        case RBUS_ERROR_DESTINATION_NOT_REACHABLE:
+            return CCSP_ERR_NOT_CONNECT;
+        case RBUS_ERROR_DESTINATION_NOT_FOUND:
+        case RBUS_ERROR_ELEMENT_DOES_NOT_EXIST:
+        case RBUS_ERROR_ELEMENT_NAME_MISSING:
+        case RBUS_ERROR_INVALID_NAMESPACE:
+            return CCSP_ERR_INVALID_PARAMETER_NAME;
+        case RBUS_ERROR_INVALID_INPUT:
+            return CCSP_ERR_INVALID_PARAMETER_VALUE;
+        case RBUS_ERROR_INVALID_OPERATION:
+        case RBUS_ERROR_ACCESS_NOT_ALLOWED:
+            return CCSP_ERR_NOT_SUPPORT;
+        default:
+            return CCSP_FAILURE;
+    }
+}
+
+/**
+ * @brief Converts a CCSP data type to an rbus value type.
+ *
+ * @param type the CCSP type.
+ * @return the rbus type.
+ */
+static rbusValueType_t type_to_rbus(enum dataType_e type)
+{
+    switch (type)
+    {
+        case ccsp_int:
+            return RBUS_INT32;
+        case ccsp_unsignedInt:
+            return RBUS_UINT32;
+        case ccsp_boolean:
+            return RBUS_BOOLEAN;
+        case ccsp_dateTime:
+            return RBUS_DATETIME;
+        case ccsp_base64:
+            return RBUS_BYTES;
+        case ccsp_long:
+            return RBUS_INT64;
+        case ccsp_unsignedLong:
+            return RBUS_UINT64;
+        case ccsp_float:
+            return RBUS_SINGLE;
+        case ccsp_double:
+            return RBUS_DOUBLE;
+        case ccsp_byte:
+            return RBUS_BYTE;
+        default:
+            return RBUS_STRING;
+    }
+}
+
+/**
+ * @brief Converts an rbus value type to a CCSP data type.
+ *
+ * @param type the rbus type.
+ * @return the CCSP type.
+ */
+static enum dataType_e type_from_rbus(rbusValueType_t type)
+{
+    switch (type)
+    {
+        case RBUS_INT8:
+        case RBUS_INT16:
+        case RBUS_INT32:
+            return ccsp_int;
+        case RBUS_UINT8:
+        case RBUS_UINT16:
+        case RBUS_UINT32:
+            return ccsp_unsignedInt;
+        case RBUS_BOOLEAN:
+            return ccsp_boolean;
+        case RBUS_DATETIME:
+            return ccsp_dateTime;
+        case RBUS_BYTES:
+            return ccsp_base64;
+        case RBUS_INT64:
+            return ccsp_long;
+        case RBUS_UINT64:
+            return ccsp_unsignedLong;
+        case RBUS_SINGLE:
+            return ccsp_float;
+        case RBUS_DOUBLE:
+            return ccsp_double;
+        case RBUS_BYTE:
+            return ccsp_byte;
+        default:
+            return ccsp_string;
+    }
+}
+
+/**
+ * @brief Handles value change events of hot parameters.
+ *
+ * This is called on an rbus thread.
+ *
+ * @param handle unused.
+ * @param event the event.
+ * @param subscription the subscription.
+ */
+static void hot_value_changed(rbusHandle_t handle, rbusEvent_t const * event, rbusEventSubscription_t * subscription)
+{
+    hot_subscription_t * hot = (hot_subscription_t *)subscription->userData;
+    rbusValue_t value = NULL;
+    char * str = NULL;
+
+    (void) handle;
+
+    if (event->data == NULL || (value = rbusObject_GetValue(event->data, "value")) == NULL)
+    {
+        return;
+    }
+
+    str = rbusValue_ToString(value, NULL, 0);
+    if (str != NULL)
+    {
+        jse_cosa_cache_notify_hot(hot->prefix, hot->name, str, (int)type_from_rbus(rbusValue_GetType(value)));
+        free(str);
+    }
+}
+
+/**
+ * @brief Subscribes to the value change events of the hot parameters.
+ */
+static void subscribe_hot_parameters(void)
+{
+    char ** names = NULL;
+    int count;
+    int i;
+
+    count = jse_cosa_cache_get_hot_names(&names);
+    if (count == 0)
+    {
+        return;
+    }
+
+    hot_subscriptions = (hot_subscription_t *)calloc((size_t)count, sizeof(hot_subscription_t));
+    if (hot_subscriptions == NULL)
+    {
+        JSE_ERROR("calloc() failed: %s", strerror(errno))
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (hot_subscriptions != NULL)
+        {
+            hot_subscription_t * hot = &hot_subscriptions[hot_subscription_count];
+            char * dotstr = names[i];
+            rbusError_t error;
+
+            jse_cosa_bus_split_prefix(&dotstr, hot->prefix);
+
+            hot->name = strdup(dotstr);
+            if (hot->name == NULL)
+            {
+                JSE_ERROR("strdup() failed: %s", strerror(errno))
+            }
+            else if ((error = rbusEvent_Subscribe(rbus_handle, hot->name, hot_value_changed, hot, 0)) != RBUS_ERROR_SUCCESS)
+            {
+                /* The value is still cached for the hot TTL */
+                JSE_WARNING("rbusEvent_Subscribe(\"%s\") failed: %d", hot->name, error)
+                free(hot->name);
+            }
+            else
+            {
+                JSE_DEBUG("Subscribed to %s", hot->name)
+                hot_subscription_count++;
+            }
+        }
+
+        free(names[i]);
+    }
+
+    free(names);
+}
+
+/**
+ * @brief Frees the values set without being committed.
+ */
+static void free_pending(void)
+{
+    int i;
+
+    for (i = 0; i < pending_count; i++)
+    {
+        free(pending[i].name);
+        rbusValue_Release(pending[i].value);
+    }
+
+    free(pending);
+    pending = NULL;
+    pending_count = 0;
+}
+
+/**
+ * @brief Opens the rbus connection.
+ *
+ * @return 0 on success or -1 on error.
+ */
+static int rbus_init(void)
+{
+    char name[32];
+    rbusError_t error;
+
+    JSE_ENTER("rbus_init()")
+
+    if (rbus_checkStatus() != RBUS_ENABLED)
+    {
+        JSE_ERROR("rbus is not enabled!")
+        JSE_EXIT("rbus_init()=-1")
+        return -1;
+    }
+
+    /* Component names must be unique and there is one per process */
+    snprintf(name, sizeof(name), "jse.%d", (int)getpid());
+
+    error = rbus_open(&rbus_handle, name);
+    if (error != RBUS_ERROR_SUCCESS)
+    {
+        JSE_ERROR("rbus_open() failed: %d", error)
+        rbus_handle = NULL;
+        JSE_EXIT("rbus_init()=-1")
+        return -1;
+    }
+
+    subscribe_hot_parameters();
+
+    JSE_INFO("COSA initialised!")
+
+    JSE_EXIT("rbus_init()=0")
+    return 0;
+}
+
+/**
+ * @brief Closes the rbus connection.
+ */
+static void rbus_shutdown(void)
+{
+    int i;
+
+    for (i = 0; i < hot_subscription_count; i++)
+    {
+        (void) rbusEvent_Unsubscribe(rbus_handle, hot_subscriptions[i].name);
+        free(hot_subscriptions[i].name);
+    }
+
+    free(hot_subscriptions);
+    hot_subscriptions = NULL;
+    hot_subscription_count = 0;
+
+    free_pending();
+
+    if (rbus_handle != NULL)
+    {
+        (void) rbus_close(rbus_handle);
+        rbus_handle = NULL;
+    }
+}
+
+/**
+ * @brief Returns the pseudo component for a name without asking rbus.
+ *
+ * @param pSystemPrefix unused.
+ * @param pObjName unused.
+ * @param ppComponent a pointer to return the component name.
+ * @param ppPath a pointer to return the component path.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int rbus_discover(const char * pSystemPrefix, char * pObjName, char ** ppComponent, char ** ppPath)
+{
+    (void) pSystemPrefix;
+    (void) pObjName;
+
+    *ppComponent = strdup(RBUS_COMPONENT);
+    *ppPath = strdup(RBUS_PATH);
+
+    if (*ppComponent == NULL || *ppPath == NULL)
+    {
+        free(*ppComponent);
+        free(*ppPath);
+        return CCSP_ERR_MEMORY_ALLOC_FAIL;
+    }
+
+    return CCSP_SUCCESS;
+}
+
+/**
+ * @brief Frees values.
+ *
+ * @param valCount the number of values.
+ * @param ppVals the values.
+ */
+static void rbus_free_values(int valCount, parameterValStruct_t ** ppVals)
+{
+    int i;
+
+    for (i = 0; i < valCount; i++)
+    {
+        if (ppVals[i] != NULL)
+        {
+            free(ppVals[i]->parameterName);
+            free(ppVals[i]->parameterValue);
+            free(ppVals[i]);
+        }
+    }
+
+    free(ppVals);
+}
+
+/**
+ * @brief Gets parameter values with rbus_getExt().
+ *
+ * Names ending in '.' get every parameter below them.
+ *
+ * @param pSystemPrefix unused.
+ * @param pComponent unused.
+ * @param pPath unused.
+ * @param ppNames the parameter names.
+ * @param count the number of names.
+ * @param pValCount a pointer to return the number of values.
+ * @param pppVals a pointer to return the values.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int rbus_get_values(const char * pSystemPrefix, const char * pComponent, char * pPath,
+    char ** ppNames, int count, int * pValCount, parameterValStruct_t *** pppVals)
+{
+    parameterValStruct_t ** ppVals = NULL;
+    rbusProperty_t props = NULL;
+    rbusProperty_t prop = NULL;
+    rbusError_t error;
+    bool failed = false;
+    int numProps = 0;
+    int i = 0;
+
+    (void) pSystemPrefix;
+    (void) pComponent;
+    (void) pPath;
+
+    error = rbus_getExt(rbus_handle, count, (char const **)ppNames, &numProps, &props);
+    if (error != RBUS_ERROR_SUCCESS)
+    {
+        JSE_VERBOSE("rbus_getExt(\"%s\"...) failed: %d", ppNames[0], error)
+        return status_from_rbus(error);
+    }
+
+    if (numProps > 0)
+    {
+        ppVals = (parameterValStruct_t **)calloc((size_t)numProps, sizeof(parameterValStruct_t *));
+        if (ppVals == NULL)
+        {
+            JSE_ERROR("calloc() failed: %s", strerror(errno))
+            rbusProperty_Release(props);
+            return CCSP_ERR_MEMORY_ALLOC_FAIL;
+        }
+    }
+
+    for (prop = props; prop != NULL && i < numProps; prop = rbusProperty_GetNext(prop))
+    {
+        rbusValue_t value = rbusProperty_GetValue(prop);
+        parameterValStruct_t * pVal = (parameterValStruct_t *)calloc(1, sizeof(parameterValStruct_t));
+
+        if (pVal == NULL)
+        {
+            JSE_ERROR("calloc() failed: %s", strerror(errno))
+            failed = true;
+            break;
+        }
+
+        ppVals[i++] = pVal;
+
+        pVal->parameterName = strdup(rbusProperty_GetName(prop));
+        pVal->parameterValue = rbusValue_ToString(value, NULL, 0);
+        pVal->type = type_from_rbus(rbusValue_GetType(value));
+
+        if (pVal->parameterName == NULL || pVal->parameterValue == NULL)
+        {
+            JSE_ERROR("Failed to copy %s", rbusProperty_GetName(prop))
+            failed = true;
+            break;
+        }
+    }
+
+    rbusProperty_Release(props);
+
+    if (failed)
+    {
+        rbus_free_values(i, ppVals);
+        return CCSP_ERR_MEMORY_ALLOC_FAIL;
+    }
+
+    *pValCount = i;
+    *pppVals = ppVals;
+
+    return CCSP_SUCCESS;
+}
+
+/**
+ * @brief Sets and commits the pending values with rbus_setMulti().
+ *
+ * The pending values are freed whatever the outcome.
+ *
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int set_pending(void)
+{
+    rbusSetOptions_t opts = { true, 0 };
+    rbusProperty_t props = NULL;
+    rbusError_t error;
+    int i;
+
+    if (pending_count == 0)
+    {
+        return CCSP_SUCCESS;
+    }
+
+    for (i = 0; i < pending_count; i++)
+    {
+        rbusProperty_t prop = NULL;
+
+        rbusProperty_Init(&prop, pending[i].name, pending[i].value);
+
+        if (props == NULL)
+        {
+            props = prop;
+        }
+        else
+        {
+            rbusProperty_PushBack(props, prop);
+            rbusProperty_Release(prop);
+        }
+    }
+
+    error = rbus_setMulti(rbus_handle, pending_count, props, &opts);
+    if (error != RBUS_ERROR_SUCCESS)
+    {
+        JSE_ERROR("rbus_setMulti(\"%s\"...) failed: %d", pending[0].name, error)
+    }
+
+    rbusProperty_Release(props);
+    free_pending();
+
+    return status_from_rbus(error);
+}
+
+/**
+ * @brief Sets parameter values.
+ *
+ * Values that are not committed are held until jse_cosa_bus_set_commit()
+ * or the next committed set, then all set at once.
+ *
+ * @param pSystemPrefix unused.
+ * @param pComponent unused.
+ * @param pPath unused.
+ * @param pVals the values.
+ * @param count the number of values.
+ * @param commit set true to commit the values.
+ * @param ppFaultName a pointer to return the name of a rejected parameter.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int rbus_set_values(const char * pSystemPrefix, const char * pComponent, char * pPath,
+    parameterValStruct_t * pVals, int count, bool commit, char ** ppFaultName)
+{
+    pending_value_t * grown = NULL;
+    int first = pending_count;
+    int status = CCSP_SUCCESS;
+    int i;
+
+    (void) pSystemPrefix;
+    (void) pComponent;
+    (void) pPath;
+
+    if (count == 0)
+    {
+        return commit ? set_pending() : CCSP_SUCCESS;
+    }
+
+    grown = (pending_value_t *)realloc(pending, (size_t)(pending_count + count) * sizeof(pending_value_t));
+    if (grown == NULL)
+    {
+        JSE_ERROR("realloc() failed: %s", strerror(errno))
+        return CCSP_ERR_MEMORY_ALLOC_FAIL;
+    }
+    pending = grown;
+
+    for (i = 0; status == CCSP_SUCCESS && i < count; i++)
+    {
+        pending_value_t * pValue = &pending[pending_count];
+
+        pValue->name = strdup(pVals[i].parameterName);
+        if (pValue->name == NULL)
+        {
+            JSE_ERROR("strdup() failed: %s", strerror(errno))
+            status = CCSP_ERR_MEMORY_ALLOC_FAIL;
+            break;
+        }
+
+        rbusValue_Init(&pValue->value);
+        pending_count++;
+
+        if (!rbusValue_SetFromString(pValue->value, type_to_rbus(pVals[i].type), pVals[i].parameterValue))
+        {
+            JSE_ERROR("Bad value for %s", pVals[i].parameterName)
+            if (ppFaultName != NULL)
+            {
+                *ppFaultName = strdup(pVals[i].parameterName);
+            }
+            status = CCSP_ERR_INVALID_PARAMETER_VALUE;
+        }
+    }
+
+    if (status != CCSP_SUCCESS)
+    {
+        /* Drop this call's values, the earlier ones are still pending */
+        while (pending_count > first)
+        {
+            pending_count--;
+            free(pending[pending_count].name);
+            rbusValue_Release(pending[pending_count].value);
+        }
+
+        return status;
+    }
+
+    return commit ? set_pending() : CCSP_SUCCESS;
+}
+
+/**
+ * @brief Commits or discards the values set without being committed.
+ *
+ * @param pComponent unused.
+ * @param pPath unused.
+ * @param commit set true to commit, false to discard.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int rbus_set_commit(const char * pComponent, char * pPath, bool commit)
+{
+    (void) pComponent;
+    (void) pPath;
+
+    if (!commit)
+    {
+        free_pending();
+        return CCSP_SUCCESS;
+    }
+
+    return set_pending();
+}
+
+/**
+ * @brief Gets the instance numbers of a table.
+ *
+ * @param pComponent unused.
+ * @param pPath unused.
+ * @param pObjName the table name.
+ * @param pCount a pointer to return the number of instances.
+ * @param ppInstances a pointer to return the instance numbers.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int rbus_get_instances(const char * pComponent, char * pPath, char * pObjName,
+    unsigned int * pCount, unsigned int ** ppInstances)
+{
+    rbusRowName_t * rows = NULL;
+    rbusRowName_t * row = NULL;
+    unsigned int * pInstances = NULL;
+    unsigned int count = 0;
+    rbusError_t error;
+
+    (void) pComponent;
+    (void) pPath;
+
+    error = rbusTable_getRowNames(rbus_handle, pObjName, &rows);
+    if (error != RBUS_ERROR_SUCCESS)
+    {
+        JSE_VERBOSE("rbusTable_getRowNames(\"%s\") failed: %d", pObjName, error)
+        return status_from_rbus(error);
+    }
+
+    for (row = rows; row != NULL; row = row->next)
+    {
+        count++;
+    }
+
+    if (count > 0)
+    {
+        pInstances = (unsigned int *)malloc(count * sizeof(unsigned int));
+        if (pInstances == NULL)
+        {
+            JSE_ERROR("malloc() failed: %s", strerror(errno))
+            (void) rbusTable_freeRowNames(rbus_handle, rows);
+            return CCSP_ERR_MEMORY_ALLOC_FAIL;
+        }
+
+        count = 0;
+        for (row = rows; row != NULL; row = row->next)
+        {
+            pInstances[count++] = row->instNum;
+        }
+    }
+
+    (void) rbusTable_freeRowNames(rbus_handle, rows);
+
+    *pCount = count;
+    *ppInstances = pInstances;
+
+    return CCSP_SUCCESS;
+}
+
+/**
+ * @brief Adds a row to a table.
+ *
+ * @param pSystemPrefix unused.
+ * @param pComponent unused.
+ * @param pPath unused.
+ * @param pObjName the table name.
+ * @param pInstance a pointer to return the instance number.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int rbus_add_row(const char * pSystemPrefix, const char * pComponent, char * pPath, char * pObjName, int * pInstance)
+{
+    uint32_t instance = 0;
+    rbusError_t error;
+
+    (void) pSystemPrefix;
+    (void) pComponent;
+    (void) pPath;
+
+    error = rbusTable_addRow(rbus_handle, pObjName, NULL, &instance);
+    if (error != RBUS_ERROR_SUCCESS)
+    {
+        JSE_ERROR("rbusTable_addRow(\"%s\") failed: %d", pObjName, error)
+        return status_from_rbus(error);
+    }
+
+    *pInstance = (int)instance;
+
+    return CCSP_SUCCESS;
+}
+
+/**
+ * @brief Deletes a row from a table.
+ *
+ * @param pSystemPrefix unused.
+ * @param pComponent unused.
+ * @param pPath unused.
+ * @param pObjName the row name.
+ * @return CCSP_SUCCESS or an error status.
+ */
+static int rbus_delete_row(const char * pSystemPrefix, const char * pComponent, char * pPath, char * pObjName)
+{
+    rbusError_t error;
+
+    (void) pSystemPrefix;
+    (void) pComponent;
+    (void) pPath;
+
+    error = rbusTable_removeRow(rbus_handle, pObjName);
+    if (error != RBUS_ERROR_SUCCESS)
+    {
+        JSE_ERROR("rbusTable_removeRow(\"%s\") failed: %d", pObjName, error)
+        return status_from_rbus(error);
+    }
+
+    return CCSP_SUCCESS;
+}
+
+/** rbus, without the CCSP message bus compatibility layer */
+const jse_cosa_backend_t jse_cosa_rbus_backend = {
+    "rbus",
+    true,
+    rbus_init,
+    rbus_shutdown,
+    rbus_discover,
+    NULL,
+    NULL,
+    rbus_get_values,
+    rbus_free_values,
+    rbus_set_values,
+    rbus_set_commit,
+    rbus_get_instances,
+    rbus_add_row,
+    rbus_delete_row
+};
+
+#endif /* BUILD_RBUS */
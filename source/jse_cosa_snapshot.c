@@ -0,0 +1,420 @@
+/*****************************************************************************
+*
+* Copyright 2020 Liberty Global B.V.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*****************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "jse_debug.h"
+#include "jse_stats.h"
+#include "jse_cosa_snapshot.h"
+
+/** A parameter value */
+typedef struct snapshot_value_s
+{
+    /** The name, followed by the value in the same allocation */
+    char * name;
+    /** The value */
+    const char * value;
+    /** The order the value was added in */
+    int order;
+} snapshot_value_t;
+
+/** A set of parameter values */
+struct jse_cosa_snapshot_s
+{
+    /** The snapshot id, once kept */
+    char * id;
+    /** The names the values are for, once kept */
+    char * source;
+    /** The revision, once kept */
+    char revision[JSE_COSA_SNAPSHOT_REVISION_SIZE];
+    /** The values, sorted by name once kept */
+    snapshot_value_t * values;
+    /** The number of values */
+    int count;
+    /** The number of values there is room for */
+    int size;
+    /** Set if a value could not be added */
+    bool error;
+    /** The next snapshot, less recently used */
+    struct jse_cosa_snapshot_s * next;
+};
+
+/** The kept snapshots, most recently used first */
+static jse_cosa_snapshot_t * snapshots = NULL;
+
+/** The number of revisions made by this process */
+static unsigned long sequence = 0;
+
+/**
+ * @brief Compares two values by name for qsort().
+ *
+ * @param a the first value.
+ * @param b the second value.
+ * @return less than, equal to or greater than 0.
+ */
+static int compare_values(const void * a, const void * b)
+{
+    const snapshot_value_t * value_a = (const snapshot_value_t *)a;
+    const snapshot_value_t * value_b = (const snapshot_value_t *)b;
+    int cmp = strcmp(value_a->name, value_b->name);
+
+    return cmp != 0 ? cmp : value_a->order - value_b->order;
+}
+
+/**
+ * @brief Sorts the values of a set by name, dropping repeated names.
+ *
+ * The last value added for a name is kept.
+ *
+ * @param snapshot the set.
+ */
+static void sort_values(jse_cosa_snapshot_t * snapshot)
+{
+    int i, j;
+
+    if (snapshot->count < 2)
+    {
+        return;
+    }
+
+    qsort(snapshot->values, (size_t)snapshot->count, sizeof(snapshot_value_t), compare_values);
+
+    for (i = 1, j = 1; i < snapshot->count; i++)
+    {
+        if (!strcmp(snapshot->values[j - 1].name, snapshot->values[i].name))
+        {
+            free(snapshot->values[--j].name);
+        }
+
+        snapshot->values[j++] = snapshot->values[i];
+    }
+
+    snapshot->count = j;
+}
+
+/**
+ * @brief Finds a kept snapshot, removing it from the list.
+ *
+ * @param id the snapshot id.
+ * @return the snapshot or NULL.
+ */
+static jse_cosa_snapshot_t * take_snapshot(const char * id)
+{
+    jse_cosa_snapshot_t ** prev = &snapshots;
+    jse_cosa_snapshot_t * snapshot = snapshots;
+
+    while (snapshot != NULL && strcmp(snapshot->id, id))
+    {
+        prev = &snapshot->next;
+        snapshot = snapshot->next;
+    }
+
+    if (snapshot != NULL)
+    {
+        *prev = snapshot->next;
+        snapshot->next = NULL;
+    }
+
+    return snapshot;
+}
+
+/**
+ * @brief Keeps a snapshot as the most recently used.
+ *
+ * The least recently used snapshot is dropped if there are too many.
+ *
+ * @param snapshot the snapshot.
+ */
+static void keep_snapshot(jse_cosa_snapshot_t * snapshot)
+{
+    jse_cosa_snapshot_t ** last = NULL;
+    int i;
+
+    snapshot->next = snapshots;
+    snapshots = snapshot;
+
+    for (i = 0, last = &snapshots; *last != NULL && i < JSE_COSA_SNAPSHOT_MAX; i++)
+    {
+        last = &(*last)->next;
+    }
+
+    while (*last != NULL)
+    {
+        jse_cosa_snapshot_t * evicted = *last;
+
+        *last = evicted->next;
+        jse_cosa_snapshot_free(evicted);
+        jse_stats_add("cosa.snapshot.evict", 1);
+    }
+}
+
+/**
+ * @brief Creates an empty set of values.
+ *
+ * @return the set or NULL on error.
+ */
+jse_cosa_snapshot_t * jse_cosa_snapshot_new(void)
+{
+    jse_cosa_snapshot_t * snapshot = (jse_cosa_snapshot_t *)calloc(1, sizeof(jse_cosa_snapshot_t));
+
+    if (snapshot == NULL)
+    {
+        JSE_ERROR("calloc() failed: %s", strerror(errno))
+    }
+
+    return snapshot;
+}
+
+/**
+ * @brief Adds a copy of a value to a set.
+ *
+ * On error the set is marked as failed and jse_cosa_snapshot_diff() fails.
+ *
+ * @param snapshot the set.
+ * @param name the parameter name.
+ * @param value the value.
+ */
+void jse_cosa_snapshot_add(jse_cosa_snapshot_t * snapshot, const char * name, const char * value)
+{
+    size_t name_length = strlen(name);
+    size_t value_length = value != NULL ? strlen(value) : 0;
+    char * copy = NULL;
+
+    if (snapshot->error)
+    {
+        return;
+    }
+
+    if (snapshot->count == snapshot->size)
+    {
+        int size = snapshot->size > 0 ? snapshot->size * 2 : 64;
+        snapshot_value_t * values =
+            (snapshot_value_t *)realloc(snapshot->values, (size_t)size * sizeof(snapshot_value_t));
+
+        if (values == NULL)
+        {
+            JSE_ERROR("realloc() failed: %s", strerror(errno))
+            snapshot->error = true;
+            return;
+        }
+
+        snapshot->values = values;
+        snapshot->size = size;
+    }
+
+    copy = (char *)malloc(name_length + value_length + 2);
+    if (copy == NULL)
+    {
+        JSE_ERROR("malloc() failed: %s", strerror(errno))
+        snapshot->error = true;
+        return;
+    }
+
+    memcpy(copy, name, name_length + 1);
+    memcpy(copy + name_length + 1, value != NULL ? value : "", value_length + 1);
+
+    snapshot->values[snapshot->count].name = copy;
+    snapshot->values[snapshot->count].value = copy + name_length + 1;
+    snapshot->values[snapshot->count].order = snapshot->count;
+    snapshot->count++;
+}
+
+/**
+ * @brief Frees a set of values not passed to jse_cosa_snapshot_diff().
+ *
+ * @param snapshot the set or NULL.
+ */
+void jse_cosa_snapshot_free(jse_cosa_snapshot_t * snapshot)
+{
+    int i;
+
+    if (snapshot == NULL)
+    {
+        return;
+    }
+
+    for (i = 0; i < snapshot->count; i++)
+    {
+        free(snapshot->values[i].name);
+    }
+
+    free(snapshot->values);
+    free(snapshot->source);
+    free(snapshot->id);
+    free(snapshot);
+}
+
+/**
+ * @brief Compares a set of values with the last one kept under an id.
+ *
+ * The set replaces the last one, so the next call compares with it. Every
+ * value is reported if there is no last set, it was for different names
+ * or revision is not NULL and is not the revision of the last set. The
+ * least recently used set is dropped if too many are kept.
+ *
+ * Both sets are sorted by name so they are compared in a single pass.
+ *
+ * @param id the snapshot id.
+ * @param source identifies the names the values are for.
+ * @param snapshot the set, which is freed or kept.
+ * @param revision the revision the caller has or NULL.
+ * @param func the function to call for each value that differs.
+ * @param data the data to pass to func.
+ * @param new_revision a buffer of JSE_COSA_SNAPSHOT_REVISION_SIZE to return
+ * the revision of the set.
+ * @return the number of values that differ or -1 on error.
+ */
+int jse_cosa_snapshot_diff(const char * id, const char * source, jse_cosa_snapshot_t * snapshot,
+    const char * revision, jse_cosa_snapshot_func_t func, void * data, char * new_revision)
+{
+    jse_cosa_snapshot_t * last = take_snapshot(id);
+    int changed = 0;
+    int unchanged = 0;
+    int i = 0;
+    int j = 0;
+
+    if (snapshot->error)
+    {
+        /* The caller's values are unknown now so start again */
+        jse_cosa_snapshot_free(last);
+        jse_cosa_snapshot_free(snapshot);
+        return -1;
+    }
+
+    sort_values(snapshot);
+
+    if (last != NULL && (strcmp(last->source, source) ||
+        (revision != NULL && strcmp(last->revision, revision))))
+    {
+        JSE_VERBOSE("Snapshot \"%s\" is not the caller's", id)
+        jse_cosa_snapshot_free(last);
+        last = NULL;
+    }
+
+    if (last == NULL)
+    {
+        for (i = 0; i < snapshot->count; i++)
+        {
+            func(data, snapshot->values[i].name, snapshot->values[i].value);
+        }
+
+        changed = snapshot->count;
+        jse_stats_add("cosa.snapshot.miss", 1);
+    }
+    else
+    {
+        while (i < last->count || j < snapshot->count)
+        {
+            int cmp;
+
+            if (i == last->count)
+            {
+                cmp = 1;
+            }
+            else if (j == snapshot->count)
+            {
+                cmp = -1;
+            }
+            else
+            {
+                cmp = strcmp(last->values[i].name, snapshot->values[j].name);
+            }
+
+            if (cmp < 0)
+            {
+                /* Gone */
+                func(data, last->values[i].name, NULL);
+                changed++;
+                i++;
+            }
+            else if (cmp > 0)
+            {
+                /* New */
+                func(data, snapshot->values[j].name, snapshot->values[j].value);
+                changed++;
+                j++;
+            }
+            else
+            {
+                if (strcmp(last->values[i].value, snapshot->values[j].value))
+                {
+                    func(data, snapshot->values[j].name, snapshot->values[j].value);
+                    changed++;
+                }
+                else
+                {
+                    unchanged++;
+                }
+                i++;
+                j++;
+            }
+        }
+
+        jse_stats_add("cosa.snapshot.unchanged", (long)unchanged);
+    }
+
+    jse_stats_add("cosa.snapshot.changed", (long)changed);
+
+    if (last != NULL && changed == 0)
+    {
+        /* Nothing new so the caller's revision stays valid */
+        jse_cosa_snapshot_free(snapshot);
+        snapshot = last;
+    }
+    else
+    {
+        jse_cosa_snapshot_free(last);
+
+        snapshot->id = strdup(id);
+        snapshot->source = strdup(source);
+        if (snapshot->id == NULL || snapshot->source == NULL)
+        {
+            JSE_ERROR("strdup() failed: %s", strerror(errno))
+            jse_cosa_snapshot_free(snapshot);
+            return -1;
+        }
+
+        /* The process id makes revisions from other processes differ */
+        snprintf(snapshot->revision, sizeof(snapshot->revision), "%ld.%lu", (long)getpid(), ++sequence);
+    }
+
+    snprintf(new_revision, JSE_COSA_SNAPSHOT_REVISION_SIZE, "%s", snapshot->revision);
+    keep_snapshot(snapshot);
+
+    return changed;
+}
+
+/**
+ * @brief Drops every kept snapshot.
+ */
+void jse_cosa_snapshot_clear(void)
+{
+    while (snapshots != NULL)
+    {
+        jse_cosa_snapshot_t * snapshot = snapshots;
+
+        snapshots = snapshot->next;
+        jse_cosa_snapshot_free(snapshot);
+    }
+}
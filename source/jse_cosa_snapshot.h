@@ -0,0 +1,100 @@
+/*****************************************************************************
+*
+* Copyright 2020 Liberty Global B.V.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*****************************************************************************/
+
+
+#ifndef JSE_COSA_SNAPSHOT_H
+#define JSE_COSA_SNAPSHOT_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/** The maximum number of snapshots kept */
+#define JSE_COSA_SNAPSHOT_MAX 64
+
+/** The maximum length of a revision including the terminator */
+#define JSE_COSA_SNAPSHOT_REVISION_SIZE 32
+
+/** A set of parameter values */
+typedef struct jse_cosa_snapshot_s jse_cosa_snapshot_t;
+
+/**
+ * @brief Called for each value that differs from the last snapshot.
+ *
+ * @param data the caller's data.
+ * @param name the parameter name.
+ * @param value the new value or NULL if the parameter has gone.
+ */
+typedef void (*jse_cosa_snapshot_func_t)(void * data, const char * name, const char * value);
+
+/**
+ * @brief Creates an empty set of values.
+ *
+ * @return the set or NULL on error.
+ */
+jse_cosa_snapshot_t * jse_cosa_snapshot_new(void);
+
+/**
+ * @brief Adds a copy of a value to a set.
+ *
+ * On error the set is marked as failed and jse_cosa_snapshot_diff() fails.
+ *
+ * @param snapshot the set.
+ * @param name the parameter name.
+ * @param value the value.
+ */
+void jse_cosa_snapshot_add(jse_cosa_snapshot_t * snapshot, const char * name, const char * value);
+
+/**
+ * @brief Frees a set of values not passed to jse_cosa_snapshot_diff().
+ *
+ * @param snapshot the set or NULL.
+ */
+void jse_cosa_snapshot_free(jse_cosa_snapshot_t * snapshot);
+
+/**
+ * @brief Compares a set of values with the last one kept under an id.
+ *
+ * The set replaces the last one, so the next call compares with it. Every
+ * value is reported if there is no last set, it was for different names
+ * or revision is not NULL and is not the revision of the last set. The
+ * least recently used set is dropped if too many are kept.
+ *
+ * @param id the snapshot id.
+ * @param source identifies the names the values are for.
+ * @param snapshot the set, which is freed or kept.
+ * @param revision the revision the caller has or NULL.
+ * @param func the function to call for each value that differs.
+ * @param data the data to pass to func.
+ * @param new_revision a buffer of JSE_COSA_SNAPSHOT_REVISION_SIZE to return
+ * the revision of the set.
+ * @return the number of values that differ or -1 on error.
+ */
+int jse_cosa_snapshot_diff(const char * id, const char * source, jse_cosa_snapshot_t * snapshot,
+    const char * revision, jse_cosa_snapshot_func_t func, void * data, char * new_revision);
+
+/**
+ * @brief Drops every kept snapshot.
+ */
+void jse_cosa_snapshot_clear(void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,1341 @@
+/*****************************************************************************
+*
+* Copyright 2020 Liberty Global B.V.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*****************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "jse_debug.h"
+#include "jse_common.h"
+#include "jse_stats.h"
+#include "jse_cosa_trace.h"
+
+/** Written instead of the values of secret parameters */
+#define REDACTED_VALUE "(redacted)"
+
+/** The number of hash buckets of the replayed calls */
+#define REPLAY_BUCKETS 1024
+
+/** The operation of a recorded call */
+#define OP_DISCOVER      'D'
+#define OP_GET_VALUES    'G'
+#define OP_SET_VALUES    'S'
+#define OP_SET_COMMIT    'C'
+#define OP_GET_INSTANCES 'I'
+#define OP_ADD_ROW       'A'
+#define OP_DELETE_ROW    'R'
+
+/** A line of a trace file being built */
+typedef struct trace_line_s
+{
+    char * data;
+    size_t length;
+    size_t size;
+    /** Set if the line could not be built */
+    bool error;
+} trace_line_t;
+
+/** A recorded result of a call */
+typedef struct replay_result_s
+{
+    /** The CCSP status */
+    int status;
+    /** The time the call took */
+    long usec;
+    /** The result fields, unescaped, pointing into line */
+    char ** results;
+    int result_count;
+    /** All the fields of the line */
+    char ** fields;
+    /** The line read from the trace */
+    char * line;
+    struct replay_result_s * next;
+} replay_result_t;
+
+/** A call with the same arguments and its recorded results */
+typedef struct replay_call_s
+{
+    /** The operation and arguments, as written in the trace */
+    char * key;
+    /** The recorded results in order */
+    replay_result_t * first;
+    replay_result_t * last;
+    /** The result to answer the next call with */
+    replay_result_t * next_result;
+    /** The next call in the hash bucket */
+    struct replay_call_s * next;
+} replay_call_t;
+
+/** Parameter names containing these, ignoring case, hold secrets */
+static const char * const secret_words[] = { "password", "passwd", "passphrase", "secret", "key", NULL };
+
+/** The backend being recorded */
+static const jse_cosa_backend_t * recorded = NULL;
+
+/** The trace file being written or -1 */
+static int record_fd = -1;
+
+/** The trace file to replay */
+static const char * replay_filename = NULL;
+
+/** The percentage of the recorded time replayed calls take */
+static long replay_scale = 100;
+
+/** The replayed calls */
+static replay_call_t * replay_calls[REPLAY_BUCKETS];
+
+/** Protects the results to answer next */
+static pthread_mutex_t replay_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Makes room in a line.
+ *
+ * @param line the line.
+ * @param length the length to add.
+ * @return true if there is room.
+ */
+static bool line_room(trace_line_t * line, size_t length)
+{
+    if (line->error)
+    {
+        return false;
+    }
+
+    if (line->length + length + 1 > line->size)
+    {
+        size_t size = line->size > 0 ? line->size : 256;
+        char * data = NULL;
+
+        while (size < line->length + length + 1)
+        {
+            size *= 2;
+        }
+
+        data = (char *)realloc(line->data, size);
+        if (data == NULL)
+        {
+            JSE_ERROR("realloc() failed: %s", strerror(errno))
+            line->error = true;
+            return false;
+        }
+
+        line->data = data;
+        line->size = size;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Adds a field to a line.
+ *
+ * @param line the line.
+ * @param str the field or NULL for an empty field.
+ * @param escape set true to escape the field, false if already escaped.
+ */
+static void line_put_field(trace_line_t * line, const char * str, bool escape)
+{
+    const char * p = NULL;
+
+    if (line->length > 0 && line_room(line, 1))
+    {
+        line->data[line->length++] = '\t';
+    }
+
+    for (p = str != NULL ? str : ""; *p != '\0'; p++)
+    {
+        if (escape && (*p == '%' || *p == '\t' || *p == '\r' || *p == '\n'))
+        {
+            if (line_room(line, 3))
+            {
+                line->length += (size_t)sprintf(&line->data[line->length], "%%%02X", (unsigned char)*p);
+            }
+        }
+        else if (line_room(line, 1))
+        {
+            line->data[line->length++] = *p;
+        }
+    }
+
+    if (line_room(line, 0))
+    {
+        line->data[line->length] = '\0';
+    }
+}
+
+/**
+ * @brief Adds a field to a line, escaping it.
+ *
+ * @param line the line.
+ * @param str the field or NULL for an empty field.
+ */
+static void line_put_string(trace_line_t * line, const char * str)
+{
+    line_put_field(line, str, true);
+}
+
+/**
+ * @brief Adds a number field to a line.
+ *
+ * @param line the line.
+ * @param value the number.
+ */
+static void line_put_long(trace_line_t * line, long value)
+{
+    char number[24];
+
+    snprintf(number, sizeof(number), "%ld", value);
+    line_put_string(line, number);
+}
+
+/**
+ * @brief Tests whether a parameter holds a secret, such as a password or
+ * a key, that must not be written to the trace.
+ *
+ * @param name the parameter name.
+ * @return true if a secret.
+ */
+static bool is_secret(const char * name)
+{
+    const char * last = NULL;
+    const char * p = NULL;
+    int i;
+
+    if (name == NULL)
+    {
+        return false;
+    }
+
+    /* Only the last part of the name, e.g. KeyPassphrase */
+    last = strrchr(name, '.');
+    last = last != NULL ? last + 1 : name;
+
+    for (i = 0; secret_words[i] != NULL; i++)
+    {
+        size_t length = strlen(secret_words[i]);
+
+        for (p = last; *p != '\0'; p++)
+        {
+            if (!strncasecmp(p, secret_words[i], length))
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Adds a value and its type to a line, redacting secrets.
+ *
+ * @param line the line.
+ * @param name the parameter name.
+ * @param type the type.
+ * @param value the value.
+ */
+static void line_put_value(trace_line_t * line, const char * name, int type, const char * value)
+{
+    line_put_string(line, name);
+    line_put_long(line, (long)type);
+    line_put_string(line, is_secret(name) ? REDACTED_VALUE : value);
+}
+
+/**
+ * @brief Adds values and their types to a line, preceded by their number.
+ *
+ * @param line the line.
+ * @param vals the values.
+ * @param count the number of values.
+ */
+static void line_put_values(trace_line_t * line, const parameterValStruct_t * vals, int count)
+{
+    int i;
+
+    line_put_long(line, count);
+
+    for (i = 0; i < count; i++)
+    {
+        line_put_value(line, vals[i].parameterName, (int)vals[i].type, vals[i].parameterValue);
+    }
+}
+
+/**
+ * @brief Starts a line with the operation of a call.
+ *
+ * The operation and arguments identify a call when it is replayed.
+ *
+ * @param line the line.
+ * @param op the operation.
+ */
+static void line_put_op(trace_line_t * line, char op)
+{
+    char op_str[2] = { op, '\0' };
+
+    line_put_string(line, op_str);
+}
+
+/**
+ * @brief Appends a call to the trace file.
+ *
+ * The status and time are inserted after the operation, the first field
+ * of the line.
+ *
+ * @param line the line, which is freed.
+ * @param status the CCSP status.
+ * @param usec the time the call took.
+ */
+static void record_line(trace_line_t * line, int status, uint64_t usec)
+{
+    char times[48];
+    size_t times_length = (size_t)snprintf(times, sizeof(times), "\t%d\t%lu", status, (unsigned long)usec);
+
+    if (line_room(line, times_length + 1))
+    {
+        /* The operation is a single character */
+        memmove(&line->data[1 + times_length], &line->data[1], line->length - 1);
+        memcpy(&line->data[1], times, times_length);
+        line->length += times_length;
+        line->data[line->length++] = '\n';
+
+        /* One write so lines from several processes don't interleave */
+        if (write(record_fd, line->data, line->length) != (ssize_t)line->length)
+        {
+            JSE_ERROR("write() failed: %s", strerror(errno))
+        }
+    }
+
+    free(line->data);
+}
+
+/**
+ * @brief Records CcspBaseIf_discComponentSupportingNamespace().
+ */
+static int record_discover(const char * pSystemPrefix, char * pObjName, char ** ppComponent, char ** ppPath)
+{
+    trace_line_t line = { 0 };
+    uint64_t start = jse_time_usec();
+    int status = recorded->discover(pSystemPrefix, pObjName, ppComponent, ppPath);
+    uint64_t usec = jse_time_usec() - start;
+
+    line_put_op(&line, OP_DISCOVER);
+    line_put_string(&line, pSystemPrefix);
+    line_put_string(&line, pObjName);
+    line_put_string(&line, status == CCSP_SUCCESS ? *ppComponent : NULL);
+    line_put_string(&line, status == CCSP_SUCCESS ? *ppPath : NULL);
+    record_line(&line, status, usec);
+
+    return status;
+}
+
+/**
+ * @brief Forgets a cached component.
+ */
+static void record_invalidate(const char * pSystemPrefix, const char * pObjName)
+{
+    if (recorded->invalidate != NULL)
+    {
+        recorded->invalidate(pSystemPrefix, pObjName);
+    }
+}
+
+/**
+ * @brief Gets the types of parameters known to the backend.
+ */
+static int record_get_types(const char * pSystemPrefix, char ** ppNames, int count, int * pTypes)
+{
+    int i;
+
+    if (recorded->get_types != NULL)
+    {
+        return recorded->get_types(pSystemPrefix, ppNames, count, pTypes);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        pTypes[i] = -1;
+    }
+
+    return CCSP_SUCCESS;
+}
+
+/**
+ * @brief Records CcspBaseIf_getParameterValues().
+ */
+static int record_get_values(const char * pSystemPrefix, const char * pComponent, char * pPath,
+    char ** ppNames, int count, int * pValCount, parameterValStruct_t *** pppVals)
+{
+    trace_line_t line = { 0 };
+    uint64_t start = jse_time_usec();
+    int status = recorded->get_values(pSystemPrefix, pComponent, pPath, ppNames, count, pValCount, pppVals);
+    uint64_t usec = jse_time_usec() - start;
+    int i;
+
+    line_put_op(&line, OP_GET_VALUES);
+    line_put_string(&line, pSystemPrefix);
+    line_put_string(&line, pComponent);
+    line_put_string(&line, pPath);
+    line_put_long(&line, count);
+    for (i = 0; i < count; i++)
+    {
+        line_put_string(&line, ppNames[i]);
+    }
+
+    if (status == CCSP_SUCCESS)
+    {
+        line_put_long(&line, *pValCount);
+        for (i = 0; i < *pValCount; i++)
+        {
+            line_put_value(&line, (*pppVals)[i]->parameterName, (int)(*pppVals)[i]->type,
+                (*pppVals)[i]->parameterValue);
+        }
+    }
+    else
+    {
+        line_put_long(&line, 0);
+    }
+
+    record_line(&line, status, usec);
+
+    return status;
+}
+
+/**
+ * @brief Frees the values returned by record_get_values().
+ */
+static void record_free_values(int valCount, parameterValStruct_t ** ppVals)
+{
+    recorded->free_values(valCount, ppVals);
+}
+
+/**
+ * @brief Records CcspBaseIf_setParameterValues().
+ */
+static int record_set_values(const char * pSystemPrefix, const char * pComponent, char * pPath,
+    parameterValStruct_t * pVals, int count, bool commit, char ** ppFaultName)
+{
+    trace_line_t line = { 0 };
+    uint64_t start = jse_time_usec();
+    int status = recorded->set_values(pSystemPrefix, pComponent, pPath, pVals, count, commit, ppFaultName);
+    uint64_t usec = jse_time_usec() - start;
+
+    line_put_op(&line, OP_SET_VALUES);
+    line_put_string(&line, pSystemPrefix);
+    line_put_string(&line, pComponent);
+    line_put_string(&line, pPath);
+    line_put_long(&line, commit);
+    line_put_values(&line, pVals, count);
+    line_put_string(&line, ppFaultName != NULL ? *ppFaultName : NULL);
+    record_line(&line, status, usec);
+
+    return status;
+}
+
+/**
+ * @brief Records CcspBaseIf_setCommit().
+ */
+static int record_set_commit(const char * pComponent, char * pPath, bool commit)
+{
+    trace_line_t line = { 0 };
+    uint64_t start = jse_time_usec();
+    int status = recorded->set_commit(pComponent, pPath, commit);
+    uint64_t usec = jse_time_usec() - start;
+
+    line_put_op(&line, OP_SET_COMMIT);
+    line_put_string(&line, pComponent);
+    line_put_string(&line, pPath);
+    line_put_long(&line, commit);
+    record_line(&line, status, usec);
+
+    return status;
+}
+
+/**
+ * @brief Records CcspBaseIf_GetNextLevelInstances().
+ */
+static int record_get_instances(const char * pComponent, char * pPath, char * pObjName,
+    unsigned int * pCount, unsigned int ** ppInstances)
+{
+    trace_line_t line = { 0 };
+    uint64_t start = jse_time_usec();
+    int status = recorded->get_instances(pComponent, pPath, pObjName, pCount, ppInstances);
+    uint64_t usec = jse_time_usec() - start;
+    unsigned int i;
+
+    line_put_op(&line, OP_GET_INSTANCES);
+    line_put_string(&line, pComponent);
+    line_put_string(&line, pPath);
+    line_put_string(&line, pObjName);
+
+    if (status == CCSP_SUCCESS)
+    {
+        line_put_long(&line, (long)*pCount);
+        for (i = 0; i < *pCount; i++)
+        {
+            line_put_long(&line, (long)(*ppInstances)[i]);
+        }
+    }
+    else
+    {
+        line_put_long(&line, 0);
+    }
+
+    record_line(&line, status, usec);
+
+    return status;
+}
+
+/**
+ * @brief Records CcspBaseIf_AddTblRow().
+ */
+static int record_add_row(const char * pSystemPrefix, const char * pComponent, char * pPath, char * pObjName,
+    int * pInstance)
+{
+    trace_line_t line = { 0 };
+    uint64_t start = jse_time_usec();
+    int status = recorded->add_row(pSystemPrefix, pComponent, pPath, pObjName, pInstance);
+    uint64_t usec = jse_time_usec() - start;
+
+    line_put_op(&line, OP_ADD_ROW);
+    line_put_string(&line, pSystemPrefix);
+    line_put_string(&line, pComponent);
+    line_put_string(&line, pPath);
+    line_put_string(&line, pObjName);
+    line_put_long(&line, status == CCSP_SUCCESS ? *pInstance : 0);
+    record_line(&line, status, usec);
+
+    return status;
+}
+
+/**
+ * @brief Records CcspBaseIf_DeleteTblRow().
+ */
+static int record_delete_row(const char * pSystemPrefix, const char * pComponent, char * pPath, char * pObjName)
+{
+    trace_line_t line = { 0 };
+    uint64_t start = jse_time_usec();
+    int status = recorded->delete_row(pSystemPrefix, pComponent, pPath, pObjName);
+    uint64_t usec = jse_time_usec() - start;
+
+    line_put_op(&line, OP_DELETE_ROW);
+    line_put_string(&line, pSystemPrefix);
+    line_put_string(&line, pComponent);
+    line_put_string(&line, pPath);
+    line_put_string(&line, pObjName);
+    record_line(&line, status, usec);
+
+    return status;
+}
+
+/**
+ * @brief Does nothing, the recorded backend is already initialised.
+ *
+ * @return 0.
+ */
+static int record_init(void)
+{
+    return 0;
+}
+
+/**
+ * @brief Shuts down the recorded backend and closes the trace.
+ */
+static void record_shutdown(void)
+{
+    recorded->shutdown();
+
+    close(record_fd);
+    record_fd = -1;
+}
+
+/** The recording backend, completed by jse_cosa_trace_record() */
+static jse_cosa_backend_t record_backend = {
+    "record",
+    false,
+    record_init,
+    record_shutdown,
+    record_discover,
+    record_invalidate,
+    record_get_types,
+    record_get_values,
+    record_free_values,
+    record_set_values,
+    record_set_commit,
+    record_get_instances,
+    record_add_row,
+    record_delete_row
+};
+
+/**
+ * @brief Wraps a backend so that every call to it is recorded.
+ *
+ * @param pBackend the initialised backend.
+ * @param filename the trace filename.
+ * @return the recording backend or pBackend if the file can't be opened.
+ */
+const jse_cosa_backend_t *jse_cosa_trace_record(const jse_cosa_backend_t *pBackend, const char *filename)
+{
+    struct stat st;
+
+    /* Even redacted, the trace describes the device so only we may read it */
+    record_fd = open(filename, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (record_fd == -1)
+    {
+        JSE_ERROR("open(\"%s\") failed: %s", filename, strerror(errno))
+        return pBackend;
+    }
+
+    if (fstat(record_fd, &st) == 0 && st.st_size == 0)
+    {
+        if (write(record_fd, JSE_COSA_TRACE_HEADER "\n", strlen(JSE_COSA_TRACE_HEADER "\n")) < 0)
+        {
+            JSE_ERROR("write() failed: %s", strerror(errno))
+        }
+    }
+
+    recorded = pBackend;
+    record_backend.concurrent = pBackend->concurrent;
+
+    JSE_DEBUG("Recording the %s backend to %s", pBackend->name, filename)
+
+    return &record_backend;
+}
+
+
+/**
+ * @brief Sets the trace file served by the replay backend.
+ *
+ * @param filename the trace filename.
+ */
+void jse_cosa_trace_set_replay(const char *filename)
+{
+    replay_filename = filename;
+}
+
+/**
+ * @brief Scales the time the replay backend takes to answer calls.
+ *
+ * @param percent the percentage of the recorded time to take, 0 to answer
+ * at once.
+ */
+void jse_cosa_trace_set_replay_scale(long percent)
+{
+    replay_scale = percent > 0 ? percent : 0;
+}
+
+/**
+ * @brief Unescapes a field in place.
+ *
+ * @param field the field.
+ */
+static void unescape_field(char * field)
+{
+    char * out = field;
+    char * in = field;
+    unsigned int c;
+
+    while (*in != '\0')
+    {
+        if (in[0] == '%' && isxdigit((unsigned char)in[1]) && isxdigit((unsigned char)in[2])
+            && sscanf(in + 1, "%2x", &c) == 1)
+        {
+            *out++ = (char)c;
+            in += 3;
+        }
+        else
+        {
+            *out++ = *in++;
+        }
+    }
+
+    *out = '\0';
+}
+
+/**
+ * @brief Gets the number of argument fields of a recorded call.
+ *
+ * @param op the operation.
+ * @param args the fields after the status and time.
+ * @param count the number of fields.
+ * @return the number of argument fields or -1 if the line is not valid.
+ */
+static int argument_count(char op, char ** args, int count)
+{
+    int n = -1;
+
+    switch (op)
+    {
+        case OP_DISCOVER:
+            n = 2;
+            break;
+        case OP_GET_VALUES:
+            n = count > 3 ? 4 + atoi(args[3]) : -1;
+            break;
+        case OP_SET_VALUES:
+            n = count > 4 ? 5 + 3 * atoi(args[4]) : -1;
+            break;
+        case OP_SET_COMMIT:
+        case OP_GET_INSTANCES:
+            n = 3;
+            break;
+        case OP_ADD_ROW:
+        case OP_DELETE_ROW:
+            n = 4;
+            break;
+    }
+
+    return n <= count ? n : -1;
+}
+
+/**
+ * @brief Hashes the key of a call.
+ *
+ * @param key the key.
+ * @return the bucket.
+ */
+static unsigned int hash_key(const char * key)
+{
+    unsigned int hash = 5381;
+
+    while (*key != '\0')
+    {
+        hash = hash * 33 + (unsigned char)*key++;
+    }
+
+    return hash % REPLAY_BUCKETS;
+}
+
+/**
+ * @brief Finds a replayed call.
+ *
+ * @param key the key.
+ * @return the call or NULL.
+ */
+static replay_call_t * find_call(const char * key)
+{
+    replay_call_t * call = replay_calls[hash_key(key)];
+
+    while (call != NULL && strcmp(call->key, key))
+    {
+        call = call->next;
+    }
+
+    return call;
+}
+
+/**
+ * @brief Frees a recorded result.
+ *
+ * @param result the result.
+ */
+static void free_result(replay_result_t * result)
+{
+    free(result->fields);
+    free(result->line);
+    free(result);
+}
+
+/**
+ * @brief Adds a line of a trace to the replayed calls.
+ *
+ * @param line the line without its end of line, which is kept or freed.
+ * @param number the line number, for logging.
+ * @return 0 on success or -1 on error.
+ */
+static int add_line(char * line, int number)
+{
+    trace_line_t key = { 0 };
+    replay_result_t * result = NULL;
+    replay_call_t * call = NULL;
+    int count = 1;
+    int args = -1;
+    char * p = NULL;
+    int i;
+
+    result = (replay_result_t *)calloc(1, sizeof(replay_result_t));
+    if (result == NULL)
+    {
+        JSE_ERROR("calloc() failed: %s", strerror(errno))
+        free(line);
+        return -1;
+    }
+
+    result->line = line;
+
+    for (p = line; *p != '\0'; p++)
+    {
+        count += *p == '\t' ? 1 : 0;
+    }
+
+    result->fields = (char **)calloc((size_t)count, sizeof(char *));
+    if (result->fields == NULL)
+    {
+        JSE_ERROR("calloc() failed: %s", strerror(errno))
+        free_result(result);
+        return -1;
+    }
+
+    for (i = 0, p = line; i < count; i++)
+    {
+        result->fields[i] = p;
+        p = strchr(p, '\t');
+        if (p != NULL)
+        {
+            *p++ = '\0';
+        }
+    }
+
+    /* The operation, status and time precede the arguments */
+    if (count >= 3 && strlen(result->fields[0]) == 1)
+    {
+        args = argument_count(result->fields[0][0], &result->fields[3], count - 3);
+    }
+
+    if (args < 0)
+    {
+        JSE_WARNING("%s:%d: not a valid call", replay_filename, number)
+        free_result(result);
+        return 0;
+    }
+
+    /* Calls are matched on the operation and arguments as written */
+    line_put_field(&key, result->fields[0], false);
+    for (i = 3; i < 3 + args; i++)
+    {
+        line_put_field(&key, result->fields[i], false);
+    }
+
+    if (key.error)
+    {
+        free(key.data);
+        free_result(result);
+        return -1;
+    }
+
+    result->status = atoi(result->fields[1]);
+    result->usec = atol(result->fields[2]);
+    result->results = &result->fields[3 + args];
+    result->result_count = count - 3 - args;
+
+    for (i = 0; i < result->result_count; i++)
+    {
+        unescape_field(result->results[i]);
+    }
+
+    call = find_call(key.data);
+    if (call == NULL)
+    {
+        unsigned int bucket = hash_key(key.data);
+
+        call = (replay_call_t *)calloc(1, sizeof(replay_call_t));
+        if (call == NULL)
+        {
+            JSE_ERROR("calloc() failed: %s", strerror(errno))
+            free(key.data);
+            free_result(result);
+            return -1;
+        }
+
+        call->key = key.data;
+        call->first = result;
+        call->next_result = result;
+        call->next = replay_calls[bucket];
+        replay_calls[bucket] = call;
+    }
+    else
+    {
+        free(key.data);
+        call->last->next = result;
+    }
+
+    call->last = result;
+
+    return 0;
+}
+
+/**
+ * @brief Frees the replayed calls.
+ */
+static void free_calls(void)
+{
+    replay_result_t * result = NULL;
+    replay_call_t * call = NULL;
+    int i;
+
+    for (i = 0; i < REPLAY_BUCKETS; i++)
+    {
+        while (replay_calls[i] != NULL)
+        {
+            call = replay_calls[i];
+            replay_calls[i] = call->next;
+
+            while (call->first != NULL)
+            {
+                result = call->first;
+                call->first = result->next;
+                free_result(result);
+            }
+
+            free(call->key);
+            free(call);
+        }
+    }
+}
+
+/**
+ * @brief Loads the trace file.
+ *
+ * @return 0 on success or -1 on error.
+ */
+static int replay_init(void)
+{
+    FILE * fp = NULL;
+    char * line = NULL;
+    size_t size = 0;
+    ssize_t length;
+    int number = 0;
+    int calls = 0;
+    int ret = 0;
+
+    if (replay_filename == NULL)
+    {
+        JSE_ERROR("No trace to replay")
+        return -1;
+    }
+
+    fp = fopen(replay_filename, "r");
+    if (fp == NULL)
+    {
+        JSE_ERROR("fopen(\"%s\") failed: %s", replay_filename, strerror(errno))
+        return -1;
+    }
+
+    while (ret == 0 && (length = getline(&line, &size, fp)) != -1)
+    {
+        number++;
+
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r'))
+        {
+            line[--length] = '\0';
+        }
+
+        if (length == 0 || line[0] == '#')
+        {
+            continue;
+        }
+
+        /* The line is kept by the call it records */
+        ret = add_line(line, number);
+        line = NULL;
+        size = 0;
+        calls++;
+    }
+
+    free(line);
+    fclose(fp);
+
+    if (ret != 0)
+    {
+        free_calls();
+        return -1;
+    }
+
+    JSE_INFO("Replaying %d calls from %s", calls, replay_filename)
+
+    return 0;
+}
+
+/**
+ * @brief Frees the replayed calls.
+ */
+static void replay_shutdown(void)
+{
+    free_calls();
+}
+
+/**
+ * @brief Finds the result to answer a call with and waits the recorded time.
+ *
+ * @param key the operation and arguments of the call, which is freed.
+ * @return the result or NULL if the call was not recorded.
+ */
+static const replay_result_t * replay(trace_line_t * key)
+{
+    const replay_result_t * result = NULL;
+    replay_call_t * call = NULL;
+
+    pthread_mutex_lock(&replay_mutex);
+
+    call = key->error ? NULL : find_call(key->data);
+    if (call != NULL)
+    {
+        result = call->next_result;
+        if (result->next != NULL)
+        {
+            call->next_result = result->next;
+        }
+        jse_stats_add("cosa.replay.hit", 1);
+    }
+    else
+    {
+        jse_stats_add("cosa.replay.miss", 1);
+    }
+
+    pthread_mutex_unlock(&replay_mutex);
+
+    if (result == NULL)
+    {
+        JSE_WARNING("Call not in trace: %s", key->data != NULL ? key->data : "")
+    }
+    else if (replay_scale > 0 && result->usec > 0)
+    {
+        (void) usleep((useconds_t)(result->usec * replay_scale / 100));
+    }
+
+    free(key->data);
+
+    return result;
+}
+
+/**
+ * @brief Copies a recorded string.
+ *
+ * @param str the string.
+ * @param pCopy a pointer to return the copy.
+ * @return CCSP_SUCCESS or CCSP_ERR_MEMORY_ALLOC_FAIL.
+ */
+static int copy_string(const char * str, char ** pCopy)
+{
+    *pCopy = strdup(str);
+    if (*pCopy == NULL)
+    {
+        JSE_ERROR("strdup() failed: %s", strerror(errno))
+        return CCSP_ERR_MEMORY_ALLOC_FAIL;
+    }
+
+    return CCSP_SUCCESS;
+}
+
+/**
+ * @brief Replays CcspBaseIf_discComponentSupportingNamespace().
+ */
+static int replay_discover(const char * pSystemPrefix, char * pObjName, char ** ppComponent, char ** ppPath)
+{
+    trace_line_t key = { 0 };
+    const replay_result_t * result = NULL;
+    int status;
+
+    line_put_op(&key, OP_DISCOVER);
+    line_put_string(&key, pSystemPrefix);
+    line_put_string(&key, pObjName);
+    result = replay(&key);
+    if (result == NULL)
+    {
+        return CCSP_CR_ERR_UNSUPPORTED_NAMESPACE;
+    }
+
+    if (result->status != CCSP_SUCCESS || result->result_count < 2)
+    {
+        return result->status != CCSP_SUCCESS ? result->status : CCSP_FAILURE;
+    }
+
+    status = copy_string(result->results[0], ppComponent);
+    if (status == CCSP_SUCCESS)
+    {
+        status = copy_string(result->results[1], ppPath);
+        if (status != CCSP_SUCCESS)
+        {
+            free(*ppComponent);
+            *ppComponent = NULL;
+        }
+    }
+
+    return status;
+}
+
+/**
+ * @brief Frees the values returned by replay_get_values().
+ */
+static void replay_free_values(int valCount, parameterValStruct_t ** ppVals)
+{
+    int i;
+
+    for (i = 0; i < valCount; i++)
+    {
+        if (ppVals[i] != NULL)
+        {
+            free(ppVals[i]->parameterName);
+            free(ppVals[i]->parameterValue);
+            free(ppVals[i]);
+        }
+    }
+
+    free(ppVals);
+}
+
+/**
+ * @brief Replays CcspBaseIf_getParameterValues().
+ */
+static int replay_get_values(const char * pSystemPrefix, const char * pComponent, char * pPath,
+    char ** ppNames, int count, int * pValCount, parameterValStruct_t *** pppVals)
+{
+    trace_line_t key = { 0 };
+    const replay_result_t * result = NULL;
+    parameterValStruct_t ** ppVals = NULL;
+    int valCount = 0;
+    int i;
+
+    line_put_op(&key, OP_GET_VALUES);
+    line_put_string(&key, pSystemPrefix);
+    line_put_string(&key, pComponent);
+    line_put_string(&key, pPath);
+    line_put_long(&key, count);
+    for (i = 0; i < count; i++)
+    {
+        line_put_string(&key, ppNames[i]);
+    }
+
+    result = replay(&key);
+    if (result == NULL)
+    {
+        return CCSP_FAILURE;
+    }
+
+    if (result->status != CCSP_SUCCESS)
+    {
+        return result->status;
+    }
+
+    if (result->result_count > 0)
+    {
+        valCount = atoi(result->results[0]);
+    }
+
+    if (valCount < 0 || result->result_count < 1 + 3 * valCount)
+    {
+        JSE_WARNING("Recorded values not valid")
+        return CCSP_FAILURE;
+    }
+
+    ppVals = (parameterValStruct_t **)calloc((size_t)valCount + 1, sizeof(parameterValStruct_t *));
+    if (ppVals == NULL)
+    {
+        JSE_ERROR("calloc() failed: %s", strerror(errno))
+        return CCSP_ERR_MEMORY_ALLOC_FAIL;
+    }
+
+    for (i = 0; i < valCount; i++)
+    {
+        ppVals[i] = (parameterValStruct_t *)calloc(1, sizeof(parameterValStruct_t));
+        if (ppVals[i] == NULL
+            || copy_string(result->results[1 + 3 * i], &ppVals[i]->parameterName) != CCSP_SUCCESS
+            || copy_string(result->results[3 + 3 * i], &ppVals[i]->parameterValue) != CCSP_SUCCESS)
+        {
+            replay_free_values(i + 1, ppVals);
+            return CCSP_ERR_MEMORY_ALLOC_FAIL;
+        }
+
+        ppVals[i]->type = (enum dataType_e)atoi(result->results[2 + 3 * i]);
+    }
+
+    *pValCount = valCount;
+    *pppVals = ppVals;
+
+    return CCSP_SUCCESS;
+}
+
+/**
+ * @brief Replays CcspBaseIf_setParameterValues().
+ */
+static int replay_set_values(const char * pSystemPrefix, const char * pComponent, char * pPath,
+    parameterValStruct_t * pVals, int count, bool commit, char ** ppFaultName)
+{
+    trace_line_t key = { 0 };
+    const replay_result_t * result = NULL;
+
+    line_put_op(&key, OP_SET_VALUES);
+    line_put_string(&key, pSystemPrefix);
+    line_put_string(&key, pComponent);
+    line_put_string(&key, pPath);
+    line_put_long(&key, commit);
+    line_put_values(&key, pVals, count);
+
+    result = replay(&key);
+    if (result == NULL)
+    {
+        return CCSP_FAILURE;
+    }
+
+    if (ppFaultName != NULL && result->result_count > 0 && result->results[0][0] != '\0')
+    {
+        (void) copy_string(result->results[0], ppFaultName);
+    }
+
+    return result->status;
+}
+
+/**
+ * @brief Replays CcspBaseIf_setCommit().
+ */
+static int replay_set_commit(const char * pComponent, char * pPath, bool commit)
+{
+    trace_line_t key = { 0 };
+    const replay_result_t * result = NULL;
+
+    line_put_op(&key, OP_SET_COMMIT);
+    line_put_string(&key, pComponent);
+    line_put_string(&key, pPath);
+    line_put_long(&key, commit);
+
+    result = replay(&key);
+
+    return result != NULL ? result->status : CCSP_FAILURE;
+}
+
+/**
+ * @brief Replays CcspBaseIf_GetNextLevelInstances().
+ */
+static int replay_get_instances(const char * pComponent, char * pPath, char * pObjName,
+    unsigned int * pCount, unsigned int ** ppInstances)
+{
+    trace_line_t key = { 0 };
+    const replay_result_t * result = NULL;
+    unsigned int * pInstances = NULL;
+    int count = 0;
+    int i;
+
+    line_put_op(&key, OP_GET_INSTANCES);
+    line_put_string(&key, pComponent);
+    line_put_string(&key, pPath);
+    line_put_string(&key, pObjName);
+
+    result = replay(&key);
+    if (result == NULL)
+    {
+        return CCSP_FAILURE;
+    }
+
+    if (result->status != CCSP_SUCCESS)
+    {
+        return result->status;
+    }
+
+    if (result->result_count > 0)
+    {
+        count = atoi(result->results[0]);
+    }
+
+    if (count < 0 || result->result_count < 1 + count)
+    {
+        JSE_WARNING("Recorded instances not valid")
+        return CCSP_FAILURE;
+    }
+
+    pInstances = (unsigned int *)calloc((size_t)count + 1, sizeof(unsigned int));
+    if (pInstances == NULL)
+    {
+        JSE_ERROR("calloc() failed: %s", strerror(errno))
+        return CCSP_ERR_MEMORY_ALLOC_FAIL;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        pInstances[i] = (unsigned int)strtoul(result->results[1 + i], NULL, 10);
+    }
+
+    *pCount = (unsigned int)count;
+    *ppInstances = pInstances;
+
+    return CCSP_SUCCESS;
+}
+
+/**
+ * @brief Replays CcspBaseIf_AddTblRow().
+ */
+static int replay_add_row(const char * pSystemPrefix, const char * pComponent, char * pPath, char * pObjName,
+    int * pInstance)
+{
+    trace_line_t key = { 0 };
+    const replay_result_t * result = NULL;
+
+    line_put_op(&key, OP_ADD_ROW);
+    line_put_string(&key, pSystemPrefix);
+    line_put_string(&key, pComponent);
+    line_put_string(&key, pPath);
+    line_put_string(&key, pObjName);
+
+    result = replay(&key);
+    if (result == NULL)
+    {
+        return CCSP_FAILURE;
+    }
+
+    if (result->status == CCSP_SUCCESS && result->result_count > 0)
+    {
+        *pInstance = atoi(result->results[0]);
+    }
+
+    return result->status;
+}
+
+/**
+ * @brief Replays CcspBaseIf_DeleteTblRow().
+ */
+static int replay_delete_row(const char * pSystemPrefix, const char * pComponent, char * pPath, char * pObjName)
+{
+    trace_line_t key = { 0 };
+    const replay_result_t * result = NULL;
+
+    line_put_op(&key, OP_DELETE_ROW);
+    line_put_string(&key, pSystemPrefix);
+    line_put_string(&key, pComponent);
+    line_put_string(&key, pPath);
+    line_put_string(&key, pObjName);
+
+    result = replay(&key);
+
+    return result != NULL ? result->status : CCSP_FAILURE;
+}
+
+/** Answers calls with those recorded in a trace */
+const jse_cosa_backend_t jse_cosa_replay_backend = {
+    "replay",
+    true,
+    replay_init,
+    replay_shutdown,
+    replay_discover,
+    NULL,
+    NULL,
+    replay_get_values,
+    replay_free_values,
+    replay_set_values,
+    replay_set_commit,
+    replay_get_instances,
+    replay_add_row,
+    replay_delete_row
+};
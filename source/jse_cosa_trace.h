@@ -0,0 +1,82 @@
+/*****************************************************************************
+*
+* Copyright 2020 Liberty Global B.V.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*****************************************************************************/
+
+
+#ifndef JSE_COSA_TRACE_H
+#define JSE_COSA_TRACE_H
+
+#include "jse_cosa_backend.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/** The first line of a trace file, naming the format version */
+#define JSE_COSA_TRACE_HEADER "# jse-cosa-trace 1"
+
+/**
+ * @brief Wraps a backend so that every call to it is recorded.
+ *
+ * Each call is appended to the trace file as a line of tab separated
+ * fields: the operation, the status, the time the call took in
+ * microseconds, the arguments and the results:
+ *
+ *     D status usec prefix name component path
+ *     G status usec prefix component path count name... valCount (name type value)...
+ *     S status usec prefix component path commit count (name type value)... faultName
+ *     C status usec component path commit
+ *     I status usec component path name count instance...
+ *     A status usec prefix component path name instance
+ *     R status usec prefix component path name
+ *
+ * '%', tab, CR and LF in a field are written as %25, %09, %0D and %0A.
+ * The values of parameters whose last name part contains "password",
+ * "passwd", "passphrase", "secret" or "key", ignoring case, are written as
+ * "(redacted)". The file is created readable only by its owner. Several
+ * processes may append to the same file.
+ *
+ * @param pBackend the initialised backend.
+ * @param filename the trace filename.
+ * @return the recording backend or pBackend if the file can't be opened.
+ */
+const jse_cosa_backend_t *jse_cosa_trace_record(const jse_cosa_backend_t *pBackend, const char *filename);
+
+/**
+ * @brief Sets the trace file served by the replay backend.
+ *
+ * Each call is answered with the results recorded for a call with the
+ * same arguments, after the recorded time. Calls recorded more than once
+ * are answered with each recorded result in turn, then the last again.
+ *
+ * @param filename the trace filename.
+ */
+void jse_cosa_trace_set_replay(const char *filename);
+
+/**
+ * @brief Scales the time the replay backend takes to answer calls.
+ *
+ * @param percent the percentage of the recorded time to take, 0 to answer
+ * at once.
+ */
+void jse_cosa_trace_set_replay_scale(long percent);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,80 @@
+/*****************************************************************************
+*
+* Copyright 2020 Liberty Global B.V.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*****************************************************************************/
+
+#ifndef JSE_COSA_TYPES_H
+#define JSE_COSA_TYPES_H
+
+#ifdef BUILD_RDK
+#include <ccsp_message_bus.h>
+#include <ccsp_base_api.h>
+#else
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * Without CCSP the Cosa bindings are built for the mock backend. These are
+ * the CCSP definitions they use, with the same values as CCSP, so scripts
+ * see the same types and error codes.
+ */
+
+#define CCSP_SUCCESS                        100
+#define CCSP_ERR_MEMORY_ALLOC_FAIL          101
+#define CCSP_FAILURE                        102
+#define CCSP_ERR_NOT_CONNECT                190
+#define CCSP_ERR_TIMEOUT                    191
+#define CCSP_ERR_NOT_EXIST                  192
+#define CCSP_ERR_NOT_SUPPORT                193
+#define CCSP_CR_ERR_UNSUPPORTED_NAMESPACE   204
+#define CCSP_ERR_INVALID_PARAMETER_NAME     9005
+#define CCSP_ERR_INVALID_PARAMETER_TYPE     9006
+#define CCSP_ERR_INVALID_PARAMETER_VALUE    9007
+
+/** The parameter data types */
+enum dataType_e
+{
+    ccsp_string = 0,
+    ccsp_int,
+    ccsp_unsignedInt,
+    ccsp_boolean,
+    ccsp_dateTime,
+    ccsp_base64,
+    ccsp_long,
+    ccsp_unsignedLong,
+    ccsp_float,
+    ccsp_double,
+    ccsp_byte,
+    ccsp_none
+};
+
+/** A parameter value */
+typedef struct
+{
+    char *parameterName;
+    char *parameterValue;
+    enum dataType_e type;
+} parameterValStruct_t;
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* BUILD_RDK */
+
+#endif
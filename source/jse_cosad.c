@@ -0,0 +1,847 @@
+/*****************************************************************************
+*
+* Copyright 2020 Liberty Global B.V.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*****************************************************************************/
+
+/*
+ * jse-cosad holds the CCSP message bus connection and the discovery, type
+ * and hot parameter caches for all the jse processes on a device. Without
+ * it each CGI request pays for initialising the message bus and starts
+ * with empty caches.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include "jse_debug.h"
+#include "jse_cosa_cache.h"
+#include "jse_cosa_broker.h"
+#include "jse_cosa_bus.h"
+#include "jse_cosa_guard.h"
+#include "jse_cosa_trace.h"
+#ifdef ENABLE_COSA_MOCK
+#include "jse_cosa_mock.h"
+#endif
+
+/** The maximum number of connected jse processes */
+#define MAX_CLIENTS 64
+
+/** The time a client may take to send or read a message */
+#define CLIENT_TIMEOUT_MSEC 5000
+
+/* Values for the options that only have a long form */
+enum long_option_e
+{
+    OPT_DISCOVERY_TTL = 256,
+    OPT_TYPE_MANIFEST,
+    OPT_HOT_PARAMS,
+    OPT_HOT_TTL,
+    OPT_COSA_MOCK,
+    OPT_COSA_MOCK_LATENCY,
+    OPT_COSA_TIMEOUT,
+    OPT_COSA_BREAKER,
+    OPT_COSA_COOLDOWN,
+    OPT_COSA_RECORD,
+    OPT_COSA_REPLAY,
+    OPT_COSA_REPLAY_SCALE,
+};
+
+/** The socket path */
+static const char * socket_path = JSE_COSA_BROKER_DEFAULT_SOCKET;
+
+/** Set by SIGTERM and SIGINT */
+static volatile sig_atomic_t stopping = 0;
+
+/** The request and response, reused for every request */
+static jse_cosa_broker_msg_t request;
+static jse_cosa_broker_msg_t response;
+
+/**
+ * @brief Frees an array of strings.
+ *
+ * @param strings the array.
+ * @param count the number of strings.
+ */
+static void free_strings(char ** strings, int count)
+{
+    int i;
+
+    if (strings != NULL)
+    {
+        for (i = 0; i < count; i++)
+        {
+            free(strings[i]);
+        }
+
+        free(strings);
+    }
+}
+
+/**
+ * @brief Parses an array of strings from the request.
+ *
+ * @param count the number of strings.
+ * @return the strings, which must be freed with free_strings(), or NULL
+ * on error.
+ */
+static char ** get_strings(int count)
+{
+    char ** strings = NULL;
+    int i;
+
+    if (count <= 0 || request.error)
+    {
+        return NULL;
+    }
+
+    strings = (char **)calloc((size_t)count, sizeof(char *));
+    if (strings == NULL)
+    {
+        JSE_ERROR("calloc() failed: %s", strerror(errno))
+        return NULL;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        strings[i] = jse_cosa_broker_get_string(&request);
+        if (strings[i] == NULL)
+        {
+            free_strings(strings, i);
+            return NULL;
+        }
+    }
+
+    return strings;
+}
+
+/**
+ * @brief Answers a GET request from the hot parameter cache.
+ *
+ * @param prefix the subsystem prefix.
+ * @param names the parameter names.
+ * @param count the number of names.
+ * @return true if all the values were cached and the response built.
+ */
+static bool get_hot(const char * prefix, char ** names, int count)
+{
+    char ** values = NULL;
+    int * types = NULL;
+    bool hit = true;
+    int i;
+
+    values = (char **)calloc((size_t)count, sizeof(char *));
+    types = (int *)calloc((size_t)count, sizeof(int));
+    if (values == NULL || types == NULL)
+    {
+        free(values);
+        free(types);
+        return false;
+    }
+
+    for (i = 0; i < count && hit; i++)
+    {
+        hit = jse_cosa_cache_get_hot(prefix, names[i], &values[i], &types[i]) == 0;
+    }
+
+    if (hit)
+    {
+        jse_cosa_broker_put_int(&response, CCSP_SUCCESS);
+        jse_cosa_broker_put_int(&response, count);
+        for (i = 0; i < count; i++)
+        {
+            jse_cosa_broker_put_string(&response, names[i]);
+            jse_cosa_broker_put_string(&response, values[i]);
+            jse_cosa_broker_put_int(&response, types[i]);
+        }
+    }
+
+    free_strings(values, count);
+    free(types);
+
+    return hit;
+}
+
+/**
+ * @brief Handles a GET request.
+ *
+ * @param prefix the subsystem prefix.
+ */
+static void handle_get(const char * prefix)
+{
+    parameterValStruct_t ** vals = NULL;
+    char * component = jse_cosa_broker_get_string(&request);
+    char * path = jse_cosa_broker_get_string(&request);
+    int count = jse_cosa_broker_get_int(&request);
+    char ** names = get_strings(count);
+    int valCount = 0;
+    int status;
+    int i;
+
+    if (component == NULL || path == NULL || names == NULL)
+    {
+        jse_cosa_broker_put_int(&response, CCSP_FAILURE);
+    }
+    else if (!get_hot(prefix, names, count))
+    {
+        status = jse_cosa_bus_get_values(prefix, component, path, names, count, &valCount, &vals);
+
+        jse_cosa_broker_put_int(&response, status);
+        if (status == CCSP_SUCCESS)
+        {
+            jse_cosa_broker_put_int(&response, valCount);
+            for (i = 0; i < valCount; i++)
+            {
+                jse_cosa_broker_put_string(&response, vals[i]->parameterName);
+                jse_cosa_broker_put_string(&response, vals[i]->parameterValue);
+                jse_cosa_broker_put_int(&response, (int32_t)vals[i]->type);
+
+                /* Shared with every jse process */
+                jse_cosa_cache_put_type(prefix, vals[i]->parameterName, (int)vals[i]->type);
+                jse_cosa_cache_put_hot(prefix, vals[i]->parameterName, vals[i]->parameterValue, (int)vals[i]->type);
+            }
+
+            if (valCount > 0)
+            {
+                jse_cosa_bus_free_values(valCount, vals);
+            }
+        }
+    }
+
+    free(component);
+    free(path);
+    free_strings(names, count);
+}
+
+/**
+ * @brief Handles a SET request.
+ *
+ * @param prefix the subsystem prefix.
+ */
+static void handle_set(const char * prefix)
+{
+    parameterValStruct_t * vals = NULL;
+    char * component = jse_cosa_broker_get_string(&request);
+    char * path = jse_cosa_broker_get_string(&request);
+    bool commit = jse_cosa_broker_get_int(&request) != 0;
+    int count = jse_cosa_broker_get_int(&request);
+    char * fault = NULL;
+    int status = CCSP_FAILURE;
+    bool parsed = true;
+    int i = 0;
+
+    if (component != NULL && path != NULL && count > 0 && !request.error)
+    {
+        vals = (parameterValStruct_t *)calloc((size_t)count, sizeof(parameterValStruct_t));
+        if (vals == NULL)
+        {
+            JSE_ERROR("calloc() failed: %s", strerror(errno))
+        }
+        else
+        {
+            for (i = 0; i < count; i++)
+            {
+                vals[i].parameterName = jse_cosa_broker_get_string(&request);
+                vals[i].parameterValue = jse_cosa_broker_get_string(&request);
+                vals[i].type = (enum dataType_e)jse_cosa_broker_get_int(&request);
+
+                if (request.error || vals[i].parameterName == NULL || vals[i].parameterValue == NULL)
+                {
+                    /* Freed below */
+                    parsed = false;
+                    i++;
+                    break;
+                }
+            }
+
+            if (parsed)
+            {
+                status = jse_cosa_bus_set_values(prefix, component, path, vals, count, commit, &fault);
+
+                for (i = 0; i < count; i++)
+                {
+                    jse_cosa_cache_invalidate_hot(prefix, vals[i].parameterName);
+                }
+            }
+        }
+    }
+
+    jse_cosa_broker_put_int(&response, status);
+    jse_cosa_broker_put_string(&response, fault);
+
+    if (vals != NULL)
+    {
+        while (i > 0)
+        {
+            i--;
+            free(vals[i].parameterName);
+            free(vals[i].parameterValue);
+        }
+
+        free(vals);
+    }
+
+    free(fault);
+    free(component);
+    free(path);
+}
+
+/**
+ * @brief Handles an INSTANCES request.
+ */
+static void handle_instances(void)
+{
+    char * component = jse_cosa_broker_get_string(&request);
+    char * path = jse_cosa_broker_get_string(&request);
+    char * name = jse_cosa_broker_get_string(&request);
+    unsigned int * instances = NULL;
+    unsigned int count = 0;
+    unsigned int i;
+    int status = CCSP_FAILURE;
+
+    if (component != NULL && path != NULL && name != NULL)
+    {
+        status = jse_cosa_bus_get_instances(component, path, name, &count, &instances);
+    }
+
+    jse_cosa_broker_put_int(&response, status);
+    if (status == CCSP_SUCCESS)
+    {
+        jse_cosa_broker_put_int(&response, (int32_t)count);
+        for (i = 0; i < count; i++)
+        {
+            jse_cosa_broker_put_int(&response, (int32_t)instances[i]);
+        }
+    }
+
+    free(instances);
+    free(component);
+    free(path);
+    free(name);
+}
+
+/**
+ * @brief Handles an ADD_ROW, DELETE_ROW or COMMIT request.
+ *
+ * @param op the operation.
+ * @param prefix the subsystem prefix, NULL for COMMIT.
+ */
+static void handle_component(enum jse_cosa_broker_op_e op, const char * prefix)
+{
+    char * component = jse_cosa_broker_get_string(&request);
+    char * path = jse_cosa_broker_get_string(&request);
+    char * name = NULL;
+    int commit = 0;
+    int instance = 0;
+    int status = CCSP_FAILURE;
+
+    if (op == JSE_COSA_BROKER_COMMIT)
+    {
+        commit = jse_cosa_broker_get_int(&request);
+    }
+    else
+    {
+        name = jse_cosa_broker_get_string(&request);
+    }
+
+    if (component != NULL && path != NULL && (op == JSE_COSA_BROKER_COMMIT || name != NULL) && !request.error)
+    {
+        switch (op)
+        {
+            case JSE_COSA_BROKER_COMMIT:
+                status = jse_cosa_bus_set_commit(component, path, commit != 0);
+                break;
+
+            case JSE_COSA_BROKER_ADD_ROW:
+                status = jse_cosa_bus_add_row(prefix, component, path, name, &instance);
+                jse_cosa_cache_invalidate_hot(prefix, name);
+                break;
+
+            case JSE_COSA_BROKER_DELETE_ROW:
+                status = jse_cosa_bus_delete_row(prefix, component, path, name);
+                jse_cosa_cache_invalidate_hot(prefix, name);
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    jse_cosa_broker_put_int(&response, status);
+    if (op == JSE_COSA_BROKER_ADD_ROW && status == CCSP_SUCCESS)
+    {
+        jse_cosa_broker_put_int(&response, instance);
+    }
+
+    free(component);
+    free(path);
+    free(name);
+}
+
+/**
+ * @brief Handles a request and builds the response.
+ */
+static void handle_request(void)
+{
+    enum jse_cosa_broker_op_e op = (enum jse_cosa_broker_op_e)jse_cosa_broker_get_int(&request);
+    char * prefix = NULL;
+    char * name = NULL;
+    char * component = NULL;
+    char * path = NULL;
+    char ** names = NULL;
+    int count = 0;
+    int type;
+    int status;
+    int i;
+
+    jse_cosa_broker_msg_reset(&response);
+
+    /* Only commits and instances are not qualified by a subsystem */
+    if (op != JSE_COSA_BROKER_COMMIT && op != JSE_COSA_BROKER_INSTANCES)
+    {
+        prefix = jse_cosa_broker_get_string(&request);
+        if (prefix == NULL)
+        {
+            jse_cosa_broker_put_int(&response, CCSP_FAILURE);
+            return;
+        }
+    }
+
+    JSE_VERBOSE("Request %d", (int)op)
+
+    switch (op)
+    {
+        case JSE_COSA_BROKER_DISCOVER:
+            name = jse_cosa_broker_get_string(&request);
+            status = name != NULL ? jse_cosa_bus_discover(name, &component, &path, prefix) : CCSP_FAILURE;
+            if (status == 0)
+            {
+                jse_cosa_broker_put_int(&response, CCSP_SUCCESS);
+                jse_cosa_broker_put_string(&response, component);
+                jse_cosa_broker_put_string(&response, path);
+                free(component);
+                free(path);
+            }
+            else
+            {
+                jse_cosa_broker_put_int(&response, status);
+            }
+            break;
+
+        case JSE_COSA_BROKER_INVALIDATE:
+            name = jse_cosa_broker_get_string(&request);
+            if (name != NULL)
+            {
+                jse_cosa_cache_invalidate_component(prefix, name);
+            }
+            jse_cosa_broker_put_int(&response, CCSP_SUCCESS);
+            break;
+
+        case JSE_COSA_BROKER_GET:
+            handle_get(prefix);
+            break;
+
+        case JSE_COSA_BROKER_SET:
+            handle_set(prefix);
+            break;
+
+        case JSE_COSA_BROKER_INSTANCES:
+            handle_instances();
+            break;
+
+        case JSE_COSA_BROKER_COMMIT:
+        case JSE_COSA_BROKER_ADD_ROW:
+        case JSE_COSA_BROKER_DELETE_ROW:
+            handle_component(op, prefix);
+            break;
+
+        case JSE_COSA_BROKER_TYPES:
+            count = jse_cosa_broker_get_int(&request);
+            names = get_strings(count);
+            if (names == NULL)
+            {
+                jse_cosa_broker_put_int(&response, CCSP_FAILURE);
+                break;
+            }
+
+            jse_cosa_broker_put_int(&response, CCSP_SUCCESS);
+            jse_cosa_broker_put_int(&response, count);
+            for (i = 0; i < count; i++)
+            {
+                if (jse_cosa_cache_get_type(prefix, names[i], &type) != 0)
+                {
+                    type = -1;
+                }
+                jse_cosa_broker_put_int(&response, type);
+            }
+            break;
+
+        default:
+            JSE_WARNING("Unknown request %d!", (int)op)
+            jse_cosa_broker_put_int(&response, CCSP_FAILURE);
+            break;
+    }
+
+    free_strings(names, count);
+    free(name);
+    free(prefix);
+}
+
+/**
+ * @brief Accepts requests until stopped.
+ *
+ * Requests are handled one at a time, in the order they arrive, as the
+ * message bus calls block.
+ *
+ * @param listener the listening socket.
+ */
+static void serve(int listener)
+{
+    struct pollfd fds[MAX_CLIENTS + 1];
+    int clients = 0;
+    int i;
+
+    fds[0].fd = listener;
+    fds[0].events = POLLIN;
+
+    while (!stopping)
+    {
+        if (poll(fds, (nfds_t)clients + 1, -1) < 0)
+        {
+            if (errno != EINTR)
+            {
+                JSE_ERROR("poll() failed: %s", strerror(errno))
+                break;
+            }
+            continue;
+        }
+
+        for (i = 1; i <= clients; i++)
+        {
+            bool drop = false;
+
+            if (fds[i].revents & POLLIN)
+            {
+                if (jse_cosa_broker_receive(fds[i].fd, &request) != 0)
+                {
+                    drop = true;
+                }
+                else
+                {
+                    handle_request();
+                    drop = jse_cosa_broker_send(fds[i].fd, &response) != 0;
+                }
+            }
+            else if (fds[i].revents & (POLLHUP | POLLERR | POLLNVAL))
+            {
+                drop = true;
+            }
+
+            if (drop)
+            {
+                JSE_VERBOSE("Client %d disconnected", fds[i].fd)
+                close(fds[i].fd);
+                fds[i] = fds[clients];
+                clients--;
+                i--;
+            }
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            int fd = accept(listener, NULL, NULL);
+            if (fd == -1)
+            {
+                if (errno != EINTR && errno != EAGAIN)
+                {
+                    JSE_ERROR("accept() failed: %s", strerror(errno))
+                }
+            }
+            else if (clients == MAX_CLIENTS)
+            {
+                /* The client falls back to the message bus */
+                JSE_WARNING("Too many clients!")
+                close(fd);
+            }
+            else if (!jse_cosa_broker_check_peer(fd, true))
+            {
+                close(fd);
+            }
+            else
+            {
+                /* A stalled client must not hold up the others */
+                (void) jse_cosa_broker_set_timeout(fd, CLIENT_TIMEOUT_MSEC);
+
+                JSE_VERBOSE("Client %d connected", fd)
+                clients++;
+                fds[clients].fd = fd;
+                fds[clients].events = POLLIN;
+                fds[clients].revents = 0;
+            }
+        }
+    }
+
+    for (i = 1; i <= clients; i++)
+    {
+        close(fds[i].fd);
+    }
+}
+
+/**
+ * @brief Signal handler to stop the daemon.
+ *
+ * @param sig the signal.
+ */
+static void stop(int sig)
+{
+    (void) sig;
+    stopping = 1;
+}
+
+/**
+ * @brief Converts an option argument to a number.
+ *
+ * Exits on error.
+ *
+ * @param name the long option name.
+ * @param arg the argument.
+ * @return the value.
+ */
+static long option_to_long(const char * name, const char * arg)
+{
+    char * end = NULL;
+    long value;
+
+    errno = 0;
+    value = strtol(arg, &end, 10);
+    if (errno != 0 || end == arg || *end != '\0' || value < 0)
+    {
+        JSE_ERROR("Invalid value for --%s: \"%s\"", name, arg)
+        exit(EXIT_FAILURE);
+    }
+
+    return value;
+}
+
+/**
+ * @brief Display help for the daemon.
+ *
+ * @param name the daemon name.
+ */
+static void help(const char * name)
+{
+    fprintf(stderr,
+"Usage: %s [OPTION]...\n"
+"Share one CCSP message bus connection between jse processes.\n"
+"\n"
+"Mandatory arguments to long options are mandatory for short options too.\n"
+"  -e, --enter-exit         Enable enter-exit debug logging.\n"
+"  -h, --help               Display this help.\n"
+"  -s, --socket=PATH        Listen on PATH instead of " JSE_COSA_BROKER_DEFAULT_SOCKET ".\n"
+"  -v, --verbose            Verbosity. Multiple uses increases vebosity.\n"
+"      --discovery-ttl=SECS Cache the CCSP component for a namespace, 0 to disable.\n"
+"      --type-manifest=FILE Load CCSP parameter types from FILE.\n"
+"      --hot-params=FILE    Cache the CCSP parameters listed in FILE.\n"
+"      --hot-ttl=SECS       Cache hot parameters that are not notified for SECS.\n"
+"      --cosa-timeout=MS    Fail CCSP calls taking more than MS milliseconds.\n"
+"      --cosa-breaker=N     Stop calling a component after N failures, 0 to disable.\n"
+"      --cosa-cooldown=SECS The time to stop calling a failing component for.\n"
+"      --cosa-record=FILE   Append every CCSP call to the trace FILE.\n"
+"      --cosa-replay=FILE   Answer CCSP calls from the trace FILE instead of CCSP.\n"
+"      --cosa-replay-scale=PERCENT The percentage of the recorded time replayed calls take.\n"
+#ifdef ENABLE_COSA_MOCK
+"      --cosa-mock=FILE     Serve the data model snapshot FILE instead of CCSP.\n"
+"      --cosa-mock-latency=USEC The latency of each mock component call.\n"
+#endif
+"\n",
+    name);
+}
+
+/**
+ * @brief Parses the options.
+ *
+ * @param argc the argument count.
+ * @param argv the array of argument strings.
+ */
+static void parse_options(int argc, char ** argv)
+{
+    static struct option long_options[] =
+    {
+        {"enter-exit",  no_argument,       0, 'e' },
+        {"help",        no_argument,       0, 'h' },
+        {"socket",      required_argument, 0, 's' },
+        {"verbose",     no_argument,       0, 'v' },
+        {"discovery-ttl", required_argument, 0, OPT_DISCOVERY_TTL },
+        {"type-manifest", required_argument, 0, OPT_TYPE_MANIFEST },
+        {"hot-params",  required_argument, 0, OPT_HOT_PARAMS },
+        {"hot-ttl",     required_argument, 0, OPT_HOT_TTL },
+        {"cosa-timeout", required_argument, 0, OPT_COSA_TIMEOUT },
+        {"cosa-breaker", required_argument, 0, OPT_COSA_BREAKER },
+        {"cosa-cooldown", required_argument, 0, OPT_COSA_COOLDOWN },
+        {"cosa-record", required_argument, 0, OPT_COSA_RECORD },
+        {"cosa-replay", required_argument, 0, OPT_COSA_REPLAY },
+        {"cosa-replay-scale", required_argument, 0, OPT_COSA_REPLAY_SCALE },
+#ifdef ENABLE_COSA_MOCK
+        {"cosa-mock",   required_argument, 0, OPT_COSA_MOCK },
+        {"cosa-mock-latency", required_argument, 0, OPT_COSA_MOCK_LATENCY },
+#endif
+        {0,             0,                 0,  0 }
+    };
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "ehs:v", long_options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+            case 'e':
+                jse_enter_exit = true;
+                break;
+
+            case 'h':
+                help(argv[0]);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 's':
+                socket_path = optarg;
+                break;
+
+            case 'v':
+                jse_verbosity ++;
+                break;
+
+            case OPT_DISCOVERY_TTL:
+                jse_cosa_cache_set_discovery_ttl(option_to_long("discovery-ttl", optarg));
+                break;
+
+            case OPT_TYPE_MANIFEST:
+                (void) jse_cosa_bus_load_types(optarg);
+                break;
+
+            case OPT_HOT_PARAMS:
+                (void) jse_cosa_bus_load_hot(optarg);
+                break;
+
+            case OPT_HOT_TTL:
+                jse_cosa_cache_set_hot_ttl(option_to_long("hot-ttl", optarg));
+                break;
+
+            case OPT_COSA_TIMEOUT:
+                jse_cosa_bus_set_timeout(option_to_long("cosa-timeout", optarg));
+                break;
+
+            case OPT_COSA_BREAKER:
+                jse_cosa_guard_set_threshold((int)option_to_long("cosa-breaker", optarg));
+                break;
+
+            case OPT_COSA_COOLDOWN:
+                jse_cosa_guard_set_cooldown(option_to_long("cosa-cooldown", optarg));
+                break;
+
+            case OPT_COSA_RECORD:
+                jse_cosa_bus_set_record(optarg);
+                break;
+
+            case OPT_COSA_REPLAY:
+                jse_cosa_trace_set_replay(optarg);
+                jse_cosa_bus_set_backend(&jse_cosa_replay_backend);
+                break;
+
+            case OPT_COSA_REPLAY_SCALE:
+                jse_cosa_trace_set_replay_scale(option_to_long("cosa-replay-scale", optarg));
+                break;
+
+#ifdef ENABLE_COSA_MOCK
+            case OPT_COSA_MOCK:
+                jse_cosa_mock_set_snapshot(optarg);
+                jse_cosa_bus_set_backend(&jse_cosa_mock_backend);
+                break;
+
+            case OPT_COSA_MOCK_LATENCY:
+                jse_cosa_mock_set_latency(option_to_long("cosa-mock-latency", optarg));
+                break;
+#endif
+
+            default:
+                help(argv[0]);
+                exit(EXIT_FAILURE);
+                break;
+        }
+    }
+}
+
+/**
+ * @brief The main entry point for jse-cosad.
+ *
+ * @param argc the argument count.
+ * @param argv the array of argument strings.
+ *
+ * @return 0 or an error code.
+ */
+int main(int argc, char ** argv)
+{
+    struct sigaction action;
+    int listener;
+
+    JSE_DEBUG_INIT()
+
+    parse_options(argc, argv);
+
+    /* We are the broker */
+    jse_cosa_bus_set_broker(NULL);
+
+    if (jse_cosa_bus_init() != 0)
+    {
+        JSE_ERROR("Failed to initialise the Cosa backend!")
+        return EXIT_FAILURE;
+    }
+
+    listener = jse_cosa_broker_listen(socket_path);
+    if (listener == -1)
+    {
+        jse_cosa_bus_shutdown();
+        return EXIT_FAILURE;
+    }
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stop;
+    sigemptyset(&action.sa_mask);
+    (void) sigaction(SIGTERM, &action, NULL);
+    (void) sigaction(SIGINT, &action, NULL);
+    (void) signal(SIGPIPE, SIG_IGN);
+
+    JSE_INFO("jse-cosad listening on %s", socket_path)
+
+    serve(listener);
+
+    JSE_INFO("jse-cosad stopping")
+
+    close(listener);
+    (void) unlink(socket_path);
+
+    jse_cosa_broker_msg_free(&request);
+    jse_cosa_broker_msg_free(&response);
+    jse_cosa_bus_shutdown();
+
+    return EXIT_SUCCESS;
+}
@@ -26,6 +26,9 @@
 #endif
 #endif
 
+/** The heap stash key of the PosixError prototype */
+#define POSIX_ERROR_STASH_KEY "PosixError.prototype"
+
 /** Reference count for binding. */
 static int ref_count = 0;
 
@@ -101,6 +104,55 @@ static duk_ret_t do_posix_error_get_errno(duk_context * ctx)
     return 1;
 }
 
+/**
+ * @brief Pushes the PosixError prototype on to the stack.
+ *
+ * The prototype inherits from Error.prototype and holds the name and
+ * methods shared by every PosixError. It is created once per heap and kept in
+ * the heap stash.
+ *
+ * @param ctx the duktape context.
+ */
+static void push_posix_error_prototype(duk_context * ctx)
+{
+    duk_push_heap_stash(ctx);
+    /* [ .... stash ] */
+
+    if (!duk_get_prop_string(ctx, -1, POSIX_ERROR_STASH_KEY))
+    {
+        /* [ .... stash, undefined ] */
+        duk_pop(ctx);
+
+        duk_push_object(ctx);
+        /* [ .... stash, prototype ] */
+
+        duk_get_global_string(ctx, "Error");
+        duk_get_prop_string(ctx, -1, "prototype");
+        /* [ .... stash, prototype, Error, Error.prototype ] */
+
+        duk_set_prototype(ctx, -3);
+        duk_pop(ctx);
+        /* [ .... stash, prototype ] */
+
+        duk_push_string(ctx, "PosixError");
+        duk_put_prop_string(ctx, -2, "name");
+
+        duk_push_c_function(ctx, do_posix_error_to_string, 0);
+        duk_put_prop_string(ctx, -2, "toString");
+
+        duk_push_c_function(ctx, do_posix_error_get_errno, 0);
+        duk_put_prop_string(ctx, -2, "getErrno");
+
+        duk_dup_top(ctx);
+        duk_put_prop_string(ctx, -3, POSIX_ERROR_STASH_KEY);
+    }
+
+    /* [ .... stash, prototype ] */
+    duk_swap_top(ctx, -2);
+    duk_pop(ctx);
+    /* [ .... prototype ] */
+}
+
 /**
  * @brief Pushes a PosixError object on to the stack.
  *
@@ -117,30 +169,18 @@ static duk_int_t push_posix_error_va(duk_context * ctx, int _errno, const char *
     duk_push_error_object_va(ctx, DUK_ERR_ERROR, format, ap);
     /* [ .... Error ] */
 
-    duk_push_string(ctx, "PosixError");
-    /* [ .... Error, "PosixError" ] */
+    push_posix_error_prototype(ctx);
+    /* [ .... Error, PosixError.prototype ] */
 
-    duk_put_prop_string(ctx, -2, "name"); /* Error */
-    /* [ .... Error ] */
+    duk_set_prototype(ctx, -2); /* Error */
+    /* [ .... PosixError ] */
 
     duk_push_int(ctx, _errno);
     /* [ .... Error, _errno ] */
 
     /* This creates the errno field. */
-    duk_put_prop_string(ctx, -2, "errno"); /* Error */
-    /* [ .... Error ] */
-
-    duk_push_c_function(ctx, do_posix_error_to_string, 0);
-    /* [ .... Error, do_posix_error_to_string ] */
-
-    duk_put_prop_string(ctx, -2, "toString"); /* Error */
-    /* [ .... Error ] */
-
-    duk_push_c_function(ctx, do_posix_error_get_errno, 0);
-    /* [ .... Error, do_posix_error_get_errno ] */
-
-    duk_put_prop_string(ctx, -2, "getErrno"); /* Error */
-    /* [ .... Error ] */
+    duk_put_prop_string(ctx, -2, "errno"); /* PosixError */
+    /* [ .... PosixError ] */
 
     return 0;
 }
@@ -308,6 +348,13 @@ duk_int_t jse_bind_jserror(jse_context_t * jse_ctx)
         if (ref_count == 0)
         {
             duk_push_c_function(jse_ctx->ctx, do_new_posix_error, 2);
+
+            /* So that instanceof PosixError works */
+            push_posix_error_prototype(jse_ctx->ctx);
+            duk_dup(jse_ctx->ctx, -2);
+            duk_put_prop_string(jse_ctx->ctx, -2, "constructor");
+            duk_put_prop_string(jse_ctx->ctx, -2, "prototype");
+
             duk_put_global_string(jse_ctx->ctx, "PosixError");
 
             duk_push_c_function(jse_ctx->ctx, do_throw_posix_error, 2);
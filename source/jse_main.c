@@ -18,6 +18,8 @@
 
 #ifdef ENABLE_FASTCGI
 #include "fcgi_stdio.h"
+#include "fcgiapp.h"
+#include "fastcgi.h"
 #else
 #include <stdio.h>
 #endif
@@ -25,12 +27,19 @@
 #include <string.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include <ctype.h>
+#include <strings.h>
 #include <getopt.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <poll.h>
+#include <time.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 #include <qdecoder.h>
 #include <duktape.h>
 
@@ -39,16 +48,25 @@
 #include "jse_jscommon.h"
 #include "jse_jserror.h"
 #include "jse_jsprocess.h"
+#include "jse_stats.h"
+#include "jse_cache.h"
+#include "jse_coalesce.h"
 
 #ifdef ENABLE_LIBXML2
 #include "jse_xml.h"
 #endif
 
-#ifdef BUILD_RDK
+#ifdef ENABLE_COSA
 #include "jse_cosa.h"
+#include "jse_cosa_bus.h"
+#include "jse_cosa_cache.h"
+#include "jse_cosa_pool.h"
+#include "jse_cosa_guard.h"
+#include "jse_cosa_trace.h"
+#endif
 
-/** Flag that is set once the Cosa API is initialised successfully */
-static bool cosa_initialised = false;
+#ifdef ENABLE_COSA_MOCK
+#include "jse_cosa_mock.h"
 #endif
 
 #ifdef ENABLE_LIBCRYPTO
@@ -67,6 +85,7 @@ static bool cosa_initialised = false;
 #define EXIT_FATAL 3
 
 #define JSE_REQUEST_OBJECT_NAME "Request"
+#define JSE_AFTER_RESPONSE_STASH_KEY "afterResponse"
 #define JSE_UPLOAD_DIR "/var/jse/uploads"
 #define JSE_UPLOAD_EXPIRY_SECS 3600
 
@@ -96,6 +115,63 @@ extern char **environ;
 /* The upload directory */
 static char * upload_dir = NULL;
 
+/* Values for the options that only have a long form */
+enum long_option_e
+{
+    OPT_GC_EVERY = 256,
+    OPT_GC_GROWTH,
+    OPT_GC_IDLE,
+    OPT_QUEUE_DEADLINE,
+    OPT_RETRY_AFTER,
+    OPT_CACHE_SIZE,
+    OPT_COALESCE,
+    OPT_COALESCE_DIR,
+    OPT_COALESCE_WAIT,
+    OPT_DISCOVERY_TTL,
+    OPT_TYPE_MANIFEST,
+    OPT_COSA_MEMO,
+    OPT_HOT_PARAMS,
+    OPT_HOT_TTL,
+    OPT_COSAD_SOCKET,
+    OPT_COSA_THREADS,
+    OPT_COSA_MOCK,
+    OPT_COSA_MOCK_LATENCY,
+    OPT_COSA_TIMEOUT,
+    OPT_COSA_BREAKER,
+    OPT_COSA_COOLDOWN,
+    OPT_COSA_RECORD,
+    OPT_COSA_REPLAY,
+    OPT_COSA_REPLAY_SCALE,
+};
+
+#ifdef ENABLE_FASTCGI
+/* Policy for releasing memory between requests. Zero disables a trigger. */
+static long gc_every = 0;
+static long gc_growth_kb = 0;
+static long gc_idle_ms = 0;
+
+/* Requests handled since memory was last released */
+static long gc_requests = 0;
+
+/* The size of the C heap when memory was last released */
+static size_t gc_heap_size = 0;
+
+/* Requests queued for longer than this are rejected. Zero disables. */
+static long queue_deadline_ms = 0;
+
+/* The Retry-After value returned when a request is rejected */
+static long retry_after_secs = 1;
+
+/* Coalesce identical GET requests even if the script has not opted in */
+static bool coalesce_all = false;
+
+/* The time to wait for another process handling the same request */
+static long coalesce_wait_ms = JSE_COALESCE_DEFAULT_WAIT_MS;
+#endif
+
+/* The time the current request started */
+static uint64_t request_start_usec = 0;
+
 /* The requests to process */
 static bool process_get     = false;
 static bool process_post    = false;
@@ -151,6 +227,21 @@ typedef struct cookie_data_s cookie_data_t;
 
 static cookie_data_t http_cookie;
 
+/* The time to cache the response for, set by the script. -1 if not set. */
+static long cache_ttl_secs = -1;
+
+/* The time a stale response may be used while it is regenerated */
+static long cache_stale_secs = 0;
+
+/* The request headers the response varies on, comma separated */
+static char * cache_vary = NULL;
+
+/* Set while regenerating a stale response that has already been sent */
+static bool cache_revalidating = false;
+
+/* The copy of the environment used while revalidating */
+static char ** revalidate_environ = NULL;
+
 /* Linked list of 'file' objects */
 struct file_object_s
 {
@@ -207,6 +298,9 @@ static void cookie_destroy(cookie_data_t * cookie)
     {
         free(cookie->domain);
     }
+
+    /* The cookie is tested to see whether the response sets one */
+    memset(cookie, 0, sizeof(*cookie));
 }
 
 /**
@@ -402,6 +496,12 @@ static void return_error(jse_context_t *jse_ctx, int status, const char* mimetyp
 
     JSE_ERROR(buffer)
 
+    /* The stale response has already been sent */
+    if (cache_revalidating)
+    {
+        return;
+    }
+
     /* Setting the content type terminates the header so output the status now */
     return_http_status(status);
 
@@ -431,1127 +531,1857 @@ static void set_any_cookies(jse_context_t *jse_ctx)
 }
 
 /**
- * @brief Returns a response to the server.
- *
- * @param status the HTTP status.
- * @param contenttype the content type.
+ * @brief Discards any buffered printed content.
  */
-static void return_response(jse_context_t *jse_ctx, int status, const char* contenttype)
+static void discard_print_buffer(void)
 {
-    return_http_status(status);
+    /* Iterate through the buffer of printed content. */
+    while (first_print_item != NULL)
+    {
+        print_buffer_item_t * item = first_print_item;
 
-    /* Iterate through the headers */
+        first_print_item = item->next;
+        free(item->string);
+        free(item);
+    }
+    last_print_item = NULL;
+}
+
+/**
+ * @brief Discards the headers, cookie, status and printed content set for
+ * a response that will not be sent.
+ */
+static void discard_response(void)
+{
     while (first_header_item != NULL)
     {
         header_item_t * item = first_header_item;
 
-        printf("%s: %s\r\n", item->name, item->value);
         first_header_item = item->next;
-
         free(item->value);
         free(item->name);
         free(item);
     }
 
-    set_any_cookies(jse_ctx);
+    cookie_destroy(&http_cookie);
+    http_status = 0;
 
-    /* This basically ends the header so has to be done last. */
-    qcgires_setcontenttype(jse_ctx->req, contenttype);
+    discard_print_buffer();
+}
 
-    /* Iterate through the buffer of printed content. */
-    while (first_print_item != NULL)
+/**
+ * @brief Completes the response to the server.
+ *
+ * Once the response has been generated the request is completed so that
+ * the client is not kept waiting on any post response work such as
+ * deferred functions and the tear down of the duktape heap.
+ */
+static void finish_response(void)
+{
+    JSE_ENTER("finish_response()")
+
+    if (fflush(stdout) != 0)
     {
-        print_buffer_item_t * item = first_print_item;
+        JSE_ERROR("fflush() failed: %s", strerror(errno))
+    }
 
-        // So we can handle strings with null characters.
-        fwrite(item->string, item->length, 1, stdout);
-        first_print_item = item->next;
-        free(item->string);
-        free(item);
+#ifdef ENABLE_FASTCGI
+    /* Completes the request. A NOP when not running as a Fast CGI server.
+       Detaches stdout so must come after the flush. */
+    FCGI_Finish();
+#endif
+
+#ifndef ENABLE_FASTCGI
+    /* For CGI the server sees the end of the response when stdout is
+       closed. Replace it with /dev/null so any later output is harmless. */
+    int fd = open("/dev/null", O_WRONLY);
+    if (fd != -1)
+    {
+        int ret = -1;
+
+        TEMP_FAILURE_RETRY(ret = dup2(fd, STDOUT_FILENO));
+        if (ret == -1)
+        {
+            JSE_ERROR("dup2() failed: %s", strerror(errno))
+        }
+
+        close(fd);
     }
-    last_print_item = NULL;
+    else
+    {
+        JSE_ERROR("open() failed: %s", strerror(errno))
+    }
+#endif
+
+    JSE_EXIT("finish_response()")
 }
 
-__attribute__((noreturn))
+#ifdef ENABLE_FASTCGI
 /**
- * @brief Handle fatal duktape errors.
+ * @brief Tests whether a comma separated header list includes a header.
  *
- * @param userdata a pointer to the jse context as a void*.
- * @param msg the error message.
+ * @param vary the header list or NULL.
+ * @param name the header name.
+ * @return true if included.
  */
-static void handle_fatal_error(void* userdata, const char *msg)
+static bool vary_includes(const char * vary, const char * name)
 {
-    jse_context_t *jse_ctx = (jse_context_t*)userdata;
+    size_t len = strlen(name);
 
-    JSE_ERROR(msg)
+    while (vary != NULL && *vary != '\0')
+    {
+        const char * end = strchr(vary, ',');
+        size_t toklen = end != NULL ? (size_t)(end - vary) : strlen(vary);
 
-    /* Only output HTTP data if we have a qdecoder request. */
-    if (jse_ctx != NULL && jse_ctx->req != NULL)
+        if (toklen == len && !strncasecmp(vary, name, len))
+        {
+            return true;
+        }
+
+        vary = end != NULL ? end + 1 : NULL;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Tests whether the response to the current request may be shared.
+ *
+ * Only the responses to GET requests are cached or shared with identical
+ * requests. Requests with cookies only if the response varies on the
+ * cookies.
+ *
+ * @param vary the headers the response varies on or NULL.
+ * @return true if shareable.
+ */
+static bool request_shareable(const char * vary)
+{
+    const char * method = getenv("REQUEST_METHOD");
+
+    if (method == NULL || strcmp(method, "GET"))
     {
-        return_error(jse_ctx, HTTP_STATUS_INTERNAL_SERVER_ERROR, "text/html", 
-            "<html><head><title>Internal server error</title></head><body>%s</body></html>", msg);
+        return false;
+    }
 
-        jse_ctx->req->free(jse_ctx->req);
-        jse_ctx->req = NULL;
+    if (getenv("HTTP_COOKIE") != NULL && !vary_includes(vary, "Cookie"))
+    {
+        return false;
     }
 
-    if (jse_ctx != NULL)
+    return true;
+}
+
+/**
+ * @brief Returns the value of a request header.
+ *
+ * @param name the header name, not necessarily terminated.
+ * @param len the length of the name.
+ * @return the value or NULL if not present.
+ */
+static const char * request_header(const char * name, size_t len)
+{
+    char envname[128];
+    size_t i;
+
+    if (len + 6 > sizeof(envname))
     {
-        free(jse_ctx);
+        JSE_WARNING("Header name too long!")
+        return NULL;
     }
 
-    exit(EXIT_FATAL);
+    /* The CGI environment variable for a header */
+    strcpy(envname, "HTTP_");
+    for (i = 0; i < len; i++)
+    {
+        envname[5 + i] = name[i] == '-' ? '_' : (char)toupper((unsigned char)name[i]);
+    }
+    envname[5 + len] = '\0';
+
+    return getenv(envname);
 }
 
 /**
- * @brief Initialise duktape
+ * @brief Creates the cache key for the current request.
  *
- * @param jse_ctx the jse context.
+ * The key is the script filename, the query string and the values of the
+ * headers the response varies on.
  *
- * @return the duktape context.
+ * @param script the script filename.
+ * @param vary the headers the response varies on or NULL.
+ * @return the key which must be freed or NULL on error.
  */
-static duk_context *init_duktape(jse_context_t *jse_ctx)
+static char * cache_key(const char * script, const char * vary)
 {
-    JSE_ENTER("init_duktape(%p)", jse_ctx)
+    const char * query = getenv("QUERY_STRING");
+    const char * name = NULL;
+    char * key = NULL;
+    size_t size = strlen(script) + (query != NULL ? strlen(query) : 0) + 2;
+
+    /* Work out the size first */
+    name = vary;
+    while (name != NULL && *name != '\0')
+    {
+        size_t len = strcspn(name, ",");
+        const char * value = request_header(name, len);
 
-    /* TODO: low mem allocators */
-    jse_ctx->ctx = duk_create_heap(NULL, NULL, NULL, jse_ctx, handle_fatal_error);
+        size += len + (value != NULL ? strlen(value) : 0) + 3;
 
-    JSE_EXIT("init_duktape()=%p", jse_ctx->ctx)
-    return jse_ctx->ctx;
+        name = name[len] == ',' ? &name[len + 1] : NULL;
+    }
+
+    key = (char *)malloc(size);
+    if (key == NULL)
+    {
+        JSE_ERROR("malloc() failed: %s", strerror(errno))
+        return NULL;
+    }
+
+    snprintf(key, size, "%s?%s", script, query != NULL ? query : "");
+
+    name = vary;
+    while (name != NULL && *name != '\0')
+    {
+        size_t len = strcspn(name, ",");
+        const char * value = request_header(name, len);
+
+        strcat(key, "\n");
+        strncat(key, name, len);
+        strcat(key, ": ");
+        if (value != NULL)
+        {
+            strcat(key, value);
+        }
+
+        name = name[len] == ',' ? &name[len + 1] : NULL;
+    }
+
+    return key;
 }
 
 /**
- * @brief Cleanup duktape
+ * @brief Writes a stored response.
  *
- * @param jse_ctx the jse context.
+ * @param status the HTTP status.
+ * @param headers the headers.
+ * @param headers_length the length of the headers.
+ * @param contenttype the content type.
+ * @param body the body.
+ * @param body_length the length of the body.
  */
-static void cleanup_duktape(jse_context_t *jse_ctx)
+static void replay_response(int status, const char * headers, size_t headers_length,
+    const char * contenttype, const void * body, size_t body_length)
 {
-    JSE_ENTER("cleanup_duktape(%p)", jse_ctx)
-
-    duk_destroy_heap(jse_ctx->ctx);
+    return_http_status(status);
+    fwrite(headers, headers_length, 1, stdout);
+    qcgires_setcontenttype(NULL, contenttype);
+    fwrite(body, body_length, 1, stdout);
 
-    JSE_EXIT("cleanup_duktape()")
+    finish_response();
+    jse_stats_add("response.usec", (long)(jse_time_usec() - request_start_usec));
 }
 
 /**
- * @brief Runs JavaScript code provided via stdin.
+ * @brief Stores the response in the cache if the script asked for it and
+ * publishes it to any processes waiting on the same request.
+ *
+ * Must be called before the headers and printed content are output.
  *
- * In case of an Error, an Error object remains on the stack when the
- * function exits.
- * 
  * @param jse_ctx the jse context.
- * @return an error status or 0.
+ * @param status the HTTP status.
+ * @param contenttype the content type.
  */
-static duk_int_t run_stdin(jse_context_t *jse_ctx)
+static void share_response(jse_context_t *jse_ctx, int status, const char* contenttype)
 {
-    duk_int_t ret = DUK_ERR_ERROR;
-    void *buffer = NULL;
-    size_t size = 0;
+    jse_coalesce_response_t response;
+    header_item_t * header = first_header_item;
+    print_buffer_item_t * item = first_print_item;
 
-    JSE_ENTER("run_stdin(%p)", jse_ctx)
- 
-    if (jse_read_fd(STDIN_FILENO, &buffer, &size) > 0)
+    /* Responses setting cookies are per client */
+    if (status != HTTP_STATUS_OK || http_cookie.name != NULL || !request_shareable(cache_vary))
     {
-        if (jse_run_buffer(jse_ctx, (char*)buffer, size) == DUK_EXEC_SUCCESS)
+        return;
+    }
+
+    if (cache_ttl_secs >= 0)
+    {
+        jse_cache_set_vary(jse_ctx->filename, cache_vary);
+    }
+
+    memset(&response, 0, sizeof(response));
+    response.status = status;
+    response.contenttype = (char *)contenttype;
+    response.vary = cache_vary;
+    response.ttl_secs = cache_ttl_secs > 0 ? cache_ttl_secs : 0;
+    response.stale_secs = cache_stale_secs;
+
+    while (header != NULL)
+    {
+        response.headers_length += strlen(header->name) + strlen(header->value) + 4;
+        header = header->next;
+    }
+
+    while (item != NULL)
+    {
+        response.body_length += item->length;
+        item = item->next;
+    }
+
+    response.headers = (char *)malloc(response.headers_length + 1);
+    response.body = malloc(response.body_length + 1);
+    response.key = cache_key(jse_ctx->filename, cache_vary);
+    if (response.headers != NULL && response.body != NULL && response.key != NULL)
+    {
+        size_t off = 0;
+
+        for (header = first_header_item; header != NULL; header = header->next)
         {
-            ret = 0;
+            off += (size_t)sprintf(&response.headers[off], "%s: %s\r\n", header->name, header->value);
         }
 
-        free(buffer);
+        off = 0;
+        for (item = first_print_item; item != NULL; item = item->next)
+        {
+            memcpy((char *)response.body + off, item->string, item->length);
+            off += item->length;
+        }
+
+        if (response.ttl_secs > 0 && jse_cache_get_limit() > 0)
+        {
+            (void) jse_cache_store(response.key, status, contenttype, response.headers, response.headers_length,
+                response.body, response.body_length, response.ttl_secs, response.stale_secs);
+        }
+
+        /* Does nothing unless other processes may be waiting */
+        jse_coalesce_publish(&response);
     }
     else
     {
-        JSE_ERROR("Error: %s", strerror(errno))
-        duk_push_error_object(jse_ctx->ctx, DUK_ERR_ERROR,  "%s", strerror(errno));
+        JSE_ERROR("Out of memory!")
     }
 
-    JSE_EXIT("run_stdin()=%d", ret)
-    return ret;
+    free(response.key);
+    free(response.body);
+    free(response.headers);
 }
 
 /**
- * @brief Runs JavaScript code provided in a file.
+ * @brief Copies the environment.
  *
- * In case of an Error, an Error object remains on the stack when the
- * function exits.
- * 
- * @param jse_ctx the jse context.
- * @return an error status or 0.
+ * @return the copy or NULL on error.
  */
-static duk_int_t run_file(jse_context_t * jse_ctx)
+static char ** copy_environment(void)
 {
-    duk_int_t ret = DUK_ERR_ERROR;
-    void * buffer = NULL;
-    size_t size = 0;
-    ssize_t bytes = 0;
+    char ** env = NULL;
+    size_t count = 0;
+    size_t i;
 
-    JSE_ENTER("run_file(%p)", jse_ctx)
+    while (environ != NULL && environ[count] != NULL)
+    {
+        count ++;
+    }
 
-    bytes = jse_read_file(jse_ctx->filename, &buffer, &size);
-    if (bytes > 0)
+    env = (char **)calloc(count + 1, sizeof(char *));
+    if (env != NULL)
     {
-        if (jse_run_buffer(jse_ctx, (char*)buffer, size) == DUK_EXEC_SUCCESS)
+        for (i = 0; i < count; i++)
         {
-            ret = 0;
-        }
+            env[i] = strdup(environ[i]);
+            if (env[i] == NULL)
+            {
+                JSE_ERROR("strdup() failed: %s", strerror(errno))
 
-        free(buffer);
+                while (i > 0)
+                {
+                    free(env[--i]);
+                }
+                free(env);
+                return NULL;
+            }
+        }
     }
     else
     {
-        JSE_ERROR("Error: %s: %s", jse_ctx->filename, strerror(errno))
-        duk_push_error_object(jse_ctx->ctx, DUK_ERR_ERROR, 
-            "%s: %s", jse_ctx->filename, strerror(errno));
+        JSE_ERROR("calloc() failed: %s", strerror(errno))
     }
 
-    JSE_EXIT("run_file()=%d", ret)
-    return ret;
+    return env;
 }
 
 /**
- * @brief Prints a string to the output.
+ * @brief Frees a copy of the environment.
  *
- * This function prints a string to the output. Typically this is standard
- * out. When handling HTTP requests output has to be delayed until the
- * HTTP header is output so all output is buffered internally and output
- * once the header has been generated.
+ * @param env the copy.
+ */
+static void free_environment(char ** env)
+{
+    size_t i;
+
+    for (i = 0; env != NULL && env[i] != NULL; i++)
+    {
+        free(env[i]);
+    }
+
+    free(env);
+}
+
+/**
+ * @brief Returns a cached response for the current request if there is one.
  *
- * @param ctx the duktape context.
- * @return 0 or a negative error status.
+ * A stale response is returned and the request completed. The request is
+ * then handled as normal, but with output suppressed, to refresh the cache.
+ * The Fast CGI library clears the environment when the request completes
+ * so a copy is kept for the refresh.
+ *
+ * @param script the script filename.
+ * @return the state of the cached response.
  */
-static duk_ret_t do_print(duk_context *ctx)
+static jse_cache_state_t serve_from_cache(const char * script)
 {
-    duk_ret_t ret = DUK_RET_ERROR;
-    duk_int_t count = duk_get_top(ctx);
+    jse_cache_state_t state = JSE_CACHE_MISS;
+    jse_cache_entry_t * entry = NULL;
+    const char * vary = NULL;
+    char * key = NULL;
 
-    JSE_ASSERT(ctx != NULL)
-    JSE_ENTER("do_print(%p)", ctx)
+    (void) jse_cache_get_vary(script, &vary);
 
-    if (count > 0)
+    if (jse_cache_get_limit() == 0 || !request_shareable(vary) || (key = cache_key(script, vary)) == NULL)
     {
-        const void * dukstr = NULL;
-        size_t dukstrlen = 0;
+        return JSE_CACHE_MISS;
+    }
 
-        /* Handle buffers as pure data */
-        if (duk_is_buffer_data(ctx, -1))
+    state = jse_cache_lookup(key, &entry);
+    if (state == JSE_CACHE_STALE)
+    {
+        revalidate_environ = copy_environment();
+        if (revalidate_environ == NULL)
         {
-            dukstr = duk_get_buffer_data(ctx, -1, &dukstrlen);
+            /* Just run the script */
+            state = JSE_CACHE_MISS;
         }
-        else
+    }
+
+    if (state != JSE_CACHE_MISS)
+    {
+        JSE_DEBUG("Cached response: %s (%s)", key, state == JSE_CACHE_FRESH ? "fresh" : "stale")
+
+        replay_response(entry->status, entry->headers, entry->headers_length,
+            entry->contenttype, entry->body, entry->body_length);
+
+        if (state == JSE_CACHE_STALE)
         {
-            dukstr = duk_safe_to_string(ctx, -1);
-            dukstrlen = strlen(dukstr);
+            environ = revalidate_environ;
+            cache_revalidating = true;
         }
+    }
 
-        /* Need to delay output because of errors, headers, etc */
-        if (is_http_request)
-        {
-            /* Do not use strdup because we may have null characters */
-            char * string = (char *)calloc(sizeof(char), dukstrlen);
-            if (string != NULL)
-            {
-                memcpy(string, dukstr, dukstrlen);
-                print_buffer_item_t *item = (print_buffer_item_t*)calloc(sizeof(print_buffer_item_t), 1);
-                if (item != NULL)
-                {
-                    item->string = string;
-                    item->length = dukstrlen;
+    free(key);
 
-                    if (last_print_item != NULL)
-                    {
-                        last_print_item->next = item;
-                    }
+    return state;
+}
 
-                    last_print_item = item;
+/**
+ * @brief Coalesces the current request with identical concurrent requests.
+ *
+ * Applies to scripts that have called setCacheTTL() or to all scripts if
+ * configured. If another process is handling the same request, waits for
+ * its response and returns it. Otherwise this process handles the request
+ * and its response is published to any processes that wait on it.
+ *
+ * @param script the script filename.
+ * @return true if the request was answered.
+ */
+static bool coalesce_request(const char * script)
+{
+    jse_coalesce_response_t * response = NULL;
+    const char * vary = NULL;
+    bool declared = jse_cache_get_vary(script, &vary);
+    bool answered = false;
+    char * key = NULL;
 
-                    if (first_print_item == NULL)
-                    {
-                        first_print_item = item;
-                    }
+    if ((!coalesce_all && !declared) || !request_shareable(vary) || (key = cache_key(script, vary)) == NULL)
+    {
+        return false;
+    }
 
-                    /* Nothing returned on the value stack */
-                    ret = 0;
-                }
-                else
-                {
-                    int _errno = errno;
-                    free(string);
-                    /* Does not return */
-                    JSE_THROW_POSIX_ERROR(ctx, _errno, "calloc() failed: %s", strerror(_errno));
-                }
+    if (jse_coalesce_begin(key, coalesce_wait_ms, &response) == JSE_COALESCE_FOLLOWER)
+    {
+        /* The response may vary on headers not known when the key was made */
+        char * response_key = cache_key(script, response->vary);
+
+        if (response_key != NULL && !strcmp(response_key, response->key))
+        {
+            JSE_DEBUG("Coalesced response: %s", response_key)
+
+            if (response->ttl_secs > 0 && jse_cache_get_limit() > 0)
+            {
+                jse_cache_set_vary(script, response->vary);
+                (void) jse_cache_store(response->key, response->status, response->contenttype,
+                    response->headers, response->headers_length, response->body, response->body_length,
+                    response->ttl_secs, response->stale_secs);
             }
-            else 
+
+            /* Unless just refreshing a stale response that has been sent */
+            if (!cache_revalidating)
             {
-                int _errno = errno;
-                /* Does not return */
-                JSE_THROW_POSIX_ERROR(ctx, _errno, "strdup() failed: %s", strerror(_errno));
+                replay_response(response->status, response->headers, response->headers_length,
+                    response->contenttype, response->body, response->body_length);
             }
-        }
-        else
-        {
-            /* Do not use strdup because we may have null characters */
-            fwrite(dukstr, dukstrlen, 1, stdout);
 
-            /* Return undefined */
-            ret = 0;
+            answered = true;
         }
+
+        free(response_key);
+        jse_coalesce_response_free(response);
     }
-    else
+
+    free(key);
+
+    return answered;
+}
+
+/**
+ * @brief Ends the refresh of a stale response.
+ */
+static void end_revalidation(void)
+{
+    if (cache_revalidating)
     {
-        /* Does nothing but is not an error */
-        ret = 0;
-    }
+        cache_revalidating = false;
 
-    JSE_EXIT("do_print()=%d", ret)
-    return ret;
+        environ = NULL;
+        free_environment(revalidate_environ);
+        revalidate_environ = NULL;
+    }
 }
+#endif
 
 /**
- * @brief Sets the HTTP status.
- *
- * This function sets the HTTP status. It expects one integer on the duktape
- * stack that specifies the status value.
- *
- * @param ctx the duktape context.
+ * @brief Returns a response to the server.
  *
- * @return 0 or a negative error status.
+ * @param status the HTTP status.
+ * @param contenttype the content type.
  */
-static duk_ret_t do_setHTTPStatus(duk_context * ctx)
+static void return_response(jse_context_t *jse_ctx, int status, const char* contenttype)
 {
-    duk_ret_t ret = DUK_RET_ERROR;
+#ifdef ENABLE_FASTCGI
+    share_response(jse_ctx, status, contenttype);
 
-    JSE_ENTER("do_setHTTPStatus(%p)", ctx)
+    /* The stale response has already been sent */
+    if (cache_revalidating)
+    {
+        discard_response();
+        return;
+    }
+#endif
 
-    if (duk_is_number(ctx, -1))
+    return_http_status(status);
+
+    /* Iterate through the headers */
+    while (first_header_item != NULL)
     {
-        http_status = (int)duk_get_int_default(ctx, -1, HTTP_STATUS_OK);
+        header_item_t * item = first_header_item;
 
-        JSE_DEBUG("status = %d", http_status)
+        printf("%s: %s\r\n", item->name, item->value);
+        first_header_item = item->next;
 
-        /* Return undefined */
-        ret = 0;
+        free(item->value);
+        free(item->name);
+        free(item);
     }
-    else
+
+    set_any_cookies(jse_ctx);
+
+    /* This basically ends the header so has to be done last. */
+    qcgires_setcontenttype(jse_ctx->req, contenttype);
+
+    /* Iterate through the buffer of printed content. */
+    while (first_print_item != NULL)
     {
-        /* Does not return */
-        JSE_THROW_TYPE_ERROR(ctx, "Invalid argument!");
-    }
+        print_buffer_item_t * item = first_print_item;
 
-    JSE_EXIT("do_setHTTPStatus()=%d", ret)
-    return ret;
+        // So we can handle strings with null characters.
+        fwrite(item->string, item->length, 1, stdout);
+        first_print_item = item->next;
+        free(item->string);
+        free(item);
+    }
+    last_print_item = NULL;
 }
 
 /**
- * @brief Sets the mimetype.
- *
- * This function sets the content type. It expects one string on the duktape
- * stack that specifies the content type.
+ * @brief Runs the functions queued by runAfterResponse().
  *
- * @param ctx the duktape context.
+ * The functions are called in the order they were queued. An error thrown
+ * by one function is reported and does not prevent the others from being
+ * called. Functions may queue further functions which are also called.
  *
- * @return 0 or a negative error status.
+ * @param jse_ctx the jse context.
  */
-static duk_ret_t do_setContentType(duk_context * ctx)
+static void run_after_response(jse_context_t *jse_ctx)
 {
-    duk_ret_t ret = DUK_RET_ERROR;
+    duk_context *ctx = jse_ctx->ctx;
+    uint64_t start = jse_time_usec();
+    duk_uarridx_t i;
 
-    JSE_ENTER("do_setContentType(%p)", ctx)
+    JSE_ENTER("run_after_response(%p)", jse_ctx)
 
-    if (duk_is_string(ctx, -1))
+    duk_push_heap_stash(ctx);
+    /* [ .... stash ] */
+
+    if (duk_get_prop_string(ctx, -1, JSE_AFTER_RESPONSE_STASH_KEY))
     {
-        char * string = strdup(duk_safe_to_string(ctx, -1));
-        if (string != NULL)
+        /* [ .... stash, array ] */
+
+        /* The length is re-read as functions may queue more functions */
+        for (i = 0; i < (duk_uarridx_t)duk_get_length(ctx, -1); i++)
         {
-            if (http_contenttype != NULL)
+            duk_get_prop_index(ctx, -1, i);
+            /* [ .... stash, array, function ] */
+
+            if (duk_pcall(ctx, 0) != DUK_EXEC_SUCCESS)
             {
-                free(http_contenttype);
+                JSE_ERROR("runAfterResponse() function failed: %s", duk_safe_to_string(ctx, -1))
             }
+            /* [ .... stash, array, result ] */
 
-            http_contenttype = string;
-
-            JSE_DEBUG("mimetype = %s", http_contenttype)
-
-            /* Return undefined */
-            ret = 0;
-        }
-        else 
-        {
-            int _errno = errno;
-            /* Does not return */
-            JSE_THROW_POSIX_ERROR(ctx, _errno, "strdup() failed: %s", strerror(_errno));
+            duk_pop(ctx);
         }
-    }
-    else
-    {
-        /* Does not return */
-        JSE_THROW_TYPE_ERROR(ctx, "Invalid argument \"mimetype\"!");
+
+        duk_push_array(ctx);
+        duk_put_prop_string(ctx, -3, JSE_AFTER_RESPONSE_STASH_KEY);
     }
 
-    JSE_EXIT("do_setContentType()=%d", ret)
-    return ret;
+    duk_pop_2(ctx);
+    /* [ .... ] */
+
+    /* There is no one to receive anything set or printed now, and it must
+       not go out with the next response */
+    discard_response();
+
+    jse_stats_add("deferred.usec", (long)(jse_time_usec() - start));
+
+    JSE_EXIT("run_after_response()")
 }
 
+__attribute__((noreturn))
 /**
- * @brief Sets the cookie value.
- *
- * This function sets the cookie value. It expects five arguments, the
- * cookie name, the cookie value, an expiry time in seconds (0 expire
- * now), an optional path (may be null), an optional domain (may be
- * null), and a boolean indicating a secure cookie or not.
- *
- * @param ctx the duktape context.
+ * @brief Handle fatal duktape errors.
  *
- * @return 0 or a negative error status.
+ * @param userdata a pointer to the jse context as a void*.
+ * @param msg the error message.
  */
-static duk_ret_t do_setCookie(duk_context * ctx)
+static void handle_fatal_error(void* userdata, const char *msg)
 {
-    char * name = NULL;
-    char * value = NULL;
-    int expire_secs = 0;
-    char * path = NULL;
-    char * domain = NULL;
-    bool secure = false;
+    jse_context_t *jse_ctx = (jse_context_t*)userdata;
 
-    JSE_ENTER("do_setCookie(%p)", ctx)
+    JSE_ERROR(msg)
 
-    if (duk_is_string(ctx, -6))
-    {
-        name = strdup(duk_safe_to_string(ctx, -6));
-        if (name == NULL)
-        {
-            int _errno = errno;
-            /* Does not return */
-            JSE_THROW_POSIX_ERROR(ctx, _errno, "strdup() failed: %s", strerror(_errno));
-        }
-    }
-    else
+    /* Only output HTTP data if we have a qdecoder request. */
+    if (jse_ctx != NULL && jse_ctx->req != NULL)
     {
-        /* Does not return */
-        JSE_THROW_TYPE_ERROR(ctx, "Invalid argument \"name\" (%d)", duk_get_type(ctx, -6));
-    }
+        return_error(jse_ctx, HTTP_STATUS_INTERNAL_SERVER_ERROR, "text/html", 
+            "<html><head><title>Internal server error</title></head><body>%s</body></html>", msg);
 
-    if (duk_is_string(ctx, -5))
-    {
-        value = strdup(duk_safe_to_string(ctx, -5));
-        if (value == NULL)
-        {
-            int _errno = errno;
-            free(name);
-            /* Does not return */
-            JSE_THROW_POSIX_ERROR(ctx, _errno, "strdup() failed: %s", strerror(_errno));
-        }
-    }
-    else
-    {
-        free(name);
-        /* Does not return */
-        JSE_THROW_TYPE_ERROR(ctx, "Invalid argument \"value\" (%d)", duk_get_type(ctx, -5));
+        jse_ctx->req->free(jse_ctx->req);
+        jse_ctx->req = NULL;
     }
 
-    if (duk_is_number(ctx, -4))
-    {
-        expire_secs = (int)duk_get_int_default(ctx, -4, 0);
-    }
-    else
+    if (jse_ctx != NULL)
     {
-        free(value);
-        free(name);
-        /* Does not return */
-        JSE_THROW_TYPE_ERROR(ctx, "Invalid argument \"expire_secs\" (%d)", duk_get_type(ctx, -4));
+        free(jse_ctx);
     }
 
-    if (!duk_is_null(ctx, -3))
+    exit(EXIT_FATAL);
+}
+
+/**
+ * @brief Initialise duktape
+ *
+ * @param jse_ctx the jse context.
+ *
+ * @return the duktape context.
+ */
+static duk_context *init_duktape(jse_context_t *jse_ctx)
+{
+    JSE_ENTER("init_duktape(%p)", jse_ctx)
+
+    /* TODO: low mem allocators */
+    jse_ctx->ctx = duk_create_heap(NULL, NULL, NULL, jse_ctx, handle_fatal_error);
+
+    JSE_EXIT("init_duktape()=%p", jse_ctx->ctx)
+    return jse_ctx->ctx;
+}
+
+/**
+ * @brief Cleanup duktape
+ *
+ * @param jse_ctx the jse context.
+ */
+static void cleanup_duktape(jse_context_t *jse_ctx)
+{
+    JSE_ENTER("cleanup_duktape(%p)", jse_ctx)
+
+    duk_destroy_heap(jse_ctx->ctx);
+
+    JSE_EXIT("cleanup_duktape()")
+}
+
+/**
+ * @brief Runs JavaScript code provided via stdin.
+ *
+ * In case of an Error, an Error object remains on the stack when the
+ * function exits.
+ * 
+ * @param jse_ctx the jse context.
+ * @return an error status or 0.
+ */
+static duk_int_t run_stdin(jse_context_t *jse_ctx)
+{
+    duk_int_t ret = DUK_ERR_ERROR;
+    void *buffer = NULL;
+    size_t size = 0;
+
+    JSE_ENTER("run_stdin(%p)", jse_ctx)
+ 
+    if (jse_read_fd(STDIN_FILENO, &buffer, &size) > 0)
     {
-        if (duk_is_string(ctx, -3))
-        {
-            path = strdup(duk_safe_to_string(ctx, -3));
-            if (path == NULL)
-            {
-                int _errno = errno;
-                free(value);
-                free(name);
-                /* Does not return */
-                JSE_THROW_POSIX_ERROR(ctx, _errno, "strdup() failed: %s", strerror(_errno));
-            }
-        }
-        else
+        if (jse_run_buffer(jse_ctx, (char*)buffer, size) == DUK_EXEC_SUCCESS)
         {
-            free(value);
-            free(name);
-            /* Does not return */
-            JSE_THROW_TYPE_ERROR(ctx, "Invalid argument \"path\" (%d)", duk_get_type(ctx, -3));
+            ret = 0;
         }
+
+        free(buffer);
+    }
+    else
+    {
+        JSE_ERROR("Error: %s", strerror(errno))
+        duk_push_error_object(jse_ctx->ctx, DUK_ERR_ERROR,  "%s", strerror(errno));
     }
 
-    if (!duk_is_null(ctx, -2))
+    JSE_EXIT("run_stdin()=%d", ret)
+    return ret;
+}
+
+/**
+ * @brief Runs JavaScript code provided in a file.
+ *
+ * In case of an Error, an Error object remains on the stack when the
+ * function exits.
+ * 
+ * @param jse_ctx the jse context.
+ * @return an error status or 0.
+ */
+static duk_int_t run_file(jse_context_t * jse_ctx)
+{
+    duk_int_t ret = DUK_ERR_ERROR;
+    void * buffer = NULL;
+    size_t size = 0;
+    ssize_t bytes = 0;
+
+    JSE_ENTER("run_file(%p)", jse_ctx)
+
+    bytes = jse_read_file(jse_ctx->filename, &buffer, &size);
+    if (bytes > 0)
     {
-        if (duk_is_string(ctx, -2))
-        {
-            domain = strdup(duk_safe_to_string(ctx, -2));
-            if (domain == NULL)
-            {
-                int _errno = errno;
-                free(value);
-                free(name);
-                free(path); /* path may be NULL but free(NULL) is a NOP per C99 */
-                /* Does not return */
-                JSE_THROW_POSIX_ERROR(ctx, _errno, "strdup() failed: %s", strerror(_errno));
-            }
-        }
-        else
+        if (jse_run_buffer(jse_ctx, (char*)buffer, size) == DUK_EXEC_SUCCESS)
         {
-            free(value);
-            free(name);
-            free(path); /* path may be NULL but free(NULL) is a NOP per C99 */
-            /* Does not return */
-            JSE_THROW_TYPE_ERROR(ctx, "Invalid argument \"domain\" (%d)", duk_get_type(ctx, -2));
+            ret = 0;
         }
-    }
 
-    if (duk_is_boolean(ctx, -1))
-    {
-        /* Prevent error with -Wbad-function-cast */
-        duk_bool_t duksec = duk_get_boolean_default(ctx, -1, false);
-        secure = (bool)duksec;
+        free(buffer);
     }
     else
     {
-        free(value);
-        free(name);
-        free(path);   /* path may be NULL but free(NULL) is a NOP per C99 */
-        free(domain); /* domain may be NULL but free(NULL) is a NOP per C99 */
-        /* Does not return */
-        JSE_THROW_TYPE_ERROR(ctx, "Invalid argument \"secure\" (%d)", duk_get_type(ctx, -1));
+        JSE_ERROR("Error: %s: %s", jse_ctx->filename, strerror(errno))
+        duk_push_error_object(jse_ctx->ctx, DUK_ERR_ERROR, 
+            "%s: %s", jse_ctx->filename, strerror(errno));
     }
 
-    cookie_destroy(&http_cookie);
-    cookie_set(&http_cookie, name, value, expire_secs, path, domain, secure);
-
-    JSE_DEBUG("cookie=\"%s\"=\"%s\",expires=%d,path=\"%s\",domain=\"%s\",secure=%s",
-        http_cookie.name, http_cookie.value, http_cookie.expire_secs,
-        http_cookie.path != NULL ? http_cookie.path : "(null)",
-        http_cookie.domain !=NULL ? http_cookie.domain : "(null)",
-        http_cookie.secure ? "true" : "false")
-
-    JSE_EXIT("do_setCookie()=0")
-    return 0;
+    JSE_EXIT("run_file()=%d", ret)
+    return ret;
 }
 
 /**
- * @brief Sets or adds an HTTP header
- * 
- * This function sets or adds a header. The function expects two strings
- * the first being the header name. The second being the value. If the
- * name already exists it is replaced by the new value. The test for the
- * name is case insensitive.
+ * @brief Prints a string to the output.
  *
- * @param ctx the duktape context.
+ * This function prints a string to the output. Typically this is standard
+ * out. When handling HTTP requests output has to be delayed until the
+ * HTTP header is output so all output is buffered internally and output
+ * once the header has been generated.
  *
+ * @param ctx the duktape context.
  * @return 0 or a negative error status.
  */
-static duk_ret_t do_setHeader(duk_context * ctx)
+static duk_ret_t do_print(duk_context *ctx)
 {
     duk_ret_t ret = DUK_RET_ERROR;
-    char * name = NULL;
-    char * value = NULL;
+    duk_int_t count = duk_get_top(ctx);
 
-    JSE_ENTER("do_setHeader(%p)", ctx)
+    JSE_ASSERT(ctx != NULL)
+    JSE_ENTER("do_print(%p)", ctx)
 
-    if (duk_is_string(ctx, -2))
+    if (count > 0)
     {
-        name = strdup(duk_safe_to_string(ctx, -2));
-        if (name != NULL)
+        const void * dukstr = NULL;
+        size_t dukstrlen = 0;
+
+        /* Handle buffers as pure data */
+        if (duk_is_buffer_data(ctx, -1))
         {
-            if (header_validate(name))
+            dukstr = duk_get_buffer_data(ctx, -1, &dukstrlen);
+        }
+        else
+        {
+            dukstr = duk_safe_to_string(ctx, -1);
+            dukstrlen = strlen(dukstr);
+        }
+
+        /* Need to delay output because of errors, headers, etc */
+        if (is_http_request)
+        {
+            /* Do not use strdup because we may have null characters */
+            char * string = (char *)calloc(sizeof(char), dukstrlen);
+            if (string != NULL)
             {
-                if (!duk_is_null(ctx, -1))
+                memcpy(string, dukstr, dukstrlen);
+                print_buffer_item_t *item = (print_buffer_item_t*)calloc(sizeof(print_buffer_item_t), 1);
+                if (item != NULL)
                 {
-                    if (duk_is_string(ctx, -1))
+                    item->string = string;
+                    item->length = dukstrlen;
+
+                    if (last_print_item != NULL)
                     {
-                        value = strdup(duk_safe_to_string(ctx, -1));
-                        if (value != NULL)
-                        {
-                            if (header_set(name, value) == 0)
-                            {
-                                ret = 0;
-                            }
-                            else
-                            {
-                                free(value);
-                                free(name);
-                            }
-                        }
-                        else
-                        {
-                            int _errno = errno;
-                            free(name);
-                            /* Does not return */
-                            JSE_THROW_POSIX_ERROR(ctx, _errno, "strdup() failed: %s", strerror(_errno));
-                        }
+                        last_print_item->next = item;
                     }
-                    else
+
+                    last_print_item = item;
+
+                    if (first_print_item == NULL)
                     {
-                        free(name);
-                        /* Does not return */
-                        JSE_THROW_TYPE_ERROR(ctx, "Invalid argument: value (%d)", duk_get_type(ctx, -1));
+                        first_print_item = item;
                     }
+
+                    /* Nothing returned on the value stack */
+                    ret = 0;
+                }
+                else
+                {
+                    int _errno = errno;
+                    free(string);
+                    /* Does not return */
+                    JSE_THROW_POSIX_ERROR(ctx, _errno, "calloc() failed: %s", strerror(_errno));
                 }
             }
-            else
+            else 
             {
-                free(name);
+                int _errno = errno;
                 /* Does not return */
-                JSE_THROW_TYPE_ERROR(ctx, "Illegal header name: \"%s\"", name);
+                JSE_THROW_POSIX_ERROR(ctx, _errno, "strdup() failed: %s", strerror(_errno));
             }
         }
         else
         {
-            int _errno = errno;
-            /* Does not return */
-            JSE_THROW_POSIX_ERROR(ctx, _errno, "strdup() failed: %s", strerror(_errno));
+            /* Do not use strdup because we may have null characters */
+            fwrite(dukstr, dukstrlen, 1, stdout);
+
+            /* Return undefined */
+            ret = 0;
         }
     }
     else
     {
-        /* Does not return */
-        JSE_THROW_TYPE_ERROR(ctx, "Invalid argument \"name\" (%d)", duk_get_type(ctx, -2));
+        /* Does nothing but is not an error */
+        ret = 0;
     }
 
-    JSE_EXIT("do_setHeader()=%d", ret)
+    JSE_EXIT("do_print()=%d", ret)
     return ret;
 }
 
 /**
- * @brief Binds external functions to the JavaScript engine.
+ * @brief Sets the HTTP status.
  *
- * @param jse_ctx the jse context.
- * @return an error code or 0.
+ * This function sets the HTTP status. It expects one integer on the duktape
+ * stack that specifies the status value.
+ *
+ * @param ctx the duktape context.
+ *
+ * @return 0 or a negative error status.
  */
-static duk_int_t bind_functions(jse_context_t *jse_ctx)
+static duk_ret_t do_setHTTPStatus(duk_context * ctx)
 {
-    duk_int_t ret = 0;
-
-    JSE_ASSERT(jse_ctx != NULL)
-    JSE_ENTER("bind_functions(%p)", jse_ctx)
-
-    /* Bind built ins */
-    duk_push_c_function(jse_ctx->ctx, do_print, 1);
-    duk_put_global_string(jse_ctx->ctx, "print");
-
-    duk_push_c_function(jse_ctx->ctx, do_setHTTPStatus, 1);
-    duk_put_global_string(jse_ctx->ctx, "setHTTPStatus");
+    duk_ret_t ret = DUK_RET_ERROR;
 
-    duk_push_c_function(jse_ctx->ctx, do_setContentType, 1);
-    duk_put_global_string(jse_ctx->ctx, "setContentType");
+    JSE_ENTER("do_setHTTPStatus(%p)", ctx)
 
-    duk_push_c_function(jse_ctx->ctx, do_setCookie, 6);
-    duk_put_global_string(jse_ctx->ctx, "setCookie");
+    if (duk_is_number(ctx, -1))
+    {
+        http_status = (int)duk_get_int_default(ctx, -1, HTTP_STATUS_OK);
 
-    duk_push_c_function(jse_ctx->ctx, do_setHeader, 2);
-    duk_put_global_string(jse_ctx->ctx, "setHeader");
+        JSE_DEBUG("status = %d", http_status)
 
-    if ((ret = jse_bind_jscommon(jse_ctx)) != 0)
-    {
-        JSE_ERROR("Failed to bind jscommon functions!")
-    }
-    else if ((ret = jse_bind_jsprocess(jse_ctx)) != 0)
-    {
-        JSE_ERROR("Failed to bind jsprocess functions!")
-    }
-#ifdef ENABLE_LIBXML2
-    else if ((ret = jse_bind_xml(jse_ctx)) != 0)
-    {
-        JSE_ERROR("Failed to bind xml functions!")
-    }
-#endif
-#ifdef BUILD_RDK
-    else if ((ret = jse_bind_cosa(jse_ctx)) != 0)
-    {
-        JSE_ERROR("Failed to bind cosa functions!")
+        /* Return undefined */
+        ret = 0;
     }
-#endif
-#ifdef ENABLE_LIBCRYPTO
-    else if ((ret = jse_bind_crypt(jse_ctx)) != 0)
+    else
     {
-        JSE_ERROR("Failed to bind xml functions!")
+        /* Does not return */
+        JSE_THROW_TYPE_ERROR(ctx, "Invalid argument!");
     }
-#endif
 
-    JSE_EXIT("bind_functions()=%d", ret)
+    JSE_EXIT("do_setHTTPStatus()=%d", ret)
     return ret;
 }
 
 /**
- * @brief Unbinds functions from the javascript engine.
- *
- * @param jse_ctx the jse context.
- */
-static void unbind_functions(jse_context_t *jse_ctx)
-{
-#ifdef ENABLE_LIBCRYPTO
-    jse_unbind_crypt(jse_ctx);
-#endif
-#ifdef BUILD_RDK
-    jse_unbind_cosa(jse_ctx);
-#endif
-#ifdef ENABLE_LIBXML2
-    jse_unbind_xml(jse_ctx);
-#endif
-    jse_unbind_jsprocess(jse_ctx);
-    jse_unbind_jscommon(jse_ctx);
-}
-
-/**
- * @brief Utility method that adds an environment variable as an object property
+ * @brief Sets the mimetype.
  *
- * Given the object at idx, this function adds the environment variable
- * env, given it is defined, as a property called env with the value of
- * the environment variable env.
+ * This function sets the content type. It expects one string on the duktape
+ * stack that specifies the content type.
  *
  * @param ctx the duktape context.
- * @param idx the request object index.
- * @param env the environment variable name.
  *
- * @return 0.
+ * @return 0 or a negative error status.
  */
-static duk_int_t add_env_as_object_property(duk_context *ctx, duk_idx_t idx, const char* env)
+static duk_ret_t do_setContentType(duk_context * ctx)
 {
-    const char * value = NULL;
+    duk_ret_t ret = DUK_RET_ERROR;
 
-    JSE_ASSERT(ctx != NULL)
-    JSE_ASSERT(env != NULL)
+    JSE_ENTER("do_setContentType(%p)", ctx)
 
-    value = getenv(env);
-    if (value != NULL)
+    if (duk_is_string(ctx, -1))
     {
-        duk_push_string(ctx, value);
-        duk_put_prop_string(ctx, idx, env);
+        char * string = strdup(duk_safe_to_string(ctx, -1));
+        if (string != NULL)
+        {
+            if (http_contenttype != NULL)
+            {
+                free(http_contenttype);
+            }
+
+            http_contenttype = string;
+
+            JSE_DEBUG("mimetype = %s", http_contenttype)
+
+            /* Return undefined */
+            ret = 0;
+        }
+        else 
+        {
+            int _errno = errno;
+            /* Does not return */
+            JSE_THROW_POSIX_ERROR(ctx, _errno, "strdup() failed: %s", strerror(_errno));
+        }
+    }
+    else
+    {
+        /* Does not return */
+        JSE_THROW_TYPE_ERROR(ctx, "Invalid argument \"mimetype\"!");
     }
 
-    return 0;
+    JSE_EXIT("do_setContentType()=%d", ret)
+    return ret;
 }
 
 /**
- * @brief Utility method that adds the query parameters to the request object
+ * @brief Sets the cookie value.
  *
- * Given the object at idex, this function adds a sub-object "QueryParameters"
- * and adds properties to that object with the name and value of each of the
- * query parameters parsed by QDecoder.
+ * This function sets the cookie value. It expects five arguments, the
+ * cookie name, the cookie value, an expiry time in seconds (0 expire
+ * now), an optional path (may be null), an optional domain (may be
+ * null), and a boolean indicating a secure cookie or not.
  *
  * @param ctx the duktape context.
- * @param req the QDecoder request list.
- * @param idx the request object index.
+ *
+ * @return 0 or a negative error status.
  */
-static void create_request_object_params(duk_context *ctx, qentry_t *req, duk_int_t idx)
+static duk_ret_t do_setCookie(duk_context * ctx)
 {
-    struct file_object_s *file_objs = NULL;
-    struct file_object_s *file_obj =  NULL;
-    qentobj_t obj;
-    duk_idx_t idx2;
-    char *propName;
-
-    JSE_ENTER("create_request_object_params(%p, %p, %d)", ctx, req, idx)
+    char * name = NULL;
+    char * value = NULL;
+    int expire_secs = 0;
+    char * path = NULL;
+    char * domain = NULL;
+    bool secure = false;
 
-    memset(&obj, 0, sizeof(obj));
+    JSE_ENTER("do_setCookie(%p)", ctx)
 
-    idx2 = duk_push_object(ctx);
+    if (duk_is_string(ctx, -6))
+    {
+        name = strdup(duk_safe_to_string(ctx, -6));
+        if (name == NULL)
+        {
+            int _errno = errno;
+            /* Does not return */
+            JSE_THROW_POSIX_ERROR(ctx, _errno, "strdup() failed: %s", strerror(_errno));
+        }
+    }
+    else
+    {
+        /* Does not return */
+        JSE_THROW_TYPE_ERROR(ctx, "Invalid argument \"name\" (%d)", duk_get_type(ctx, -6));
+    }
 
-    JSE_VERBOSE("idx2=%d", idx2);
+    if (duk_is_string(ctx, -5))
+    {
+        value = strdup(duk_safe_to_string(ctx, -5));
+        if (value == NULL)
+        {
+            int _errno = errno;
+            free(name);
+            /* Does not return */
+            JSE_THROW_POSIX_ERROR(ctx, _errno, "strdup() failed: %s", strerror(_errno));
+        }
+    }
+    else
+    {
+        free(name);
+        /* Does not return */
+        JSE_THROW_TYPE_ERROR(ctx, "Invalid argument \"value\" (%d)", duk_get_type(ctx, -5));
+    }
 
-    while (req->getnext(req, &obj, NULL, false))
+    if (duk_is_number(ctx, -4))
     {
-        JSE_DEBUG("Parameter: name=\"%s\", value=\"%s\"", obj.name, (char*)obj.data)
+        expire_secs = (int)duk_get_int_default(ctx, -4, 0);
+    }
+    else
+    {
+        free(value);
+        free(name);
+        /* Does not return */
+        JSE_THROW_TYPE_ERROR(ctx, "Invalid argument \"expire_secs\" (%d)", duk_get_type(ctx, -4));
+    }
 
-        // File uploads result in several parameters with the upload name
-        // followed by . followed by property, e.g. filename, mimetype etc.
-        propName = strchr(obj.name, '.');
-        if (propName != NULL)
+    if (!duk_is_null(ctx, -3))
+    {
+        if (duk_is_string(ctx, -3))
         {
-            file_obj = file_objs;
-
-            *propName++ = '\0';
-            while (file_obj)
+            path = strdup(duk_safe_to_string(ctx, -3));
+            if (path == NULL)
             {
-                if (!strcmp(obj.name, file_obj->name))
-                {
-                    break;
-                }
-
-                file_obj = file_obj->next;
+                int _errno = errno;
+                free(value);
+                free(name);
+                /* Does not return */
+                JSE_THROW_POSIX_ERROR(ctx, _errno, "strdup() failed: %s", strerror(_errno));
             }
+        }
+        else
+        {
+            free(value);
+            free(name);
+            /* Does not return */
+            JSE_THROW_TYPE_ERROR(ctx, "Invalid argument \"path\" (%d)", duk_get_type(ctx, -3));
+        }
+    }
 
-            JSE_VERBOSE("file_obj=%p", file_obj)
-
-            if (file_obj == NULL)
-            {
-                // Create a new file object
-                file_obj = (struct file_object_s*)calloc(sizeof(struct file_object_s), 1);
-                if (file_obj != NULL)
-                {
-                    JSE_DEBUG("Creating object: %s", obj.name)
-
-                    file_obj->name = strdup(obj.name);
-                    if (file_obj->name != NULL)
-                    {
-                        // Create the object and add it
-                        file_obj->idx = duk_push_object(ctx);
-
-                        // You can't put an object as a property of a parent
-                        // object until all its own properties are set. So no
-                        // duk_put_prop_string(ctx, idx, "QueryParameters");
-                        // here.
-
-                        // Link in the new object
-                        file_obj->next = file_objs;
-                        file_objs = file_obj;
-                    }
-                    else
-                    {
-                        JSE_ERROR("strdup() failed: %s", strerror(errno))
-                        free(file_obj);
-
-                        // Skip on to next param
-                        continue;
-                    }
-                }
-                else
-                {
-                    JSE_ERROR("calloc() failed: %s", strerror(errno))
-
-                    // Skip on to next param
-                    continue;
-                }
-            }
-
-            JSE_VERBOSE("file_obj=%p", file_obj)
-
-            if (file_obj != NULL)
+    if (!duk_is_null(ctx, -2))
+    {
+        if (duk_is_string(ctx, -2))
+        {
+            domain = strdup(duk_safe_to_string(ctx, -2));
+            if (domain == NULL)
             {
-                JSE_VERBOSE("Adding file property: %s (idx=%d)", propName, file_obj->idx)
-
-                // Add the property to the file object
-                duk_push_string(ctx, (char*)obj.data);
-                duk_put_prop_string(ctx, file_obj->idx, propName);
+                int _errno = errno;
+                free(value);
+                free(name);
+                free(path); /* path may be NULL but free(NULL) is a NOP per C99 */
+                /* Does not return */
+                JSE_THROW_POSIX_ERROR(ctx, _errno, "strdup() failed: %s", strerror(_errno));
             }
         }
         else
         {
-            // Simple case for a string
-            duk_push_string(ctx, (char*)obj.data);
-            duk_put_prop_string(ctx, idx2, obj.name);
+            free(value);
+            free(name);
+            free(path); /* path may be NULL but free(NULL) is a NOP per C99 */
+            /* Does not return */
+            JSE_THROW_TYPE_ERROR(ctx, "Invalid argument \"domain\" (%d)", duk_get_type(ctx, -2));
         }
     }
 
-    // Clean up temp data and set properties. This should be in reverse
-    // order to them being added. I.e. the first file object pushed on to
-    // the stack will be the last one read.
-    while (file_objs)
+    if (duk_is_boolean(ctx, -1))
     {
-        file_obj  = file_objs;
-        file_objs = file_objs->next;
-
-        JSE_VERBOSE("Adding file as property of QueryParameters: %s (idx=%d)", file_obj->name, idx2)
-
-        duk_put_prop_string(ctx, idx2, file_obj->name);
-        free(file_obj->name);
-        free(file_obj);
+        /* Prevent error with -Wbad-function-cast */
+        duk_bool_t duksec = duk_get_boolean_default(ctx, -1, false);
+        secure = (bool)duksec;
+    }
+    else
+    {
+        free(value);
+        free(name);
+        free(path);   /* path may be NULL but free(NULL) is a NOP per C99 */
+        free(domain); /* domain may be NULL but free(NULL) is a NOP per C99 */
+        /* Does not return */
+        JSE_THROW_TYPE_ERROR(ctx, "Invalid argument \"secure\" (%d)", duk_get_type(ctx, -1));
     }
 
-    duk_put_prop_string(ctx, idx, "QueryParameters");
+    cookie_destroy(&http_cookie);
+    cookie_set(&http_cookie, name, value, expire_secs, path, domain, secure);
 
-    JSE_EXIT("create_request_object_params()")
+    JSE_DEBUG("cookie=\"%s\"=\"%s\",expires=%d,path=\"%s\",domain=\"%s\",secure=%s",
+        http_cookie.name, http_cookie.value, http_cookie.expire_secs,
+        http_cookie.path != NULL ? http_cookie.path : "(null)",
+        http_cookie.domain !=NULL ? http_cookie.domain : "(null)",
+        http_cookie.secure ? "true" : "false")
+
+    JSE_EXIT("do_setCookie()=0")
+    return 0;
 }
 
 /**
- * @brief Adds the CGI variables as properties to the request object.
- *
- * This function adds properties to the "Request" object with the name
- * and value of each of the CGI environment variables.
+ * @brief Sets or adds an HTTP header
+ * 
+ * This function sets or adds a header. The function expects two strings
+ * the first being the header name. The second being the value. If the
+ * name already exists it is replaced by the new value. The test for the
+ * name is case insensitive.
  *
  * @param ctx the duktape context.
- * @param idx the request object index.
+ *
+ * @return 0 or a negative error status.
  */
-static void create_request_object_envs(duk_context *ctx, duk_int_t idx)
+static duk_ret_t do_setHeader(duk_context * ctx)
 {
-    int i;
-
-    add_env_as_object_property(ctx, idx, "CONTENT_LENGTH");
-    add_env_as_object_property(ctx, idx, "CONTENT_TYPE");
-    add_env_as_object_property(ctx, idx, "DOCUMENT_ROOT");
-    add_env_as_object_property(ctx, idx, "HTTPS");
-    add_env_as_object_property(ctx, idx, "PATH");
-    add_env_as_object_property(ctx, idx, "QUERY_STRING");
-    add_env_as_object_property(ctx, idx, "REMOTE_ADDR");
-    add_env_as_object_property(ctx, idx, "REMOTE_HOST");
-    add_env_as_object_property(ctx, idx, "REMOTE_PORT");
-    add_env_as_object_property(ctx, idx, "REMOTE_USER");
-    add_env_as_object_property(ctx, idx, "REQUEST_METHOD");
-    add_env_as_object_property(ctx, idx, "REQUEST_URI");
-    add_env_as_object_property(ctx, idx, "SCRIPT_FILENAME");
-    add_env_as_object_property(ctx, idx, "SCRIPT_NAME");
-    add_env_as_object_property(ctx, idx, "SERVER_NAME");
-    add_env_as_object_property(ctx, idx, "SERVER_PORT");
+    duk_ret_t ret = DUK_RET_ERROR;
+    char * name = NULL;
+    char * value = NULL;
 
-    /* environ is a NULL terminated list of pointers */
+    JSE_ENTER("do_setHeader(%p)", ctx)
 
-    /* Now add all the HTTP_ environment variables. All request
-       headers are converted in to HTTP_ environment variables
-       by the server by capitalisation of the header name and
-       prepending HTTP_ to it. */
-    for (i = 0; environ[i] != NULL; i++)
+    if (duk_is_string(ctx, -2))
     {
-        /* If the variable starts with HTTP_ process it */
-        if (0 == strncmp(environ[i], "HTTP_", CONST_STRLEN("HTTP_")))
+        name = strdup(duk_safe_to_string(ctx, -2));
+        if (name != NULL)
         {
-            /* Get a modifiable version of the name=value pair. */
-            char * var = strdup(environ[i]);
-            if (var == NULL)
+            if (header_validate(name))
             {
-                JSE_ERROR("strdup() failed: %s", strerror(errno))
+                if (!duk_is_null(ctx, -1))
+                {
+                    if (duk_is_string(ctx, -1))
+                    {
+                        value = strdup(duk_safe_to_string(ctx, -1));
+                        if (value != NULL)
+                        {
+                            if (header_set(name, value) == 0)
+                            {
+                                ret = 0;
+                            }
+                            else
+                            {
+                                free(value);
+                                free(name);
+                            }
+                        }
+                        else
+                        {
+                            int _errno = errno;
+                            free(name);
+                            /* Does not return */
+                            JSE_THROW_POSIX_ERROR(ctx, _errno, "strdup() failed: %s", strerror(_errno));
+                        }
+                    }
+                    else
+                    {
+                        free(name);
+                        /* Does not return */
+                        JSE_THROW_TYPE_ERROR(ctx, "Invalid argument: value (%d)", duk_get_type(ctx, -1));
+                    }
+                }
             }
             else
             {
-                char * pequals = strchr(var, '=');
-                if (pequals != NULL)
-                {
-                    *pequals = 0;
-                    add_env_as_object_property(ctx, idx, var);
-                }
-
-                free(var);
+                free(name);
+                /* Does not return */
+                JSE_THROW_TYPE_ERROR(ctx, "Illegal header name: \"%s\"", name);
             }
         }
+        else
+        {
+            int _errno = errno;
+            /* Does not return */
+            JSE_THROW_POSIX_ERROR(ctx, _errno, "strdup() failed: %s", strerror(_errno));
+        }
+    }
+    else
+    {
+        /* Does not return */
+        JSE_THROW_TYPE_ERROR(ctx, "Invalid argument \"name\" (%d)", duk_get_type(ctx, -2));
     }
+
+    JSE_EXIT("do_setHeader()=%d", ret)
+    return ret;
 }
 
 /**
- * @brief Indicates if the request has a body to parse
+ * @brief Queues a function to be run after the response is sent.
  *
- * This function returns true if the request has a body to parse. I.e. the
- * request is either a PUT, POST or PATCH.
+ * This function expects one function argument. The function is stored
+ * and called, without arguments, once the HTTP response has been sent and
+ * the request completed. This allows work that the client does not need to
+ * wait on, e.g. logging or cache refreshes, to be deferred. When not
+ * handling an HTTP request the function is called once the script ends.
  *
- * @return true if there is a request body to parse
+ * @param ctx the duktape context.
+ *
+ * @return 0 or a negative error status.
  */
-static bool request_has_body(void)
+static duk_ret_t do_runAfterResponse(duk_context * ctx)
 {
-    bool hasBody = false;
+    JSE_ENTER("do_runAfterResponse(%p)", ctx)
 
-    JSE_ENTER("request_has_body()")
+    if (!duk_is_callable(ctx, -1))
+    {
+        /* Does not return */
+        JSE_THROW_TYPE_ERROR(ctx, "Invalid argument \"function\" (%d)", duk_get_type(ctx, -1));
+    }
 
-    char * requestMethod = getenv("REQUEST_METHOD");
-    if (requestMethod != NULL)
+    duk_push_heap_stash(ctx);
+    /* [ .... function, stash ] */
+
+    if (!duk_get_prop_string(ctx, -1, JSE_AFTER_RESPONSE_STASH_KEY))
     {
-        if (0 == strcmp(requestMethod, "PUT")  ||
-            0 == strcmp(requestMethod, "POST") ||
-            0 == strcmp(requestMethod, "PATCH"))
-        {
-            hasBody = true;
-        }
+        /* [ .... function, stash, undefined ] */
+        duk_pop(ctx);
+
+        duk_push_array(ctx);
+        duk_dup_top(ctx);
+        duk_put_prop_string(ctx, -3, JSE_AFTER_RESPONSE_STASH_KEY);
     }
+    /* [ .... function, stash, array ] */
 
-    JSE_EXIT("request_has_body()=%s", hasBody ? "true" : "false");
-    return hasBody;
+    duk_dup(ctx, -3);
+    duk_put_prop_index(ctx, -2, (duk_uarridx_t)duk_get_length(ctx, -2));
+    /* [ .... function, stash, array ] */
+
+    duk_pop_2(ctx);
+
+    JSE_EXIT("do_runAfterResponse()=0")
+    return 0;
 }
 
 /**
- * @brief Indicates if the content is parsable by qdecoder
+ * @brief Sets the time to cache the response for.
  *
- * QDecoder can parse the following mime types:
+ * This function expects a number, the time in seconds, an optional list
+ * of request headers the response varies on, either an array of names or a
+ * single name, and an optional number, the time in seconds the response
+ * may be used after it expires while a fresh response is generated. This
+ * defaults to the time to cache the response for. Only successful GET
+ * responses that do not set cookies are cached. Only applies when running
+ * as a Fast CGI server.
  *
- *  - "application/x-www-form-urlencoded"
- *  - "multipart/form-data"
+ * @param ctx the duktape context.
  *
- * @return true if parsable by qdecoder.
+ * @return 0 or a negative error status.
  */
-static bool request_parsable_by_qdecoder(void)
+static duk_ret_t do_setCacheTTL(duk_context * ctx)
 {
-    bool parsable = false;
+    char * vary = NULL;
+    long ttl = 0;
+    long stale = 0;
 
-    JSE_ENTER("request_parsable_by_qdecoder()")
+    JSE_ENTER("do_setCacheTTL(%p)", ctx)
 
-    /* If qdecoder can parse the content let it. */
-    const char * contentType = getenv("CONTENT_TYPE");
-    if (contentType != NULL)
+    if (!duk_is_number(ctx, 0) || duk_get_number(ctx, 0) < 0)
     {
-        if (0 == strncmp(contentType,
-                "application/x-www-form-urlencoded",
-                CONST_STRLEN("application/x-www-form-urlencoded")) ||
-            0 == strncmp(contentType,
-                "multipart/form-data",
-                CONST_STRLEN("multipart/form-data")))
-        {
-            parsable = true;
-        }
+        /* Does not return */
+        JSE_THROW_TYPE_ERROR(ctx, "Invalid argument \"seconds\" (%d)", duk_get_type(ctx, 0));
     }
 
-    JSE_EXIT("request_parsable_by_qdecoder()=%s", parsable ? "true" : "false");
-    return parsable;
-}
+    ttl = (long)duk_get_number(ctx, 0);
+    stale = ttl;
 
-/**
- * @brief Returns the request body content length
- *
- * This function returns the request body content length or -1 if it is not
- * defined or is defined but not set in the header.
- *
- * @return the request body content length or -1 if not set
- */
-static int get_request_content_length(void)
-{
-    const char * contentLength = getenv("CONTENT_LENGTH");
-    int length = -1;
+    if (duk_is_string(ctx, 1))
+    {
+        vary = strdup(duk_get_string(ctx, 1));
+    }
+    else if (duk_is_array(ctx, 1))
+    {
+        /* Join the names with commas */
+        duk_get_prop_string(ctx, 1, "join");
+        duk_dup(ctx, 1);
+        duk_push_string(ctx, ",");
+        duk_call_method(ctx, 1);
+        vary = strdup(duk_safe_to_string(ctx, -1));
+        duk_pop(ctx);
+    }
+    else if (!duk_is_null_or_undefined(ctx, 1))
+    {
+        /* Does not return */
+        JSE_THROW_TYPE_ERROR(ctx, "Invalid argument \"varyOn\" (%d)", duk_get_type(ctx, 1));
+    }
 
-    JSE_ENTER("get_request_content_length()")
+    if ((duk_is_string(ctx, 1) || duk_is_array(ctx, 1)) && vary == NULL)
+    {
+        int _errno = errno;
+        /* Does not return */
+        JSE_THROW_POSIX_ERROR(ctx, _errno, "strdup() failed: %s", strerror(_errno));
+    }
 
-    if (contentLength != NULL)
+    if (duk_is_number(ctx, 2) && duk_get_number(ctx, 2) >= 0)
     {
-        length = atoi(contentLength);
+        stale = (long)duk_get_number(ctx, 2);
+    }
+    else if (!duk_is_null_or_undefined(ctx, 2))
+    {
+        free(vary);
+        /* Does not return */
+        JSE_THROW_TYPE_ERROR(ctx, "Invalid argument \"staleSeconds\" (%d)", duk_get_type(ctx, 2));
     }
 
-    JSE_EXIT("get_request_content_length()=%d", length);
-    return length;
+    cache_ttl_secs = ttl;
+    cache_stale_secs = stale;
+    free(cache_vary);
+    cache_vary = vary;
+
+    JSE_DEBUG("Cache TTL: %lds, stale: %lds, vary: %s", ttl, stale, vary != NULL ? vary : "")
+
+    JSE_EXIT("do_setCacheTTL()=0")
+    return 0;
 }
 
 /**
- * @brief Creates a property comprising the HTTP request body.
- *
- * This function creates a property that comprises the body of the request.
- * The property is only created if qdecoder does not handle it. QDecoder can
- * parse the following mime types:
- *
- *  - "application/x-www-form-urlencoded"
- *  - "multipart/form-data"
- *
- * If qdecoder cannot handle the mimetype the request body is read in to a
- * property called "body" so that it can be processed by a script.
+ * @brief Binds external functions to the JavaScript engine.
  *
- * @param ctx the duktape context.
- * @param idx the index of the Request object.
+ * @param jse_ctx the jse context.
+ * @return an error code or 0.
  */
-static void create_request_object_body(duk_context *ctx, duk_int_t idx)
+static duk_int_t bind_functions(jse_context_t *jse_ctx)
 {
-    JSE_ENTER("create_request_object_body()")
+    duk_int_t ret = 0;
 
-    /* Is it a POST, PUT or PATCH? */
-    if (request_has_body())
-    {
-        /* If qdecoder doesn't handle it, read the body and return it. */
-        if (!request_parsable_by_qdecoder())
-        {
-            /* Negative content length means not set */
-            int length = get_request_content_length();
-            if (length > 0)
-            {
-                /* Easy case. We know the size. */
-                size_t size = (size_t)length;
+    JSE_ASSERT(jse_ctx != NULL)
+    JSE_ENTER("bind_functions(%p)", jse_ctx)
 
-                char * buffer = (char*)calloc(size, sizeof(char));
-                if (buffer != NULL)
-                {
-                    /* Use buffered streams because FCGI redirects these and
-                       we want to read from FCGI's stdin when enabled. */
-                    size_t bytes = fread(buffer, 1, size, stdin);
+    /* Bind built ins */
+    duk_push_c_function(jse_ctx->ctx, do_print, 1);
+    duk_put_global_string(jse_ctx->ctx, "print");
 
-                    /* bytes short when error or EOF */
-                    if (bytes < size && ferror(stdin))
-                    {
-                        JSE_ERROR("read() failed: %s", strerror(errno))
-                    }
-                    else
-                    {
-                        /* EOF is fine */
-                        duk_push_lstring(ctx, buffer, bytes);
-                        duk_put_prop_string(ctx, idx, "Body");
-                    }
+    duk_push_c_function(jse_ctx->ctx, do_setHTTPStatus, 1);
+    duk_put_global_string(jse_ctx->ctx, "setHTTPStatus");
 
-                    free(buffer);
-                }
-            }
-            /* else no body to return */
-        }
+    duk_push_c_function(jse_ctx->ctx, do_setContentType, 1);
+    duk_put_global_string(jse_ctx->ctx, "setContentType");
+
+    duk_push_c_function(jse_ctx->ctx, do_setCookie, 6);
+    duk_put_global_string(jse_ctx->ctx, "setCookie");
+
+    duk_push_c_function(jse_ctx->ctx, do_setHeader, 2);
+    duk_put_global_string(jse_ctx->ctx, "setHeader");
+
+    duk_push_c_function(jse_ctx->ctx, do_runAfterResponse, 1);
+    duk_put_global_string(jse_ctx->ctx, "runAfterResponse");
+
+    duk_push_c_function(jse_ctx->ctx, do_setCacheTTL, 3);
+    duk_put_global_string(jse_ctx->ctx, "setCacheTTL");
+
+    if ((ret = jse_bind_jscommon(jse_ctx)) != 0)
+    {
+        JSE_ERROR("Failed to bind jscommon functions!")
+    }
+    else if ((ret = jse_bind_jsprocess(jse_ctx)) != 0)
+    {
+        JSE_ERROR("Failed to bind jsprocess functions!")
     }
+    else if ((ret = jse_bind_stats(jse_ctx)) != 0)
+    {
+        JSE_ERROR("Failed to bind stats functions!")
+    }
+#ifdef ENABLE_LIBXML2
+    else if ((ret = jse_bind_xml(jse_ctx)) != 0)
+    {
+        JSE_ERROR("Failed to bind xml functions!")
+    }
+#endif
+#ifdef ENABLE_COSA
+    else if ((ret = jse_bind_cosa(jse_ctx)) != 0)
+    {
+        JSE_ERROR("Failed to bind cosa functions!")
+    }
+#endif
+#ifdef ENABLE_LIBCRYPTO
+    else if ((ret = jse_bind_crypt(jse_ctx)) != 0)
+    {
+        JSE_ERROR("Failed to bind xml functions!")
+    }
+#endif
 
-    JSE_EXIT("create_request_object_body()")
+    JSE_EXIT("bind_functions()=%d", ret)
+    return ret;
 }
 
 /**
- * @brief Creates a request object.
- *
- * Creates a global JavaScipt object called "Request" which comprises the
- * HTTP request data including the environment variables, query parameters
- * etc.
+ * @brief Unbinds functions from the javascript engine.
  *
  * @param jse_ctx the jse context.
- *
- * @return 0.
  */
-static duk_int_t create_request_object(jse_context_t *jse_ctx)
+static void unbind_functions(jse_context_t *jse_ctx)
 {
-    duk_context *ctx = jse_ctx->ctx;
-    qentry_t *req = jse_ctx->req;
-    duk_int_t idx = duk_push_object(ctx);
-
-    create_request_object_params(ctx, req, idx);
-    create_request_object_envs(ctx, idx);
-    create_request_object_body(ctx, idx);
-
-    duk_put_global_string(ctx, JSE_REQUEST_OBJECT_NAME);
-
-    return 0;
+#ifdef ENABLE_LIBCRYPTO
+    jse_unbind_crypt(jse_ctx);
+#endif
+#ifdef ENABLE_COSA
+    jse_unbind_cosa(jse_ctx);
+#endif
+#ifdef ENABLE_LIBXML2
+    jse_unbind_xml(jse_ctx);
+#endif
+    jse_unbind_stats(jse_ctx);
+    jse_unbind_jsprocess(jse_ctx);
+    jse_unbind_jscommon(jse_ctx);
 }
 
- /**
- * @brief Returns a simple HTTP server error response.
+/**
+ * @brief Utility method that adds an environment variable as an object property
  *
- * @param status the HTTP status.
- * @param msg the message.
+ * Given the object at idx, this function adds the environment variable
+ * env, given it is defined, as a property called env with the value of
+ * the environment variable env.
+ *
+ * @param ctx the duktape context.
+ * @param idx the request object index.
+ * @param env the environment variable name.
+ *
+ * @return 0.
  */
-static void basic_return_error(int status)
+static duk_int_t add_env_as_object_property(duk_context *ctx, duk_idx_t idx, const char* env)
 {
-    const char * msg = msg_for_http_status(status);
+    const char * value = NULL;
 
-    printf("Status: %d %s\r\nContent-Type: text/plain\r\n\r\n%s\r\n", status, msg, msg);
+    JSE_ASSERT(ctx != NULL)
+    JSE_ASSERT(env != NULL)
+
+    value = getenv(env);
+    if (value != NULL)
+    {
+        duk_push_string(ctx, value);
+        duk_put_prop_string(ctx, idx, env);
+    }
+
+    return 0;
 }
 
 /**
- * @brief Handle an HTTP request
- *
- * A note on error return codes.
- *
- * Returning an error from this function means the an error occurred and it
- * was not reported to the caller. This means that if in CGI mode and
- * qdecoder was initialised correctly an error will be reported as an HTTP
- * error status and the function will return success. Similarly if in
- * command line mode and the error is a script error and reported on stderr,
- * the function will return success.
+ * @brief Utility method that adds the query parameters to the request object
  *
- * So if this function returns an error status it should be handled.
+ * Given the object at idex, this function adds a sub-object "QueryParameters"
+ * and adds properties to that object with the name and value of each of the
+ * query parameters parsed by QDecoder.
  *
- * @param jse_ctx the jse context.
- * @return an error code or 0.
+ * @param ctx the duktape context.
+ * @param req the QDecoder request list.
+ * @param idx the request object index.
  */
-static duk_int_t handle_request(jse_context_t *jse_ctx)
+static void create_request_object_params(duk_context *ctx, qentry_t *req, duk_int_t idx)
 {
-    duk_int_t ret = DUK_ERR_ERROR;
+    struct file_object_s *file_objs = NULL;
+    struct file_object_s *file_obj =  NULL;
+    qentobj_t obj;
+    duk_idx_t idx2;
+    char *propName;
 
-    JSE_ENTER("handle_request(%p)", jse_ctx)
+    JSE_ENTER("create_request_object_params(%p, %p, %d)", ctx, req, idx)
 
-    ret = bind_functions(jse_ctx); 
-    if (ret == 0)
-    {
-        /* Set the file upload options (POST only) */
-        if (process_post)
-        {
-            jse_ctx->req = qcgireq_setoption(jse_ctx->req, true, upload_dir, JSE_UPLOAD_EXPIRY_SECS);
-        }
+    memset(&obj, 0, sizeof(obj));
 
-        /* Parse the request */
-        if (process_post)
-        {
-            jse_ctx->req = qcgireq_parse(jse_ctx->req, Q_CGI_POST);
-        }
+    idx2 = duk_push_object(ctx);
+
+    JSE_VERBOSE("idx2=%d", idx2);
+
+    while (req->getnext(req, &obj, NULL, false))
+    {
+        JSE_DEBUG("Parameter: name=\"%s\", value=\"%s\"", obj.name, (char*)obj.data)
+
+        // File uploads result in several parameters with the upload name
+        // followed by . followed by property, e.g. filename, mimetype etc.
+        propName = strchr(obj.name, '.');
+        if (propName != NULL)
+        {
+            file_obj = file_objs;
+
+            *propName++ = '\0';
+            while (file_obj)
+            {
+                if (!strcmp(obj.name, file_obj->name))
+                {
+                    break;
+                }
+
+                file_obj = file_obj->next;
+            }
+
+            JSE_VERBOSE("file_obj=%p", file_obj)
+
+            if (file_obj == NULL)
+            {
+                // Create a new file object
+                file_obj = (struct file_object_s*)calloc(sizeof(struct file_object_s), 1);
+                if (file_obj != NULL)
+                {
+                    JSE_DEBUG("Creating object: %s", obj.name)
+
+                    file_obj->name = strdup(obj.name);
+                    if (file_obj->name != NULL)
+                    {
+                        // Create the object and add it
+                        file_obj->idx = duk_push_object(ctx);
+
+                        // You can't put an object as a property of a parent
+                        // object until all its own properties are set. So no
+                        // duk_put_prop_string(ctx, idx, "QueryParameters");
+                        // here.
+
+                        // Link in the new object
+                        file_obj->next = file_objs;
+                        file_objs = file_obj;
+                    }
+                    else
+                    {
+                        JSE_ERROR("strdup() failed: %s", strerror(errno))
+                        free(file_obj);
+
+                        // Skip on to next param
+                        continue;
+                    }
+                }
+                else
+                {
+                    JSE_ERROR("calloc() failed: %s", strerror(errno))
+
+                    // Skip on to next param
+                    continue;
+                }
+            }
+
+            JSE_VERBOSE("file_obj=%p", file_obj)
+
+            if (file_obj != NULL)
+            {
+                JSE_VERBOSE("Adding file property: %s (idx=%d)", propName, file_obj->idx)
+
+                // Add the property to the file object
+                duk_push_string(ctx, (char*)obj.data);
+                duk_put_prop_string(ctx, file_obj->idx, propName);
+            }
+        }
+        else
+        {
+            // Simple case for a string
+            duk_push_string(ctx, (char*)obj.data);
+            duk_put_prop_string(ctx, idx2, obj.name);
+        }
+    }
+
+    // Clean up temp data and set properties. This should be in reverse
+    // order to them being added. I.e. the first file object pushed on to
+    // the stack will be the last one read.
+    while (file_objs)
+    {
+        file_obj  = file_objs;
+        file_objs = file_objs->next;
+
+        JSE_VERBOSE("Adding file as property of QueryParameters: %s (idx=%d)", file_obj->name, idx2)
+
+        duk_put_prop_string(ctx, idx2, file_obj->name);
+        free(file_obj->name);
+        free(file_obj);
+    }
+
+    duk_put_prop_string(ctx, idx, "QueryParameters");
+
+    JSE_EXIT("create_request_object_params()")
+}
+
+/**
+ * @brief Adds the CGI variables as properties to the request object.
+ *
+ * This function adds properties to the "Request" object with the name
+ * and value of each of the CGI environment variables.
+ *
+ * @param ctx the duktape context.
+ * @param idx the request object index.
+ */
+static void create_request_object_envs(duk_context *ctx, duk_int_t idx)
+{
+    int i;
+
+    add_env_as_object_property(ctx, idx, "CONTENT_LENGTH");
+    add_env_as_object_property(ctx, idx, "CONTENT_TYPE");
+    add_env_as_object_property(ctx, idx, "DOCUMENT_ROOT");
+    add_env_as_object_property(ctx, idx, "HTTPS");
+    add_env_as_object_property(ctx, idx, "PATH");
+    add_env_as_object_property(ctx, idx, "QUERY_STRING");
+    add_env_as_object_property(ctx, idx, "REMOTE_ADDR");
+    add_env_as_object_property(ctx, idx, "REMOTE_HOST");
+    add_env_as_object_property(ctx, idx, "REMOTE_PORT");
+    add_env_as_object_property(ctx, idx, "REMOTE_USER");
+    add_env_as_object_property(ctx, idx, "REQUEST_METHOD");
+    add_env_as_object_property(ctx, idx, "REQUEST_URI");
+    add_env_as_object_property(ctx, idx, "SCRIPT_FILENAME");
+    add_env_as_object_property(ctx, idx, "SCRIPT_NAME");
+    add_env_as_object_property(ctx, idx, "SERVER_NAME");
+    add_env_as_object_property(ctx, idx, "SERVER_PORT");
+
+    /* environ is a NULL terminated list of pointers */
+
+    /* Now add all the HTTP_ environment variables. All request
+       headers are converted in to HTTP_ environment variables
+       by the server by capitalisation of the header name and
+       prepending HTTP_ to it. */
+    for (i = 0; environ[i] != NULL; i++)
+    {
+        /* If the variable starts with HTTP_ process it */
+        if (0 == strncmp(environ[i], "HTTP_", CONST_STRLEN("HTTP_")))
+        {
+            /* Get a modifiable version of the name=value pair. */
+            char * var = strdup(environ[i]);
+            if (var == NULL)
+            {
+                JSE_ERROR("strdup() failed: %s", strerror(errno))
+            }
+            else
+            {
+                char * pequals = strchr(var, '=');
+                if (pequals != NULL)
+                {
+                    *pequals = 0;
+                    add_env_as_object_property(ctx, idx, var);
+                }
+
+                free(var);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Indicates if the request has a body to parse
+ *
+ * This function returns true if the request has a body to parse. I.e. the
+ * request is either a PUT, POST or PATCH.
+ *
+ * @return true if there is a request body to parse
+ */
+static bool request_has_body(void)
+{
+    bool hasBody = false;
+
+    JSE_ENTER("request_has_body()")
+
+    char * requestMethod = getenv("REQUEST_METHOD");
+    if (requestMethod != NULL)
+    {
+        if (0 == strcmp(requestMethod, "PUT")  ||
+            0 == strcmp(requestMethod, "POST") ||
+            0 == strcmp(requestMethod, "PATCH"))
+        {
+            hasBody = true;
+        }
+    }
+
+    JSE_EXIT("request_has_body()=%s", hasBody ? "true" : "false");
+    return hasBody;
+}
+
+/**
+ * @brief Indicates if the content is parsable by qdecoder
+ *
+ * QDecoder can parse the following mime types:
+ *
+ *  - "application/x-www-form-urlencoded"
+ *  - "multipart/form-data"
+ *
+ * @return true if parsable by qdecoder.
+ */
+static bool request_parsable_by_qdecoder(void)
+{
+    bool parsable = false;
+
+    JSE_ENTER("request_parsable_by_qdecoder()")
+
+    /* If qdecoder can parse the content let it. */
+    const char * contentType = getenv("CONTENT_TYPE");
+    if (contentType != NULL)
+    {
+        if (0 == strncmp(contentType,
+                "application/x-www-form-urlencoded",
+                CONST_STRLEN("application/x-www-form-urlencoded")) ||
+            0 == strncmp(contentType,
+                "multipart/form-data",
+                CONST_STRLEN("multipart/form-data")))
+        {
+            parsable = true;
+        }
+    }
+
+    JSE_EXIT("request_parsable_by_qdecoder()=%s", parsable ? "true" : "false");
+    return parsable;
+}
+
+/**
+ * @brief Returns the request body content length
+ *
+ * This function returns the request body content length or -1 if it is not
+ * defined or is defined but not set in the header.
+ *
+ * @return the request body content length or -1 if not set
+ */
+static int get_request_content_length(void)
+{
+    const char * contentLength = getenv("CONTENT_LENGTH");
+    int length = -1;
+
+    JSE_ENTER("get_request_content_length()")
+
+    if (contentLength != NULL)
+    {
+        length = atoi(contentLength);
+    }
+
+    JSE_EXIT("get_request_content_length()=%d", length);
+    return length;
+}
+
+/**
+ * @brief Creates a property comprising the HTTP request body.
+ *
+ * This function creates a property that comprises the body of the request.
+ * The property is only created if qdecoder does not handle it. QDecoder can
+ * parse the following mime types:
+ *
+ *  - "application/x-www-form-urlencoded"
+ *  - "multipart/form-data"
+ *
+ * If qdecoder cannot handle the mimetype the request body is read in to a
+ * property called "body" so that it can be processed by a script.
+ *
+ * @param ctx the duktape context.
+ * @param idx the index of the Request object.
+ */
+static void create_request_object_body(duk_context *ctx, duk_int_t idx)
+{
+    JSE_ENTER("create_request_object_body()")
+
+    /* Is it a POST, PUT or PATCH? */
+    if (request_has_body())
+    {
+        /* If qdecoder doesn't handle it, read the body and return it. */
+        if (!request_parsable_by_qdecoder())
+        {
+            /* Negative content length means not set */
+            int length = get_request_content_length();
+            if (length > 0)
+            {
+                /* Easy case. We know the size. */
+                size_t size = (size_t)length;
+
+                char * buffer = (char*)calloc(size, sizeof(char));
+                if (buffer != NULL)
+                {
+                    /* Use buffered streams because FCGI redirects these and
+                       we want to read from FCGI's stdin when enabled. */
+                    size_t bytes = fread(buffer, 1, size, stdin);
+
+                    /* bytes short when error or EOF */
+                    if (bytes < size && ferror(stdin))
+                    {
+                        JSE_ERROR("read() failed: %s", strerror(errno))
+                    }
+                    else
+                    {
+                        /* EOF is fine */
+                        duk_push_lstring(ctx, buffer, bytes);
+                        duk_put_prop_string(ctx, idx, "Body");
+                    }
+
+                    free(buffer);
+                }
+            }
+            /* else no body to return */
+        }
+    }
+
+    JSE_EXIT("create_request_object_body()")
+}
+
+/**
+ * @brief Creates a request object.
+ *
+ * Creates a global JavaScipt object called "Request" which comprises the
+ * HTTP request data including the environment variables, query parameters
+ * etc.
+ *
+ * @param jse_ctx the jse context.
+ *
+ * @return 0.
+ */
+static duk_int_t create_request_object(jse_context_t *jse_ctx)
+{
+    duk_context *ctx = jse_ctx->ctx;
+    qentry_t *req = jse_ctx->req;
+    duk_int_t idx = duk_push_object(ctx);
+
+    create_request_object_params(ctx, req, idx);
+    create_request_object_envs(ctx, idx);
+    create_request_object_body(ctx, idx);
+
+    duk_put_global_string(ctx, JSE_REQUEST_OBJECT_NAME);
+
+    return 0;
+}
+
+ /**
+ * @brief Returns a simple HTTP server error response.
+ *
+ * @param status the HTTP status.
+ * @param msg the message.
+ */
+static void basic_return_error(int status)
+{
+    const char * msg = msg_for_http_status(status);
+
+    printf("Status: %d %s\r\nContent-Type: text/plain\r\n\r\n%s\r\n", status, msg, msg);
+}
+
+/**
+ * @brief Handle an HTTP request
+ *
+ * A note on error return codes.
+ *
+ * Returning an error from this function means the an error occurred and it
+ * was not reported to the caller. This means that if in CGI mode and
+ * qdecoder was initialised correctly an error will be reported as an HTTP
+ * error status and the function will return success. Similarly if in
+ * command line mode and the error is a script error and reported on stderr,
+ * the function will return success.
+ *
+ * So if this function returns an error status it should be handled.
+ *
+ * @param jse_ctx the jse context.
+ * @return an error code or 0.
+ */
+static duk_int_t handle_request(jse_context_t *jse_ctx)
+{
+    duk_int_t ret = DUK_ERR_ERROR;
+
+    JSE_ENTER("handle_request(%p)", jse_ctx)
+
+    ret = bind_functions(jse_ctx); 
+    if (ret == 0)
+    {
+        /* Set the file upload options (POST only) */
+        if (process_post)
+        {
+            jse_ctx->req = qcgireq_setoption(jse_ctx->req, true, upload_dir, JSE_UPLOAD_EXPIRY_SECS);
+        }
+
+        /* Parse the request */
+        if (process_post)
+        {
+            jse_ctx->req = qcgireq_parse(jse_ctx->req, Q_CGI_POST);
+        }
 
         if (process_get)
         {
@@ -1592,29 +2422,40 @@ static duk_int_t handle_request(jse_context_t *jse_ctx)
             }
             else
             {
-                /* Iterate through the buffer of printed content. */
-                while (first_print_item != NULL)
-                {
-                    print_buffer_item_t * item = first_print_item;
-
-                    first_print_item = item->next;
-                    free(item->string);
-                    free(item);
-                }
-                last_print_item = NULL;
+                discard_print_buffer();
 
                 /* In case of an error, an error object is on the duktape stack */
                 return_error(jse_ctx, HTTP_STATUS_INTERNAL_SERVER_ERROR, "text/html", 
                     "<html><head><title>Internal server error</title></head><body>%s</body></html>",
                     duk_safe_to_string(jse_ctx->ctx, -1));
 
-                duk_pop(jse_ctx->ctx);
+                duk_pop(jse_ctx->ctx);
+            }
+
+            /* The client has its answer, anything else happens in our time */
+            if (!cache_revalidating)
+            {
+                finish_response();
+                jse_stats_add("response.usec", (long)(jse_time_usec() - request_start_usec));
             }
 
+#ifdef ENABLE_FASTCGI
+            /* The response is published so waiting processes need not wait
+               for the deferred work and tear down too */
+            jse_coalesce_end();
+#endif
+
+            run_after_response(jse_ctx);
+
             /* Gets freed on subsequent requests but it's no longer relevent once the request has been handled */
             free(http_contenttype);
             http_contenttype = NULL;
 
+            cache_ttl_secs = -1;
+            cache_stale_secs = 0;
+            free(cache_vary);
+            cache_vary = NULL;
+
             ret = 0;
         }
         /* An HTTP method was set but we failed to parse. */
@@ -1646,60 +2487,646 @@ static duk_int_t handle_request(jse_context_t *jse_ctx)
                 ret = run_stdin(jse_ctx);
             }
 
-            JSE_VERBOSE("ret=%d", ret)
-            if (ret != 0)
-            {
-                fprintf(stderr, "Script error: %s\n", duk_safe_to_string(jse_ctx->ctx, -1));
+            JSE_VERBOSE("ret=%d", ret)
+            if (ret != 0)
+            {
+                fprintf(stderr, "Script error: %s\n", duk_safe_to_string(jse_ctx->ctx, -1));
+
+                /* Exit the process */
+                exit(EXIT_FATAL);
+            }
+
+            run_after_response(jse_ctx);
+        }
+
+        /* clean up qdecoder */
+        if (jse_ctx->req != NULL)
+        {
+            jse_ctx->req->free(jse_ctx->req);
+            jse_ctx->req = NULL;
+        }
+
+        unbind_functions(jse_ctx);
+    }
+    else
+    {
+        JSE_ERROR("bind_functions() failed!")
+    }
+
+    JSE_EXIT("handle_request()=%d", ret)
+    return ret;
+}
+
+/**
+ * Displays help on stderr.
+ */
+static void help(const char* name)
+{
+    fprintf(stderr,
+"Usage: %s [OPTION]... [FILENAME]\n"
+"Run a JavaScript script as a CGI request.\n"
+"\n"
+"Mandatory arguments to long options are mandatory for short options too.\n"
+"  -c, --cookies            Handle cookie requests.\n"
+"  -e, --enter-exit         Enable enter-exit debug logging.\n"
+"  -g, --get                Handle GET requests.\n"
+"  -h, --help               Display this help.\n"
+"  -p, --post               Handle POST requests.\n"
+"  -u, --upload-dir         Override the default file upload directory.\n"
+"  -v, --verbose            Verbosity. Multiple uses increases vebosity.\n"
+#ifdef ENABLE_COSA
+"  -n, --no-ccsp            Do not initialise CCSP.\n"
+"      --discovery-ttl=SECS Cache the CCSP component for a namespace, 0 to disable.\n"
+"      --type-manifest=FILE Load CCSP parameter types from FILE.\n"
+"      --cosa-memo          Memoise CCSP parameter values during a request.\n"
+"      --hot-params=FILE    Cache the CCSP parameters listed in FILE across requests.\n"
+"      --hot-ttl=SECS       Cache hot parameters that are not notified for SECS.\n"
+"      --cosad-socket=PATH  Use the jse-cosad socket PATH, \"none\" to never use it.\n"
+"      --cosa-threads=N     Query up to N+1 CCSP components at once, 0 to disable.\n"
+"      --cosa-timeout=MS    Fail CCSP calls taking more than MS milliseconds.\n"
+"      --cosa-breaker=N     Stop calling a component after N failures, 0 to disable.\n"
+"      --cosa-cooldown=SECS The time to stop calling a failing component for.\n"
+"      --cosa-record=FILE   Append every CCSP call to the trace FILE.\n"
+"      --cosa-replay=FILE   Answer CCSP calls from the trace FILE instead of CCSP.\n"
+"      --cosa-replay-scale=PERCENT The percentage of the recorded time replayed calls take.\n"
+#endif
+#ifdef ENABLE_COSA_MOCK
+"      --cosa-mock=FILE     Use the data model snapshot FILE instead of CCSP.\n"
+"      --cosa-mock-latency=USEC The latency of each mock component call.\n"
+#endif
+#ifdef ENABLE_FASTCGI
+"      --gc-every=N         Release memory every N requests.\n"
+"      --gc-growth=KB       Release memory when the heap grows by KB.\n"
+"      --gc-idle=MS         Release memory when idle for MS milliseconds.\n"
+"      --queue-deadline=MS  Reject requests queued for more than MS milliseconds.\n"
+"      --retry-after=SECS   The Retry-After value for rejected requests.\n"
+"      --cache-size=KB      The response cache size, 0 to disable.\n"
+"      --coalesce           Coalesce all identical concurrent GET requests.\n"
+"      --coalesce-dir=DIR   The directory for the coalescing files.\n"
+"      --coalesce-wait=MS   The time to wait for a coalesced response.\n"
+#endif
+"\n"
+"Exit status:\n"
+" 0  if OK,\n"
+" 1  if an ERROR,\n"
+" 2  if a FATAL error.\n", name);
+}
+
+/**
+ * @brief Converts an option argument to a non-negative number.
+ *
+ * Exits the process if the argument is invalid.
+ *
+ * @param name the long option name.
+ * @param arg the option argument.
+ * @return the value.
+ */
+static long option_to_long(const char * name, const char * arg)
+{
+    char * end = NULL;
+    long value;
+
+    errno = 0;
+    value = strtol(arg, &end, 10);
+    if (errno != 0 || end == arg || *end != '\0' || value < 0)
+    {
+        JSE_ERROR("Invalid value for --%s: \"%s\"", name, arg)
+        exit(EXIT_FAILURE);
+    }
+
+    return value;
+}
+
+/**
+ * @brief Parses the options.
+ *
+ * This is used for both the command line and the options in the
+ * JSE_ARGUMENTS environment variable. Invalid options in the environment
+ * are ignored.
+ *
+ * @param argc the argument count.
+ * @param argv the array of argument strings.
+ * @param from_env set true if the options come from the environment.
+ */
+static void parse_options(int argc, char **argv, bool from_env)
+{
+    static struct option long_options[] =
+    {
+        {"cookies",     no_argument,       0, 'c' },
+        {"enter-exit",  no_argument,       0, 'e' },
+        {"get",         no_argument,       0, 'g' },
+        {"help",        no_argument,       0, 'h' },
+#ifdef ENABLE_COSA
+        {"no-ccsp",     no_argument,       0, 'n' },
+        {"discovery-ttl", required_argument, 0, OPT_DISCOVERY_TTL },
+        {"type-manifest", required_argument, 0, OPT_TYPE_MANIFEST },
+        {"cosa-memo",   no_argument,       0, OPT_COSA_MEMO },
+        {"hot-params",  required_argument, 0, OPT_HOT_PARAMS },
+        {"hot-ttl",     required_argument, 0, OPT_HOT_TTL },
+        {"cosad-socket", required_argument, 0, OPT_COSAD_SOCKET },
+        {"cosa-threads", required_argument, 0, OPT_COSA_THREADS },
+        {"cosa-timeout", required_argument, 0, OPT_COSA_TIMEOUT },
+        {"cosa-breaker", required_argument, 0, OPT_COSA_BREAKER },
+        {"cosa-cooldown", required_argument, 0, OPT_COSA_COOLDOWN },
+        {"cosa-record", required_argument, 0, OPT_COSA_RECORD },
+        {"cosa-replay", required_argument, 0, OPT_COSA_REPLAY },
+        {"cosa-replay-scale", required_argument, 0, OPT_COSA_REPLAY_SCALE },
+#endif
+#ifdef ENABLE_COSA_MOCK
+        {"cosa-mock",   required_argument, 0, OPT_COSA_MOCK },
+        {"cosa-mock-latency", required_argument, 0, OPT_COSA_MOCK_LATENCY },
+#endif
+        {"post",        no_argument,       0, 'p' },
+        {"upload-dir",  required_argument, 0, 'u' },
+        {"verbose",     no_argument,       0, 'v' },
+#ifdef ENABLE_FASTCGI
+        {"gc-every",    required_argument, 0, OPT_GC_EVERY },
+        {"gc-growth",   required_argument, 0, OPT_GC_GROWTH },
+        {"gc-idle",     required_argument, 0, OPT_GC_IDLE },
+        {"queue-deadline", required_argument, 0, OPT_QUEUE_DEADLINE },
+        {"retry-after", required_argument, 0, OPT_RETRY_AFTER },
+        {"cache-size",  required_argument, 0, OPT_CACHE_SIZE },
+        {"coalesce",    no_argument,       0, OPT_COALESCE },
+        {"coalesce-dir", required_argument, 0, OPT_COALESCE_DIR },
+        {"coalesce-wait", required_argument, 0, OPT_COALESCE_WAIT },
+#endif
+        {0,             0,                 0,  0  }
+    };
+
+    /* Zero rather than one makes getopt reinitialise between calls */
+    optind = 0;
+    opterr = from_env ? 0 : 1;
+
+    while (1)
+    {
+        int c, option_index = 0;
+
+#ifdef JSE_DEBUG_ENABLED
+        c = getopt_long(argc, argv, "ceghnpu:v", long_options, &option_index);
+#else
+        c = getopt_long(argc, argv, "cghnpu:", long_options, &option_index);
+#endif
+        if (c == -1)
+        {
+            break;
+        }
+
+        switch (c)
+        {
+            case 'c':
+                JSE_DEBUG("Cookie processing enabled!")
+                process_cookie = true;
+                break;
+
+#ifdef JSE_DEBUG_ENABLED
+            case 'e':
+                JSE_DEBUG("Enter/Exit debug enabled!")
+                jse_enter_exit = true;
+                break;
+#endif
+
+            case 'g':
+                JSE_DEBUG("GET processing enabled!")
+                process_get = true;
+                break;
+
+            case 'h':
+                if (!from_env)
+                {
+                    help(argv[0]);
+                    exit(EXIT_SUCCESS);
+                }
+                break;
+
+#ifdef ENABLE_COSA
+            case 'n':
+                JSE_DEBUG("CCSP init disabled")
+                jse_cosa_set_auto_init(false);
+                break;
+
+            case OPT_DISCOVERY_TTL:
+                jse_cosa_cache_set_discovery_ttl(option_to_long("discovery-ttl", optarg));
+                JSE_DEBUG("Discovery TTL %ss", optarg)
+                break;
+
+            case OPT_TYPE_MANIFEST:
+                JSE_DEBUG("Type manifest: %s", optarg)
+                /* Failure isn't terminal, the types are learnt as they are read */
+                (void) jse_cosa_bus_load_types(optarg);
+                break;
+
+            case OPT_COSA_MEMO:
+                JSE_DEBUG("Cosa memo enabled")
+                jse_cosa_set_memo(true);
+                break;
+
+            case OPT_HOT_PARAMS:
+                JSE_DEBUG("Hot parameters: %s", optarg)
+                /* Failure isn't terminal, the parameters are just not cached */
+                (void) jse_cosa_bus_load_hot(optarg);
+                break;
+
+            case OPT_HOT_TTL:
+                jse_cosa_cache_set_hot_ttl(option_to_long("hot-ttl", optarg));
+                JSE_DEBUG("Hot TTL %ss", optarg)
+                break;
+
+            case OPT_COSAD_SOCKET:
+                JSE_DEBUG("jse-cosad socket: %s", optarg)
+                if (strcmp(optarg, "none") == 0)
+                {
+                    jse_cosa_bus_set_broker(NULL);
+                }
+                else
+                {
+                    /* The options may come from the environment, which is freed */
+                    jse_cosa_bus_set_broker(strdup(optarg));
+                }
+                break;
+
+            case OPT_COSA_THREADS:
+                jse_cosa_pool_set_threads((int)option_to_long("cosa-threads", optarg));
+                JSE_DEBUG("Cosa threads %s", optarg)
+                break;
+
+            case OPT_COSA_TIMEOUT:
+                jse_cosa_bus_set_timeout(option_to_long("cosa-timeout", optarg));
+                JSE_DEBUG("Cosa timeout %sms", optarg)
+                break;
+
+            case OPT_COSA_BREAKER:
+                jse_cosa_guard_set_threshold((int)option_to_long("cosa-breaker", optarg));
+                JSE_DEBUG("Cosa breaker after %s failures", optarg)
+                break;
+
+            case OPT_COSA_COOLDOWN:
+                jse_cosa_guard_set_cooldown(option_to_long("cosa-cooldown", optarg));
+                JSE_DEBUG("Cosa breaker cooldown %ss", optarg)
+                break;
+
+            case OPT_COSA_RECORD:
+                JSE_DEBUG("Cosa record: %s", optarg)
+                /* The options may come from the environment, which is freed */
+                jse_cosa_bus_set_record(strdup(optarg));
+                break;
+
+            case OPT_COSA_REPLAY:
+                JSE_DEBUG("Cosa replay: %s", optarg)
+                jse_cosa_trace_set_replay(strdup(optarg));
+                jse_cosa_bus_set_backend(&jse_cosa_replay_backend);
+                break;
+
+            case OPT_COSA_REPLAY_SCALE:
+                jse_cosa_trace_set_replay_scale(option_to_long("cosa-replay-scale", optarg));
+                JSE_DEBUG("Cosa replay scale %s%%", optarg)
+                break;
+#endif
+
+#ifdef ENABLE_COSA_MOCK
+            case OPT_COSA_MOCK:
+                JSE_DEBUG("Cosa mock snapshot: %s", optarg)
+                /* The options may come from the environment, which is freed */
+                jse_cosa_mock_set_snapshot(strdup(optarg));
+                jse_cosa_bus_set_backend(&jse_cosa_mock_backend);
+                break;
+
+            case OPT_COSA_MOCK_LATENCY:
+                jse_cosa_mock_set_latency(option_to_long("cosa-mock-latency", optarg));
+                JSE_DEBUG("Cosa mock latency %sus", optarg)
+                break;
+#endif
+
+            case 'p':
+                JSE_DEBUG("POST processing enabled!")
+                process_post = true;
+                break;
+
+            case 'u':
+                JSE_DEBUG("Upload directory: %s", optarg)
+                upload_dir = strdup(optarg);
+                break;
+
+#ifdef JSE_DEBUG_ENABLED
+            case 'v':
+                jse_verbosity ++;
+                break;
+#endif
+
+#ifdef ENABLE_FASTCGI
+            case OPT_GC_EVERY:
+                gc_every = option_to_long("gc-every", optarg);
+                JSE_DEBUG("Release memory every %ld requests", gc_every)
+                break;
+
+            case OPT_GC_GROWTH:
+                gc_growth_kb = option_to_long("gc-growth", optarg);
+                JSE_DEBUG("Release memory on %ldKB heap growth", gc_growth_kb)
+                break;
+
+            case OPT_GC_IDLE:
+                gc_idle_ms = option_to_long("gc-idle", optarg);
+                JSE_DEBUG("Release memory when idle for %ldms", gc_idle_ms)
+                break;
+
+            case OPT_QUEUE_DEADLINE:
+                queue_deadline_ms = option_to_long("queue-deadline", optarg);
+                JSE_DEBUG("Queue deadline %ldms", queue_deadline_ms)
+                break;
+
+            case OPT_RETRY_AFTER:
+                retry_after_secs = option_to_long("retry-after", optarg);
+                JSE_DEBUG("Retry after %lds", retry_after_secs)
+                break;
+
+            case OPT_CACHE_SIZE:
+                jse_cache_set_limit((size_t)option_to_long("cache-size", optarg) * 1024);
+                JSE_DEBUG("Response cache size %luKB", (unsigned long)(jse_cache_get_limit() / 1024))
+                break;
+
+            case OPT_COALESCE:
+                JSE_DEBUG("Coalescing all GET requests")
+                coalesce_all = true;
+                break;
+
+            case OPT_COALESCE_DIR:
+                JSE_DEBUG("Coalescing directory: %s", optarg)
+                jse_coalesce_set_dir(strdup(optarg));
+                break;
+
+            case OPT_COALESCE_WAIT:
+                coalesce_wait_ms = option_to_long("coalesce-wait", optarg);
+                JSE_DEBUG("Coalescing wait %ldms", coalesce_wait_ms)
+                break;
+#endif
+
+            default:
+                if (from_env)
+                {
+                    JSE_WARNING("Invalid option in JSE_ARGUMENTS")
+                }
+                else
+                {
+                    JSE_ERROR("Invalid option")
+                    exit(EXIT_FAILURE);
+                }
+                break;
+        }
+    }
+}
+
+/**
+ * @brief Parses the options in the JSE_ARGUMENTS environment variable.
+ *
+ * The options are space separated and are the same as the command line
+ * options. A script filename is ignored.
+ *
+ * @param name the program name.
+ * @param jseargs the value of the environment variable.
+ */
+static void parse_env_options(char * name, const char * jseargs)
+{
+    char * env = strdup(jseargs);
+    char ** args = NULL;
+    char * arg = NULL;
+    int count = 0;
+    int max = 0;
+
+    if (env == NULL)
+    {
+        JSE_ERROR("strdup() failed: %s", strerror(errno))
+        exit(EXIT_FAILURE);
+    }
+
+    /* Worst case is single characters separated by single spaces */
+    max = (int)(strlen(env) / 2) + 2;
+
+    /* One extra for the NULL terminator */
+    args = (char **)calloc((size_t)max + 1, sizeof(char *));
+    if (args == NULL)
+    {
+        JSE_ERROR("calloc() failed: %s", strerror(errno))
+        exit(EXIT_FAILURE);
+    }
+
+    args[count++] = name;
+
+    arg = strtok(env, " ");
+    while (arg != NULL && count < max)
+    {
+        JSE_DEBUG("arg=%s", arg)
+
+        args[count++] = arg;
+        arg = strtok(NULL, " ");
+    }
+
+    parse_options(count, args, true);
+
+    // done processing env
+    free(args);
+    free(env);
+}
+
+#ifdef ENABLE_FASTCGI
+/**
+ * @brief Returns the size of the C heap.
+ *
+ * @return the size in bytes or 0 if not known.
+ */
+static size_t heap_size(void)
+{
+    size_t size = 0;
+
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+    struct mallinfo2 mi = mallinfo2();
+
+    size = mi.arena + mi.hblkhd;
+#elif defined(__GLIBC__)
+    struct mallinfo mi = mallinfo();
+
+    size = (size_t)(unsigned int)mi.arena + (size_t)(unsigned int)mi.hblkhd;
+#endif
+
+    return size;
+}
+
+/**
+ * @brief Releases freed memory back to the system.
+ *
+ * Each request creates and destroys a duktape heap, all of its garbage
+ * being collected when it is destroyed, after the response is complete.
+ * What remains is freed memory held on to by the C heap. Releasing it
+ * is done between requests so that it is off the critical path.
+ *
+ * @param reason the reason for releasing the memory.
+ */
+static void release_memory(const char * reason)
+{
+    uint64_t start = jse_time_usec();
+
+#ifdef __GLIBC__
+    (void) malloc_trim(0);
+#endif
+
+    gc_requests = 0;
+    gc_heap_size = heap_size();
 
-                /* Exit the process */
-                exit(EXIT_FATAL);
-            }
-        }
+    jse_stats_add("gc.usec", (long)(jse_time_usec() - start));
+    jse_stats_add("gc.count", 1);
 
-        /* clean up qdecoder */
-        if (jse_ctx->req != NULL)
+    JSE_DEBUG("Memory released (%s), heap size: %lu", reason, (unsigned long)gc_heap_size)
+
+    /* reason is only used for debug */
+    (void) reason;
+}
+
+/**
+ * @brief Releases memory after a request if the policy requires it.
+ */
+static void release_memory_after_request(void)
+{
+    gc_requests ++;
+
+    if (gc_every > 0 && gc_requests >= gc_every)
+    {
+        release_memory("requests");
+    }
+    else if (gc_growth_kb > 0 && heap_size() > gc_heap_size + ((size_t)gc_growth_kb * 1024))
+    {
+        release_memory("growth");
+    }
+}
+
+/**
+ * @brief Accepts the next Fast CGI request.
+ *
+ * If configured to do so, memory is released if no request arrives
+ * within the idle time. This relies upon the server making a new
+ * connection for each request.
+ *
+ * @return the FCGI_Accept() result.
+ */
+static int accept_request(void)
+{
+    if (gc_idle_ms > 0 && gc_requests > 0 && !FCGX_IsCGI())
+    {
+        struct pollfd pfd;
+        int ret = -1;
+
+        pfd.fd = FCGI_LISTENSOCK_FILENO;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        TEMP_FAILURE_RETRY(ret = poll(&pfd, 1, (int)gc_idle_ms));
+        if (ret == 0)
         {
-            jse_ctx->req->free(jse_ctx->req);
-            jse_ctx->req = NULL;
+            release_memory("idle");
         }
+    }
 
-        unbind_functions(jse_ctx);
+    return FCGI_Accept();
+}
+
+/**
+ * @brief Returns how long the current request was queued for.
+ *
+ * The front end server must supply the time it received the request in
+ * the X-Request-Start header, e.g. for nginx:
+ *
+ *   fastcgi_param HTTP_X_REQUEST_START "t=${msec}";
+ *
+ * The value may optionally be prefixed by "t=" and may be in seconds (with
+ * or without a fraction), milliseconds or microseconds since the epoch.
+ *
+ * @return the time in microseconds or -1 if not known.
+ */
+static long request_queue_usec(void)
+{
+    const char * header = getenv("HTTP_X_REQUEST_START");
+    struct timespec ts;
+    char * end = NULL;
+    double start;
+    double now;
+
+    if (header == NULL)
+    {
+        return -1;
+    }
+
+    if (!strncmp(header, "t=", 2))
+    {
+        header += 2;
+    }
+
+    errno = 0;
+    start = strtod(header, &end);
+    if (errno != 0 || end == header || start <= 0)
+    {
+        JSE_WARNING("Invalid X-Request-Start: %s", header)
+        return -1;
+    }
+
+    /* Work out the units from the magnitude */
+    if (start > 1e14)
+    {
+        /* Microseconds */
+    }
+    else if (start > 1e11)
+    {
+        start *= 1e3;
     }
     else
     {
-        JSE_ERROR("bind_functions() failed!")
+        start *= 1e6;
     }
 
-    JSE_EXIT("handle_request()=%d", ret)
-    return ret;
+    if (clock_gettime(CLOCK_REALTIME, &ts) != 0)
+    {
+        JSE_ERROR("clock_gettime() failed: %s", strerror(errno))
+        return -1;
+    }
+
+    now = ((double)ts.tv_sec * 1e6) + ((double)ts.tv_nsec / 1e3);
+
+    /* Allow for the clocks being slightly out */
+    return now > start ? (long)(now - start) : 0;
 }
 
 /**
- * Displays help on stderr.
+ * @brief Checks whether the current request should be rejected.
+ *
+ * A request that has already waited longer than the queue deadline is
+ * answered with a 503 immediately. The front end has likely given up on
+ * it and running the script would only delay the requests queued behind.
+ *
+ * @return true if the request was rejected.
  */
-static void help(const char* name)
+static bool shed_request(void)
 {
-    fprintf(stderr,
-"Usage: %s [OPTION]... [FILENAME]\n"
-"Run a JavaScript script as a CGI request.\n"
-"\n"
-"Mandatory arguments to long options are mandatory for short options too.\n"
-"  -c, --cookies            Handle cookie requests.\n"
-"  -e, --enter-exit         Enable enter-exit debug logging.\n"
-"  -g, --get                Handle GET requests.\n"
-"  -h, --help               Display this help.\n"
-"  -p, --post               Handle POST requests.\n"
-"  -u, --upload-dir         Override the default file upload directory.\n"
-"  -v, --verbose            Verbosity. Multiple uses increases vebosity.\n"
-#ifdef BUILD_RDK
-"  -n, --no-ccsp            Do not initialise CCSP.\n"
-#endif
-"\n"
-"Exit status:\n"
-" 0  if OK,\n"
-" 1  if an ERROR,\n"
-" 2  if a FATAL error.\n", name);
+    long wait_usec = request_queue_usec();
+
+    if (wait_usec < 0)
+    {
+        return false;
+    }
+
+    jse_stats_add("queue.wait_usec", wait_usec);
+
+    if (queue_deadline_ms == 0 || wait_usec <= queue_deadline_ms * 1000)
+    {
+        return false;
+    }
+
+    JSE_WARNING("Request queued for %ldus, rejecting!", wait_usec)
+
+    jse_stats_add("queue.shed", 1);
+
+    printf("Status: %d %s\r\nRetry-After: %ld\r\nContent-Type: text/plain\r\n\r\n%s\r\n",
+        HTTP_STATUS_SERVICE_UNAVAILABLE, msg_for_http_status(HTTP_STATUS_SERVICE_UNAVAILABLE),
+        retry_after_secs, msg_for_http_status(HTTP_STATUS_SERVICE_UNAVAILABLE));
+
+    return true;
 }
+#endif
 
 /**
  * main!
@@ -1713,95 +3140,12 @@ int main(int argc, char **argv)
 {
     char * jseargs = NULL;
     char * filename = NULL;
-    char * arg = NULL;
     duk_int_t ret = DUK_ERR_ERROR;
     
-#ifdef BUILD_RDK
-    /* By default we initialise CCSP unless turned off on the command line */
-    bool init_ccsp = true;
-#endif
     JSE_DEBUG_INIT()
     JSE_VERBOSE("main()")
-    
-    while (1)
-    {
-        int c, option_index = 0;
-        static struct option long_options[] =
-        {
-            {"cookies",     no_argument,       0, 'c' },
-            {"enter-exit",  no_argument,       0, 'e' },
-            {"get",         no_argument,       0, 'g' },
-            {"help",        no_argument,       0, 'h' },
-#ifdef BUILD_RDK
-            {"no-ccsp",     no_argument,       0, 'n' },
-#endif
-            {"post",        no_argument,       0, 'p' },
-            {"upload-dir",  required_argument, 0, 'u' },
-            {"verbose",     no_argument,       0, 'v' },
-            {0,             0,                 0,  0  }
-        };
-
-#ifdef JSE_DEBUG_ENABLED
-        c = getopt_long(argc, argv, "ceghnpu:v", long_options, &option_index);
-#else
-        c = getopt_long(argc, argv, "cghnpu:", long_options, &option_index);
-#endif
-        if (c == -1)
-        {
-            break;
-        }
-
-        switch (c)
-        {
-            case 'c':
-                JSE_DEBUG("Cookie processing enabled!")
-                process_cookie = true;
-                break;
-
-#ifdef JSE_DEBUG_ENABLED
-            case 'e':
-                JSE_DEBUG("Enter/Exit debug enabled!")
-                jse_enter_exit = true;
-                break;
-#endif
-
-            case 'g':
-                JSE_DEBUG("GET processing enabled!")
-                process_get = true;
-                break;
-
-            case 'h':
-                help(argv[0]);
-                exit(EXIT_SUCCESS);
-
-#ifdef BUILD_RDK
-            case 'n':
-                JSE_DEBUG("CCSP init disabled")
-                init_ccsp = false;
-                break;
-#endif
-
-            case 'p':
-                JSE_DEBUG("POST processing enabled!")
-                process_post = true;
-                break;
-
-            case 'u':
-                JSE_DEBUG("Upload directory: %s", optarg)
-                upload_dir = strdup(optarg);
-                break;
-
-#ifdef JSE_DEBUG_ENABLED
-            case 'v':
-                jse_verbosity ++;
-                break;
-#endif
 
-            default:
-                JSE_ERROR("Invalid option")
-                exit(EXIT_FAILURE);
-        }
-    }
+    parse_options(argc, argv, false);
 
     if (optind < argc)
     {
@@ -1825,89 +3169,7 @@ int main(int argc, char **argv)
     jseargs = getenv("JSE_ARGUMENTS");
     if (jseargs != NULL)
     {
-        char * env = strdup(jseargs);
-        if (env == NULL)
-        {
-            JSE_ERROR("strdup() failed: %s", strerror(errno))
-            exit(EXIT_FAILURE);
-        }
-
-        arg = strtok(env, " ");
-        while (arg != NULL)
-        {
-            JSE_DEBUG("arg=%s", arg)
-
-            if (!strcmp("-c", arg) || !strcmp("--cookie", arg))
-            {
-                process_cookie = true;
-            }
-#ifdef JSE_DEBUG_ENABLED
-            else
-            if (!strcmp("-e", arg) || !strcmp("--enter-exit", arg))
-            {
-                jse_enter_exit = true;
-            }
-#endif
-            else
-            if (!strcmp("-g", arg) || !strcmp("--get", arg))
-            {
-                process_get = true;
-            }
-#ifdef BUILD_RDK
-            else
-            if (!strcmp("-n", arg) || !strcmp("--no-ccsp", arg))
-            {
-                init_ccsp = false;
-            }
-#endif
-            else
-            if (!strncmp("-u", arg, 2))
-            {
-                if (strlen(arg) > 2)
-                {
-                    /* path immediately follows option */
-                    arg += 2;
-                }
-                else
-                {
-                    arg = strtok(NULL, " ");
-                }
-                
-                if (arg == NULL) {
-                    JSE_WARNING("Missing parameter for -u")
-                    break;
-                }
-
-                upload_dir = strdup(arg);
-            }
-            else 
-            if (!strcmp("--upload-dir", arg))
-            {
-                arg = strtok(NULL, " ");
-                if (arg == NULL) {
-                    JSE_WARNING("Missing parameter for --upload-dir")
-                    break;
-                }
-
-                upload_dir = strdup(arg);
-            }
-            else
-            if (!strcmp("-p", arg) || !strcmp("--post", arg))
-            {
-                process_post = true;
-            }
-#ifdef JSE_DEBUG_ENABLED
-            else
-            if (!strcmp("-v", arg) || !strcmp("--verbose", arg))
-            {
-                jse_verbosity ++;
-            }
-#endif
-
-            arg = strtok(NULL, " ");
-        }
-        // done processing env
-        free(env);
+        parse_env_options(argv[0], jseargs);
     }
 
     // Post only
@@ -1925,33 +3187,24 @@ int main(int argc, char **argv)
         }
     }
 
-/* Disable initialisation on start up for FCGI for now. */
-#if defined(BUILD_RDK) && !defined(ENABLE_FASTCGI)
-    /* Try and initialise cosa before the main processing */
-    if (init_ccsp)
-    {
-        JSE_INFO("Initialising COSA!")
-
-        ret = jse_cosa_init();
-        if (ret != 0)
-        {
-            /* Failure isn't terminal. */
-            JSE_WARNING("jse_cosa_init() failed. Will try again later!");
-        }
-        else
-        {
-            cosa_initialised = true;
-        }
-    }
-#endif
+    /* CCSP is initialised by the first Cosa call, if any */
 
 #ifdef ENABLE_FASTCGI
-    while (FCGI_Accept() >= 0)
+    while (accept_request() >= 0)
     {
         ret = DUK_ERR_ERROR;
 
         JSE_INFO("FCGI loop start")
 
+        jse_stats_request_start();
+        request_start_usec = jse_time_usec();
+
+        if (shed_request())
+        {
+            jse_stats_request_log();
+            continue;
+        }
+
         /* For Fast CGI get the script file name from the environment */
         char *filenameenv = getenv("SCRIPT_FILENAME");
         if (filenameenv == NULL)
@@ -1974,37 +3227,41 @@ int main(int argc, char **argv)
 
         JSE_INFO("Script filename: %s", filename)
 
-#ifdef BUILD_RDK
-        /* If we didn't successfully initialise CCSP Cosa but we wanted to
-           lets try again! */
-        if (init_ccsp && !cosa_initialised)
+        if (serve_from_cache(filename) == JSE_CACHE_FRESH)
         {
-            JSE_INFO("Initialising COSA!")
+            free(filename);
+            filename = NULL;
 
-            ret = jse_cosa_init();
-            if (ret != 0)
-            {
-                JSE_WARNING("jse_cosa_init() failed. Will try again later!");
+            jse_stats_add("request.usec", (long)(jse_time_usec() - request_start_usec));
+            jse_stats_request_log();
+            continue;
+        }
 
-                basic_return_error(HTTP_STATUS_INTERNAL_SERVER_ERROR);
+        if (coalesce_request(filename))
+        {
+            end_revalidation();
 
-                free(filename);
-                filename = NULL;
+            free(filename);
+            filename = NULL;
 
-                continue;
-            }
-            else
-            {
-                cosa_initialised = true;
-            }
+            jse_stats_add("request.usec", (long)(jse_time_usec() - request_start_usec));
+            jse_stats_request_log();
+            continue;
         }
+
 #endif
+
+#ifndef ENABLE_FASTCGI
+        jse_stats_request_start();
+        request_start_usec = jse_time_usec();
 #endif
 
         /* Get the script and process it */
         jse_context_t *jse_ctx = jse_context_create(filename);
         if (jse_ctx != NULL)
         {
+            uint64_t teardown_start = 0;
+
             if (init_duktape(jse_ctx) != NULL)
             {
                 if (handle_request(jse_ctx) == 0)
@@ -2012,12 +3269,19 @@ int main(int argc, char **argv)
                     ret = 0;
                 }
 
+                teardown_start = jse_time_usec();
                 cleanup_duktape(jse_ctx);
             }
+            else
+            {
+                teardown_start = jse_time_usec();
+            }
 
             // frees filename
             jse_context_destroy(jse_ctx);
             filename = NULL;
+
+            jse_stats_add("teardown.usec", (long)(jse_time_usec() - teardown_start));
         }
         else
         {
@@ -2033,16 +3297,23 @@ int main(int argc, char **argv)
             ret = 0;
         }
 
+#ifdef ENABLE_FASTCGI
+        end_revalidation();
+        jse_coalesce_end();
+        release_memory_after_request();
+#endif
+
+        jse_stats_add("request.usec", (long)(jse_time_usec() - request_start_usec));
+        jse_stats_request_log();
+
 #ifdef ENABLE_FASTCGI
         JSE_INFO("FCGI loop end")
     }
 #endif
 
-#ifdef BUILD_RDK
-    /* If we successfully initialised CCSP Cosa, shut it down */
-    if (init_ccsp && cosa_initialised) {
-        jse_cosa_shutdown();
-    }
+#ifdef ENABLE_COSA
+    /* If a script initialised CCSP Cosa, shut it down */
+    jse_cosa_shutdown();
 #endif
 
     /* An error is returned only when it hasn't already been handled. */
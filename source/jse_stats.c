@@ -0,0 +1,250 @@
+/*****************************************************************************
+*
+* Copyright 2020 Liberty Global B.V.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "jse_debug.h"
+#include "jse_stats.h"
+
+/** Reference count for binding. */
+static int ref_count = 0;
+
+/** A named statistic */
+struct jse_stat_s
+{
+    /** The name */
+    char name[JSE_STATS_NAME_MAX];
+    /** The running total */
+    long total;
+    /** The total for the current request */
+    long request;
+    /** Set if changed during the current request */
+    bool changed;
+};
+
+typedef struct jse_stat_s jse_stat_t;
+
+/** The statistics. Few enough that a linear search is fine. */
+static jse_stat_t stats[JSE_STATS_MAX];
+
+/** The number of statistics in use */
+static int stats_count = 0;
+
+/**
+ * @brief Finds a statistic creating it if necessary.
+ *
+ * @param name the statistic name.
+ * @param create set true to create the statistic if it does not exist.
+ * @return the statistic or NULL.
+ */
+static jse_stat_t * find_stat(const char * name, bool create)
+{
+    jse_stat_t * stat = NULL;
+    int i;
+
+    for (i = 0; i < stats_count; i++)
+    {
+        if (!strcmp(stats[i].name, name))
+        {
+            stat = &stats[i];
+            break;
+        }
+    }
+
+    if (stat == NULL && create)
+    {
+        if (stats_count < JSE_STATS_MAX && strlen(name) < JSE_STATS_NAME_MAX)
+        {
+            stat = &stats[stats_count++];
+            strcpy(stat->name, name);
+        }
+        else
+        {
+            JSE_WARNING("Cannot create statistic: %s", name)
+        }
+    }
+
+    return stat;
+}
+
+/**
+ * @brief Adds a value to a statistic.
+ *
+ * @param name the statistic name.
+ * @param value the value to add.
+ */
+void jse_stats_add(const char * name, long value)
+{
+    jse_stat_t * stat = find_stat(name, true);
+    if (stat != NULL)
+    {
+        stat->total += value;
+        stat->request += value;
+        stat->changed = true;
+    }
+}
+
+/**
+ * @brief Sets the value of a statistic.
+ *
+ * @param name the statistic name.
+ * @param value the value.
+ */
+void jse_stats_set(const char * name, long value)
+{
+    jse_stat_t * stat = find_stat(name, true);
+    if (stat != NULL)
+    {
+        stat->total = value;
+        stat->request = value;
+        stat->changed = true;
+    }
+}
+
+/**
+ * @brief Returns the running total of a statistic.
+ *
+ * @param name the statistic name.
+ * @return the value or 0 if the statistic does not exist.
+ */
+long jse_stats_get(const char * name)
+{
+    jse_stat_t * stat = find_stat(name, false);
+
+    return stat != NULL ? stat->total : 0;
+}
+
+/**
+ * @brief Marks the start of a request.
+ */
+void jse_stats_request_start(void)
+{
+    int i;
+
+    for (i = 0; i < stats_count; i++)
+    {
+        stats[i].request = 0;
+        stats[i].changed = false;
+    }
+}
+
+/**
+ * @brief Logs the per request totals of the statistics.
+ */
+void jse_stats_request_log(void)
+{
+    char buffer[1024];
+    size_t off = 0;
+    int i;
+
+    buffer[0] = '\0';
+
+    for (i = 0; i < stats_count; i++)
+    {
+        if (stats[i].changed)
+        {
+            int len = snprintf(&buffer[off], sizeof(buffer) - off, " %s=%ld",
+                stats[i].name, stats[i].request);
+            if (len < 0 || (size_t)len >= sizeof(buffer) - off)
+            {
+                break;
+            }
+
+            off += (size_t)len;
+        }
+    }
+
+    JSE_INFO("Request timing:%s", buffer)
+}
+
+/**
+ * @brief The getStats() function binding.
+ *
+ * Returns an object with a property for each statistic. The value of the
+ * property is the running total of the statistic. Takes no arguments.
+ *
+ * @param ctx the duktape context.
+ * @return 1.
+ */
+static duk_ret_t do_get_stats(duk_context * ctx)
+{
+    duk_idx_t obj_idx = duk_push_object(ctx);
+    int i;
+
+    for (i = 0; i < stats_count; i++)
+    {
+        duk_push_number(ctx, (duk_double_t)stats[i].total);
+        duk_put_prop_string(ctx, obj_idx, stats[i].name);
+    }
+
+    /* One item returned, the object */
+    return 1;
+}
+
+/**
+ * @brief Binds a set of JavaScript extensions
+ *
+ * @param jse_ctx the jse context.
+ * @return an error status or 0.
+ */
+duk_int_t jse_bind_stats(jse_context_t * jse_ctx)
+{
+    duk_int_t ret = DUK_ERR_ERROR;
+
+    JSE_ENTER("jse_bind_stats(%p)", jse_ctx)
+
+    JSE_VERBOSE("ref_count=%d", ref_count)
+    if (jse_ctx != NULL)
+    {
+        if (ref_count == 0)
+        {
+            duk_push_c_function(jse_ctx->ctx, do_get_stats, 0);
+            duk_put_global_string(jse_ctx->ctx, "getStats");
+        }
+
+        ref_count ++;
+        ret = 0;
+    }
+
+    JSE_EXIT("jse_bind_stats()=%d", ret)
+    return ret;
+}
+
+/**
+ * @brief Unbinds the JavaScript extensions.
+ *
+ * Actually just decrements the reference count. Needed for fast cgi
+ * since the same process will rebind. Not unbinding is not an issue
+ * as the duktape context is destroyed each time cleaning everything
+ * up.
+ *
+ * @param jse_ctx the jse context.
+ */
+void jse_unbind_stats(jse_context_t * jse_ctx)
+{
+    JSE_ENTER("jse_unbind_stats(%p)", jse_ctx)
+
+    ref_count --;
+    JSE_VERBOSE("ref_count=%d", ref_count)
+
+    /* TODO: Actually unbind */
+
+    JSE_EXIT("jse_unbind_stats()")
+}
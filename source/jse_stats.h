@@ -0,0 +1,97 @@
+/*****************************************************************************
+*
+* Copyright 2020 Liberty Global B.V.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*****************************************************************************/
+
+#ifndef JSE_STATS_H
+#define JSE_STATS_H
+
+#include "jse_common.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/** The maximum number of named statistics */
+#define JSE_STATS_MAX 96
+
+/** The maximum length of a statistic name including the terminator */
+#define JSE_STATS_NAME_MAX 48
+
+/**
+ * @brief Adds a value to a statistic.
+ *
+ * The statistic is created the first time it is used. The value is added
+ * both to the running total and to the total for the current request.
+ *
+ * @param name the statistic name.
+ * @param value the value to add.
+ */
+void jse_stats_add(const char * name, long value);
+
+/**
+ * @brief Sets the value of a statistic.
+ *
+ * Used for values that are a level rather than a count, e.g. a state or
+ * the number of entries in a cache.
+ *
+ * @param name the statistic name.
+ * @param value the value.
+ */
+void jse_stats_set(const char * name, long value);
+
+/**
+ * @brief Returns the running total of a statistic.
+ *
+ * @param name the statistic name.
+ * @return the value or 0 if the statistic does not exist.
+ */
+long jse_stats_get(const char * name);
+
+/**
+ * @brief Marks the start of a request.
+ *
+ * Resets the per request totals of all statistics.
+ */
+void jse_stats_request_start(void);
+
+/**
+ * @brief Logs the per request totals of the statistics.
+ *
+ * Only statistics that changed during the request are logged.
+ */
+void jse_stats_request_log(void);
+
+/**
+ * @brief Binds a set of JavaScript extensions
+ *
+ * @param jse_ctx the jse context.
+ * @return an error status or 0.
+ */
+duk_int_t jse_bind_stats(jse_context_t * jse_ctx);
+
+/**
+ * @brief Unbinds the JavaScript extensions.
+ *
+ * @param jse_ctx the jse context.
+ */
+void jse_unbind_stats(jse_context_t * jse_ctx);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif